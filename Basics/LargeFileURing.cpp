@@ -0,0 +1,593 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2011 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+#include "StdDefines.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef DETECTED_OS_LINUX
+# include <linux/version.h>
+# include <sys/syscall.h>
+# if LINUX_VERSION_CODE >= KERNEL_VERSION(5,1,0) && \
+     defined(__NR_io_uring_setup)
+#  include <linux/io_uring.h>
+#  define TUVOK_HAVE_IO_URING 1
+# endif
+#endif
+#ifndef NDEBUG
+# include <iostream>
+# define DEBUG(...) do { std::cerr << __VA_ARGS__ << "\n"; } while(0)
+#else
+# define DEBUG(...) do { /* nothing, debug msg removed. */ } while(0)
+#endif
+#include "LargeFileURing.h"
+
+namespace {
+  const unsigned QUEUE_DEPTH = 64;
+  /// enqueue'd reads are submitted once this many are queued.
+  const unsigned BATCH = 16;
+  /// registered buffers.  Their memory is locked, so they are limited by
+  /// RLIMIT_MEMLOCK; we do without them if the kernel refuses.
+  const size_t   BUFFERS = 16;
+  const size_t   BUFFER_SIZE = 256*1024;
+  /// alignment O_DIRECT needs for offsets, sizes and memory.  The logical
+  /// block size of most devices is smaller.
+  const uint64_t DIRECT_ALIGNMENT = 4096;
+}
+
+#ifdef TUVOK_HAVE_IO_URING
+struct LargeFileURing::BufferPool {
+  BufferPool() : mem(NULL) {
+    if(posix_memalign(&mem, DIRECT_ALIGNMENT, BUFFERS*BUFFER_SIZE) != 0) {
+      mem = NULL;
+      return;
+    }
+    for(size_t i=0; i < BUFFERS; ++i) { free_slots.push_back(int(i)); }
+  }
+  ~BufferPool() { ::free(mem); }
+
+  char* slot(int s) const { return static_cast<char*>(mem) + s*BUFFER_SIZE; }
+  /// @returns a free buffer, or -1 if all are in use.
+  int acquire() {
+    std::lock_guard<std::mutex> lock(guard);
+    if(free_slots.empty()) { return -1; }
+    const int s = free_slots.back();
+    free_slots.pop_back();
+    return s;
+  }
+  /// the data we hand out may be released by any thread.
+  void release(int s) {
+    std::lock_guard<std::mutex> lock(guard);
+    free_slots.push_back(s);
+  }
+
+  void* mem;
+  std::mutex guard;
+  std::vector<int> free_slots;
+};
+
+namespace {
+  /// returns a registered buffer to its pool once the user is done with it.
+  /// Holds on to the pool, which may outlive the file.
+  struct ReleaseSlot {
+    ReleaseSlot(std::shared_ptr<LargeFileURing::BufferPool> p, int s) :
+      pool(p), slot(s) {}
+    void operator()(void*) const { pool->release(slot); }
+    std::shared_ptr<LargeFileURing::BufferPool> pool;
+    int slot;
+  };
+  void free_aligned(void* p) { ::free(p); }
+}
+
+// there is no libc wrapper for these.
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                  min_complete, flags, NULL, 0));
+}
+static int sys_io_uring_register(int fd, unsigned opcode, const void* arg,
+                                 unsigned nr_args) {
+  return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg,
+                                  nr_args));
+}
+
+/// the submission and completion queues we share with the kernel.
+struct LargeFileURing::Ring {
+  Ring() : fd(-1), sq_map(MAP_FAILED), cq_map(MAP_FAILED),
+           sqe_map(MAP_FAILED), fixed_file(false) {}
+  ~Ring() {
+    if(sqe_map != MAP_FAILED) { munmap(sqe_map, sqe_map_size); }
+    if(cq_map != MAP_FAILED) { munmap(cq_map, cq_map_size); }
+    if(sq_map != MAP_FAILED) { munmap(sq_map, sq_map_size); }
+    if(fd != -1) { ::close(fd); }
+  }
+
+  bool setup(unsigned depth) {
+    struct io_uring_params p;
+    ::memset(&p, 0, sizeof(p));
+    this->fd = sys_io_uring_setup(depth, &p);
+    if(this->fd < 0) { return false; }
+
+    // newer kernels can map both rings at once; mapping them one by one
+    // works everywhere.
+    sq_map_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+    cq_map_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    sqe_map_size = p.sq_entries*sizeof(struct io_uring_sqe);
+    sq_map = mmap(NULL, sq_map_size, PROT_READ|PROT_WRITE,
+                  MAP_SHARED|MAP_POPULATE, this->fd, IORING_OFF_SQ_RING);
+    cq_map = mmap(NULL, cq_map_size, PROT_READ|PROT_WRITE,
+                  MAP_SHARED|MAP_POPULATE, this->fd, IORING_OFF_CQ_RING);
+    sqe_map = mmap(NULL, sqe_map_size, PROT_READ|PROT_WRITE,
+                   MAP_SHARED|MAP_POPULATE, this->fd, IORING_OFF_SQES);
+    if(sq_map == MAP_FAILED || cq_map == MAP_FAILED ||
+       sqe_map == MAP_FAILED) {
+      return false;
+    }
+
+    char* sq = static_cast<char*>(sq_map);
+    sq_head  = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sq_tail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sq_mask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    char* cq = static_cast<char*>(cq_map);
+    cq_head  = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cq_tail  = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cq_mask  = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes     = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+    sqes     = static_cast<struct io_uring_sqe*>(sqe_map);
+    entries  = p.sq_entries;
+    return true;
+  }
+
+  /// @returns the next free submission entry, cleared, or NULL if the queue
+  /// is full.  It is not visible to the kernel before 'push'.
+  struct io_uring_sqe* next() {
+    const unsigned tail = *sq_tail;
+    if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= entries) {
+      return NULL;
+    }
+    struct io_uring_sqe* sqe = &sqes[tail & *sq_mask];
+    ::memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+  }
+  void push() {
+    const unsigned tail = *sq_tail;
+    sq_array[tail & *sq_mask] = tail & *sq_mask;
+    __atomic_store_n(sq_tail, tail+1, __ATOMIC_RELEASE);
+  }
+
+  int fd;
+  void* sq_map;  size_t sq_map_size;
+  void* cq_map;  size_t cq_map_size;
+  void* sqe_map; size_t sqe_map_size;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+  unsigned entries;
+  bool fixed_file; ///< our descriptor is registered as file 0
+};
+
+struct LargeFileURing::Request {
+  Request() : offset(0), len(0), start(0), span(0), slot(-1), done(false),
+              result(0) {}
+  uint64_t offset;  ///< what the user asked for, header included
+  size_t len;
+  uint64_t start;   ///< what we read; differs when it must be aligned
+  size_t span;
+  std::shared_ptr<void> buffer;
+  int slot;         ///< registered buffer, or -1
+  struct iovec iov;
+  bool done;
+  int32_t result;
+};
+#else
+struct LargeFileURing::BufferPool {};
+struct LargeFileURing::Ring {};
+struct LargeFileURing::Request {};
+#endif
+
+LargeFileURing::LargeFileURing(const std::string fn,
+                               std::ios_base::openmode mode,
+                               uint64_t header_size,
+                               uint64_t /* length */,
+                               bool direct) :
+  LargeFileFD(fn, mode, header_size), queued(0), want_direct(direct),
+  is_direct(false)
+{
+  this->open(mode);
+}
+LargeFileURing::LargeFileURing(const std::wstring fn,
+                               std::ios_base::openmode mode,
+                               uint64_t header_size,
+                               uint64_t /* length */,
+                               bool direct) :
+  LargeFileFD(fn, mode, header_size), queued(0), want_direct(direct),
+  is_direct(false)
+{
+  this->open(mode);
+}
+
+LargeFileURing::~LargeFileURing()
+{
+  this->close();
+}
+
+void LargeFileURing::open(std::ios_base::openmode mode)
+{
+  this->close();
+  this->is_direct = false;
+#if defined(TUVOK_HAVE_IO_URING) && defined(O_DIRECT)
+  // writes would need to be aligned, too; only reading goes direct.
+  if(this->want_direct && !(mode & std::ios_base::out)) {
+    this->fd = ::open(this->m_filename.c_str(), O_RDONLY | O_DIRECT);
+    // EINVAL: the file system does not do O_DIRECT, e.g. tmpfs.
+    this->is_direct = this->fd != -1;
+  }
+#endif
+  if(!this->is_direct) {
+    LargeFileFD::open(mode);
+  }
+  this->setup_ring();
+  if(!this->ring && this->is_direct) {
+    // the plain descriptor I/O we fall back to can't do unaligned reads.
+    this->is_direct = false;
+    LargeFileFD::open(mode);
+  }
+}
+
+void LargeFileURing::setup_ring()
+{
+#ifdef TUVOK_HAVE_IO_URING
+  std::unique_ptr<Ring> r(new Ring);
+  if(!r->setup(QUEUE_DEPTH)) {
+    DEBUG("io_uring unavailable (errno=" << errno << "), using plain reads.");
+    return;
+  }
+  // registered files and buffers save the kernel work on every request.
+  r->fixed_file = sys_io_uring_register(r->fd, IORING_REGISTER_FILES,
+                                        &this->fd, 1) == 0;
+  std::shared_ptr<BufferPool> p = std::make_shared<BufferPool>();
+  if(p->mem) {
+    struct iovec vec[BUFFERS];
+    for(size_t i=0; i < BUFFERS; ++i) {
+      vec[i].iov_base = p->slot(int(i));
+      vec[i].iov_len = BUFFER_SIZE;
+    }
+    if(sys_io_uring_register(r->fd, IORING_REGISTER_BUFFERS, vec,
+                             BUFFERS) != 0) {
+      DEBUG("could not register buffers (errno=" << errno << ").");
+      p.reset();
+    }
+  } else {
+    p.reset();
+  }
+  this->pool = p;
+  this->ring = std::move(r);
+#endif
+}
+
+bool LargeFileURing::uring() const { return this->ring.get() != NULL; }
+bool LargeFileURing::direct() const { return this->is_direct; }
+
+bool LargeFileURing::available()
+{
+#ifdef TUVOK_HAVE_IO_URING
+  static const bool avail = Ring().setup(1);
+  return avail;
+#else
+  return false;
+#endif
+}
+
+std::shared_ptr<const void> LargeFileURing::rd(uint64_t offset,
+                                               size_t len)
+{
+#ifdef TUVOK_HAVE_IO_URING
+  if(this->ring) { return this->ring_rd(offset, len); }
+#endif
+  return LargeFileFD::rd(offset, len);
+}
+
+void LargeFileURing::enqueue(uint64_t offset, size_t len)
+{
+  if(len == 0) { return; }
+#ifdef TUVOK_HAVE_IO_URING
+  if(this->ring) {
+    const uint64_t real_offset = offset + this->header_size;
+    // keep room for the reads and writes which must not wait.
+    if(this->reqs.size() >= QUEUE_DEPTH-1 ||
+       len > std::numeric_limits<uint32_t>::max()/2 ||
+       this->find_request(real_offset, len)) {
+      return;
+    }
+    this->queue_read(real_offset, len);
+    if(this->queued >= BATCH) { this->enter(0); }
+    return;
+  }
+#endif
+  LargeFileFD::enqueue(offset, len);
+}
+
+void LargeFileURing::submit()
+{
+#ifdef TUVOK_HAVE_IO_URING
+  if(this->ring) { this->enter(0); }
+#endif
+}
+
+void LargeFileURing::wr(const std::shared_ptr<const void>& data,
+                        uint64_t offset,
+                        size_t len)
+{
+  if(len == 0) { return; }
+#ifdef TUVOK_HAVE_IO_URING
+  if(this->ring) {
+    this->ring_wr(data, offset, len);
+    return;
+  }
+#endif
+  LargeFileFD::wr(data, offset, len);
+}
+
+void LargeFileURing::close()
+{
+#ifdef TUVOK_HAVE_IO_URING
+  if(this->ring) {
+    // the kernel may still be writing into our buffers; let it finish.
+    this->enter(0);
+    for(size_t i=0; i < this->reqs.size(); ++i) {
+      this->wait_for(*this->reqs[i]);
+    }
+  }
+#endif
+  this->reqs.clear();
+  this->queued = 0;
+  this->ring.reset();
+  this->pool.reset();
+  LargeFileFD::close();
+}
+
+#ifdef TUVOK_HAVE_IO_URING
+std::shared_ptr<LargeFileURing::Request>
+LargeFileURing::find_request(uint64_t offset, size_t len) const
+{
+  for(size_t i=0; i < this->reqs.size(); ++i) {
+    if(this->reqs[i]->offset == offset && this->reqs[i]->len == len) {
+      return this->reqs[i];
+    }
+  }
+  return std::shared_ptr<Request>();
+}
+
+std::shared_ptr<LargeFileURing::Request>
+LargeFileURing::queue_read(uint64_t offset, size_t len)
+{
+  std::shared_ptr<Request> r = std::make_shared<Request>();
+  r->offset = offset;
+  r->len = len;
+  const uint64_t align = this->is_direct ? DIRECT_ALIGNMENT : 1;
+  r->start = offset / align * align;
+  r->span = static_cast<size_t>((offset+len + align-1) / align * align -
+                                r->start);
+
+  if(this->pool && r->span <= BUFFER_SIZE) {
+    r->slot = this->pool->acquire();
+  }
+  if(r->slot >= 0) {
+    r->buffer = std::shared_ptr<void>(this->pool->slot(r->slot),
+                                      ReleaseSlot(this->pool, r->slot));
+  } else {
+    void* mem;
+    if(posix_memalign(&mem, DIRECT_ALIGNMENT, r->span) != 0) {
+      throw std::bad_alloc();
+    }
+    r->buffer = std::shared_ptr<void>(mem, free_aligned);
+  }
+
+  struct io_uring_sqe* sqe;
+  while((sqe = this->ring->next()) == NULL) { this->enter(0); }
+  if(r->slot >= 0) {
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->addr = reinterpret_cast<uintptr_t>(r->buffer.get());
+    sqe->len = static_cast<uint32_t>(r->span);
+    sqe->buf_index = static_cast<uint16_t>(r->slot);
+  } else {
+    r->iov.iov_base = r->buffer.get();
+    r->iov.iov_len = r->span;
+    sqe->opcode = IORING_OP_READV;
+    sqe->addr = reinterpret_cast<uintptr_t>(&r->iov);
+    sqe->len = 1;
+  }
+  if(this->ring->fixed_file) {
+    sqe->fd = 0;
+    sqe->flags |= IOSQE_FIXED_FILE;
+  } else {
+    sqe->fd = this->fd;
+  }
+  sqe->off = r->start;
+  sqe->user_data = reinterpret_cast<uintptr_t>(r.get());
+  this->ring->push();
+  ++this->queued;
+  this->reqs.push_back(r);
+  return r;
+}
+
+void LargeFileURing::enter(unsigned wait)
+{
+  while(this->queued > 0) {
+    const int rv = sys_io_uring_enter(this->ring->fd, this->queued, 0, 0);
+    if(rv < 0) {
+      if(errno == EINTR) { continue; }
+      // EAGAIN/EBUSY: completions pile up; make room and try again.
+      if(errno == EAGAIN || errno == EBUSY) { this->reap(); continue; }
+      throw std::ios_base::failure("could not submit I/O requests.");
+    }
+    this->queued -= std::min(this->queued, static_cast<unsigned>(rv));
+  }
+  if(wait == 0) { return; }
+  int rv;
+  do {
+    rv = sys_io_uring_enter(this->ring->fd, 0, wait, IORING_ENTER_GETEVENTS);
+  } while(rv < 0 && errno == EINTR);
+  if(rv < 0) {
+    throw std::ios_base::failure("waiting for I/O requests failed.");
+  }
+}
+
+void LargeFileURing::reap()
+{
+  unsigned head = *this->ring->cq_head;
+  const unsigned tail = __atomic_load_n(this->ring->cq_tail, __ATOMIC_ACQUIRE);
+  for(; head != tail; ++head) {
+    const struct io_uring_cqe& cqe =
+      this->ring->cqes[head & *this->ring->cq_mask];
+    Request* r = reinterpret_cast<Request*>(
+      static_cast<uintptr_t>(cqe.user_data)
+    );
+    r->result = cqe.res;
+    r->done = true;
+  }
+  __atomic_store_n(this->ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+void LargeFileURing::wait_for(const Request& r)
+{
+  this->reap();
+  while(!r.done) {
+    this->enter(1);
+    this->reap();
+  }
+}
+
+std::shared_ptr<const void> LargeFileURing::ring_rd(uint64_t offset,
+                                                    size_t len)
+{
+  if(!this->is_open()) {
+    throw std::ios_base::failure("file is not open!!");
+  }
+  if(len > std::numeric_limits<uint32_t>::max()/2) {
+    // io_uring takes 32bit lengths.  Direct reads never get here: the
+    // descriptor would need aligned requests.
+    if(this->is_direct) {
+      throw std::length_error("read too large for direct I/O");
+    }
+    return LargeFileFD::rd(offset, len);
+  }
+
+  const uint64_t real_offset = offset + this->header_size;
+  std::shared_ptr<Request> r = this->find_request(real_offset, len);
+  if(!r) { r = this->queue_read(real_offset, len); }
+  this->wait_for(*r);
+  this->reqs.erase(std::find(this->reqs.begin(), this->reqs.end(), r));
+
+  if(r->result < 0) {
+    DEBUG("read failed, errno=" << -r->result);
+    throw std::ios_base::failure("read failure.");
+  }
+  size_t got = static_cast<size_t>(r->result);
+  // buffered reads may come back short before EOF; finish those up.
+  char* buf = static_cast<char*>(r->buffer.get());
+  while(got < r->span) {
+    const ssize_t bytes = pread(this->fd, buf+got, r->span-got,
+                                static_cast<off_t>(r->start+got));
+    if(bytes < 0 && errno == EINTR) { continue; }
+    if(bytes <= 0) { break; }
+    got += static_cast<size_t>(bytes);
+  }
+
+  const size_t skip = static_cast<size_t>(real_offset - r->start);
+  this->bytes_read = got > skip ? std::min(got-skip, len) : 0;
+  return std::shared_ptr<const void>(r->buffer, buf+skip);
+}
+
+void LargeFileURing::ring_wr(const std::shared_ptr<const void>& data,
+                             uint64_t offset, size_t len)
+{
+  if(!this->is_open()) {
+    throw std::ios_base::failure("file is not open!!");
+  }
+  const uint64_t real_offset = offset + this->header_size;
+
+  // reads of this range which are still in flight would see old data.
+  for(size_t i=0; i < this->reqs.size(); ) {
+    const Request& r = *this->reqs[i];
+    if(r.start < real_offset+len && real_offset < r.start+r.span) {
+      this->wait_for(r);
+      this->reqs.erase(this->reqs.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+
+  const char* bytes = static_cast<const char*>(data.get());
+  Request w;
+  size_t written = 0;
+  while(written < len) {
+    w.done = false;
+    w.iov.iov_base = const_cast<char*>(bytes) + written;
+    w.iov.iov_len = std::min<size_t>(len-written,
+                                     std::numeric_limits<int32_t>::max());
+    struct io_uring_sqe* sqe;
+    while((sqe = this->ring->next()) == NULL) { this->enter(0); }
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->addr = reinterpret_cast<uintptr_t>(&w.iov);
+    sqe->len = 1;
+    if(this->ring->fixed_file) {
+      sqe->fd = 0;
+      sqe->flags |= IOSQE_FIXED_FILE;
+    } else {
+      sqe->fd = this->fd;
+    }
+    sqe->off = real_offset + written;
+    sqe->user_data = reinterpret_cast<uintptr_t>(&w);
+    this->ring->push();
+    ++this->queued;
+    this->wait_for(w);
+
+    if(w.result == -EINTR || w.result == -EAGAIN) { continue; }
+    if(w.result <= 0) {
+      DEBUG("write failed, result=" << w.result);
+      throw std::ios_base::failure("write failure.");
+    }
+    written += static_cast<size_t>(w.result);
+  }
+}
+#endif
@@ -0,0 +1,124 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2011 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+#ifndef BASICS_LARGEFILE_URING_H
+#define BASICS_LARGEFILE_URING_H
+
+#include <memory>
+#include <vector>
+#include "LargeFileFD.h"
+
+/** Uses a Linux io_uring to read data.  Unlike AIO, nothing is emulated with
+ * threads: 'enqueue'd reads are handed to the kernel in batches, and many of
+ * them can be in flight at once.  Reads which fit are done into buffers
+ * registered with the kernel.  Optionally the file is read with O_DIRECT,
+ * which keeps datasets larger than memory from thrashing the page cache.
+ * Where io_uring is not available (old kernels, other systems, seccomp'd
+ * containers) this silently behaves like a LargeFileFD. */
+class LargeFileURing : public LargeFileFD {
+  public:
+    /// @argument header_size is maintained as a "base" offset.  Seeking to
+    /// byte 0 actually seeks to 'header_size'.
+    /// @argument direct bypass the page cache.  Only used for files opened
+    /// read-only, and only where the file system supports it.
+    LargeFileURing(const std::string fn,
+                   std::ios_base::openmode mode = std::ios_base::in,
+                   uint64_t header_size=0,
+                   uint64_t length=0,
+                   bool direct=false);
+    /// @argument header_size is maintained as a "base" offset.  Seeking to
+    /// byte 0 actually seeks to 'header_size'.
+    /// @argument direct bypass the page cache.  Only used for files opened
+    /// read-only, and only where the file system supports it.
+    LargeFileURing(const std::wstring fn,
+                   std::ios_base::openmode mode = std::ios_base::in,
+                   uint64_t header_size=0,
+                   uint64_t length=0,
+                   bool direct=false);
+    virtual ~LargeFileURing();
+
+    virtual void open(std::ios_base::openmode mode = std::ios_base::in);
+
+    /// reads a block of data, returns a pointer to it.  User must cast it to
+    /// the type that makes sense for them.
+    virtual std::shared_ptr<const void> rd(uint64_t offset,
+                                           size_t len);
+    using LargeFile::read;
+    using LargeFile::rd;
+
+    /// notifies the object that we're going to need the following data soon.
+    /// The read is queued and handed to the kernel together with the next
+    /// few, or on the next rd/wr/submit.
+    virtual void enqueue(uint64_t offset, size_t len);
+    /// hands all queued reads to the kernel now.
+    void submit();
+
+    /// writes a block of data.  Returns once the data are written.
+    virtual void wr(const std::shared_ptr<const void>& data,
+                    uint64_t offset,
+                    size_t len);
+    using LargeFile::write;
+
+    virtual void close();
+
+    /// @returns false if we fell back to plain descriptor I/O.
+    bool uring() const;
+    /// @returns true if reads bypass the page cache.
+    bool direct() const;
+    /// @returns true if the running kernel lets us create an io_uring.
+    static bool available();
+
+    struct Ring;
+    struct Request;
+    struct BufferPool;
+
+  private:
+    LargeFileURing(const LargeFileURing&);
+    LargeFileURing& operator=(const LargeFileURing&);
+
+    void setup_ring();
+    std::shared_ptr<Request> find_request(uint64_t offset, size_t len) const;
+    std::shared_ptr<Request> queue_read(uint64_t offset, size_t len);
+    /// submits what is queued and waits for 'wait' completions.
+    void enter(unsigned wait);
+    /// takes note of all completed requests.
+    void reap();
+    void wait_for(const Request&);
+    std::shared_ptr<const void> ring_rd(uint64_t offset, size_t len);
+    void ring_wr(const std::shared_ptr<const void>& data, uint64_t offset,
+                 size_t len);
+
+  private:
+    std::unique_ptr<Ring> ring;
+    std::shared_ptr<BufferPool> pool;
+    std::vector<std::shared_ptr<Request>> reqs; ///< in flight or queued
+    unsigned queued;                           ///< not yet submitted
+    bool want_direct;
+    bool is_direct;
+};
+
+#endif /* BASICS_LARGEFILE_URING_H */
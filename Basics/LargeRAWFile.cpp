@@ -2,6 +2,10 @@
 #include <sstream>
 #include <algorithm> // for std::max, std::min
 #include "LargeRAWFile.h"
+#ifndef _WIN32
+# include <cerrno>
+# include <unistd.h>
+#endif
 #include "nonstd.h"
 
 using namespace std;
@@ -231,6 +235,80 @@ bool LargeRAWFile::CopyRAW(uint64_t iCount, uint64_t iSourcePos, uint64_t iTarge
   return true;
 }
 
+size_t LargeRAWFile::ReadAt(uint64_t iPos, unsigned char* pData,
+                            uint64_t iCount) const {
+  uint64_t iTotalRead = 0;
+  iPos += m_iHeaderSize;
+  #ifdef _WIN32
+  while (iCount > 0) {
+    // given an OVERLAPPED offset, ReadFile does not use the file pointer
+    OVERLAPPED ov = {0};
+    ov.Offset     = DWORD(iPos & 0xFFFFFFFF);
+    ov.OffsetHigh = DWORD(iPos >> 32);
+    DWORD dwReadBytes;
+    if (!ReadFile(m_StreamFile, pData,
+                  DWORD(min<uint64_t>(iCount, numeric_limits<DWORD>::max())),
+                  &dwReadBytes, &ov) || dwReadBytes == 0) {
+      break;
+    }
+    iCount -= dwReadBytes;
+    iTotalRead += dwReadBytes;
+    iPos += dwReadBytes;
+    pData += dwReadBytes;
+  }
+  #else
+  // pending writes sit in the stream's buffer, where pread can't see them.
+  if (m_bWritable) fflush(m_StreamFile);
+  const int fd = fileno(m_StreamFile);
+  while (iCount > 0) {
+    const ssize_t iRead = pread(fd, pData, size_t(iCount), off_t(iPos));
+    if (iRead < 0 && errno == EINTR) continue;
+    if (iRead <= 0) break;
+    iCount -= iRead;
+    iTotalRead += iRead;
+    iPos += iRead;
+    pData += iRead;
+  }
+  #endif
+  return size_t(iTotalRead);
+}
+
+size_t LargeRAWFile::WriteAt(uint64_t iPos, const unsigned char* pData,
+                             uint64_t iCount) const {
+  uint64_t iTotalWritten = 0;
+  iPos += m_iHeaderSize;
+  #ifdef _WIN32
+  while (iCount > 0) {
+    OVERLAPPED ov = {0};
+    ov.Offset     = DWORD(iPos & 0xFFFFFFFF);
+    ov.OffsetHigh = DWORD(iPos >> 32);
+    DWORD dwWrittenBytes;
+    if (!WriteFile(m_StreamFile, pData,
+                   DWORD(min<uint64_t>(iCount, numeric_limits<DWORD>::max())),
+                   &dwWrittenBytes, &ov) || dwWrittenBytes == 0) {
+      break;
+    }
+    iCount -= dwWrittenBytes;
+    iTotalWritten += dwWrittenBytes;
+    iPos += dwWrittenBytes;
+    pData += dwWrittenBytes;
+  }
+  #else
+  // the stream must not write stale buffered data over ours later on.
+  fflush(m_StreamFile);
+  const int fd = fileno(m_StreamFile);
+  while (iCount > 0) {
+    const ssize_t iWritten = pwrite(fd, pData, size_t(iCount), off_t(iPos));
+    if (iWritten < 0 && errno == EINTR) continue;
+    if (iWritten <= 0) break;
+    iCount -= iWritten;
+    iTotalWritten += iWritten;
+    iPos += iWritten;
+    pData += iWritten;
+  }
+  #endif
+  return size_t(iTotalWritten);
+}
 
 void LargeRAWFile::Delete() {
   if (m_bIsOpen) Close();
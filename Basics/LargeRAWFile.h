@@ -53,6 +53,8 @@ public:
   virtual bool Truncate(uint64_t iPos);
   virtual uint64_t GetCurrentSize();
   std::string GetFilename() const { return m_strFilename;}
+  /// bytes skipped at the start of the file; positions are relative to them.
+  uint64_t GetHeaderSize() const { return m_iHeaderSize; }
 
   virtual void SeekStart();
   virtual uint64_t SeekEnd();
@@ -63,6 +65,15 @@ public:
   virtual bool CopyRAW(uint64_t iCount, uint64_t iSourcePos, uint64_t iTargetPos,
                        unsigned char* pBuffer, uint64_t iBufferSize);
 
+  /// Positional I/O: reads/writes at 'iPos' without going through the file
+  /// position, so several threads may call these on one open file at once.
+  /// Afterwards the file position is unspecified; seek before the next
+  /// ReadRAW/WriteRAW.  Do not mix with sequential I/O from other threads.
+  virtual size_t ReadAt(uint64_t iPos, unsigned char* pData,
+                        uint64_t iCount) const;
+  virtual size_t WriteAt(uint64_t iPos, const unsigned char* pData,
+                         uint64_t iCount) const;
+
   template<class T> void Read(const T* pData, uint64_t iCount, uint64_t iPos,
                               uint64_t iOffset) {
     SeekPos(iOffset+sizeof(T)*iPos);
@@ -36,6 +36,8 @@
 
 #include "SystemInfo.h"
 
+#include <algorithm>
+#include <vector>
 #include "StdDefines.h"
 #ifdef _WIN32
   #include <windows.h>
@@ -44,9 +46,15 @@
     #include <sys/sysctl.h>
   #else
     #include <cstdio>
+    #include <fstream>
     #include <iostream>
+    #include <set>
     #include <sstream>
+    #include <dirent.h>
+    #include <sched.h>
+    #include <unistd.h>
     #include <sys/resource.h>
+    #include <sys/syscall.h>
     #include <sys/sysinfo.h>
     #include <sys/time.h>
     #include "IO/KeyValueFileParser.h"
@@ -63,11 +71,21 @@ SystemInfo::SystemInfo(std::string strProgramPath,
   m_iUseMaxGPUMem(iDefaultGPUMemSize),
   m_iCPUMemSize(iDefaultCPUMemSize),
   m_iGPUMemSize(iDefaultGPUMemSize),
+  m_iNumberOfCPUs(1),
+  m_iNumberOfCores(0),
+  m_iNumberOfNUMANodes(0),
+  m_iL2CacheSize(0),
+  m_iL3CacheSize(0),
+  m_iCPUMemLimit(0),
+  m_bHasHugePages(false),
+  m_bNUMALocalBrickCache(false),
   m_bIsCPUSizeComputed(false),
   m_bIsGPUSizeComputed(false),
   m_bIsNumberOfCPUsComputed(false),
   m_bIsDirectX10Capable(false)
 {
+  ComputeTopology();
+
   uint32_t iNumberOfCPUs = ComputeNumCPUs();
   if (iNumberOfCPUs > 0) {
     m_iNumberOfCPUs = iNumberOfCPUs;
@@ -76,8 +94,13 @@ SystemInfo::SystemInfo(std::string strProgramPath,
 
   uint64_t iCPUMemSize = ComputeCPUMemSize();
   if (iCPUMemSize > 0) {
+    // in a container, we only get what our cgroup allows.
+    if (m_iCPUMemLimit >= iCPUMemSize) m_iCPUMemLimit = 0;
+    if (m_iCPUMemLimit > 0) iCPUMemSize = m_iCPUMemLimit;
     m_iCPUMemSize = iCPUMemSize;
     m_bIsCPUSizeComputed = true;
+    // the default is an upper bound; don't plan with memory we do not have.
+    m_iUseMaxCPUMem = std::min(m_iUseMaxCPUMem, m_iCPUMemSize);
   }
 
   uint64_t iGPUMemSize = ComputeGPUMemory();  // also sets m_bIsDirectX10Capable
@@ -87,20 +110,6 @@ SystemInfo::SystemInfo(std::string strProgramPath,
   }
 }
 
-uint32_t SystemInfo::ComputeNumCPUs() {
-  #ifdef _WIN32
-    SYSTEM_INFO siSysInfo;
-    GetSystemInfo(&siSysInfo);
-    return siSysInfo.dwNumberOfProcessors;
-  #else
-    #ifdef DETECTED_OS_APPLE
-      return 0;
-    #else
-      return 0;
-    #endif
-  #endif
-}
-
 #ifdef __linux__
 
 #ifndef NDEBUG
@@ -108,6 +117,103 @@ uint32_t SystemInfo::ComputeNumCPUs() {
 #else
 #   define DBG(str) /* nothing */
 #endif
+
+/// reads the first line of a (/proc or /sys) file.
+static bool lnx_read(const std::string& strFile, std::string& strLine) {
+  std::ifstream f(strFile.c_str());
+  if(!f) { return false; }
+  std::getline(f, strLine);
+  return !f.fail();
+}
+
+static uint64_t lnx_read_uint(const std::string& strFile) {
+  std::string s;
+  if(!lnx_read(strFile, s)) { return 0; }
+  std::istringstream strm(s);
+  uint64_t v = 0;
+  strm >> v;
+  return strm.fail() ? 0 : v;
+}
+
+/// parses sizes such as "2048K" as found in sysfs' cache descriptions.
+static uint64_t lnx_parse_size(const std::string& s) {
+  std::istringstream strm(s);
+  uint64_t v = 0;
+  char unit = 0;
+  strm >> v >> unit;
+  switch(unit) {
+    case 'K': return v * 1024;
+    case 'M': return v * 1024 * 1024;
+    case 'G': return v * 1024 * 1024 * 1024;
+  }
+  return v;
+}
+
+/// CPUs granted by the cgroup's CPU quota, 0 if there is no quota.
+static uint32_t lnx_cpu_quota() {
+  int64_t quota = -1;
+  int64_t period = 0;
+  std::string s;
+  if(lnx_read("/sys/fs/cgroup/cpu.max", s)) { // cgroup v2: "quota period"
+    std::istringstream strm(s);
+    std::string strQuota;
+    strm >> strQuota >> period;
+    if(strQuota != "max") {
+      std::istringstream(strQuota) >> quota;
+    }
+  } else if(lnx_read("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", s)) {
+    std::istringstream(s) >> quota;
+    period = int64_t(lnx_read_uint("/sys/fs/cgroup/cpu/cpu.cfs_period_us"));
+  }
+  if(quota <= 0 || period <= 0) { return 0; }
+  return static_cast<uint32_t>(std::max<int64_t>(1, (quota+period-1)/period));
+}
+
+/// memory limit of our cgroup, 0 if there is none.
+static uint64_t lnx_mem_cgroup() {
+  std::string s;
+  if(lnx_read("/sys/fs/cgroup/memory.max", s)) { // cgroup v2
+    if(s == "max") { return 0; }
+    std::istringstream strm(s);
+    uint64_t limit = 0;
+    strm >> limit;
+    return limit;
+  }
+  // v1 reports a huge number if there is no limit; the caller clamps it to
+  // the physical memory anyway.
+  return lnx_read_uint("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+}
+
+static uint32_t lnx_num_cpus() {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if(n <= 0) { return 0; }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if(sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) {
+    n = std::min<long>(n, CPU_COUNT(&set));
+  }
+  const uint32_t quota = lnx_cpu_quota();
+  if(quota > 0) { n = std::min<long>(n, quota); }
+  return static_cast<uint32_t>(n);
+}
+
+static bool lnx_huge_pages() {
+  KeyValueFileParser meminfo("/proc/meminfo");
+  if(meminfo.FileReadable()) {
+    KeyValPair* huge = meminfo.GetData("HugePages_Total");
+    if(huge != NULL && huge->iValue > 0) { return true; }
+  }
+  std::string s;
+  if(lnx_read("/sys/kernel/mm/transparent_hugepage/enabled", s)) {
+    return s.find("[never]") == std::string::npos;
+  }
+  return false;
+}
+
+// mbind(2) without depending on libnuma; values from <numaif.h>.
+static const int LNX_MPOL_PREFERRED = 1;
+static const unsigned LNX_MPOL_MF_MOVE = 1 << 1;
+
 static unsigned long lnx_mem_sysinfo() {
   struct sysinfo si;
   if(sysinfo(&si) < 0) {
@@ -171,6 +277,181 @@ static uint64_t lnx_mem() {
 }
 #endif
 
+uint32_t SystemInfo::ComputeNumCPUs() {
+  #ifdef _WIN32
+    SYSTEM_INFO siSysInfo;
+    GetSystemInfo(&siSysInfo);
+    return siSysInfo.dwNumberOfProcessors;
+  #else
+    #ifdef DETECTED_OS_APPLE
+      int iCPUs = 0;
+      size_t len = sizeof(iCPUs);
+      if(sysctlbyname("hw.logicalcpu", &iCPUs, &len, NULL, 0) != 0) {
+        return 0;
+      }
+      return static_cast<uint32_t>(std::max(iCPUs, 0));
+    #elif defined(__linux__)
+      return lnx_num_cpus();
+    #else
+      return 0;
+    #endif
+  #endif
+}
+
+void SystemInfo::ComputeTopology() {
+  #ifdef _WIN32
+    DWORD len = 0;
+    GetLogicalProcessorInformation(NULL, &len);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(
+      len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION)
+    );
+    if(!info.empty() && GetLogicalProcessorInformation(&info[0], &len)) {
+      for(size_t i=0; i < info.size(); ++i) {
+        switch(info[i].Relationship) {
+          case RelationProcessorCore: ++m_iNumberOfCores; break;
+          case RelationNumaNode: ++m_iNumberOfNUMANodes; break;
+          case RelationCache:
+            if(info[i].Cache.Level == 2) {
+              m_iL2CacheSize = std::max<uint64_t>(m_iL2CacheSize,
+                                                  info[i].Cache.Size);
+            } else if(info[i].Cache.Level == 3) {
+              m_iL3CacheSize = std::max<uint64_t>(m_iL3CacheSize,
+                                                  info[i].Cache.Size);
+            }
+            break;
+          default: break;
+        }
+      }
+    }
+    m_bHasHugePages = GetLargePageMinimum() > 0;
+  #elif defined(DETECTED_OS_APPLE)
+    int iCores = 0;
+    size_t len = sizeof(iCores);
+    if(sysctlbyname("hw.physicalcpu", &iCores, &len, NULL, 0) == 0) {
+      m_iNumberOfCores = static_cast<uint32_t>(std::max(iCores, 0));
+    }
+    uint64_t iCache = 0;
+    len = sizeof(iCache);
+    if(sysctlbyname("hw.l2cachesize", &iCache, &len, NULL, 0) == 0) {
+      m_iL2CacheSize = iCache;
+    }
+    len = sizeof(iCache);
+    if(sysctlbyname("hw.l3cachesize", &iCache, &len, NULL, 0) == 0) {
+      m_iL3CacheSize = iCache;
+    }
+    m_iNumberOfNUMANodes = 1;
+  #elif defined(__linux__)
+    const std::string strCPU = "/sys/devices/system/cpu/cpu";
+    const long iCPUs = sysconf(_SC_NPROCESSORS_CONF);
+    // SMT siblings share package and core id.
+    std::set<std::pair<uint64_t, uint64_t>> cores;
+    for(long i=0; i < iCPUs; ++i) {
+      std::ostringstream topo;
+      topo << strCPU << i << "/topology/";
+      std::string strPackage, strCore;
+      if(lnx_read(topo.str() + "physical_package_id", strPackage) &&
+         lnx_read(topo.str() + "core_id", strCore)) {
+        cores.insert(std::make_pair(lnx_parse_size(strPackage),
+                                    lnx_parse_size(strCore)));
+      }
+    }
+    m_iNumberOfCores = static_cast<uint32_t>(cores.size());
+
+    for(unsigned i=0; ; ++i) {
+      std::ostringstream idx;
+      idx << strCPU << "0/cache/index" << i << "/";
+      std::string strType, strSize;
+      if(!lnx_read(idx.str() + "type", strType) ||
+         !lnx_read(idx.str() + "size", strSize)) {
+        break;
+      }
+      if(strType == "Instruction") { continue; }
+      const uint64_t iLevel = lnx_read_uint(idx.str() + "level");
+      if(iLevel == 2) { m_iL2CacheSize = lnx_parse_size(strSize); }
+      if(iLevel == 3) { m_iL3CacheSize = lnx_parse_size(strSize); }
+    }
+
+    DIR* nodes = opendir("/sys/devices/system/node");
+    if(nodes != NULL) {
+      for(struct dirent* e = readdir(nodes); e != NULL; e = readdir(nodes)) {
+        const std::string strName(e->d_name);
+        if(strName.size() > 4 && strName.compare(0, 4, "node") == 0 &&
+           strName.find_first_not_of("0123456789", 4) == std::string::npos) {
+          ++m_iNumberOfNUMANodes;
+        }
+      }
+      closedir(nodes);
+    }
+
+    m_bHasHugePages = lnx_huge_pages();
+    m_iCPUMemLimit = lnx_mem_cgroup();
+  #endif
+}
+
+// The brick cache and the buffer pool share 80% of the usable memory; the
+// rest is left for the bricks in flight and everything else we allocate.
+uint64_t SystemInfo::GetBrickCacheBudget() const {
+  return static_cast<uint64_t>(0.4 * double(m_iUseMaxCPUMem));
+}
+
+uint64_t SystemInfo::GetBufferPoolBudget() const {
+  return static_cast<uint64_t>(0.8 * double(m_iUseMaxCPUMem)) -
+         GetBrickCacheBudget();
+}
+
+uint64_t SystemInfo::GetWorkerCacheBudget() const {
+  // fall back to a common L2 size if the topology is unknown.
+  uint64_t iBudget = m_iL2CacheSize > 0 ? m_iL2CacheSize : 256*1024;
+  const uint32_t iCores = std::max(m_iNumberOfCores, 1u);
+  if(m_iL3CacheSize > 0) {
+    // there is one L3 per package, i.e. per node on most NUMA systems.
+    const uint32_t iPackages = std::max(m_iNumberOfNUMANodes, 1u);
+    iBudget += m_iL3CacheSize / std::max(iCores / iPackages, 1u);
+  }
+  // SMT siblings share their core's caches.
+  const uint32_t iThreadsPerCore = m_iNumberOfCores > 0 ?
+    std::max(m_iNumberOfCPUs / m_iNumberOfCores, 1u) : 1u;
+  return iBudget / iThreadsPerCore;
+}
+
+int SystemInfo::GetCurrentNUMANode() const {
+  if(m_iNumberOfNUMANodes < 2) { return -1; }
+  #ifdef _WIN32
+    UCHAR node = 0;
+    if(!GetNumaProcessorNode(UCHAR(GetCurrentProcessorNumber()), &node)) {
+      return -1;
+    }
+    return int(node);
+  #elif defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu = 0, node = 0;
+    if(syscall(SYS_getcpu, &cpu, &node, NULL) != 0) { return -1; }
+    return int(node);
+  #else
+    return -1;
+  #endif
+}
+
+bool SystemInfo::MoveToNUMANode(const void* pData, size_t iSize,
+                                int iNode) const {
+  if(m_iNumberOfNUMANodes < 2 || iNode < 0 || pData == NULL) { return false; }
+  #if defined(__linux__) && defined(SYS_mbind)
+    // mbind works on whole pages.
+    const uintptr_t iPage = uintptr_t(sysconf(_SC_PAGESIZE));
+    const uintptr_t iBegin = (uintptr_t(pData) + iPage-1) / iPage * iPage;
+    const uintptr_t iEnd = (uintptr_t(pData) + iSize) / iPage * iPage;
+    if(iEnd <= iBegin) { return false; }
+
+    const size_t iBits = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> mask(size_t(iNode) / iBits + 1, 0);
+    mask[size_t(iNode) / iBits] = 1UL << (size_t(iNode) % iBits);
+    return syscall(SYS_mbind, reinterpret_cast<void*>(iBegin),
+                   iEnd - iBegin, LNX_MPOL_PREFERRED, &mask[0],
+                   mask.size() * iBits + 1, LNX_MPOL_MF_MOVE) == 0;
+  #else
+    (void)iSize;
+    return false;
+  #endif
+}
 uint64_t SystemInfo::ComputeCPUMemSize() {
   #ifdef _WIN32
     MEMORYSTATUSEX statex;
@@ -60,13 +60,57 @@ public:
   void SetMaxUsableCPUMem(uint64_t iUseMaxCPUMem) {m_iUseMaxCPUMem = iUseMaxCPUMem;}
   void SetMaxUsableGPUMem(uint64_t iUseMaxGPUMem) {m_iUseMaxGPUMem = iUseMaxGPUMem;}
   bool IsNumberOfCPUsComputed() const {return m_bIsNumberOfCPUsComputed;}
+  /// number of CPUs we may use: respects the affinity mask and cgroup (i.e.
+  /// container) CPU quotas.  This is the number of worker threads to use.
   uint32_t GetNumberOfCPUs() const {return m_iNumberOfCPUs;}
   bool IsDirectX10Capable() const {return m_bIsDirectX10Capable; }
 
+  /// Topology of the host; everything is 0 if it could not be determined.
+  ///@{
+  /// physical cores, i.e. without SMT siblings.
+  uint32_t GetNumberOfCores() const {return m_iNumberOfCores;}
+  uint32_t GetNumberOfNUMANodes() const {return m_iNumberOfNUMANodes;}
+  /// size of one instance of the cache, in bytes.
+  uint64_t GetL2CacheSize() const {return m_iL2CacheSize;}
+  uint64_t GetL3CacheSize() const {return m_iL3CacheSize;}
+  /// true if huge pages are reserved or transparent huge pages are enabled.
+  bool HasHugePages() const {return m_bHasHugePages;}
+  /// memory limit of our cgroup (container), 0 if there is none.
+  uint64_t GetCPUMemLimit() const {return m_iCPUMemLimit;}
+  ///@}
+
+  /// Budgets derived from the above and the usable memory.
+  ///@{
+  /// bytes for in-core caches of source bricks, such as DynamicBrickingDS's.
+  uint64_t GetBrickCacheBudget() const;
+  /// bytes for the bricks the memory manager keeps for upload (GPUMemMan).
+  uint64_t GetBufferPoolBudget() const;
+  /// bytes of working data a single worker should process at a time so
+  /// that it stays in its share of the L2 and L3 caches.
+  uint64_t GetWorkerCacheBudget() const;
+  ///@}
+
+  /// if set, brick caches move the bricks they get to the NUMA node of the
+  /// thread adding them.  Off by default; only matters on NUMA systems.
+  void SetNUMALocalBrickCache(bool bLocal) {m_bNUMALocalBrickCache = bLocal;}
+  bool GetNUMALocalBrickCache() const {return m_bNUMALocalBrickCache;}
+
+  /// NUMA support for brick caches.  Both are no-ops (returning -1 and
+  /// false) on single node systems and where the OS does not support it.
+  ///@{
+  /// @returns the NUMA node the calling thread currently runs on.
+  int GetCurrentNUMANode() const;
+  /// moves the pages of the given memory to the given node; parts of the
+  /// first and last page which also hold other data are left alone.
+  bool MoveToNUMANode(const void* pData, size_t iSize, int iNode) const;
+  ///@}
+
 private:
   uint32_t ComputeNumCPUs();
   uint64_t ComputeCPUMemSize();
   uint64_t ComputeGPUMemory();
+  /// fills in the topology and cgroup limits.
+  void ComputeTopology();
 
   std::string m_strProgramPath;
   uint32_t  m_iProgramBitWidth;
@@ -75,6 +119,13 @@ private:
   uint64_t  m_iCPUMemSize;
   uint64_t  m_iGPUMemSize;
   uint32_t  m_iNumberOfCPUs;
+  uint32_t  m_iNumberOfCores;
+  uint32_t  m_iNumberOfNUMANodes;
+  uint64_t  m_iL2CacheSize;
+  uint64_t  m_iL3CacheSize;
+  uint64_t  m_iCPUMemLimit;
+  bool      m_bHasHugePages;
+  bool      m_bNUMALocalBrickCache;
 
   bool m_bIsCPUSizeComputed;
   bool m_bIsGPUSizeComputed;
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include "TaskScheduler.h"
+
+namespace tuvok
+{
+  namespace detail {
+    bool TaskState::Wait(uint32_t timeoutInMilliseconds) const {
+      SCOPEDLOCK(m_Guard);
+      if(!m_bDone) { m_DoneCondition.Wait(m_Guard, timeoutInMilliseconds); }
+      return m_bDone;
+    }
+
+    void TaskState::Finish(bool bCancelled, std::exception_ptr e) {
+      std::vector<std::function<void ()>> vContinuations;
+      {
+        SCOPEDLOCK(m_Guard);
+        m_bDone = true;
+        m_bCancelled = bCancelled;
+        m_Exception = e;
+        vContinuations.swap(m_vContinuations);
+        m_DoneCondition.WakeAll();
+      }
+      for(size_t i=0; i < vContinuations.size(); ++i) { vContinuations[i](); }
+    }
+
+    void TaskState::OnDone(std::function<void ()> f) {
+      {
+        SCOPEDLOCK(m_Guard);
+        if(!m_bDone) { m_vContinuations.push_back(f); return; }
+      }
+      f();
+    }
+
+    void TaskState::Rethrow() const {
+      SCOPEDLOCK(m_Guard);
+      if(m_Exception) { std::rethrow_exception(m_Exception); }
+    }
+  }
+
+  TaskScheduler::TaskScheduler(size_t iThreads) :
+    m_iPending(0),
+    m_iNextWorker(0),
+    m_bShutdown(false),
+    m_iStarted(0)
+  {
+    using namespace std::placeholders;
+    iThreads = std::max<size_t>(iThreads, 1);
+    for(size_t i=0; i < iThreads; ++i) {
+      m_vWorkers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    for(size_t i=0; i < iThreads; ++i) {
+      m_vWorkers[i]->m_pThread.reset(new LambdaThread(
+        std::bind(&TaskScheduler::Run, this, i, _1, _2)
+      ));
+      m_vWorkers[i]->m_pThread->StartThread();
+    }
+    // WorkerIndex relies on the workers' IDs; wait until all are known.
+    SCOPEDLOCK(m_WakeGuard);
+    while(m_iStarted < iThreads) { m_Wake.Wait(m_WakeGuard); }
+  }
+
+  TaskScheduler::~TaskScheduler() {
+    {
+      SCOPEDLOCK(m_WakeGuard);
+      for(size_t i=0; i < m_vWorkers.size(); ++i) {
+        m_vWorkers[i]->m_pThread->RequestThreadStop();
+      }
+      m_Wake.WakeAll();
+    }
+    for(size_t i=0; i < m_vWorkers.size(); ++i) {
+      m_vWorkers[i]->m_pThread->JoinThread();
+    }
+
+    // cancel what is left.  Continuations of those tasks end up in Push,
+    // which now cancels them right away.
+    m_bShutdown = true;
+    Job job;
+    while(Pop(-1, job)) { job(false); }
+  }
+
+  void TaskScheduler::Push(Job job, Priority p) {
+    if(m_bShutdown) { job(false); return; }
+
+    const int iSelf = WorkerIndex();
+    const size_t iWorker = iSelf >= 0 ? size_t(iSelf) :
+      m_iNextWorker.fetch_add(1) % m_vWorkers.size();
+    {
+      Worker& w = *m_vWorkers[iWorker];
+      SCOPEDLOCK(w.m_Guard);
+      w.m_Jobs[p].push_back(job);
+    }
+    ++m_iPending;
+    SCOPEDLOCK(m_WakeGuard);
+    m_Wake.WakeOne();
+  }
+
+  bool TaskScheduler::Pop(int iSelf, Job& job) {
+    if(m_iPending == 0) { return false; }
+
+    const size_t n = m_vWorkers.size();
+    for(int p=PRIORITY_COUNT-1; p >= 0; --p) {
+      // our own jobs newest first, they are likely still in the cache ...
+      if(iSelf >= 0) {
+        Worker& w = *m_vWorkers[iSelf];
+        SCOPEDLOCK(w.m_Guard);
+        if(!w.m_Jobs[p].empty()) {
+          job = w.m_Jobs[p].back();
+          w.m_Jobs[p].pop_back();
+          --m_iPending;
+          return true;
+        }
+      }
+      // ... others' oldest first, which are usually the bigger ones.
+      const size_t iStart = iSelf >= 0 ? size_t(iSelf)+1 : 0;
+      for(size_t i=0; i < n; ++i) {
+        Worker& w = *m_vWorkers[(iStart+i) % n];
+        SCOPEDLOCK(w.m_Guard);
+        if(!w.m_Jobs[p].empty()) {
+          job = w.m_Jobs[p].front();
+          w.m_Jobs[p].pop_front();
+          --m_iPending;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  bool TaskScheduler::RunOne(int iSelf) {
+    Job job;
+    if(!Pop(iSelf, job)) { return false; }
+    job(true);
+    return true;
+  }
+
+  int TaskScheduler::WorkerIndex() const {
+    const std::thread::id id = std::this_thread::get_id();
+    for(size_t i=0; i < m_vWorkers.size(); ++i) {
+      if(m_vWorkers[i]->m_ID == id) { return static_cast<int>(i); }
+    }
+    return -1;
+  }
+
+  void TaskScheduler::Wait(const detail::TaskState& state) {
+    const int iSelf = WorkerIndex();
+    if(iSelf < 0) {
+      state.Wait();
+      return;
+    }
+    // blocking a worker could deadlock if the task is queued behind us.
+    while(!state.Done()) {
+      if(!RunOne(iSelf)) { state.Wait(1); }
+    }
+  }
+
+  void TaskScheduler::Run(size_t iWorker, const bool& bContinue,
+                          LambdaThread::Interface&) {
+    {
+      SCOPEDLOCK(m_WakeGuard);
+      m_vWorkers[iWorker]->m_ID = std::this_thread::get_id();
+      ++m_iStarted;
+      m_Wake.WakeAll();
+    }
+
+    const int iSelf = static_cast<int>(iWorker);
+    // the stop request is made under m_WakeGuard; only look at it there.
+    for(;;) {
+      if(RunOne(iSelf)) { continue; }
+      SCOPEDLOCK(m_WakeGuard);
+      if(!bContinue) { break; }
+      if(m_iPending == 0) { m_Wake.Wait(m_WakeGuard); }
+    }
+  }
+
+  namespace {
+    /// what the threads working on one ParallelFor share.
+    struct ForState {
+      ForState(size_t iChunks, const TaskScheduler::RangeFunction& body) :
+        iChunks(iChunks), body(body), iNext(0), iDone(0), iActive(0),
+        bClosed(false), bFailed(false) {}
+
+      const size_t                   iChunks;
+      TaskScheduler::RangeFunction   body;
+      std::atomic<size_t>            iNext;
+      std::atomic<size_t>            iDone;
+      std::atomic<size_t>            iActive;
+      std::atomic<bool>              bClosed;
+      std::atomic<bool>              bFailed;
+      CriticalSection                guard;
+      WaitCondition                  idle;
+      std::exception_ptr             exception;
+    };
+
+    void RunChunks(ForState& s, size_t iBegin, size_t iEnd, size_t iGrain,
+                   const CancelToken& token) {
+      // once the caller closed the loop, 'body' may refer to things which
+      // are gone; see ParallelFor.
+      ++s.iActive;
+      while(!s.bClosed && !s.bFailed && !token.Cancelled()) {
+        const size_t c = s.iNext++;
+        if(c >= s.iChunks) { break; }
+        try {
+          s.body(iBegin + c*iGrain, std::min(iEnd, iBegin + (c+1)*iGrain));
+          ++s.iDone;
+        } catch(...) {
+          SCOPEDLOCK(s.guard);
+          if(!s.exception) { s.exception = std::current_exception(); }
+          s.bFailed = true;
+        }
+      }
+      if(--s.iActive == 0) {
+        SCOPEDLOCK(s.guard);
+        s.idle.WakeAll();
+      }
+    }
+  }
+
+  bool TaskScheduler::ParallelFor(size_t iBegin, size_t iEnd, size_t iGrain,
+                                  const RangeFunction& body, Priority p,
+                                  const CancelToken& token) {
+    if(iBegin >= iEnd) { return true; }
+    if(iGrain == 0) {
+      // the caller is one more thread working on the ranges.
+      iGrain = (iEnd - iBegin) / (4 * (m_vWorkers.size()+1));
+    }
+    iGrain = std::max<size_t>(iGrain, 1);
+    const size_t iChunks = (iEnd - iBegin + iGrain-1) / iGrain;
+
+    std::shared_ptr<ForState> state(new ForState(iChunks, body));
+    const size_t iHelpers = std::min(iChunks-1, m_vWorkers.size());
+    for(size_t i=0; i < iHelpers; ++i) {
+      Submit([=]() { RunChunks(*state, iBegin, iEnd, iGrain, token); }, p);
+    }
+    RunChunks(*state, iBegin, iEnd, iGrain, token);
+
+    // helpers which did not start yet will find the loop closed; wait for
+    // those which are still working on a range.
+    state->bClosed = true;
+    {
+      SCOPEDLOCK(state->guard);
+      while(state->iActive != 0) { state->idle.Wait(state->guard); }
+    }
+    if(state->exception) { std::rethrow_exception(state->exception); }
+    return state->iDone == iChunks;
+  }
+}
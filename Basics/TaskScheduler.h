@@ -0,0 +1,235 @@
+#pragma once
+
+#ifndef TUVOK_TASKSCHEDULER_H
+#define TUVOK_TASKSCHEDULER_H
+
+#include "StdDefines.h"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Threads.h"
+
+namespace tuvok
+{
+  /// Shared flag to ask tasks to stop.  Cancellation is cooperative: tasks
+  /// which did not start yet are not run at all, running ones have to check
+  /// Cancelled() themselves.
+  class CancelToken {
+  public:
+    CancelToken() : m_pCancelled(std::make_shared<std::atomic<bool>>(false)) {}
+    void Cancel() { m_pCancelled->store(true); }
+    bool Cancelled() const { return m_pCancelled->load(); }
+
+  private:
+    std::shared_ptr<std::atomic<bool>> m_pCancelled;
+  };
+
+  namespace detail {
+    /// completion state shared by a task and its futures.
+    class TaskState {
+    public:
+      TaskState() : m_bDone(false), m_bCancelled(false) {}
+
+      bool Done() const { SCOPEDLOCK(m_Guard); return m_bDone; }
+      bool Cancelled() const { SCOPEDLOCK(m_Guard); return m_bCancelled; }
+      /// waits at most the given time; @returns true if we are done.
+      bool Wait(uint32_t timeoutInMilliseconds = INFINITE_TIMEOUT) const;
+      /// marks the task finished and runs its continuations.
+      void Finish(bool bCancelled, std::exception_ptr e);
+      /// runs 'f' once the task finished, right away if it already has.
+      void OnDone(std::function<void ()> f);
+      /// re-throws what the task threw, if anything.
+      void Rethrow() const;
+
+    private:
+      mutable CriticalSection m_Guard;
+      mutable WaitCondition   m_DoneCondition;
+      bool                    m_bDone;
+      bool                    m_bCancelled;
+      std::exception_ptr      m_Exception;
+      std::vector<std::function<void ()>> m_vContinuations;
+    };
+
+    template<class T> struct TaskValue : public TaskState {
+      std::unique_ptr<T> value;
+    };
+    template<> struct TaskValue<void> : public TaskState {};
+
+    template<class T, class F> void Store(TaskValue<T>& s, F& f) {
+      s.value.reset(new T(f()));
+    }
+    template<class F> void Store(TaskValue<void>&, F& f) { f(); }
+
+    template<class T> T Value(const TaskValue<T>& s) { return *s.value; }
+    inline void Value(const TaskValue<void>&) {}
+  }
+
+  template<class T> class TaskFuture;
+
+  /// A fixed pool of worker threads which runs short tasks.  Every worker
+  /// has its own queues; idle workers steal from the others.  Tasks of
+  /// higher priority are always picked first, so interactive work overtakes
+  /// queued background work as soon as a worker becomes free (running tasks
+  /// are not interrupted; long running work should be split, e.g. with
+  /// ParallelFor).
+  class TaskScheduler {
+  public:
+    enum Priority {
+      PRIORITY_BACKGROUND=0,
+      PRIORITY_NORMAL,
+      PRIORITY_INTERACTIVE,
+      PRIORITY_COUNT ///< don't use, but must be the last one.
+    };
+    typedef std::function<void (size_t iBegin, size_t iEnd)> RangeFunction;
+
+    /// @param iThreads number of workers; usually the number of CPUs.
+    explicit TaskScheduler(size_t iThreads);
+    /// tasks which did not start yet are cancelled.
+    ~TaskScheduler();
+
+    size_t GetThreadCount() const { return m_vWorkers.size(); }
+
+    /// Queues 'f' for execution.
+    template<class F>
+    TaskFuture<typename std::result_of<F()>::type>
+    Submit(F f, Priority p=PRIORITY_NORMAL,
+           const CancelToken& token=CancelToken());
+
+    /// Calls 'body' for consecutive ranges of at most 'iGrain' elements of
+    /// [iBegin, iEnd), e.g. brick indices, and waits for all of them.  The
+    /// calling thread works on the ranges, too.  Exceptions thrown by 'body'
+    /// are passed on to the caller.  A grain of 0 picks one which gives
+    /// every thread a few ranges, for elements of similar cost.
+    /// @returns false if the token was cancelled before all ranges ran.
+    bool ParallelFor(size_t iBegin, size_t iEnd, size_t iGrain,
+                     const RangeFunction& body, Priority p=PRIORITY_NORMAL,
+                     const CancelToken& token=CancelToken());
+
+  private:
+    template<class T> friend class TaskFuture;
+    /// runs the task, or (if called with false) just marks it cancelled.
+    typedef std::function<void (bool bRun)> Job;
+
+    template<class T, class F>
+    static Job MakeJob(std::shared_ptr<detail::TaskValue<T>> state, F f,
+                       const CancelToken& token);
+    void Push(Job job, Priority p);
+    bool Pop(int iSelf, Job& job);
+    /// runs one queued job, if there is one.
+    bool RunOne(int iSelf);
+    /// @returns the index of the calling worker, -1 for other threads.
+    int WorkerIndex() const;
+    /// waits for the task; workers keep running other tasks meanwhile.
+    void Wait(const detail::TaskState& state);
+    void Run(size_t iWorker, const bool& bContinue,
+             LambdaThread::Interface& thread);
+
+    struct Worker {
+      CriticalSection                           m_Guard;
+      std::array<std::deque<Job>, PRIORITY_COUNT> m_Jobs;
+      std::thread::id                           m_ID;
+      std::unique_ptr<LambdaThread>             m_pThread;
+    };
+    std::vector<std::unique_ptr<Worker>> m_vWorkers;
+    /// number of queued jobs, over all workers.
+    std::atomic<size_t>     m_iPending;
+    /// where threads other than our workers put their jobs.
+    std::atomic<size_t>     m_iNextWorker;
+    bool                    m_bShutdown;
+    size_t                  m_iStarted;
+    CriticalSection         m_WakeGuard;
+    WaitCondition           m_Wake;
+
+    TaskScheduler(TaskScheduler const&);
+    TaskScheduler& operator=(TaskScheduler const&);
+  };
+
+  /// Result of a task queued in a TaskScheduler.
+  template<class T>
+  class TaskFuture {
+  public:
+    TaskFuture() : m_pScheduler(NULL) {}
+
+    bool Valid() const { return m_pState.get() != NULL; }
+    bool Ready() const { return m_pState->Done(); }
+    /// @returns true if the task was cancelled before it ran.
+    bool Cancelled() const { return m_pState->Cancelled(); }
+    void Wait() const { m_pScheduler->Wait(*m_pState); }
+    /// Waits for and returns the result; re-throws what the task threw.
+    /// Must not be called for a cancelled task.
+    T Get() const {
+      Wait();
+      m_pState->Rethrow();
+      return detail::Value(*m_pState);
+    }
+
+    /// Queues 'f' once this task finished (or was cancelled); 'f' is passed
+    /// this future.
+    template<class F>
+    TaskFuture<typename std::result_of<F(TaskFuture<T>)>::type>
+    Then(F f, TaskScheduler::Priority p=TaskScheduler::PRIORITY_NORMAL,
+         const CancelToken& token=CancelToken()) const;
+
+  private:
+    friend class TaskScheduler;
+    TaskFuture(std::shared_ptr<detail::TaskValue<T>> state,
+               TaskScheduler* pScheduler) :
+      m_pState(state), m_pScheduler(pScheduler) {}
+
+    std::shared_ptr<detail::TaskValue<T>> m_pState;
+    TaskScheduler*                        m_pScheduler;
+  };
+
+  template<class T, class F>
+  TaskScheduler::Job TaskScheduler::MakeJob(
+    std::shared_ptr<detail::TaskValue<T>> state, F f,
+    const CancelToken& token
+  ) {
+    return [=](bool bRun) mutable {
+      if(!bRun || token.Cancelled()) {
+        state->Finish(true, std::exception_ptr());
+        return;
+      }
+      try {
+        detail::Store(*state, f);
+      } catch(...) {
+        state->Finish(false, std::current_exception());
+        return;
+      }
+      state->Finish(false, std::exception_ptr());
+    };
+  }
+
+  template<class F>
+  TaskFuture<typename std::result_of<F()>::type>
+  TaskScheduler::Submit(F f, Priority p, const CancelToken& token) {
+    typedef typename std::result_of<F()>::type R;
+    std::shared_ptr<detail::TaskValue<R>> state(new detail::TaskValue<R>());
+    Push(MakeJob(state, f, token), p);
+    return TaskFuture<R>(state, this);
+  }
+
+  template<class T> template<class F>
+  TaskFuture<typename std::result_of<F(TaskFuture<T>)>::type>
+  TaskFuture<T>::Then(F f, TaskScheduler::Priority p,
+                      const CancelToken& token) const {
+    typedef typename std::result_of<F(TaskFuture<T>)>::type R;
+    std::shared_ptr<detail::TaskValue<R>> state(new detail::TaskValue<R>());
+    const TaskFuture<T> self(*this);
+    TaskScheduler* pScheduler = m_pScheduler;
+    m_pState->OnDone([=]() {
+      pScheduler->Push(TaskScheduler::MakeJob(state,
+                                              [=]() { return f(self); },
+                                              token), p);
+    });
+    return TaskFuture<R>(state, m_pScheduler);
+  }
+}
+
+#endif // TUVOK_TASKSCHEDULER_H
@@ -83,8 +83,13 @@ namespace tuvok
       timeval tv;
       timespec ts;
       gettimeofday(&tv, NULL);
-      ts.tv_sec = tv.tv_sec + (timeoutInMilliseconds / 10000);
-      ts.tv_nsec = tv.tv_usec * 1000;
+      ts.tv_sec = tv.tv_sec + (timeoutInMilliseconds / 1000);
+      ts.tv_nsec = tv.tv_usec * 1000 +
+                   long(timeoutInMilliseconds % 1000) * 1000000;
+      if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000;
+      }
       bWaitResult = (pthread_cond_timedwait(&m_cvWaitCondition, &criticalSection.m_csIDGuard, &ts) == 0);
     }
 		else
@@ -141,14 +146,18 @@ namespace tuvok
 			m_hThread = CreateThread(NULL, 0, StaticStartFunc, m_pStartData, NULL, 0);
 			if (m_hThread) return true;
 #else
+			// a short-lived thread may finish before pthread_create returns; it
+			// must not be marked joinable after it marked itself as done.
+			m_JoinMutex.Lock();
 			m_bJoinable = false;
 			if (pthread_create(&m_hThread, NULL, StaticStartFunc, (void*)m_pStartData) == 0)
 			{
         m_bInitialized = true;
 				m_bJoinable = true;
-				pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+				m_JoinMutex.Unlock();
 				return true;
 			}
+			m_JoinMutex.Unlock();
 #endif
 		}
 		delete m_pStartData;
@@ -193,6 +202,9 @@ namespace tuvok
 #ifdef DETECTED_OS_WINDOWS
 		return (TerminateThread(m_hThread, 0) != 0);
 #else
+		// threads keep the default, deferred cancel type: the thread stops at
+		// its next cancellation point rather than in the middle of, e.g., a
+		// malloc holding a lock.
 		return (pthread_cancel(m_hThread) == 0);
 #endif
 	}
@@ -66,21 +66,17 @@ namespace Controller {
   };
 }}
 
-#define T_ERROR(...)                                              \
-  do {                                                            \
-    tuvok::Controller::Debug::Out().Error(_func_, __VA_ARGS__);   \
-  } while(0)
-#define WARNING(...)                                              \
-  do {                                                            \
-    tuvok::Controller::Debug::Out().Warning(_func_, __VA_ARGS__); \
-  } while(0)
-#define MESSAGE(...)                                              \
-  do {                                                            \
-    tuvok::Controller::Debug::Out().Message(_func_, __VA_ARGS__); \
-  } while(0)
-#define OTHER(...)                                                \
-  do {                                                            \
-    tuvok::Controller::Debug::Out().Other(_func_, __VA_ARGS__);   \
+// The channel is checked before the call, so neither the arguments are
+// evaluated nor the message formatted when nobody would see it.
+#define TUVOK_DEBUG_OUT(show, fn, ...)                                \
+  do {                                                                \
+    AbstrDebugOut& tvk_dbg_out_ = tuvok::Controller::Debug::Out();    \
+    if(tvk_dbg_out_.show()) { tvk_dbg_out_.fn(_func_, __VA_ARGS__); } \
   } while(0)
 
+#define T_ERROR(...) TUVOK_DEBUG_OUT(ShowErrors, Error, __VA_ARGS__)
+#define WARNING(...) TUVOK_DEBUG_OUT(ShowWarnings, Warning, __VA_ARGS__)
+#define MESSAGE(...) TUVOK_DEBUG_OUT(ShowMessages, Message, __VA_ARGS__)
+#define OTHER(...)   TUVOK_DEBUG_OUT(ShowOther, Other, __VA_ARGS__)
+
 #endif // TUVOK_CONTROLLER_H
@@ -40,6 +40,8 @@
 #include "MasterController.h"
 #include "../Basics/SystemInfo.h"
 #include "../Basics/SysTools.h"
+#include "../Basics/TaskScheduler.h"
+#include "../DebugOut/AsyncDebugOut.h"
 #include "../IO/IOManager.h"
 #include "../IO/TransferFunction1D.h"
 #include "../IO/Dataset.h"
@@ -64,11 +66,13 @@ using namespace tuvok;
 MasterController::MasterController() :
   m_bDeleteDebugOutOnExit(false),
   m_bExperimentalFeatures(false),
+  m_bAsyncDebugOut(false),
   m_pLuaScript(new LuaScripting()),
   m_pMemReg(new LuaMemberReg(m_pLuaScript)),
   m_pActiveRenderer(NULL)
 {
   m_pSystemInfo   = new SystemInfo();
+  m_pScheduler    = new TaskScheduler(m_pSystemInfo->GetNumberOfCPUs());
   m_pIOManager    = new IOManager();
   m_pGPUMemMan    = new GPUMemMan(this);
 
@@ -94,6 +98,10 @@ MasterController::MasterController() :
 MasterController::~MasterController() {
   Cleanup();
   m_DebugOut.clear();
+  m_AsyncDebugOuts.clear();
+  // the asynchronous debug outs write from the scheduler's workers.
+  delete m_pScheduler;
+  m_pScheduler = NULL;
 }
 
 void MasterController::Cleanup() {
@@ -114,7 +122,13 @@ void MasterController::AddDebugOut(AbstrDebugOut* debugOut) {
   if (debugOut != NULL) {
     m_DebugOut.Other(_func_, "Disconnecting from this debug out");
 
-    m_DebugOut.AddDebugOut(debugOut);
+    if (m_bAsyncDebugOut) {
+      AbstrDebugOut* async = new AsyncDebugOut(debugOut, *m_pScheduler);
+      m_AsyncDebugOuts[debugOut] = async;
+      m_DebugOut.AddDebugOut(async);
+    } else {
+      m_DebugOut.AddDebugOut(debugOut);
+    }
 
     debugOut->Other(_func_, "Connected to this debug out");
   } else {
@@ -125,9 +139,24 @@ void MasterController::AddDebugOut(AbstrDebugOut* debugOut) {
 
 
 void MasterController::RemoveDebugOut(AbstrDebugOut* debugOut) {
+  // the caller knows the out it gave us, not the wrapper we added.
+  std::map<AbstrDebugOut*, AbstrDebugOut*>::iterator async =
+    m_AsyncDebugOuts.find(debugOut);
+  if (async != m_AsyncDebugOuts.end()) {
+    debugOut = async->second;
+    m_AsyncDebugOuts.erase(async);
+  }
   m_DebugOut.RemoveDebugOut(debugOut);
 }
 
+void MasterController::SetAsyncDebugOut(bool bAsync) {
+  m_bAsyncDebugOut = bAsync;
+}
+
+bool MasterController::GetAsyncDebugOut() const {
+  return m_bAsyncDebugOut;
+}
+
 /// Access the currently-active debug stream.
 AbstrDebugOut* MasterController::DebugOut()
 {
@@ -336,6 +365,14 @@ uint64_t MasterController::GetMaxCPUMem() const {
   return m_pSystemInfo->GetMaxUsableCPUMem() / megabyte;
 }
 
+void MasterController::SetNUMALocalBrickCache(bool bLocal) {
+  m_pSystemInfo->SetNUMALocalBrickCache(bLocal);
+}
+
+bool MasterController::GetNUMALocalBrickCache() const {
+  return m_pSystemInfo->GetNUMALocalBrickCache();
+}
+
 void register_unsigned(lua_State* lua, const char* name, unsigned value) {
   lua_pushinteger(lua, value);
   lua_setglobal(lua, name);
@@ -479,6 +516,16 @@ void MasterController::RegisterLuaCommands() {
     &MasterController::GetMaxCPUMem, "tuvok.state.getCpuMem",
     "gets the max amount of CPU memory.  In megabytes.", false
     );
+  m_pMemReg->registerFunction(this,
+    &MasterController::SetNUMALocalBrickCache,
+    "tuvok.state.numaLocalBrickCache", "if true, rebricked datasets loaded "
+    "from now on keep their cached bricks on the NUMA node of the thread "
+    "which read them.  default: false", false
+  );
+  m_pMemReg->registerFunction(this,
+    &MasterController::GetNUMALocalBrickCache,
+    "tuvok.state.getNumaLocalBrickCache", "", false
+  );
   m_pMemReg->registerFunction(this, &MasterController::SetMDUpdateStrategy,
     "tuvok.state.mdUpdateStrategy", "control the background metadata update "
     "thread.\n  0: enabled (default)\n  1: async thread does nothing\n  2: "
@@ -489,6 +536,12 @@ void MasterController::RegisterLuaCommands() {
     "values give better raw performance; smaller values make the system more "
     " responsive.  default: 509", false);
 
+  m_pMemReg->registerFunction(this, &MasterController::SetAsyncDebugOut,
+    "tuvok.state.asyncDebugOut", "if true, debug outputs added from now on "
+    "are written to by a background thread.  default: false", false);
+  m_pMemReg->registerFunction(this, &MasterController::GetAsyncDebugOut,
+    "tuvok.state.getAsyncDebugOut", "", false);
+
   m_pMemReg->registerFunction(this, &MasterController::GetBrickStrategy,
     "tuvok.state.getBrickStrategy", "", false);
   m_pMemReg->registerFunction(this, &MasterController::GetRehashCount,
@@ -33,6 +33,7 @@
 #include "../StdTuvokDefines.h"
 #include <functional>
 #include <list>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -55,6 +56,7 @@ class LuaScripting;
 class LuaMemberReg;
 class LuaIOManagerProxy;
 class RenderRegion;
+class TaskScheduler;
 
 typedef std::deque<AbstrRenderer*> AbstrRendererList;
 
@@ -113,6 +115,14 @@ public:
   /// \param debugOut      the new stream
   void AddDebugOut(AbstrDebugOut* debugOut);
 
+  /// Whether debug outputs added from now on are written to by a
+  /// background thread (see AsyncDebugOut), so that slow outputs do not
+  /// hold up the threads which log.  Off by default.
+  ///@{
+  void SetAsyncDebugOut(bool bAsync);
+  bool GetAsyncDebugOut() const;
+  ///@}
+
   /// Removes the given debug output stream.
   /// The stream must be the currently connected/used one.
   void RemoveDebugOut(AbstrDebugOut* debugOut);
@@ -144,6 +154,11 @@ public:
   const SystemInfo& SysInfo() const { return *m_pSystemInfo; }
   ///@}
 
+  /// The task scheduler runs short, parallel jobs on a pool of one worker
+  /// per CPU; use it instead of starting threads of your own.  It outlives
+  /// Cleanup(); whoever submits tasks must wait for them before going away.
+  TaskScheduler& Scheduler() { return *m_pScheduler; }
+
   /// Whether or not to expose certain features which aren't actually ready for
   /// users.
   bool ExperimentalFeatures() const;
@@ -165,6 +180,11 @@ public:
   uint64_t GetMaxGPUMem() const;
   uint64_t GetMaxCPUMem() const;
 
+  /// keep the bricks of rebricked datasets on the NUMA node of the thread
+  /// which read them; applies to datasets loaded from now on.
+  void SetNUMALocalBrickCache(bool bLocal);
+  bool GetNUMALocalBrickCache() const;
+
   /// centralized storage for renderer parameters
   ///@{
   void SetBrickStrategy(size_t strat);
@@ -214,12 +234,16 @@ private:
 
 private:
   SystemInfo*      m_pSystemInfo;
+  TaskScheduler*   m_pScheduler;
   GPUMemMan*       m_pGPUMemMan;
   IOManager*       m_pIOManager;
   MultiplexOut     m_DebugOut;
   ConsoleOut       m_DefaultOut;
   bool             m_bDeleteDebugOutOnExit;
   bool             m_bExperimentalFeatures;
+  bool             m_bAsyncDebugOut;
+  /// debug outs we wrapped in an AsyncDebugOut, and their wrapper
+  std::map<AbstrDebugOut*, AbstrDebugOut*> m_AsyncDebugOuts;
 
   std::shared_ptr<LuaScripting>       m_pLuaScript;
   std::unique_ptr<LuaMemberReg>       m_pMemReg;
@@ -0,0 +1,249 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2014 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \file    AsyncDebugOut.cpp
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include "AsyncDebugOut.h"
+
+using namespace tuvok;
+
+namespace {
+  size_t RoundUpPow2(size_t n) {
+    size_t p = 1;
+    while(p < n) { p <<= 1; }
+    return p;
+  }
+
+  void CopyTruncated(char* dst, size_t iSize, const char* src) {
+    if(src == NULL) { dst[0] = '\0'; return; }
+    const size_t iLen = std::min(strlen(src), iSize-1);
+    memcpy(dst, src, iLen);
+    dst[iLen] = '\0';
+  }
+}
+
+AsyncDebugOut::AsyncDebugOut(AbstrDebugOut* out, TaskScheduler& scheduler,
+                             size_t iSlots) :
+  m_pOut(out),
+  m_Ring(new Record[RoundUpPow2(std::max<size_t>(iSlots, 2))]),
+  m_iMask(RoundUpPow2(std::max<size_t>(iSlots, 2)) - 1),
+  m_iHead(0),
+  m_iTail(0),
+  m_iDropsReported(0),
+  m_Scheduler(scheduler),
+  m_bWriting(false)
+{
+  for(size_t i=0; i <= m_iMask; ++i) {
+    m_Ring[i].seq.store(i, std::memory_order_relaxed);
+  }
+  for(size_t i=0; i < m_iDropped.size(); ++i) {
+    m_iDropped[i].store(0, std::memory_order_relaxed);
+  }
+  // we show whatever the wrapped out shows.
+  m_bShowMessages = m_pOut->ShowMessages();
+  m_bShowWarnings = m_pOut->ShowWarnings();
+  m_bShowErrors = m_pOut->ShowErrors();
+  m_bShowOther = m_pOut->ShowOther();
+}
+
+AsyncDebugOut::~AsyncDebugOut() {
+  // the writer refers to us.
+  WaitForWriter();
+  // anything logged while the writer was finishing.
+  Drain();
+}
+
+// Bounded multi producer, single consumer queue after D. Vyukov: every slot
+// carries a sequence number which tells producers whether the slot is free
+// for the current lap and the consumer whether it has been filled.
+bool AsyncDebugOut::Push(enum DebugChannel channel, const char* source,
+                         const char* msg) {
+  size_t pos = m_iHead.load(std::memory_order_relaxed);
+  Record* r;
+  for(;;) {
+    r = &m_Ring[pos & m_iMask];
+    const size_t seq = r->seq.load(std::memory_order_acquire);
+    const ptrdiff_t diff = ptrdiff_t(seq) - ptrdiff_t(pos);
+    if(diff == 0) {
+      if(m_iHead.compare_exchange_weak(pos, pos+1,
+                                       std::memory_order_relaxed)) {
+        break;
+      }
+    } else if(diff < 0) {
+      // the consumer has not yet read this slot: the ring is full.
+      return false;
+    } else {
+      pos = m_iHead.load(std::memory_order_relaxed);
+    }
+  }
+  r->channel = channel;
+  CopyTruncated(r->source, sizeof(r->source), source);
+  CopyTruncated(r->msg, sizeof(r->msg), msg);
+  r->seq.store(pos+1, std::memory_order_release);
+  Wake();
+  return true;
+}
+
+void AsyncDebugOut::Wake() {
+  // the writer announces that it stops before it looks at the ring for the
+  // last time; one of us is bound to see what the other did.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(m_bWriting.exchange(true)) { return; }
+  SCOPEDLOCK(m_WriterGuard);
+  // writing is short, and the user waits to see it.
+  m_Writer = m_Scheduler.Submit([this]() { Write(); },
+                                TaskScheduler::PRIORITY_INTERACTIVE);
+}
+
+void AsyncDebugOut::Write() {
+  do {
+    Drain();
+    m_bWriting.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // a record pushed meanwhile may have seen us still writing.
+  } while(Pending() && !m_bWriting.exchange(true));
+}
+
+void AsyncDebugOut::WaitForWriter() const {
+  for(;;) {
+    TaskFuture<void> writer;
+    {
+      SCOPEDLOCK(m_WriterGuard);
+      writer = m_Writer;
+    }
+    // waiting on a worker runs other tasks meanwhile, maybe the writer.
+    if(writer.Valid()) { writer.Wait(); }
+    if(!m_bWriting.load() || (writer.Valid() && writer.Cancelled())) {
+      return;
+    }
+    // the next writer is being queued.
+    std::this_thread::yield();
+  }
+}
+
+bool AsyncDebugOut::Pending() const {
+  const size_t pos = m_iTail.load(std::memory_order_relaxed);
+  return m_Ring[pos & m_iMask].seq.load(std::memory_order_acquire) == pos+1;
+}
+
+bool AsyncDebugOut::Drain() {
+  bool bAny = false;
+  size_t pos = m_iTail.load(std::memory_order_relaxed);
+  for(;;) {
+    Record& r = m_Ring[pos & m_iMask];
+    if(r.seq.load(std::memory_order_acquire) != pos+1) { break; }
+    if(m_pOut->Enabled(r.channel)) {
+      m_pOut->printf(r.channel, r.source, r.msg);
+    }
+    // hand the slot to the producers of the next lap.
+    r.seq.store(pos+m_iMask+1, std::memory_order_release);
+    m_iTail.store(++pos, std::memory_order_release);
+    bAny = true;
+  }
+
+  uint64_t iDropped = 0;
+  for(size_t i=0; i < m_iDropped.size(); ++i) {
+    iDropped += m_iDropped[i].load(std::memory_order_relaxed);
+  }
+  if(iDropped > m_iDropsReported) {
+    if(m_pOut->Enabled(CHANNEL_WARNING)) {
+      char buff[128];
+#ifdef DETECTED_OS_WINDOWS
+      _snprintf_s(buff, sizeof(buff), _TRUNCATE,
+#else
+      snprintf(buff, sizeof(buff),
+#endif
+               "%llu debug messages were dropped, the output could not keep "
+               "up.",
+               static_cast<unsigned long long>(iDropped - m_iDropsReported));
+      m_pOut->printf(CHANNEL_WARNING, _func_, buff);
+    }
+    m_iDropsReported = iDropped;
+  }
+  return bAny;
+}
+
+void AsyncDebugOut::printf(enum DebugChannel channel, const char* source,
+                           const char* msg)
+{
+  if(!Push(channel, source, msg) &&
+     channel > CHANNEL_NONE && channel < CHANNEL_FINAL) {
+    m_iDropped[channel].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void AsyncDebugOut::printf(const char *s) const
+{
+  // not a log record (used to print the recorded lists); flush so that it
+  // shows up after what was logged before.
+  Flush();
+  m_pOut->printf(s);
+}
+
+void AsyncDebugOut::Flush() const {
+  const size_t iHead = m_iHead.load(std::memory_order_acquire);
+  while(m_iTail.load(std::memory_order_acquire) < iHead) {
+    WaitForWriter();
+    // a record being pushed may not be filled in yet.
+    if(m_iTail.load(std::memory_order_acquire) < iHead) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+uint64_t AsyncDebugOut::Dropped(enum DebugChannel channel) const {
+  if(channel <= CHANNEL_NONE || channel >= CHANNEL_FINAL) { return 0; }
+  return m_iDropped[channel].load(std::memory_order_relaxed);
+}
+
+void AsyncDebugOut::SetShowMessages(bool bShowMessages) {
+  AbstrDebugOut::SetShowMessages(bShowMessages);
+  m_pOut->SetShowMessages(bShowMessages);
+}
+
+void AsyncDebugOut::SetShowWarnings(bool bShowWarnings) {
+  AbstrDebugOut::SetShowWarnings(bShowWarnings);
+  m_pOut->SetShowWarnings(bShowWarnings);
+}
+
+void AsyncDebugOut::SetShowErrors(bool bShowErrors) {
+  AbstrDebugOut::SetShowErrors(bShowErrors);
+  m_pOut->SetShowErrors(bShowErrors);
+}
+
+void AsyncDebugOut::SetShowOther(bool bShowOther) {
+  AbstrDebugOut::SetShowOther(bShowOther);
+  m_pOut->SetShowOther(bShowOther);
+}
@@ -0,0 +1,122 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2014 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \file    AsyncDebugOut.h
+  \brief   Hands debug output to a background thread, which writes it to
+           another debug out.
+*/
+
+#pragma once
+
+#ifndef TUVOK_ASYNCDEBUGOUT_H
+#define TUVOK_ASYNCDEBUGOUT_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include "AbstrDebugOut.h"
+#include "Basics/TaskScheduler.h"
+
+/// Decouples the threads which log from the (slow) output: messages are
+/// copied into a fixed size ring buffer and written to the wrapped debug out
+/// by a writer task on the task scheduler.  Logging only allocates and takes
+/// a lock when it has to queue the writer, i.e. once for a burst of
+/// messages; if the ring is full, the message is dropped and counted
+/// instead.  There is at most one writer at a time, so the wrapped out need
+/// not be thread safe.
+class AsyncDebugOut : public AbstrDebugOut {
+  public:
+    /// @param out the debug out to write to; we take ownership.
+    /// @param scheduler runs the writer; it must outlive us.
+    /// @param iSlots capacity of the ring, rounded up to a power of two.
+    AsyncDebugOut(AbstrDebugOut* out, tuvok::TaskScheduler& scheduler,
+                  size_t iSlots=1024);
+    /// writes whatever is still queued before shutting down.
+    ~AsyncDebugOut();
+
+    virtual void printf(enum DebugChannel, const char* source,
+                        const char* msg);
+    virtual void printf(const char *s) const;
+
+    virtual void SetShowMessages(bool bShowMessages);
+    virtual void SetShowWarnings(bool bShowWarnings);
+    virtual void SetShowErrors(bool bShowErrors);
+    virtual void SetShowOther(bool bShowOther);
+
+    /// Waits until everything queued so far has been written.
+    void Flush() const;
+
+    /// @returns the number of messages on the channel we had to drop
+    /// because the ring was full.
+    uint64_t Dropped(enum DebugChannel channel) const;
+
+  private:
+    AsyncDebugOut(const AsyncDebugOut&); ///< unimplemented.
+    AsyncDebugOut& operator=(const AsyncDebugOut&); ///< unimplemented.
+
+    /// one slot of the ring; longer messages are truncated.
+    struct Record {
+      std::atomic<size_t> seq;
+      enum DebugChannel channel;
+      char source[64];
+      char msg[1024];
+    };
+
+    bool Push(enum DebugChannel channel, const char* source, const char* msg);
+    /// @returns true if the next slot to read has been filled.
+    bool Pending() const;
+    /// writes everything queued; @returns false if there was nothing.
+    bool Drain();
+    /// queues the writer unless it is queued or running already.
+    void Wake();
+    /// the writer task: writes until the ring is empty.
+    void Write();
+    /// waits for the latest writer task.
+    void WaitForWriter() const;
+
+    std::unique_ptr<AbstrDebugOut> m_pOut;
+    std::unique_ptr<Record[]>      m_Ring;
+    const size_t                   m_iMask;
+    /// next slot to write; shared by all logging threads.
+    std::atomic<size_t>            m_iHead;
+    /// next slot to read; only touched by the writer.
+    std::atomic<size_t>            m_iTail;
+    std::array<std::atomic<uint64_t>, CHANNEL_FINAL> m_iDropped;
+    /// drops we already told the wrapped out about.
+    uint64_t                       m_iDropsReported;
+
+    tuvok::TaskScheduler&          m_Scheduler;
+    /// set while the writer is queued or running.
+    std::atomic<bool>              m_bWriting;
+    mutable tuvok::CriticalSection m_WriterGuard;
+    /// the latest writer task.
+    tuvok::TaskFuture<void>        m_Writer;
+};
+
+#endif // TUVOK_ASYNCDEBUGOUT_H
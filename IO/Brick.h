@@ -71,8 +71,6 @@ struct BKeyHash : std::unary_function<BrickKey, std::size_t> {
     return seed;
   }
 };
-typedef std::unordered_map<BrickKey, BrickMD, BKeyHash> BrickTable;
-
 } // namespace tuvok
 
 #endif // TUVOK_BRICK_H
@@ -4,6 +4,8 @@
 #include <map>
 #include <memory>
 #include "BrickCache.h"
+#include "Basics/SystemInfo.h"
+#include "Controller/Controller.h"
 #include "Controller/StackTimer.h"
 
 namespace tuvok {
@@ -91,7 +93,7 @@ struct CacheLRU {
 };
 
 struct BrickCache::bcinfo {
-    bcinfo(): bytes(0) {}
+    bcinfo(): bytes(0), numa_local(false) {}
     // this is wordy but they all just forward to a real implementation below.
     const void* lookup(const BrickKey& k, uint8_t) {
       return this->typed_lookup<uint8_t>(k);
@@ -174,6 +176,7 @@ struct BrickCache::bcinfo {
       this->bytes = 0;
     }
     size_t size() const { return this->bytes; }
+    void set_numa_local(bool local) { this->numa_local = local; }
 
   private:
     template<typename T> const void* typed_lookup(const BrickKey& k);
@@ -184,6 +187,7 @@ struct BrickCache::bcinfo {
     typedef std::pair<BrickInfo, TypeErase> CacheElem;
     std::vector<CacheElem> cache;
     size_t bytes; ///< how much memory we're currently using for data.
+    bool numa_local; ///< move added bricks to the adding thread's node
 };
 
 struct KeyMatches {
@@ -230,10 +234,22 @@ const void* BrickCache::bcinfo::typed_add(const BrickKey& k,
 
   assert(this->size() == this->bytes);
   TypeErase::GenericType& gt = *this->cache.back().second.gt;
-  return dynamic_cast<TypeErase::TypeEraser<std::vector<T>>&>(gt).get().data();
+  const std::vector<T>& stored =
+    dynamic_cast<TypeErase::TypeEraser<std::vector<T>>&>(gt).get();
+  if(this->numa_local && !stored.empty()) {
+    // the data may have been read by a thread on another node.
+    const SystemInfo& si = Controller::ConstInstance().SysInfo();
+    si.MoveToNUMANode(stored.data(), stored.size()*sizeof(T),
+                      si.GetCurrentNUMANode());
+  }
+  return stored.data();
 }
 
-BrickCache::BrickCache() : ci(new BrickCache::bcinfo) {}
+BrickCache::BrickCache() : ci(new BrickCache::bcinfo) {
+  this->ci->set_numa_local(
+    Controller::ConstInstance().SysInfo().GetNUMALocalBrickCache()
+  );
+}
 BrickCache::~BrickCache() {}
 
 const void* BrickCache::lookup(const BrickKey& k, uint8_t value) {
@@ -307,6 +323,7 @@ const void* BrickCache::add(const BrickKey& k,
 void BrickCache::remove() { this->ci->remove(); }
 void BrickCache::clear() { return this->ci->clear(); }
 size_t BrickCache::size() const { return this->ci->size(); }
+void BrickCache::SetNUMALocal(bool bLocal) { this->ci->set_numa_local(bLocal); }
 
 }
 /*
@@ -53,6 +53,11 @@ class BrickCache {
     /// empties the cache.
     void clear();
 
+    /// On NUMA systems, move the pages of every brick we add to the node of
+    /// the thread adding it, i.e. the one which will use it.  Defaults to
+    /// SystemInfo::GetNUMALocalBrickCache().
+    void SetNUMALocal(bool bLocal);
+
   private:
     struct bcinfo;
     std::unique_ptr<bcinfo> ci;
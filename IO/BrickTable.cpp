@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cmath>
+#include "BrickTable.h"
+
+namespace tuvok {
+
+BrickTable::const_iterator::const_iterator(const BrickTable* pTable,
+                                           uint64_t iPos, size_t iGrid) :
+  m_pTable(pTable), m_iPos(iPos), m_iGrid(iGrid)
+{
+  Update();
+}
+
+BrickTable::const_iterator& BrickTable::const_iterator::operator++() {
+  ++m_iPos;
+  Update();
+  return *this;
+}
+
+void BrickTable::const_iterator::Update() {
+  if(m_iPos >= m_pTable->m_iSize) { return; }
+  if(m_iPos < m_pTable->m_vBricks.size()) {
+    m_Current = m_pTable->m_vBricks[size_t(m_iPos)];
+    return;
+  }
+  // step to the next grid once we are through with this one
+  const uint64_t iGridPos = m_iPos - m_pTable->m_vBricks.size();
+  while(m_iGrid+1 < m_pTable->m_vGridStart.size() &&
+        iGridPos >= m_pTable->m_vGridStart[m_iGrid+1]) {
+    ++m_iGrid;
+  }
+  const Grid& g = m_pTable->m_vGrids[m_iGrid];
+  const uint64_t iIndex = iGridPos - m_pTable->m_vGridStart[m_iGrid];
+  m_Current.first = BrickKey(g.iTimestep, g.iLOD, size_t(iIndex));
+  m_Current.second = GridBrick(g, iIndex);
+}
+
+BrickTable::BrickTable() : m_iSize(0) {}
+
+BrickTable::const_iterator BrickTable::begin() const {
+  return const_iterator(this, 0, 0);
+}
+
+BrickTable::const_iterator BrickTable::end() const {
+  return const_iterator(this, m_iSize, 0);
+}
+
+BrickTable::const_iterator BrickTable::find(const BrickKey& k) const {
+  size_t iGrid;
+  const Grid* g = FindGrid(std::get<0>(k), std::get<1>(k), iGrid);
+  if(g) {
+    if(std::get<2>(k) >= g->vBrickCount.volume()) { return end(); }
+    return const_iterator(this, m_vBricks.size() + m_vGridStart[iGrid] +
+                                std::get<2>(k), iGrid);
+  }
+  std::unordered_map<BrickKey, size_t, BKeyHash>::const_iterator i =
+    m_Index.find(k);
+  if(i == m_Index.end()) { return end(); }
+  return const_iterator(this, i->second, 0);
+}
+
+BrickTable::size_type BrickTable::count(size_t iTimestep, size_t iLOD) const {
+  size_type n = 0;
+  size_t iGrid;
+  const Grid* g = FindGrid(iTimestep, iLOD, iGrid);
+  if(g) { n += size_type(g->vBrickCount.volume()); }
+  for(std::vector<value_type>::const_iterator b = m_vBricks.begin();
+      b != m_vBricks.end(); ++b) {
+    if(std::get<0>(b->first) == iTimestep && std::get<1>(b->first) == iLOD) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+void BrickTable::reserve(size_t n) {
+  m_vBricks.reserve(n);
+  // The following line implements m_Index.reserve(n);
+  // in a portable way. unordered_map does not define
+  // a reserve function but is seems gcc's tr1 does
+  m_Index.rehash(size_t(ceil(float(n) / m_Index.max_load_factor())));
+}
+
+void BrickTable::insert(const value_type& brick) {
+  size_t iGrid;
+  if(FindGrid(std::get<0>(brick.first), std::get<1>(brick.first), iGrid) ||
+     m_Index.find(brick.first) != m_Index.end()) {
+    return;
+  }
+  m_Index.insert(std::make_pair(brick.first, m_vBricks.size()));
+  m_vBricks.push_back(brick);
+  ++m_iSize;
+}
+
+void BrickTable::insert(const Grid& grid) {
+  if(m_vGridLookup.size() <= grid.iTimestep) {
+    m_vGridLookup.resize(grid.iTimestep+1);
+  }
+  std::vector<size_t>& lods = m_vGridLookup[grid.iTimestep];
+  if(lods.size() <= grid.iLOD) { lods.resize(grid.iLOD+1, 0); }
+  if(lods[grid.iLOD] != 0) { return; }
+
+  const uint64_t iGridBricks = m_iSize - m_vBricks.size();
+  m_vGridStart.push_back(iGridBricks);
+  m_vGrids.push_back(grid);
+  lods[grid.iLOD] = m_vGrids.size();
+  m_iSize += grid.vBrickCount.volume();
+}
+
+void BrickTable::clear() {
+  m_vBricks.clear();
+  m_Index.clear();
+  m_vGrids.clear();
+  m_vGridStart.clear();
+  m_vGridLookup.clear();
+  m_iSize = 0;
+}
+
+BrickMD BrickTable::GridBrick(const Grid& g, uint64_t iIndex) {
+  const UINT64VECTOR3 vBrick(iIndex % g.vBrickCount.x,
+                             (iIndex / g.vBrickCount.x) % g.vBrickCount.y,
+                             iIndex / (g.vBrickCount.x * g.vBrickCount.y));
+  BrickMD md;
+  for(size_t d=0; d < 3; ++d) {
+    const uint64_t iStart = vBrick[d] * g.vCore[d];
+    const uint64_t iVoxels = std::min<uint64_t>(g.vCore[d],
+                                                g.vDomainSize[d] - iStart);
+    md.n_voxels[d] = static_cast<unsigned>(iVoxels) + 2*g.iOverlap;
+    md.extents[d] = float(iVoxels) * g.vVoxelSize[d];
+    md.center[d] = g.vOrigin[d] +
+                   (float(iStart) + float(iVoxels) / 2.0f) * g.vVoxelSize[d];
+  }
+  return md;
+}
+
+const BrickTable::Grid* BrickTable::FindGrid(size_t iTimestep, size_t iLOD,
+                                             size_t& iGrid) const {
+  if(iTimestep >= m_vGridLookup.size() ||
+     iLOD >= m_vGridLookup[iTimestep].size() ||
+     m_vGridLookup[iTimestep][iLOD] == 0) {
+    return NULL;
+  }
+  iGrid = m_vGridLookup[iTimestep][iLOD] - 1;
+  return &m_vGrids[iGrid];
+}
+
+} // namespace tuvok
@@ -0,0 +1,115 @@
+#pragma once
+#ifndef TUVOK_BRICK_TABLE_H
+#define TUVOK_BRICK_TABLE_H
+
+#include <cstddef>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Brick.h"
+
+namespace tuvok {
+
+/// The metadata of all bricks of a dataset.  Bricks are either added one by
+/// one, or as a regular grid per timestep and LOD, like an ExtendedOctree
+/// lays them out; the metadata of those are computed when they are asked
+/// for, so a grid costs the same no matter how many bricks it holds.
+/// Iteration visits the bricks added one by one in the order they were
+/// added, then those of the grids, grid by grid in brick index order.
+class BrickTable {
+public:
+  typedef std::pair<BrickKey, BrickMD> value_type;
+  typedef size_t size_type;
+
+  /// The bricks of one LOD of one timestep, on a regular grid.  Brick i
+  /// along an axis starts at voxel i*vCore and holds vCore voxels (fewer for
+  /// the last brick) plus the overlap on both sides.
+  struct Grid {
+    size_t        iTimestep;
+    size_t        iLOD;
+    UINT64VECTOR3 vDomainSize; ///< voxels in this LOD
+    UINT64VECTOR3 vBrickCount;
+    UINTVECTOR3   vCore;       ///< voxels per brick, without the overlap
+    uint32_t      iOverlap;
+    FLOATVECTOR3  vVoxelSize;  ///< extents of a voxel
+    FLOATVECTOR3  vOrigin;     ///< lower corner of the domain
+  };
+
+  /// The metadata of grid bricks do not exist until they are asked for, so
+  /// the iterator holds the brick it points to: a reference obtained from it
+  /// is valid only as long as the iterator is not advanced or destroyed.
+  /// That makes it an input iterator, even though it can pass over the table
+  /// several times.
+  class const_iterator {
+  public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef const BrickTable::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const BrickTable::value_type* pointer;
+    typedef const BrickTable::value_type& reference;
+
+    const_iterator() : m_pTable(NULL), m_iPos(0), m_iGrid(0) {}
+
+    reference operator*() const { return m_Current; }
+    pointer operator->() const { return &m_Current; }
+    const_iterator& operator++();
+    const_iterator operator++(int) {
+      const_iterator it(*this);
+      ++(*this);
+      return it;
+    }
+    bool operator==(const const_iterator& it) const {
+      return m_iPos == it.m_iPos && m_pTable == it.m_pTable;
+    }
+    bool operator!=(const const_iterator& it) const { return !(*this == it); }
+
+  private:
+    friend class BrickTable;
+    const_iterator(const BrickTable* pTable, uint64_t iPos, size_t iGrid);
+    void Update();
+
+    const BrickTable* m_pTable;
+    uint64_t          m_iPos;  ///< position in iteration order
+    size_t            m_iGrid; ///< grid m_iPos lies in, if it is in one
+    BrickTable::value_type m_Current;
+  };
+
+  BrickTable();
+
+  const_iterator begin() const;
+  const_iterator end() const;
+  const_iterator find(const BrickKey& k) const;
+
+  size_type size() const { return size_type(m_iSize); }
+  bool empty() const { return m_iSize == 0; }
+  /// @returns the number of bricks of the given timestep and LOD.
+  size_type count(size_t iTimestep, size_t iLOD) const;
+
+  void reserve(size_t n);
+  /// adds a single brick; does nothing if the key is known already.
+  void insert(const value_type& brick);
+  /// adds all bricks of a grid; the grid's timestep/LOD must be new.
+  void insert(const Grid& grid);
+  void clear();
+
+private:
+  /// @returns the metadata of brick 'iIndex' of grid 'g'.
+  static BrickMD GridBrick(const Grid& g, uint64_t iIndex);
+  /// @returns the grid of the given timestep and LOD, or NULL.
+  const Grid* FindGrid(size_t iTimestep, size_t iLOD, size_t& iGrid) const;
+
+  std::vector<value_type>                         m_vBricks;
+  std::unordered_map<BrickKey, size_t, BKeyHash>  m_Index;
+  std::vector<Grid>                               m_vGrids;
+  /// position of each grid's first brick in iteration order, counted from
+  /// the first grid's first brick
+  std::vector<uint64_t>                           m_vGridStart;
+  /// [timestep][LOD] -> grid index + 1, 0 if there is no grid
+  std::vector<std::vector<size_t>>                m_vGridLookup;
+  uint64_t                                        m_iSize;
+};
+
+} // namespace tuvok
+
+#endif // TUVOK_BRICK_TABLE_H
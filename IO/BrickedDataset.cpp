@@ -42,10 +42,7 @@ BrickedDataset::BrickedDataset() { }
 BrickedDataset::~BrickedDataset() { }
 
 void BrickedDataset::NBricksHint(size_t n) {
-  // The following line implements bricks.reserve(n);
-  // in a portable way. unordered_map does not define
-  // a reserve function but is seems gcc's tr1 does
-  bricks.rehash(size_t(ceil(float(n) / bricks.max_load_factor())));
+  bricks.reserve(n);
 }
 
 /// Adds a brick to the dataset.
@@ -66,6 +63,10 @@ void BrickedDataset::AddBrick(const BrickKey& bk,
   this->bricks.insert(std::make_pair(bk, brick));
 }
 
+void BrickedDataset::AddBrickGrid(const BrickTable::Grid& grid) {
+  this->bricks.insert(grid);
+}
+
 /// Looks up the spatial range of a brick.
 FLOATVECTOR3 BrickedDataset::GetBrickExtents(const BrickKey &bk) const
 {
@@ -101,15 +102,7 @@ BrickTable::const_iterator BrickedDataset::BricksEnd() const
 /// @return the number of bricks at the given LOD.
 BrickTable::size_type BrickedDataset::GetBrickCount(size_t lod, size_t ts) const
 {
-  BrickTable::size_type count = 0;
-  BrickTable::const_iterator iter = this->bricks.begin();
-  for(; iter != this->bricks.end(); ++iter) {
-    if(std::get<0>(iter->first) == ts &&
-       std::get<1>(iter->first) == lod) {
-      ++count;
-    }
-  }
-  return count;
+  return this->bricks.count(ts, lod);
 }
 
 size_t BrickedDataset::GetLargestSingleBrickLOD(size_t ts) const {
@@ -127,7 +120,7 @@ uint64_t BrickedDataset::GetTotalBrickCount() const {
   return static_cast<uint64_t>(this->bricks.size());
 }
 
-const BrickMD& BrickedDataset::GetBrickMetadata(const BrickKey& k) const {
+BrickMD BrickedDataset::GetBrickMetadata(const BrickKey& k) const {
   return this->bricks.find(k)->second;
 }
 
@@ -148,7 +141,7 @@ bool
 BrickedDataset::BrickIsFirstInDimension(size_t dim, const BrickKey& k) const
 {
   assert(dim <= 3);
-  const BrickMD& md = this->bricks.find(k)->second;
+  const BrickMD md = this->bricks.find(k)->second;
   for(BrickTable::const_iterator iter = this->BricksBegin();
       iter != this->BricksEnd(); ++iter) {
     if(iter->second.center[dim] < md.center[dim]) {
@@ -162,7 +155,7 @@ bool
 BrickedDataset::BrickIsLastInDimension(size_t dim, const BrickKey& k) const
 {
   assert(dim <= 3);
-  const BrickMD& md = this->bricks.find(k)->second;
+  const BrickMD md = this->bricks.find(k)->second;
   for(BrickTable::const_iterator iter = this->BricksBegin();
       iter != this->BricksEnd(); ++iter) {
     if(iter->second.center[dim] > md.center[dim]) {
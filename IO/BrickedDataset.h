@@ -61,7 +61,7 @@ public:
   virtual size_t GetLargestSingleBrickLOD(size_t ts) const;
   virtual uint64_t GetTotalBrickCount() const;
 
-  virtual const BrickMD& GetBrickMetadata(const BrickKey&) const;
+  virtual BrickMD GetBrickMetadata(const BrickKey&) const;
 
   /// @returns the bricking size used for this decomposition
   virtual UINTVECTOR3 GetMaxBrickSize() const;
@@ -90,6 +90,9 @@ protected:
 
   /// Adds a brick to the dataset.
   virtual void AddBrick(const BrickKey&, const BrickMD&);
+  /// Adds the bricks of a timestep's LOD which lie on a regular grid; their
+  /// metadata are computed when needed instead of being stored.
+  void AddBrickGrid(const BrickTable::Grid& grid);
 
 protected:
   BrickTable bricks;
@@ -37,11 +37,14 @@
 
 #include <algorithm>
 #include <functional>
+#include <sstream>
 #include <sys/stat.h>
+#include <unordered_map>
 #include <vector>
 #include "DICOMParser.h"
 
 #include <Controller/Controller.h>
+#include <Basics/TaskScheduler.h>
 #include <Basics/SysTools.h>
 
 #ifdef DEBUG_DICOM
@@ -90,6 +93,157 @@ std::string DICOM_TypeStrings[28] = {
 
 using namespace std;
 
+namespace {
+  /// Bytes read per file when scanning a directory; enough for the header of
+  /// nearly all DICOMs we have seen.  Longer headers are reread in full.
+  const size_t iHeaderPrefix = 64*1024;
+  /// Files whose header prefixes are held in memory at once while scanning.
+  const size_t iScanBatch = 256;
+
+  template<typename T> void WritePOD(ostream& os, const T& t) {
+    os.write(reinterpret_cast<const char*>(&t), sizeof(T));
+  }
+  template<typename T> void ReadPOD(istream& is, T& t) {
+    is.read(reinterpret_cast<char*>(&t), sizeof(T));
+  }
+  template<typename T> void WriteVec3(ostream& os, const VECTOR3<T>& v) {
+    WritePOD(os, v.x); WritePOD(os, v.y); WritePOD(os, v.z);
+  }
+  template<typename T> void ReadVec3(istream& is, VECTOR3<T>& v) {
+    ReadPOD(is, v.x); ReadPOD(is, v.y); ReadPOD(is, v.z);
+  }
+  void WriteString(ostream& os, const string& str) {
+    WritePOD(os, uint32_t(str.size()));
+    os.write(str.data(), streamsize(str.size()));
+  }
+  bool ReadString(istream& is, string& str) {
+    uint32_t iLength = 0;
+    ReadPOD(is, iLength);
+    if (!is || iLength > 65536) return false;
+    str.resize(iLength);
+    if (iLength) is.read(&str[0], iLength);
+    return !is.fail();
+  }
+
+  /// What the scan index remembers about one file.
+  struct ScanEntry {
+    ScanEntry() : iSize(0), iMTime(0), bValid(false) {}
+    uint64_t      iSize;
+    int64_t       iMTime;
+    bool          bValid; ///< false for files which are not DICOMs
+    DICOMFileInfo info;
+  };
+  typedef std::unordered_map<string, ScanEntry> ScanIndex;
+
+  const char     ScanIndexMagic[8] = {'T','V','K','D','C','M','I','X'};
+  const uint32_t ScanIndexVersion  = 1;
+
+  // DICOM directories are frequently read-only, so the index lives in the
+  // temp directory, named after the directory it describes.
+  string ScanIndexFile(const string& strDirectory) {
+    string strTemp;
+    if (!SysTools::GetTempDirectory(strTemp)) return "";
+    ostringstream name;
+    name << "tuvok-dicom-" << hex << std::hash<string>()(strDirectory)
+         << ".idx";
+    return strTemp + name.str();
+  }
+
+  bool LoadScanIndex(const string& strIndexFile, ScanIndex& index) {
+    ifstream is(strIndexFile.c_str(), ios::in | ios::binary);
+    if (!is) return false;
+
+    char magic[8];
+    uint32_t iVersion = 0;
+    uint64_t iCount = 0;
+    is.read(magic, 8);
+    ReadPOD(is, iVersion);
+    ReadPOD(is, iCount);
+    if (!is || !equal(magic, magic+8, ScanIndexMagic) ||
+        iVersion != ScanIndexVersion) {
+      return false;
+    }
+
+    for (uint64_t i = 0; i < iCount; ++i) {
+      string strFile;
+      ScanEntry e;
+      uint8_t iValid = 0;
+      if (!ReadString(is, strFile)) break;
+      ReadPOD(is, e.iSize);
+      ReadPOD(is, e.iMTime);
+      ReadPOD(is, iValid);
+      e.bValid = iValid != 0;
+      if (e.bValid && !e.info.Read(is)) break;
+      if (!is) break;
+      e.info.m_strFileName = strFile;
+      e.info.m_wstrFileName = wstring(strFile.begin(), strFile.end());
+      index[strFile] = e;
+    }
+    if (index.size() != iCount) {
+      WARNING("DICOM scan index %s is corrupt; ignoring it.",
+              strIndexFile.c_str());
+      index.clear();
+      return false;
+    }
+    return true;
+  }
+
+  bool SaveScanIndex(const string& strIndexFile, const vector<string>& files,
+                     const vector<ScanEntry>& entries,
+                     const vector<char>& bKnown) {
+    ofstream os(strIndexFile.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!os) return false;
+
+    os.write(ScanIndexMagic, 8);
+    WritePOD(os, ScanIndexVersion);
+    WritePOD(os, uint64_t(count(bKnown.begin(), bKnown.end(), 1)));
+    for (size_t i = 0; i < files.size(); ++i) {
+      if (!bKnown[i]) continue;
+      WriteString(os, files[i]);
+      WritePOD(os, entries[i].iSize);
+      WritePOD(os, entries[i].iMTime);
+      WritePOD(os, uint8_t(entries[i].bValid ? 1 : 0));
+      if (entries[i].bValid) entries[i].info.Write(os);
+    }
+    return !os.fail();
+  }
+
+  template<typename T> void AppendKey(string& key, const T& t) {
+    key.append(reinterpret_cast<const char*>(&t), sizeof(T));
+  }
+  void AppendKey(string& key, float f) {
+    f += 0.0f; // -0 and +0 compare equal, so they must hash equal too
+    key.append(reinterpret_cast<const char*>(&f), sizeof(float));
+  }
+  void AppendKey(string& key, const string& str) {
+    AppendKey(key, uint32_t(str.size()));
+    key.append(str);
+  }
+
+  /// Files which agree on everything DICOMStackInfo::Match compares belong to
+  /// the same stack, so this is what we bucket files by.
+  string StackKey(const DICOMFileInfo& info) {
+    string key;
+    AppendKey(key, info.m_iSeries);
+    AppendKey(key, info.m_ivSize.x);
+    AppendKey(key, info.m_ivSize.y);
+    AppendKey(key, info.m_ivSize.z);
+    AppendKey(key, info.m_iAllocated);
+    AppendKey(key, info.m_iStored);
+    AppendKey(key, info.m_iComponentCount);
+    AppendKey(key, info.m_bSigned);
+    AppendKey(key, info.m_fvfAspect.x);
+    AppendKey(key, info.m_fvfAspect.y);
+    AppendKey(key, info.m_fvfAspect.z);
+    AppendKey(key, info.m_bIsBigEndian);
+    AppendKey(key, info.m_bIsJPEGEncoded);
+    AppendKey(key, info.m_strAcquDate);
+    AppendKey(key, info.m_strModality);
+    AppendKey(key, info.m_strDesc);
+    return key;
+  }
+}
+
 DICOMParser::DICOMParser(void)
 {
 }
@@ -107,41 +261,109 @@ bool StacksSmaller ( FileStackInfo* pElem1, FileStackInfo* pElem2 )
 }
 
 
+bool ImagesSmaller ( const SimpleFileInfo* elem1, const SimpleFileInfo* elem2 )
+{
+  return elem1->m_iImageIndex < elem2->m_iImageIndex;
+}
+
+
 void DICOMParser::GetDirInfo(string  strDirectory) {
   vector<string> files = SysTools::GetDirContents(strDirectory);
-  vector<DICOMFileInfo> fileInfos;
+
+  // Files whose size and modification time match the index of the previous
+  // scan of this directory are not opened again.
+  const string strIndexFile = ScanIndexFile(strDirectory);
+  ScanIndex index;
+  if (!strIndexFile.empty()) LoadScanIndex(strIndexFile, index);
+
+  vector<ScanEntry> entries(files.size());
+  vector<char> bKnown(files.size(), 0);
+  size_t iScanned = 0;
+  size_t iReused = 0;
 
   // query directory for DICOM files
-  for (size_t i = 0;i<files.size();i++) {
-    MESSAGE("Looking for DICOM data in file %s", files[i].c_str());
-    DICOMFileInfo info;
-    if (GetDICOMFileInfo(files[i], info)) {
-      fileInfos.push_back(info);
+  for (size_t first = 0; first < files.size(); first += iScanBatch) {
+    const size_t n = min(iScanBatch, files.size()-first);
+    vector<string> headers(n);
+    vector<char> bFresh(n, 0);
+
+    // Opening and reading the files is what takes the time, so it is done
+    // concurrently; the headers are then parsed in memory.
+    auto read = [&](size_t i) {
+      const string& strFile = files[first+i];
+      ScanEntry& e = entries[first+i];
+
+      LARGE_STAT_BUFFER stat_buf;
+      if (!SysTools::GetFileStats(strFile, stat_buf)) return;
+      bKnown[first+i] = 1;
+      e.iSize  = uint64_t(stat_buf.st_size);
+      e.iMTime = int64_t(stat_buf.st_mtime);
+
+      ScanIndex::const_iterator old = index.find(strFile);
+      if (old != index.end() && old->second.iSize == e.iSize &&
+          old->second.iMTime == e.iMTime) {
+        e = old->second;
+        return;
+      }
+
+      bFresh[i] = 1;
+      if (e.iSize < 128+4) return;
+      headers[i].resize(size_t(min<uint64_t>(e.iSize, iHeaderPrefix)));
+      ifstream fs(strFile.c_str(), ios::in | ios::binary);
+      fs.read(&headers[i][0], streamsize(headers[i].size()));
+      headers[i].resize(size_t(fs.gcount()));
+    };
+    tuvok::Controller::Instance().Scheduler().ParallelFor(0, n, 1,
+      [&](size_t iBegin, size_t iEnd) {
+        for (size_t i = iBegin; i < iEnd; ++i) read(i);
+      });
+
+    for (size_t i = 0; i < n; ++i) {
+      if (!bFresh[i]) {
+        if (bKnown[first+i]) ++iReused;
+        continue;
+      }
+      ScanEntry& e = entries[first+i];
+      MESSAGE("Looking for DICOM data in file %s", files[first+i].c_str());
+      e.bValid = GetDICOMFileInfo(files[first+i], headers[i], e.iSize, e.info);
+      ++iScanned;
     }
   }
+  MESSAGE("Scanned %u files, %u unchanged since the last scan.",
+          static_cast<unsigned>(iScanned), static_cast<unsigned>(iReused));
+
+  if (!strIndexFile.empty() && (iScanned > 0 || iReused != index.size()) &&
+      !SaveScanIndex(strIndexFile, files, entries, bKnown)) {
+    WARNING("Could not write DICOM scan index %s", strIndexFile.c_str());
+  }
 
   // sort results into stacks
   for (size_t i = 0; i<m_FileStacks.size(); i++) delete m_FileStacks[i];
   m_FileStacks.clear();
 
-  MESSAGE("%d files in candidate list.", fileInfos.size());
-  // Ignore duplicate DICOMs.
-  for (size_t i = 0; i<fileInfos.size(); i++) {
-    bool bFoundMatch = false;
-    for (size_t j = 0; j<m_FileStacks.size(); j++) {
-      if (((DICOMStackInfo*)m_FileStacks[j])->Match(&fileInfos[i])) {
-        MESSAGE("found match at %u(%s), dropping %u(%s) out.",
-                static_cast<unsigned>(j), m_FileStacks[j]->m_strDesc.c_str(),
-                static_cast<unsigned>(i), fileInfos[i].m_strDesc.c_str());
-        bFoundMatch = true;
-        break;
-      }
-    }
-    if (!bFoundMatch) {
-      DICOMStackInfo* newStack = new DICOMStackInfo(&fileInfos[i]);
-      m_FileStacks.push_back(newStack);
+  std::unordered_map<string, DICOMStackInfo*> stacks;
+  size_t iCandidates = 0;
+  for (size_t i = 0; i<entries.size(); i++) {
+    if (!entries[i].bValid) continue;
+    ++iCandidates;
+
+    DICOMStackInfo*& stack = stacks[StackKey(entries[i].info)];
+    if (stack == NULL) {
+      stack = new DICOMStackInfo(&entries[i].info);
+      m_FileStacks.push_back(stack);
+    } else {
+      stack->m_Elements.push_back(new SimpleDICOMFileInfo(&entries[i].info));
     }
   }
+  MESSAGE("%u files in candidate list, %u stacks.",
+          static_cast<unsigned>(iCandidates),
+          static_cast<unsigned>(m_FileStacks.size()));
+
+  // order slices by image index; stable, so duplicates keep directory order
+  for (size_t i = 0; i<m_FileStacks.size(); i++) {
+    stable_sort(m_FileStacks[i]->m_Elements.begin(),
+                m_FileStacks[i]->m_Elements.end(), ImagesSmaller);
+  }
 
   // sort stacks by sequence number
   sort( m_FileStacks.begin( ), m_FileStacks.end( ), StacksSmaller );
@@ -160,7 +382,7 @@ void DICOMParser::GetDirInfo(wstring wstrDirectory) {
   GetDirInfo(strDirectory);
 }
 
-void DICOMParser::ReadHeaderElemStart(ifstream& fileDICOM, short& iGroupID, short& iElementID, DICOM_eType& eElementType, uint32_t& iElemLength, bool bImplicit, bool bNeedsEndianConversion) {
+void DICOMParser::ReadHeaderElemStart(istream& fileDICOM, short& iGroupID, short& iElementID, DICOM_eType& eElementType, uint32_t& iElemLength, bool bImplicit, bool bNeedsEndianConversion) {
   string typeString = "  ";
 
   fileDICOM.read((char*)&iGroupID,2);
@@ -210,7 +432,7 @@ void DICOMParser::ReadHeaderElemStart(ifstream& fileDICOM, short& iGroupID, shor
 }
 
 
-uint32_t DICOMParser::GetUInt(ifstream& fileDICOM, const DICOM_eType eElementType, const uint32_t iElemLength, const bool bNeedsEndianConversion) {
+uint32_t DICOMParser::GetUInt(istream& fileDICOM, const DICOM_eType eElementType, const uint32_t iElemLength, const bool bNeedsEndianConversion) {
   string value;
   uint32_t result;
   switch (eElementType) {
@@ -239,11 +461,11 @@ uint32_t DICOMParser::GetUInt(ifstream& fileDICOM, const DICOM_eType eElementTyp
 
 
 #ifdef DEBUG_DICOM
-void DICOMParser::ParseUndefLengthSequence(ifstream& fileDICOM, short& iSeqGroupID, short& iSeqElementID, DICOMFileInfo& info, const bool bImplicit, const bool bNeedsEndianConversion, uint32_t iDepth) {
+void DICOMParser::ParseUndefLengthSequence(istream& fileDICOM, short& iSeqGroupID, short& iSeqElementID, DICOMFileInfo& info, const bool bImplicit, const bool bNeedsEndianConversion, uint32_t iDepth) {
   for (int i = 0;i<int(iDepth)-1;i++) Console::printf("  ");
   Console::printf("iGroupID=%x iElementID=%x elementType=SEQUENCE (undef length)\n", iSeqGroupID, iSeqElementID);
 #else
-void DICOMParser::ParseUndefLengthSequence(ifstream& fileDICOM, short& , short& , DICOMFileInfo& info, const bool bImplicit, const bool bNeedsEndianConversion) {
+void DICOMParser::ParseUndefLengthSequence(istream& fileDICOM, short& , short& , DICOMFileInfo& info, const bool bImplicit, const bool bNeedsEndianConversion) {
 #endif
   int iItemCount = 0;
   uint32_t iData;
@@ -313,7 +535,7 @@ void DICOMParser::ParseUndefLengthSequence(ifstream& fileDICOM, short& , short&
         }
       }
     }
-  } while (iData != 0xE0DDFFFE && !fileDICOM.eof());
+  } while (iData != 0xE0DDFFFE && fileDICOM.good());
   fileDICOM.read((char*)&iData,4);
 
 #ifdef DEBUG_DICOM
@@ -323,31 +545,21 @@ void DICOMParser::ParseUndefLengthSequence(ifstream& fileDICOM, short& , short&
 
 }
 
-void DICOMParser::ReadSizedElement(ifstream& fileDICOM, string& value, const uint32_t iElemLength) {
+void DICOMParser::ReadSizedElement(istream& fileDICOM, string& value, const uint32_t iElemLength) {
   value.resize(iElemLength);
   if (iElemLength) {
     fileDICOM.read(&value[0],iElemLength);
   }
 }
 
-void DICOMParser::SkipUnusedElement(ifstream& fileDICOM, string& value, const uint32_t iElemLength) {
+void DICOMParser::SkipUnusedElement(istream& fileDICOM, string& value, const uint32_t iElemLength) {
   ReadSizedElement(fileDICOM, value, iElemLength);
 }
 
 bool DICOMParser::GetDICOMFileInfo(const string& strFilename,
                                    DICOMFileInfo& info) {
-  DICOM_DBG("Processing file %s\n",strFilename.c_str());
-
   LARGE_STAT_BUFFER stat_buf;
 
-  bool bImplicit    = false;
-  info.m_bIsJPEGEncoded = false;
-  bool bNeedsEndianConversion = EndianConvert::IsBigEndian();
-
-  info.m_strFileName = strFilename;
-  info.m_wstrFileName = wstring(strFilename.begin(), strFilename.end());
-  info.m_ivSize.z = 1; // default if slices does not appear in the dicom
-
   // check for basic properties
   if (!SysTools::GetFileStats(strFilename, stat_buf)) {// file must exist
     MESSAGE("File '%s' can't be a DICOM -- doesn't exist.",
@@ -361,6 +573,47 @@ bool DICOMParser::GetDICOMFileInfo(const string& strFilename,
 
   // open file
   ifstream fileDICOM(strFilename.c_str(), ios::in | ios::binary);
+  return ParseDICOMHeader(strFilename, fileDICOM, uint64_t(stat_buf.st_size),
+                          info);
+}
+
+bool DICOMParser::GetDICOMFileInfo(const string& strFilename,
+                                   const string& strHeader,
+                                   uint64_t iFileLength,
+                                   DICOMFileInfo& info) {
+  if (iFileLength < 128+4) { // file has minimum length ?
+    MESSAGE("File '%s' can't be a DICOM -- too short.", strFilename.c_str());
+    return false;
+  }
+
+  istringstream header(strHeader);
+  const bool bResult = ParseDICOMHeader(strFilename, header, iFileLength,
+                                        info);
+
+  // If we ran past the end of the prefix the header was longer than we
+  // guessed; parse it again, this time from the file itself.
+  if ((header.eof() || header.fail()) && strHeader.size() < iFileLength) {
+    DICOM_DBG("Header of %s exceeds %u bytes, rereading the file\n",
+              strFilename.c_str(), unsigned(strHeader.size()));
+    info = DICOMFileInfo();
+    return GetDICOMFileInfo(strFilename, info);
+  }
+  return bResult;
+}
+
+bool DICOMParser::ParseDICOMHeader(const string& strFilename,
+                                   istream& fileDICOM, uint64_t iFileLength,
+                                   DICOMFileInfo& info) {
+  DICOM_DBG("Processing file %s\n",strFilename.c_str());
+
+  bool bImplicit    = false;
+  info.m_bIsJPEGEncoded = false;
+  bool bNeedsEndianConversion = EndianConvert::IsBigEndian();
+
+  info.m_strFileName = strFilename;
+  info.m_wstrFileName = wstring(strFilename.begin(), strFilename.end());
+  info.m_ivSize.z = 1; // default if slices does not appear in the dicom
+
   fileDICOM.seekg(128);  // skip first 128 bytes
 
   string value;
@@ -778,7 +1031,10 @@ bool DICOMParser::GetDICOMFileInfo(const string& strFilename,
     #endif
 
     ReadHeaderElemStart(fileDICOM, iGroupID, iElementID, elementType, iElemLength, bImplicit, info.m_bIsBigEndian);
-  } while (iGroupID != 0x7fe0 && elementType != TYPE_UN);
+  } while (iGroupID != 0x7fe0 && elementType != TYPE_UN && !fileDICOM.fail());
+
+  // ran out of header without ever seeing the pixel data
+  if (fileDICOM.fail()) return false;
 
   if (elementType != TYPE_UN) {
     if (!bImplicit) {
@@ -823,9 +1079,6 @@ bool DICOMParser::GetDICOMFileInfo(const string& strFilename,
     // 0x7fe0, then use the last one found
     DICOM_DBG("Manual search for GroupId 0x7fe0\n");
     size_t iPosition   = size_t(fileDICOM.tellg());
-    fileDICOM.seekg(0,ios::end);
-    size_t iFileLength = size_t(fileDICOM.tellg());
-    fileDICOM.seekg(iPosition,ios::beg);
 
     DICOM_DBG("volume size: %u\n", info.m_ivSize.volume());
     DICOM_DBG("n components: %u\n", info.m_iComponentCount);
@@ -838,7 +1091,7 @@ bool DICOMParser::GetDICOMFileInfo(const string& strFilename,
       iPosition = size_t(fileDICOM.tellg());
 
       while (!fileDICOM.eof() && iGroupID != 0x7fe0 &&
-             iPosition+iPixelDataSize < iFileLength) {
+             iPosition+iPixelDataSize < size_t(iFileLength)) {
         iPosition++;
         fileDICOM.read((char*)&iGroupID,2);
       }
@@ -876,14 +1129,11 @@ bool DICOMParser::GetDICOMFileInfo(const string& strFilename,
       // ok everthing failed than let's just use the data we have so far,
       // and let's hope that the file ends with the data
       WARNING("Trouble parsing DICOM file; assuming data starts at %u",
-              static_cast<unsigned int>(iFileLength - size_t(iPixelDataSize)));
-      info.SetOffsetToData(uint32_t(iFileLength - size_t(iPixelDataSize)));
+              static_cast<unsigned int>(iFileLength - iPixelDataSize));
+      info.SetOffsetToData(uint32_t(iFileLength - iPixelDataSize));
     }
   }
 
-
-  fileDICOM.close();
-
   return info.m_ivSize.volume() != 0;
 }
 
@@ -1012,6 +1262,52 @@ void DICOMFileInfo::SetOffsetToData(const uint32_t iOffset) {
   m_iDataSize = m_iComponentCount*m_ivSize.volume()*m_iAllocated/8;
 }
 
+void DICOMFileInfo::Write(ostream& os) const {
+  WritePOD(os, m_iImageIndex);
+  WritePOD(os, m_iDataSize);
+  WriteVec3(os, m_fvPatientPosition);
+  WritePOD(os, m_iComponentCount);
+  WritePOD(os, m_fScale);
+  WritePOD(os, m_fBias);
+  WritePOD(os, m_fWindowWidth);
+  WritePOD(os, m_fWindowCenter);
+  WritePOD(os, m_bSigned);
+  WritePOD(os, m_iOffsetToData);
+  WritePOD(os, m_iSeries);
+  WriteVec3(os, m_ivSize);
+  WriteVec3(os, m_fvfAspect);
+  WritePOD(os, m_iAllocated);
+  WritePOD(os, m_iStored);
+  WritePOD(os, m_bIsBigEndian);
+  WritePOD(os, m_bIsJPEGEncoded);
+  WriteString(os, m_strAcquDate);
+  WriteString(os, m_strAcquTime);
+  WriteString(os, m_strModality);
+  WriteString(os, m_strDesc);
+}
+
+bool DICOMFileInfo::Read(istream& is) {
+  ReadPOD(is, m_iImageIndex);
+  ReadPOD(is, m_iDataSize);
+  ReadVec3(is, m_fvPatientPosition);
+  ReadPOD(is, m_iComponentCount);
+  ReadPOD(is, m_fScale);
+  ReadPOD(is, m_fBias);
+  ReadPOD(is, m_fWindowWidth);
+  ReadPOD(is, m_fWindowCenter);
+  ReadPOD(is, m_bSigned);
+  ReadPOD(is, m_iOffsetToData);
+  ReadPOD(is, m_iSeries);
+  ReadVec3(is, m_ivSize);
+  ReadVec3(is, m_fvfAspect);
+  ReadPOD(is, m_iAllocated);
+  ReadPOD(is, m_iStored);
+  ReadPOD(is, m_bIsBigEndian);
+  ReadPOD(is, m_bIsJPEGEncoded);
+  return ReadString(is, m_strAcquDate) && ReadString(is, m_strAcquTime) &&
+         ReadString(is, m_strModality) && ReadString(is, m_strDesc);
+}
+
 /*************************************************************************************/
 
 DICOMStackInfo::DICOMStackInfo() :
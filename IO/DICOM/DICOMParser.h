@@ -40,6 +40,8 @@
 #define DICOMPARSER_H
 
 #include <fstream>
+#include <istream>
+#include <ostream>
 #include <string>
 
 // if the following define is set, the DICOM parser outputs detailed parsing
@@ -104,6 +106,10 @@ public:
   std::string  m_strDesc;
 
   void SetOffsetToData(const uint32_t iOffset);
+
+  /// (De)serialization for the scan index; see DICOMParser::GetDirInfo.
+  void Write(std::ostream& os) const;
+  bool Read(std::istream& is);
 };
 
 
@@ -163,22 +169,32 @@ public:
   virtual void GetDirInfo(std::wstring wstrDirectory);
 
   static bool GetDICOMFileInfo(const std::string& fileName, DICOMFileInfo& info);
+  /// Parses the DICOM header from the first bytes of the file, which the
+  /// caller has already read into 'header'.  Falls back to reading the file
+  /// if the header turns out to be longer than the given prefix.
+  static bool GetDICOMFileInfo(const std::string& fileName,
+                               const std::string& header,
+                               uint64_t iFileLength, DICOMFileInfo& info);
+
 protected:
-  static void ReadSizedElement(std::ifstream& fileDICOM, std::string& value, 
+  static bool ParseDICOMHeader(const std::string& fileName,
+                               std::istream& fileDICOM, uint64_t iFileLength,
+                               DICOMFileInfo& info);
+  static void ReadSizedElement(std::istream& fileDICOM, std::string& value, 
                                 const uint32_t iElemLength);
-  static void SkipUnusedElement(std::ifstream& fileDICOM, std::string& value,
+  static void SkipUnusedElement(std::istream& fileDICOM, std::string& value,
                                 const uint32_t iElemLength);
-  static void ReadHeaderElemStart(std::ifstream& fileDICOM, short& iGroupID,
+  static void ReadHeaderElemStart(std::istream& fileDICOM, short& iGroupID,
                                   short& iElementID, DICOM_eType& eElementType,
                                   uint32_t& iElemLength, bool bImplicit,
                                   bool bNeedsEndianConversion);
-  static uint32_t GetUInt(std::ifstream& fileDICOM,
+  static uint32_t GetUInt(std::istream& fileDICOM,
                         const DICOM_eType eElementType,
                         const uint32_t iElemLength,
                         const bool bNeedsEndianConversion);
 
   #ifdef DEBUG_DICOM
-  static void ParseUndefLengthSequence(std::ifstream& fileDICOM,
+  static void ParseUndefLengthSequence(std::istream& fileDICOM,
                                        short& iSeqGroupID,
                                        short& iSeqElementID,
                                        DICOMFileInfo& info,
@@ -186,7 +202,7 @@ protected:
                                        const bool bNeedsEndianConversion,
                                        uint32_t iDepth);
   #else
-  static void ParseUndefLengthSequence(std::ifstream& fileDICOM,
+  static void ParseUndefLengthSequence(std::istream& fileDICOM,
                                        short& iSeqGroupID,
                                        short& iSeqElementID,
                                        DICOMFileInfo& info,
@@ -61,6 +61,23 @@ DOUBLEVECTOR3 Dataset::GetRescaleFactors() const {
   return m_UserScale;
 }
 
+namespace {
+  bool CallParallelBrickFunc(void* pData, const UINT64VECTOR3& vBrickSize,
+                             const UINT64VECTOR3& vBrickOffset,
+                             void* pUserContext) {
+    const Dataset::ParallelBrickFunc& f =
+      *static_cast<const Dataset::ParallelBrickFunc*>(pUserContext);
+    return f(pData, vBrickSize, vBrickOffset, 0);
+  }
+}
+
+bool Dataset::ParallelApplyFunction(uint64_t iLODLevel,
+                                    const ParallelBrickFunc& brickFunc,
+                                    size_t, uint64_t iOverlap) const {
+  return ApplyFunction(iLODLevel, &CallParallelBrickFunc,
+                       const_cast<ParallelBrickFunc*>(&brickFunc), iOverlap);
+}
+
 std::pair<FLOATVECTOR3, FLOATVECTOR3>
 Dataset::GetTextCoords(BrickTable::const_iterator brick,
                        bool bUseOnlyPowerOfTwo) const {
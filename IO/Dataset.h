@@ -45,7 +45,7 @@
 #include <boost/noncopyable.hpp>
 #include "Basics/Grids.h"
 #include "Basics/Vectors.h"
-#include "Brick.h"
+#include "BrickTable.h"
 
 #define MAX_TRANSFERFUNCTION_SIZE 4096
 
@@ -88,6 +88,8 @@ public:
   virtual UINTVECTOR3 GetBrickVoxelCounts(const BrickKey&) const = 0;
   /// World space extents.
   virtual FLOATVECTOR3 GetBrickExtents(const BrickKey &) const = 0;
+  /// All we know about a brick, including its world space center.
+  virtual BrickMD GetBrickMetadata(const BrickKey&) const = 0;
   /// Data access
   ///@{
   virtual bool GetBrick(const BrickKey&, std::vector<uint8_t>&) const=0;
@@ -126,6 +128,25 @@ public:
   virtual unsigned GetLODLevelCount() const = 0;
   /// @todo FIXME, should be pure virtual && overridden in derived
   virtual uint64_t GetNumberOfTimesteps() const { return 1; }
+  /// Playback mode: load the bricks of the next 'iLookahead' timesteps in
+  /// the background, holding at most 'iMemBudget' bytes.  0 turns it off.
+  /// Formats which cannot prefetch ignore this.
+  virtual void SetTimestepPrefetch(size_t /*iLookahead*/,
+                                   uint64_t /*iMemBudget*/) {}
+  /// Tells the dataset which timestep is displayed now, so it knows which
+  /// ones to prefetch.
+  virtual void SetPlaybackTimestep(size_t) {}
+  /// Keeps decoded bricks in a cache of at most 'iMaxBytes' in 'strDir',
+  /// which survives the session.  Only worth it for data which is slow to
+  /// decode; formats without such data ignore this.  0 bytes turns it off.
+  virtual void SetDiskCache(const std::string& /*strDir*/,
+                            uint64_t /*iMaxBytes*/) {}
+  /// Shares decoded bricks with other processes on this host which use a
+  /// cache of the same 'strName'.  The first of them sizes it to 'iMaxBytes'.
+  /// Formats which cannot share their bricks ignore this.  0 bytes turns
+  /// it off.
+  virtual void SetSharedCache(const std::string& /*strName*/,
+                              uint64_t /*iMaxBytes*/) {}
   virtual UINT64VECTOR3 GetDomainSize(const size_t lod=0,
                                       const size_t ts=0) const = 0;
   virtual DOUBLEVECTOR3 GetScale() const {return m_DomainScale * m_UserScale;}
@@ -163,6 +184,22 @@ public:
                         void *pUserContext,
                         uint64_t iOverlap) const = 0;
 
+  /// Called concurrently for different bricks by ParallelApplyFunction.  The
+  /// last argument is the index (smaller than the thread count) of the
+  /// calling thread, e.g. to pick a per-thread context.
+  typedef std::function<bool (void* pData,
+                              const UINT64VECTOR3& vBrickSize,
+                              const UINT64VECTOR3& vBrickOffset,
+                              size_t iThread)> ParallelBrickFunc;
+
+  /// Like ApplyFunction, but 'brickFunc' may be called from up to 'iThreads'
+  /// threads at once.  Datasets which cannot decompress bricks concurrently
+  /// use ApplyFunction, i.e. a single thread.
+  virtual bool ParallelApplyFunction(uint64_t iLODLevel,
+                                     const ParallelBrickFunc& brickFunc,
+                                     size_t iThreads,
+                                     uint64_t iOverlap) const;
+
   /// Virtual constructor.
   virtual Dataset* Create(const std::string&, uint64_t, bool) const=0;  
 
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "DiskBrickCache.h"
+#ifdef DETECTED_OS_WINDOWS
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/file.h>
+#endif
+#include "Basics/MemMappedFile.h"
+#include "Controller/Controller.h"
+
+namespace tuvok {
+
+namespace {
+  const char MAGIC[8] = { 'T','V','K','L','2','C','0','1' };
+
+  /// FNV-1a; unlike std::hash it is the same for every build, which keeps
+  /// the cache file names stable.
+  uint64_t Hash(const std::string& s) {
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i=0; i < s.size(); ++i) {
+      h ^= static_cast<unsigned char>(s[i]);
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  /// everything that must not change for the cached bricks to be valid.
+  std::string Identity(const std::string& strSource,
+                       const std::string& strVariant) {
+    std::ostringstream id;
+    id << strSource << "|" << strVariant;
+#ifdef DETECTED_OS_WINDOWS
+    struct _stat64 st;
+    if(_stat64(strSource.c_str(), &st) == 0) {
+#else
+    struct stat st;
+    if(stat(strSource.c_str(), &st) == 0) {
+#endif
+      id << "|" << uint64_t(st.st_size) << "|" << uint64_t(st.st_mtime);
+    }
+    return id.str();
+  }
+
+  std::string BaseName(const std::string& strDir,
+                       const std::string& strSource,
+                       const std::string& strVariant) {
+    std::ostringstream name;
+    name << strDir;
+    if(!strDir.empty() && strDir[strDir.size()-1] != '/' &&
+       strDir[strDir.size()-1] != '\\') {
+      name << "/";
+    }
+    name << "tuvok-" << std::hex << Hash(strSource + "|" + strVariant);
+    return name.str();
+  }
+
+  template<typename T> bool ReadPOD(std::istream& is, T& v) {
+    is.read(reinterpret_cast<char*>(&v), sizeof(T));
+    return !is.fail();
+  }
+  template<typename T> void WritePOD(std::ostream& os, const T& v) {
+    os.write(reinterpret_cast<const char*>(&v), sizeof(T));
+  }
+
+  // slots are page aligned, so every brick sits in its own pages.
+  const uint64_t SLOT_ALIGNMENT = 4096;
+}
+
+DiskBrickCache::DiskBrickCache(const std::string& strDir,
+                               const std::string& strSource,
+                               const std::string& strVariant,
+                               uint64_t iMaxBytes, uint64_t iSlotBytes) :
+  m_strIdentity(Identity(strSource, strVariant)),
+  m_strSlabFile(BaseName(strDir, strSource, strVariant) + ".bricks"),
+  m_strIndexFile(BaseName(strDir, strSource, strVariant) + ".index"),
+  m_strLockFile(BaseName(strDir, strSource, strVariant) + ".lock"),
+  m_iSlotBytes((iSlotBytes + SLOT_ALIGNMENT-1) / SLOT_ALIGNMENT *
+               SLOT_ALIGNMENT),
+  m_iMaxSlots(m_iSlotBytes > 0 ? iMaxBytes / m_iSlotBytes : 0),
+  m_iSlabSlots(0),
+  m_iBytes(0),
+  m_iNextSlot(0),
+#ifdef DETECTED_OS_WINDOWS
+  m_hLock(INVALID_HANDLE_VALUE)
+#else
+  m_iLockFile(-1)
+#endif
+{
+  if(m_iMaxSlots == 0) { return; }
+  // without the lock we must not touch the files: their owner has the slab
+  // mapped and rewrites the index when it is done.
+  if(!Lock()) {
+    MESSAGE("Disk brick cache %s is in use elsewhere; not using it.",
+            m_strSlabFile.c_str());
+    m_iMaxSlots = 0;
+    return;
+  }
+  if(LoadIndex()) {
+    MESSAGE("Disk brick cache %s holds %u bricks.", m_strSlabFile.c_str(),
+            static_cast<unsigned>(m_LRU.size()));
+  } else {
+    m_LRU.clear();
+    m_Index.clear();
+    m_vFreeSlots.clear();
+    m_iBytes = 0;
+    m_iNextSlot = 0;
+    m_iSlabSlots = 0;
+    m_pSlab.reset();
+    remove(m_strSlabFile.c_str());
+  }
+  // a crash must not leave an index behind which describes stale slots.
+  remove(m_strIndexFile.c_str());
+}
+
+DiskBrickCache::~DiskBrickCache() {
+  SCOPEDLOCK(m_Guard);
+  if(IsOpen() && m_pSlab) {
+    m_pSlab->Flush();
+    if(!SaveIndex()) {
+      WARNING("Could not write the disk brick cache index %s.",
+              m_strIndexFile.c_str());
+      remove(m_strIndexFile.c_str());
+    }
+  }
+  m_pSlab.reset();
+  Unlock();
+}
+
+bool DiskBrickCache::Lock() {
+#ifdef DETECTED_OS_WINDOWS
+  m_hLock = CreateFileA(m_strLockFile.c_str(), GENERIC_READ | GENERIC_WRITE,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS,
+                        FILE_ATTRIBUTE_NORMAL, NULL);
+  if(m_hLock == INVALID_HANDLE_VALUE) { return false; }
+  OVERLAPPED ov;
+  memset(&ov, 0, sizeof(ov));
+  if(!LockFileEx(m_hLock, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY,
+                 0, 1, 0, &ov)) {
+    CloseHandle(m_hLock);
+    m_hLock = INVALID_HANDLE_VALUE;
+    return false;
+  }
+  return true;
+#else
+  m_iLockFile = open(m_strLockFile.c_str(), O_RDWR | O_CREAT, 0644);
+  if(m_iLockFile < 0) { return false; }
+  // flock locks belong to the open file, so a second instance within this
+  // process is locked out just like another process.
+  if(flock(m_iLockFile, LOCK_EX | LOCK_NB) != 0) {
+    close(m_iLockFile);
+    m_iLockFile = -1;
+    return false;
+  }
+  return true;
+#endif
+}
+
+void DiskBrickCache::Unlock() {
+  // the lock file stays: removing it would race with someone locking it.
+#ifdef DETECTED_OS_WINDOWS
+  if(m_hLock == INVALID_HANDLE_VALUE) { return; }
+  OVERLAPPED ov;
+  memset(&ov, 0, sizeof(ov));
+  UnlockFileEx(m_hLock, 0, 1, 0, &ov);
+  CloseHandle(m_hLock);
+  m_hLock = INVALID_HANDLE_VALUE;
+#else
+  if(m_iLockFile < 0) { return; }
+  flock(m_iLockFile, LOCK_UN);
+  close(m_iLockFile);
+  m_iLockFile = -1;
+#endif
+}
+
+bool DiskBrickCache::LoadIndex() {
+  std::ifstream is(m_strIndexFile.c_str(), std::ios::binary);
+  if(!is) { return false; }
+
+  char magic[sizeof(MAGIC)];
+  is.read(magic, sizeof(magic));
+  if(!is || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) { return false; }
+
+  uint64_t iLength = 0;
+  if(!ReadPOD(is, iLength) || iLength > 65536) { return false; }
+  std::string strIdentity(size_t(iLength), '\0');
+  if(iLength > 0) { is.read(&strIdentity[0], std::streamsize(iLength)); }
+  if(!is || strIdentity != m_strIdentity) {
+    MESSAGE("Source of disk brick cache %s changed; discarding it.",
+            m_strSlabFile.c_str());
+    return false;
+  }
+
+  uint64_t iSlotBytes = 0, iSlabSlots = 0, iNextSlot = 0, iEntries = 0;
+  if(!ReadPOD(is, iSlotBytes) || !ReadPOD(is, iSlabSlots) ||
+     !ReadPOD(is, iNextSlot) || !ReadPOD(is, iEntries) ||
+     iSlotBytes != m_iSlotBytes || iNextSlot > iSlabSlots) {
+    return false;
+  }
+
+  m_pSlab.reset(new MemMappedFile(m_strSlabFile, MMFILE_ACCESS_READWRITE));
+  if(!m_pSlab->IsOpen() ||
+     m_pSlab->GetFileLength() < iSlabSlots * m_iSlotBytes) {
+    return false;
+  }
+  m_iSlabSlots = m_pSlab->GetFileLength() / m_iSlotBytes;
+
+  // the budget may have shrunk since; drop what lies beyond it.
+  m_iNextSlot = std::min(iNextSlot, m_iMaxSlots);
+  std::vector<bool> used(size_t(m_iNextSlot), false);
+  for(uint64_t i=0; i < iEntries; ++i) {
+    uint64_t ts, lod, brick;
+    Entry e;
+    if(!ReadPOD(is, ts) || !ReadPOD(is, lod) || !ReadPOD(is, brick) ||
+       !ReadPOD(is, e.iSlot) || !ReadPOD(is, e.iBytes)) {
+      return false;
+    }
+    if(e.iSlot >= m_iNextSlot || e.iBytes > m_iSlotBytes || used[e.iSlot]) {
+      continue;
+    }
+    e.key = BrickKey(size_t(ts), size_t(lod), size_t(brick));
+    if(m_Index.find(e.key) != m_Index.end()) { continue; }
+    used[size_t(e.iSlot)] = true;
+    m_LRU.push_back(e);
+    m_Index[e.key] = --m_LRU.end();
+    m_iBytes += e.iBytes;
+  }
+  for(uint64_t s=0; s < m_iNextSlot; ++s) {
+    if(!used[size_t(s)]) { m_vFreeSlots.push_back(s); }
+  }
+  return true;
+}
+
+bool DiskBrickCache::SaveIndex() const {
+  std::ofstream os(m_strIndexFile.c_str(), std::ios::binary);
+  if(!os) { return false; }
+  os.write(MAGIC, sizeof(MAGIC));
+  WritePOD(os, uint64_t(m_strIdentity.size()));
+  os.write(m_strIdentity.data(), std::streamsize(m_strIdentity.size()));
+  WritePOD(os, m_iSlotBytes);
+  WritePOD(os, m_iSlabSlots);
+  WritePOD(os, m_iNextSlot);
+  WritePOD(os, uint64_t(m_LRU.size()));
+  for(LRUList::const_iterator e = m_LRU.begin(); e != m_LRU.end(); ++e) {
+    WritePOD(os, uint64_t(std::get<0>(e->key)));
+    WritePOD(os, uint64_t(std::get<1>(e->key)));
+    WritePOD(os, uint64_t(std::get<2>(e->key)));
+    WritePOD(os, e->iSlot);
+    WritePOD(os, e->iBytes);
+  }
+  return !os.fail();
+}
+
+bool DiskBrickCache::Grow(uint64_t iSlots) {
+  // the mapping changes, but nobody holds on to pointers into it.
+  m_pSlab.reset();
+  m_pSlab.reset(new MemMappedFile(m_strSlabFile, MMFILE_ACCESS_READWRITE,
+                                  iSlots * m_iSlotBytes));
+  if(!m_pSlab->IsOpen() || m_pSlab->GetFileLength() < iSlots*m_iSlotBytes) {
+    WARNING("Could not grow the disk brick cache %s; disabling it.",
+            m_strSlabFile.c_str());
+    m_pSlab.reset();
+    m_iMaxSlots = 0;
+    return false;
+  }
+  m_iSlabSlots = iSlots;
+  return true;
+}
+
+bool DiskBrickCache::AllocateSlot(uint64_t& iSlot) {
+  if(!m_vFreeSlots.empty()) {
+    iSlot = m_vFreeSlots.back();
+    m_vFreeSlots.pop_back();
+    return true;
+  }
+  if(m_iNextSlot < m_iMaxSlots) {
+    if(m_iNextSlot >= m_iSlabSlots) {
+      // grow geometrically; every grow re-maps the whole file.
+      const uint64_t iSlots = std::min(m_iMaxSlots,
+                                       std::max<uint64_t>(16, 2*m_iSlabSlots));
+      if(!Grow(iSlots)) { return false; }
+    }
+    iSlot = m_iNextSlot++;
+    return true;
+  }
+  if(m_LRU.empty()) { return false; }
+  const Entry& victim = m_LRU.front();
+  iSlot = victim.iSlot;
+  m_iBytes -= victim.iBytes;
+  m_Index.erase(victim.key);
+  m_LRU.pop_front();
+  return true;
+}
+
+uint8_t* DiskBrickCache::SlotData(uint64_t iSlot) const {
+  return static_cast<uint8_t*>(m_pSlab->GetDataPointer()) +
+         iSlot * m_iSlotBytes;
+}
+
+bool DiskBrickCache::Lookup(const BrickKey& k, void* pData, size_t iBytes) {
+  SCOPEDLOCK(m_Guard);
+  Index::iterator i = m_Index.find(k);
+  if(i == m_Index.end() || i->second->iBytes != iBytes) { return false; }
+  memcpy(pData, SlotData(i->second->iSlot), iBytes);
+  m_LRU.splice(m_LRU.end(), m_LRU, i->second);
+  return true;
+}
+
+bool DiskBrickCache::Store(const BrickKey& k, const void* pData,
+                           size_t iBytes) {
+  SCOPEDLOCK(m_Guard);
+  if(!IsOpen() || iBytes > m_iSlotBytes) { return false; }
+
+  Index::iterator i = m_Index.find(k);
+  if(i != m_Index.end()) {
+    m_iBytes -= i->second->iBytes;
+    i->second->iBytes = iBytes;
+    m_LRU.splice(m_LRU.end(), m_LRU, i->second);
+  } else {
+    Entry e;
+    e.key = k;
+    e.iBytes = iBytes;
+    if(!AllocateSlot(e.iSlot)) { return false; }
+    m_LRU.push_back(e);
+    m_Index[k] = --m_LRU.end();
+  }
+  m_iBytes += iBytes;
+  memcpy(SlotData(m_LRU.back().iSlot), pData, iBytes);
+  return true;
+}
+
+uint64_t DiskBrickCache::GetSize() const {
+  SCOPEDLOCK(m_Guard);
+  return m_iBytes;
+}
+
+size_t DiskBrickCache::GetBrickCount() const {
+  SCOPEDLOCK(m_Guard);
+  return m_LRU.size();
+}
+
+}
@@ -0,0 +1,102 @@
+#ifndef TUVOK_DISK_BRICK_CACHE_H
+#define TUVOK_DISK_BRICK_CACHE_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "StdTuvokDefines.h"
+#include "Brick.h"
+#include "Basics/Threads.h"
+
+class MemMappedFile;
+
+namespace tuvok {
+
+/// Second level brick cache on disk, meant for an SSD: keeps decoded bricks
+/// of slow-to-read (e.g. LZMA or bzip2 compressed) data across sessions.
+/// Bricks live in fixed size slots of a memory mapped slab file; an index
+/// file maps keys to slots and stores the LRU order.  The cache is tied to
+/// the identity (path, size and modification time) of the source file and
+/// starts out empty if the source changed.  The index is only written when
+/// the cache is destroyed, so after a crash the cache starts out empty, too.
+/// A cache is used by a single process at a time: the first one to open it
+/// holds a lock on it until it is destroyed, other processes (and other
+/// instances) for the same source and variant find it closed.
+class DiskBrickCache {
+public:
+  /// @param strDir directory to keep the cache files in
+  /// @param strSource the file the bricks come from
+  /// @param strVariant distinguishes different brickings/types of a source
+  /// @param iMaxBytes size limit of the slab file
+  /// @param iSlotBytes size of the largest brick we will be asked to store
+  DiskBrickCache(const std::string& strDir, const std::string& strSource,
+                 const std::string& strVariant, uint64_t iMaxBytes,
+                 uint64_t iSlotBytes);
+  /// writes the index, so the next session starts warm.
+  ~DiskBrickCache();
+
+  /// @returns false if the cache files could not be created or the cache
+  /// is in use elsewhere.
+  bool IsOpen() const { return m_iMaxSlots > 0; }
+
+  /// Copies the brick into 'pData' if we have it with exactly 'iBytes'.
+  bool Lookup(const BrickKey& k, void* pData, size_t iBytes);
+  /// Adds the brick, evicting the least recently used ones if necessary.
+  /// Bricks larger than a slot are not stored.
+  bool Store(const BrickKey& k, const void* pData, size_t iBytes);
+
+  /// @returns the number of bytes of brick data held.
+  uint64_t GetSize() const;
+  size_t GetBrickCount() const;
+
+private:
+  struct Entry {
+    BrickKey key;
+    uint64_t iSlot;
+    uint64_t iBytes;
+  };
+  typedef std::list<Entry> LRUList; ///< least recently used first
+  typedef std::unordered_map<BrickKey, LRUList::iterator, BKeyHash> Index;
+
+  /// takes the lock which makes us the only user of the cache files.
+  /// @returns false if someone else holds it.
+  bool Lock();
+  void Unlock();
+  bool LoadIndex();
+  bool SaveIndex() const;
+  /// makes the slab file large enough for 'iSlots' slots.
+  bool Grow(uint64_t iSlots);
+  /// @returns a slot to store a brick in; evicts if the cache is full.
+  bool AllocateSlot(uint64_t& iSlot);
+  uint8_t* SlotData(uint64_t iSlot) const;
+
+  const std::string           m_strIdentity;
+  const std::string           m_strSlabFile;
+  const std::string           m_strIndexFile;
+  const std::string           m_strLockFile;
+  const uint64_t              m_iSlotBytes;
+  uint64_t                    m_iMaxSlots;
+  uint64_t                    m_iSlabSlots; ///< slots the slab holds now
+  uint64_t                    m_iBytes;
+
+  mutable CriticalSection     m_Guard;
+  std::unique_ptr<MemMappedFile> m_pSlab;
+  LRUList                     m_LRU;
+  Index                       m_Index;
+  std::vector<uint64_t>       m_vFreeSlots;
+  uint64_t                    m_iNextSlot; ///< first slot never used
+#ifdef DETECTED_OS_WINDOWS
+  void*                       m_hLock; ///< HANDLE of the locked file
+#else
+  int                         m_iLockFile;
+#endif
+
+  DiskBrickCache(const DiskBrickCache&);
+  DiskBrickCache& operator=(const DiskBrickCache&);
+};
+
+}
+
+#endif // TUVOK_DISK_BRICK_CACHE_H
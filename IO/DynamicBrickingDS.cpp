@@ -166,6 +166,20 @@ size_t DynamicBrickingDS::GetCacheSize() const {
   return this->di->GetCacheSize() / megabyte;
 }
 
+void DynamicBrickingDS::SetNUMALocal(bool bLocal) {
+  this->di->cache.SetNUMALocal(bLocal);
+}
+
+void DynamicBrickingDS::SetDiskCache(const std::string& strDir,
+                                     uint64_t iMaxBytes) {
+  this->di->ds->SetDiskCache(strDir, iMaxBytes);
+}
+
+void DynamicBrickingDS::SetSharedCache(const std::string& strName,
+                                       uint64_t iMaxBytes) {
+  this->di->ds->SetSharedCache(strName, iMaxBytes);
+}
+
 // Removes all the cache information we've made so far.
 void DynamicBrickingDS::Clear() {
   di->ds->Clear();
@@ -39,6 +39,12 @@ public:
   void SetCacheSize(size_t megabytes);
   /// get the cache size used for holding large bricks in MB
   size_t GetCacheSize() const;
+  /// keep cached bricks on the NUMA node of the thread requesting them.
+  void SetNUMALocal(bool bLocal);
+  /// the source's bricks are what is expensive to read, so the source
+  /// keeps the disk and shared caches; cutting them up again is cheap.
+  virtual void SetDiskCache(const std::string& strDir, uint64_t iMaxBytes);
+  virtual void SetSharedCache(const std::string& strName, uint64_t iMaxBytes);
 
   virtual float MaxGradientMagnitude() const;
   /// Removes all the cache information we've made so far.
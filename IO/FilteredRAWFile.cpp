@@ -0,0 +1,112 @@
+#include <cassert>
+#include "FilteredRAWFile.h"
+
+FilteredRAWFile::FilteredRAWFile(LargeRAWFile_ptr source, size_t iSourceWidth,
+                                 size_t iTargetWidth)
+  : LargeRAWFile(source->GetFilename())
+  , m_pSource(source)
+  , m_iSourceWidth(iSourceWidth)
+  , m_iTargetWidth(iTargetWidth)
+  , m_iPos(0)
+{
+  assert(iSourceWidth > 0 && iTargetWidth > 0);
+}
+
+bool FilteredRAWFile::Open(bool bReadWrite) {
+  if(bReadWrite) { return false; }
+  m_iPos = 0;
+  if(m_pSource->IsOpen()) {
+    m_pSource->SeekStart();
+    return true;
+  }
+  return m_pSource->Open(false);
+}
+
+bool FilteredRAWFile::IsOpen() const { return m_pSource->IsOpen(); }
+
+void FilteredRAWFile::Close() {
+  // we might be called from our destructor after the source went away.
+  if(m_pSource) { m_pSource->Close(); }
+}
+
+uint64_t FilteredRAWFile::GetCurrentSize() {
+  return (m_pSource->GetCurrentSize() / m_iSourceWidth) * m_iTargetWidth;
+}
+
+uint64_t FilteredRAWFile::SeekEnd() {
+  m_iPos = GetCurrentSize();
+  m_pSource->SeekPos(ToSource(m_iPos));
+  return m_iPos;
+}
+
+void FilteredRAWFile::SeekPos(uint64_t iPos) {
+  assert(iPos % m_iTargetWidth == 0);
+  m_iPos = iPos;
+  m_pSource->SeekPos(ToSource(iPos));
+}
+
+size_t FilteredRAWFile::ReadRAW(unsigned char* pData, uint64_t iCount) {
+  assert(iCount % m_iTargetWidth == 0);
+  const size_t iElements = static_cast<size_t>(iCount / m_iTargetWidth);
+  if(iElements == 0) { return 0; }
+
+  size_t iRead;
+  if(m_iSourceWidth == m_iTargetWidth) {
+    // filter in place, no need for an extra copy.
+    iRead = m_pSource->ReadRAW(pData, iElements*m_iSourceWidth) /
+            m_iSourceWidth;
+    Filter(pData, pData, iRead);
+  } else {
+    m_vScratch.resize(iElements*m_iSourceWidth);
+    iRead = m_pSource->ReadRAW(&m_vScratch[0], iElements*m_iSourceWidth) /
+            m_iSourceWidth;
+    Filter(&m_vScratch[0], pData, iRead);
+  }
+  m_iPos += iRead * m_iTargetWidth;
+  return iRead * m_iTargetWidth;
+}
+
+size_t FilteredRAWFile::ReadAt(uint64_t iPos, unsigned char* pData,
+                               uint64_t iCount) const {
+  assert(iPos % m_iTargetWidth == 0);
+  assert(iCount % m_iTargetWidth == 0);
+  const size_t iElements = static_cast<size_t>(iCount / m_iTargetWidth);
+  if(iElements == 0) { return 0; }
+
+  size_t iRead;
+  if(m_iSourceWidth == m_iTargetWidth) {
+    iRead = m_pSource->ReadAt(ToSource(iPos), pData,
+                              iElements*m_iSourceWidth) / m_iSourceWidth;
+    Filter(pData, pData, iRead);
+  } else {
+    // m_vScratch belongs to the sequential reads; other threads may be
+    // using it.
+    std::vector<unsigned char> scratch(iElements*m_iSourceWidth);
+    iRead = m_pSource->ReadAt(ToSource(iPos), &scratch[0],
+                              scratch.size()) / m_iSourceWidth;
+    Filter(&scratch[0], pData, iRead);
+  }
+  return iRead * m_iTargetWidth;
+}
+
+void FilteredRAWFile::Hint(IOHint hint, uint64_t offset,
+                           uint64_t length) const {
+  m_pSource->Hint(hint, ToSource(offset), ToSource(length));
+}
+
+EndianSwappedRAWFile::EndianSwappedRAWFile(LargeRAWFile_ptr source,
+                                           size_t iWidth)
+  : FilteredRAWFile(source, iWidth, iWidth)
+  , m_iWidth(iWidth)
+{
+  assert(iWidth == 2 || iWidth == 4 || iWidth == 8);
+}
+
+void EndianSwappedRAWFile::Filter(const unsigned char* in, unsigned char* out,
+                                  size_t iElements) const {
+  switch(m_iWidth) {
+    case 2: Swap<uint16_t>(in, out, iElements); break;
+    case 4: Swap<uint32_t>(in, out, iElements); break;
+    case 8: Swap<uint64_t>(in, out, iElements); break;
+  }
+}
@@ -0,0 +1,121 @@
+#ifndef TUVOK_FILTERED_RAW_FILE_H
+#define TUVOK_FILTERED_RAW_FILE_H
+
+#include <algorithm>
+#include <vector>
+#include "Basics/EndianConvert.h"
+#include "Basics/LargeRAWFile.h"
+
+/// A read-only view of another LargeRAWFile which transforms the data as it
+/// is read.  Positions and sizes are given in units of the *filtered* data;
+/// they are mapped to the source file element-wise.  This lets us hand an
+/// endian-swapped or quantized version of a dataset to the octree converter
+/// without ever writing that version to disk.
+/// All positions and read sizes must be multiples of the target width.
+class FilteredRAWFile : public LargeRAWFile {
+public:
+  FilteredRAWFile(LargeRAWFile_ptr source, size_t iSourceWidth,
+                  size_t iTargetWidth);
+  virtual ~FilteredRAWFile() { Close(); }
+
+  virtual bool Open(bool bReadWrite=false);
+  virtual bool IsOpen() const;
+  virtual bool IsWritable() const { return false; }
+  virtual bool Create(uint64_t) { return false; }
+  virtual bool Append() { return false; }
+  virtual void Close();
+  virtual void Delete() { Close(); }
+  virtual bool Truncate() { return false; }
+  virtual bool Truncate(uint64_t) { return false; }
+  virtual uint64_t GetCurrentSize();
+
+  virtual void SeekStart() { SeekPos(0); }
+  virtual uint64_t SeekEnd();
+  virtual uint64_t GetPos() { return m_iPos; }
+  virtual void SeekPos(uint64_t iPos);
+  virtual size_t ReadRAW(unsigned char* pData, uint64_t iCount);
+  virtual size_t WriteRAW(const unsigned char*, uint64_t) { return 0; }
+  virtual bool CopyRAW(uint64_t, uint64_t, uint64_t, unsigned char*,
+                       uint64_t) { return false; }
+  virtual size_t ReadAt(uint64_t iPos, unsigned char* pData,
+                        uint64_t iCount) const;
+  virtual size_t WriteAt(uint64_t, const unsigned char*, uint64_t) const {
+    return 0;
+  }
+
+  virtual void Hint(IOHint hint, uint64_t offset, uint64_t length) const;
+
+protected:
+  /// converts 'iElements' elements from 'in' (source width) to 'out' (target
+  /// width).  When both widths are equal, 'in' and 'out' may alias.
+  virtual void Filter(const unsigned char* in, unsigned char* out,
+                      size_t iElements) const = 0;
+
+private:
+  uint64_t ToSource(uint64_t iPos) const {
+    return (iPos / m_iTargetWidth) * m_iSourceWidth;
+  }
+
+  LargeRAWFile_ptr           m_pSource;
+  const size_t               m_iSourceWidth;
+  const size_t               m_iTargetWidth;
+  uint64_t                   m_iPos;
+  std::vector<unsigned char> m_vScratch;
+};
+
+/// Swaps the byte order of every element while reading.
+class EndianSwappedRAWFile : public FilteredRAWFile {
+public:
+  EndianSwappedRAWFile(LargeRAWFile_ptr source, size_t iWidth);
+
+protected:
+  virtual void Filter(const unsigned char* in, unsigned char* out,
+                      size_t iElements) const;
+
+private:
+  template<typename T> static void Swap(const unsigned char* in,
+                                        unsigned char* out, size_t n) {
+    const T* src = reinterpret_cast<const T*>(in);
+    T* dst = reinterpret_cast<T*>(out);
+    std::transform(src, src+n, dst, EndianConvert::Swap<T>);
+  }
+  const size_t m_iWidth;
+};
+
+/// Linearly maps source values of type T into the range of U while reading,
+/// i.e. applies the same transformation Quantize<T,U> writes into its
+/// intermediate file.
+template<typename T, typename U>
+class QuantizedRAWFile : public FilteredRAWFile {
+public:
+  QuantizedRAWFile(LargeRAWFile_ptr source, T minimum, double fQuantFact,
+                   size_t iMaxOutputValue)
+    : FilteredRAWFile(source, sizeof(T), sizeof(U))
+    , m_Min(minimum)
+    , m_fQuantFact(fQuantFact)
+    , m_MaxOut(static_cast<U>(iMaxOutputValue))
+  {}
+
+  /// the mapping itself, for callers which write the quantized data.
+  static void Map(const T* src, U* dst, size_t iElements, T minimum,
+                  double fQuantFact, U maxOut) {
+    for(size_t i=0; i < iElements; ++i) {
+      dst[i] = std::min<U>(maxOut,
+                           static_cast<U>((src[i]-minimum) * fQuantFact));
+    }
+  }
+
+protected:
+  virtual void Filter(const unsigned char* in, unsigned char* out,
+                      size_t iElements) const {
+    Map(reinterpret_cast<const T*>(in), reinterpret_cast<U*>(out), iElements,
+        m_Min, m_fQuantFact, m_MaxOut);
+  }
+
+private:
+  const T      m_Min;
+  const double m_fQuantFact;
+  const U      m_MaxOut;
+};
+
+#endif // TUVOK_FILTERED_RAW_FILE_H
@@ -39,11 +39,14 @@
 #include <cstring>
 #include <fstream>
 #include <float.h>
+#include <functional>
 #include <iterator>
 #include <set>
 #include <sstream>
 #include <map>
+#include <tuple>
 #include <memory>
+#include <numeric>
 #include "3rdParty/jpeglib/jconfig.h"
 
 #include "IOManager.h"
@@ -51,6 +54,7 @@
 #include "Basics/MC.h"
 #include "Basics/SysTools.h"
 #include "Basics/SystemInfo.h"
+#include "Basics/Threads.h"
 #include "Controller/Controller.h"
 #include "DSFactory.h"
 #include "DynamicBrickingDS.h"
@@ -62,6 +66,7 @@
 #include "IO/Images/ImageParser.h"
 #include "IO/Images/StackExporter.h"
 #include "Quantize.h"
+#include "StackDecoder.h"
 #include "TuvokJPEG.h"
 #include "TransferFunction1D.h"
 #include "TuvokSizes.h"
@@ -70,6 +75,8 @@
 #include "UVF/GeometryDataBlock.h"
 #include "UVF/Histogram1DDataBlock.h"
 #include "UVF/Histogram2DDataBlock.h"
+#include "UVF/MaxMinDataBlock.h"
+#include "UVF/TOCBlock.h"
 
 #include "AmiraConverter.h"
 #include "AnalyzeConverter.h"
@@ -295,6 +302,133 @@ IOManager::ScanDirectory(string strDirectory) const {
   #pragma warning(disable:4996)
 #endif
 
+/// Reads the contents of file 'strFilename' from 'offset' on into 'vData',
+/// without logging.
+static bool ReadFileFrom(const string& strFilename, std::streamoff offset,
+                         vector<char>& vData) {
+  ifstream ifs(strFilename.c_str(), ios::binary);
+  if (!ifs.is_open()) return false;
+  ifs.seekg(0, ios::end);
+  const std::streamoff size = std::streamoff(ifs.tellg()) - offset;
+  if (size <= 0) return false;
+  ifs.seekg(offset, ios::beg);
+  vData.resize(size_t(size));
+  ifs.read(&vData[0], std::streamsize(size));
+  return ifs.gcount() == std::streamsize(size);
+}
+
+/// Reads slice 'j' of a DICOM stack and converts it into the layout of the
+/// intermediate raw file.  Runs concurrently for different slices.
+static bool DecodeDICOMSlice(const DICOMStackInfo& stack, bool bExpandRGB,
+                             size_t j, vector<char>& vData) {
+  const SimpleDICOMFileInfo* pDICOMFileInfo =
+    dynamic_cast<const SimpleDICOMFileInfo*>(stack.m_Elements[j]);
+
+  if (!pDICOMFileInfo) {
+    vData.clear();
+    return true;
+  }
+
+  uint32_t iDataSize = stack.m_Elements[j]->GetDataSize();
+  vData.resize(iDataSize);
+
+  if (stack.m_bIsJPEGEncoded) {
+    // the debug out is not thread safe: read the file and decode it through
+    // the buffer path, neither of which logs; DecodeStack reports failures.
+    vector<char> vJPEG;
+    if (!ReadFileFrom(stack.m_Elements[j]->m_strFileName,
+                      pDICOMFileInfo->GetOffsetToData(), vJPEG))
+      return false;
+    tuvok::JPEG jpg(vJPEG);
+    if(!jpg.valid()) return false;
+
+    const char *jpeg_data = jpg.data();
+    vData.resize(std::max<size_t>(iDataSize, jpg.size()));
+    copy(jpeg_data, jpeg_data + jpg.size(), &vData[0]);
+  } else {
+    if (!stack.m_Elements[j]->GetData(vData)) return false;
+  }
+
+  if (stack.m_bIsBigEndian != EndianConvert::IsBigEndian()) {
+    switch (stack.m_iAllocated) {
+      case  8 : break;
+      case 16 : {
+            short *pData = reinterpret_cast<short*>(&vData[0]);
+            for (uint32_t k = 0;k<iDataSize/2;k++)
+              pData[k] = EndianConvert::Swap<short>(pData[k]);
+            } break;
+      case 32 : {
+            int *pData = reinterpret_cast<int*>(&vData[0]);
+            for (uint32_t k = 0;k<iDataSize/4;k++)
+              pData[k] = EndianConvert::Swap<int>(pData[k]);
+            } break;
+    }
+  }
+
+  if (pDICOMFileInfo->m_fScale != 1.0f || pDICOMFileInfo->m_fBias != 0.0f) {
+    if (stack.m_bSigned) {
+      switch (stack.m_iAllocated) {
+        case  8 :{
+              char *pData = reinterpret_cast<char*>(&vData[0]);
+              for (uint32_t k = 0;k<iDataSize/2;k++){
+                float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
+                pData[k] = (char)(sbValue);
+              }} break;
+        case 16 : {
+              short *pData = reinterpret_cast<short*>(&vData[0]);
+              for (uint32_t k = 0;k<iDataSize/2;k++){
+                float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
+                pData[k] = (short)(sbValue);
+              }} break;
+        case 32 : {
+              int *pData = reinterpret_cast<int*>(&vData[0]);
+              for (uint32_t k = 0;k<iDataSize/4;k++){
+                float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
+                pData[k] = (int)(sbValue);
+              }} break;
+      }
+    } else {
+      switch (stack.m_iAllocated) {
+        case  8 :{
+              unsigned char *pData = reinterpret_cast<unsigned char*>(&vData[0]);
+              for (uint32_t k = 0;k<iDataSize/2;k++){
+                float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
+                pData[k] = (unsigned char)(sbValue);
+              }} break;
+        case 16 : {
+              unsigned short *pData = reinterpret_cast<unsigned short*>(&vData[0]);
+              for (uint32_t k = 0;k<iDataSize/2;k++){
+                float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
+                pData[k] = (unsigned short)(sbValue);
+              }} break;
+        case 32 : {
+              unsigned int *pData = reinterpret_cast<unsigned int*>(&vData[0]);
+              for (uint32_t k = 0;k<iDataSize/4;k++) {
+                float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
+                pData[k] = (unsigned int)(sbValue);
+              }} break;
+      }
+    }
+  }
+
+  // We pretend 3 component data is 4 component data to simplify processing
+  // later.
+  /// @todo FIXME: this code assumes 3 component data is always 3*char
+  if (bExpandRGB) {
+    const uint32_t iPixels = iDataSize / 3;
+    vData.resize(size_t(iPixels) * 4);
+    for (uint32_t k = iPixels; k-- > 0;) {
+      vData[k*4+3] = char(255);
+      vData[k*4+2] = vData[k*3+2];
+      vData[k*4+1] = vData[k*3+1];
+      vData[k*4+0] = vData[k*3+0];
+    }
+  } else {
+    vData.resize(iDataSize);
+  }
+  return true;
+}
+
 bool IOManager::ConvertDataset(FileStackInfo* pStack,
                                const string& strTargetFilename,
                                const string& strTempDir,
@@ -335,140 +469,45 @@ bool IOManager::ConvertDataset(FileStackInfo* pStack,
       return false;
     }
 
-    vector<char> vData;
+    if (pDICOMStack->m_bIsJPEGEncoded) {
+      pDICOMStack->m_iAllocated = BITS_IN_JSAMPLE;
+    }
     for (size_t j=0; j < pDICOMStack->m_Elements.size(); j++) {
-
-      SimpleDICOMFileInfo* pDICOMFileInfo = dynamic_cast<SimpleDICOMFileInfo*>(pDICOMStack->m_Elements[j]);
-
-      if (!pDICOMFileInfo) continue;
-
-      uint32_t iDataSize = pDICOMStack->m_Elements[j]->GetDataSize();
-      vData.resize(iDataSize);
-
-      if (pDICOMStack->m_bIsJPEGEncoded) {
-        MESSAGE("JPEG is %d bytes, offset %d", iDataSize,
-                pDICOMFileInfo->GetOffsetToData());
-        tuvok::JPEG jpg(pDICOMStack->m_Elements[j]->m_strFileName,
-                        pDICOMFileInfo->GetOffsetToData());
-        if(!jpg.valid()) {
-          T_ERROR("'%s' reports an embedded JPEG, but the JPEG is invalid.",
-                  pDICOMStack->m_Elements[j]->m_strFileName.c_str());
-          return false;
-        }
-        MESSAGE("jpg is: %u bytes (%ux%u, %u components)", uint32_t(jpg.size()),
-                uint32_t(jpg.width()), uint32_t(jpg.height()),
-                uint32_t(jpg.components()));
-
-        const char *jpeg_data = jpg.data();
-        copy(jpeg_data, jpeg_data + jpg.size(), &vData[0]);
-        pDICOMStack->m_iAllocated = BITS_IN_JSAMPLE;
-      } else {
-        pDICOMStack->m_Elements[j]->GetData(vData);
-        MESSAGE("Creating intermediate file %s\n%u%%",
-                strTempMergeFilename.c_str(),
-                static_cast<unsigned>((100*j)/pDICOMStack->m_Elements.size()));
-      }
-
-      if (pDICOMStack->m_bIsBigEndian != EndianConvert::IsBigEndian()) {
-        MESSAGE("Converting Endianess ...");
-        switch (pDICOMStack->m_iAllocated) {
-          case  8 : break;
-          case 16 : {
-                short *pData = reinterpret_cast<short*>(&vData[0]);
-                for (uint32_t k = 0;k<iDataSize/2;k++)
-                  pData[k] = EndianConvert::Swap<short>(pData[k]);
-                } break;
-          case 32 : {
-                int *pData = reinterpret_cast<int*>(&vData[0]);
-                for (uint32_t k = 0;k<iDataSize/4;k++)
-                  pData[k] = EndianConvert::Swap<int>(pData[k]);
-                } break;
-        }
-      }
-
+      SimpleDICOMFileInfo* pDICOMFileInfo =
+        dynamic_cast<SimpleDICOMFileInfo*>(pDICOMStack->m_Elements[j]);
       // HACK: For now we set bias to 0 for unsigned file as we've
       // encountered a number of DICOM files files where the bias
       // parameter would create negative values and so far I don't know
       // how to interpret this correctly
-      if (!pDICOMStack->m_bSigned) pDICOMFileInfo->m_fBias = 0.0f;
-
-      if (pDICOMFileInfo->m_fScale != 1.0f || pDICOMFileInfo->m_fBias != 0.0f) {
-        MESSAGE("Applying Scale and Bias  ...");
-        if (pDICOMStack->m_bSigned) {
-          switch (pDICOMStack->m_iAllocated) {
-            case  8 :{
-                  char *pData = reinterpret_cast<char*>(&vData[0]);
-                  for (uint32_t k = 0;k<iDataSize/2;k++){
-                    float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
-                    pData[k] = (char)(sbValue);
-                  }} break;
-            case 16 : {
-                  short *pData = reinterpret_cast<short*>(&vData[0]);
-                  for (uint32_t k = 0;k<iDataSize/2;k++){
-                    float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
-                    pData[k] = (short)(sbValue);
-                  }} break;
-            case 32 : {
-                  int *pData = reinterpret_cast<int*>(&vData[0]);
-                  for (uint32_t k = 0;k<iDataSize/4;k++){
-                    float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
-                    pData[k] = (int)(sbValue);
-                  }} break;
-          }
-        } else {
-          switch (pDICOMStack->m_iAllocated) {
-            case  8 :{
-                  unsigned char *pData = reinterpret_cast<unsigned char*>(&vData[0]);
-                  for (uint32_t k = 0;k<iDataSize/2;k++){
-                    float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
-                    pData[k] = (unsigned char)(sbValue);
-                  }} break;
-            case 16 : {
-                  unsigned short *pData = reinterpret_cast<unsigned short*>(&vData[0]);
-                  for (uint32_t k = 0;k<iDataSize/2;k++){
-                    float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
-                    pData[k] = (unsigned short)(sbValue);
-                  }} break;
-            case 32 : {
-                  unsigned int *pData = reinterpret_cast<unsigned int*>(&vData[0]);
-                  for (uint32_t k = 0;k<iDataSize/4;k++) {
-                    float sbValue = pData[k] * pDICOMFileInfo->m_fScale + pDICOMFileInfo->m_fBias;
-                    pData[k] = (unsigned int)(sbValue);
-                  }} break;
-          }
-        }
+      if (pDICOMFileInfo && !pDICOMStack->m_bSigned) {
+        pDICOMFileInfo->m_fBias = 0.0f;
       }
- 
       // TODO: implement proper DICOM Windowing
-      if (pDICOMFileInfo->m_fWindowWidth > 0) {
+      if (pDICOMFileInfo && pDICOMFileInfo->m_fWindowWidth > 0) {
         WARNING("DICOM Windowing parameters found!");
       }
+    }
 
-      // Create temporary file with the DICOM (image) data.  We pretend 3
-      // component data is 4 component data to simplify processing later.
-      /// @todo FIXME: this code assumes 3 component data is always 3*char
-      if (pDICOMStack->m_iComponentCount == 3) {
-        uint32_t iRGBADataSize = (iDataSize / 3) * 4;
-
-        // Later we'll tell RAWConverter that this dataset has
-        // m_iComponentCount components.  Since we're upping the number of
-        // components here, we update the component count too.
-        pDICOMStack->m_iComponentCount = 4;
-        // Do note that the number of components in the data and the number of
-        // components in our in-memory copy of the data now differ.
-
-        unsigned char *pRGBAData = new unsigned char[iRGBADataSize];
-        for (uint32_t k = 0;k<iDataSize/3;k++) {
-          pRGBAData[k*4+0] = vData[k*3+0];
-          pRGBAData[k*4+1] = vData[k*3+1];
-          pRGBAData[k*4+2] = vData[k*3+2];
-          pRGBAData[k*4+3] = 255;
-        }
-        fs.write((char*)pRGBAData, iRGBADataSize);
-        delete[] pRGBAData;
-      } else {
-        fs.write(&vData[0], iDataSize);
-      }
+    // We pretend 3 component data is 4 component data to simplify processing
+    // later.  Later we'll tell RAWConverter that this dataset has
+    // m_iComponentCount components, so we update the component count too.
+    const bool bExpandRGB = pDICOMStack->m_iComponentCount == 3;
+    if (bExpandRGB) pDICOMStack->m_iComponentCount = 4;
+
+    const uint64_t iSliceSize = uint64_t(pDICOMStack->m_ivSize.volume()) *
+                                (pDICOMStack->m_iAllocated/8) *
+                                pDICOMStack->m_iComponentCount;
+    const bool bDecoded = DecodeStack(
+      pDICOMStack->m_Elements.size(),
+      std::bind(DecodeDICOMSlice, std::cref(*pDICOMStack), bExpandRGB,
+                std::placeholders::_1, std::placeholders::_2),
+      fs, StackSlicesInFlight(iSliceSize, m_iIncoresize),
+      strTempMergeFilename
+    );
+    if (!bDecoded) {
+      fs.close();
+      remove(strTempMergeFilename.c_str());
+      return false;
     }
 
     fs.close();
@@ -530,14 +569,22 @@ bool IOManager::ConvertDataset(FileStackInfo* pStack,
       return false;
     }
 
-    vector<char> vData;
-    for (size_t j = 0;j<pStack->m_Elements.size();j++) {
-      pStack->m_Elements[j]->GetData(vData);
-
-      fs.write(&vData[0], vData.size());
-      MESSAGE("Creating intermediate file %s\n%u%%",
-              strTempMergeFilename.c_str(),
-              static_cast<unsigned>((100*j)/pStack->m_Elements.size()));
+    const uint64_t iSliceSize = uint64_t(pStack->m_ivSize.volume()) *
+                                (pStack->m_iAllocated/8) *
+                                pStack->m_iComponentCount;
+    const vector<SimpleFileInfo*>& elements = pStack->m_Elements;
+    const bool bDecoded = DecodeStack(
+      elements.size(),
+      [&elements](size_t j, vector<char>& vData) {
+        return elements[j]->GetData(vData);
+      },
+      fs, StackSlicesInFlight(iSliceSize, m_iIncoresize),
+      strTempMergeFilename
+    );
+    if (!bDecoded) {
+      fs.close();
+      remove(strTempMergeFilename.c_str());
+      return false;
     }
 
     fs.close();
@@ -1313,7 +1360,7 @@ Dataset* IOManager::LoadRebrickedDataset(const std::string& filename,
   }
 
   const size_t cache_size = static_cast<size_t>(
-    0.80f * Controller::ConstInstance().SysInfo().GetMaxUsableCPUMem()
+    Controller::ConstInstance().SysInfo().GetBrickCacheBudget()
   );
   enum DynamicBrickingDS::MinMaxMode mm =
     static_cast<enum DynamicBrickingDS::MinMaxMode>(minmaxType);
@@ -1337,19 +1384,15 @@ public:
   {}
 
   virtual ~MCData() {}
-  virtual bool PerformMC(void* pData, const UINTVECTOR3& vBrickSize, const UINT64VECTOR3& vBrickOffset) = 0;
+  /// may be called concurrently for different bricks, as long as no two
+  /// calls share the same iThread.
+  virtual bool PerformMC(void* pData, const UINTVECTOR3& vBrickSize,
+                         const UINT64VECTOR3& vBrickOffset, size_t iThread) = 0;
 
 protected:
   std::string m_strTargetFile;
 };
 
-bool MCBrick(void* pData, const UINT64VECTOR3& vBrickSize, 
-             const UINT64VECTOR3& vBrickOffset, void* pUserContext) {
-    MCData* pMCData = (MCData*)pUserContext;
-    return pMCData->PerformMC(pData, UINTVECTOR3(vBrickSize), vBrickOffset);
-}
-
-
 bool IOManager::ExtractImageStack(const tuvok::UVFDataset* pSourceData,
                                   const TransferFunction1D* pTrans,
                                   uint64_t iLODlevel, 
@@ -1391,7 +1434,8 @@ bool IOManager::ExtractImageStack(const tuvok::UVFDataset* pSourceData,
                                                    pSourceData->GetComponentCount(),
                                                    float(pTrans->GetSize() / fMaxActValue),
                                                    pSourceData->GetDomainSize(static_cast<size_t>(iLODlevel)),
-                                                   bAllDirs);
+                                                   bAllDirs,
+                                                   m_iIncoresize);
   remove(strTempFilename.c_str());
 
   if (!bTargetCreated) {
@@ -1409,21 +1453,39 @@ public:
   MCDataTemplate(const std::string& strTargetFile, T TIsoValue, 
                  const FLOATVECTOR3& vScale, 
                  UINT64VECTOR3 vDataSize, tuvok::AbstrGeoConverter* conv,
-                 const FLOATVECTOR4& vColor) :
+                 const FLOATVECTOR4& vColor, size_t iThreads) :
     MCData(strTargetFile),
     m_TIsoValue(TIsoValue),
-    m_iIndexoffset(0),
-    m_pMarchingCubes(new MarchingCubes<T>()),
     m_vDataSize(vDataSize),
     m_conv(conv),
     m_vColor(vColor),
     m_vScale(vScale)
   {
+    for (size_t i = 0;i<std::max<size_t>(iThreads, 1);i++) {
+      m_vpMarchingCubes.push_back(std::make_shared<MarchingCubes<T>>());
+    }
   }
 
   virtual ~MCDataTemplate() {
-    tuvok::Mesh m = tuvok::Mesh(m_vertices, m_normals, tuvok::TexCoordVec(),
-                                tuvok::ColorVec(), m_indices, m_indices, 
+    // stitch the bricks together in brick order, so the mesh does not
+    // depend on which thread finished first
+    tuvok::VertVec vertices;
+    tuvok::NormVec normals;
+    tuvok::IndexVec indices;
+    for (typename std::map<BrickOrder, Piece>::const_iterator p =
+         m_Pieces.begin(); p != m_Pieces.end(); ++p) {
+      const uint32_t iIndexoffset = uint32_t(vertices.size());
+      vertices.insert(vertices.end(), p->second.vertices.begin(),
+                      p->second.vertices.end());
+      normals.insert(normals.end(), p->second.normals.begin(),
+                     p->second.normals.end());
+      for (size_t i = 0;i<p->second.indices.size();i++) {
+        indices.push_back(p->second.indices[i]+iIndexoffset);
+      }
+    }
+
+    tuvok::Mesh m = tuvok::Mesh(vertices, normals, tuvok::TexCoordVec(),
+                                tuvok::ColorVec(), indices, indices, 
                                 tuvok::IndexVec(),tuvok::IndexVec(), 
                                 false,false,"Marching Cubes mesh by ImageVis3D",
                                 tuvok::Mesh::MT_TRIANGLES);
@@ -1431,14 +1493,16 @@ public:
     m_conv->ConvertToNative(m, m_strTargetFile);
   }
 
-  virtual bool PerformMC(void* pData, const UINTVECTOR3& vBrickSize, const UINT64VECTOR3& vBrickOffset) {
+  virtual bool PerformMC(void* pData, const UINTVECTOR3& vBrickSize,
+                         const UINT64VECTOR3& vBrickOffset, size_t iThread) {
+    if (iThread >= m_vpMarchingCubes.size()) return false;
+    MarchingCubes<T>& mc = *m_vpMarchingCubes[iThread];
    
     T* ptData = (T*)pData;
 
     // extract isosurface
-    m_pMarchingCubes->SetVolume(vBrickSize.x, vBrickSize.y, vBrickSize.z,
-                                ptData);
-    m_pMarchingCubes->Process(m_TIsoValue);
+    mc.SetVolume(vBrickSize.x, vBrickSize.y, vBrickSize.z, ptData);
+    mc.Process(m_TIsoValue);
 
     // brick scale
     float fMaxSize = (FLOATVECTOR3(m_vDataSize) * m_vScale).maxVal();
@@ -1446,36 +1510,50 @@ public:
     FLOATVECTOR3 vecBrickOffset(vBrickOffset);
     vecBrickOffset = vecBrickOffset * m_vScale;
 
-    for (int i = 0;i<m_pMarchingCubes->m_Isosurface->iVertices;i++) {
-      m_vertices.push_back((m_pMarchingCubes->m_Isosurface->vfVertices[i]+vecBrickOffset-FLOATVECTOR3(m_vDataSize)/2.0f)/fMaxSize);
+    Piece piece;
+    for (int i = 0;i<mc.m_Isosurface->iVertices;i++) {
+      piece.vertices.push_back((mc.m_Isosurface->vfVertices[i]+vecBrickOffset-FLOATVECTOR3(m_vDataSize)/2.0f)/fMaxSize);
     }
 
-    for (int i = 0;i<m_pMarchingCubes->m_Isosurface->iVertices;i++) {
-      m_normals.push_back(m_pMarchingCubes->m_Isosurface->vfNormals[i]);
+    for (int i = 0;i<mc.m_Isosurface->iVertices;i++) {
+      piece.normals.push_back(mc.m_Isosurface->vfNormals[i]);
     }    
 
-    for (int i = 0;i<m_pMarchingCubes->m_Isosurface->iTriangles;i++) {
-      m_indices.push_back(m_pMarchingCubes->m_Isosurface->viTriangles[i].x+m_iIndexoffset);
-      m_indices.push_back(m_pMarchingCubes->m_Isosurface->viTriangles[i].y+m_iIndexoffset);
-      m_indices.push_back(m_pMarchingCubes->m_Isosurface->viTriangles[i].z+m_iIndexoffset);
+    // indices are relative to the brick until the pieces are stitched
+    for (int i = 0;i<mc.m_Isosurface->iTriangles;i++) {
+      piece.indices.push_back(mc.m_Isosurface->viTriangles[i].x);
+      piece.indices.push_back(mc.m_Isosurface->viTriangles[i].y);
+      piece.indices.push_back(mc.m_Isosurface->viTriangles[i].z);
     }
 
-    m_iIndexoffset += m_pMarchingCubes->m_Isosurface->iVertices;
+    const BrickOrder order(vBrickOffset.z, vBrickOffset.y, vBrickOffset.x);
+    SCOPEDLOCK(m_PiecesGuard);
+    Piece& stored = m_Pieces[order];
+    stored.vertices.swap(piece.vertices);
+    stored.normals.swap(piece.normals);
+    stored.indices.swap(piece.indices);
 
     return true;
   }
 
 protected:
+  /// the geometry of a single brick
+  struct Piece {
+    tuvok::VertVec     vertices;
+    tuvok::NormVec     normals;
+    tuvok::IndexVec    indices;
+  };
+  /// z, y, x of the brick offset: sorts pieces in brick order
+  typedef std::tuple<uint64_t, uint64_t, uint64_t> BrickOrder;
+
   T                  m_TIsoValue;
-  uint32_t           m_iIndexoffset;
-  std::shared_ptr<MarchingCubes<T>> m_pMarchingCubes;
+  std::vector<std::shared_ptr<MarchingCubes<T>>> m_vpMarchingCubes;
   UINT64VECTOR3      m_vDataSize;
   tuvok::AbstrGeoConverter* m_conv;
   FLOATVECTOR4       m_vColor;
   FLOATVECTOR3       m_vScale;
-  tuvok::VertVec     m_vertices;
-  tuvok::NormVec     m_normals;
-  tuvok::IndexVec    m_indices;
+  CriticalSection    m_PiecesGuard;
+  std::map<BrickOrder, Piece> m_Pieces;
 };
 
 bool IOManager::ExtractIsosurface(const tuvok::UVFDataset* pSourceData,
@@ -1495,6 +1573,7 @@ bool IOManager::ExtractIsosurface(const tuvok::UVFDataset* pSourceData,
   bool   bSigned         = pSourceData->GetIsSigned();
   unsigned iComponentSize = pSourceData->GetBitWidth();
   FLOATVECTOR3 vScale    = FLOATVECTOR3(pSourceData->GetScale());
+  const size_t iThreads  = Controller::ConstInstance().SysInfo().GetNumberOfCPUs();
 
   AbstrGeoConverter* conv = GetGeoConverterForExt(SysTools::ToLowerCase(SysTools::GetExt(strTargetFilename)),true, false);
   
@@ -1510,11 +1589,11 @@ bool IOManager::ExtractIsosurface(const tuvok::UVFDataset* pSourceData,
       switch (iComponentSize) {
         case 32:
           pMCData.reset(new MCDataTemplate<float>(strTargetFilename,
-            float(fIsovalue), vScale, vDomainSize, conv, vfColor
+            float(fIsovalue), vScale, vDomainSize, conv, vfColor, iThreads
           )); break;
         case 64:
           pMCData.reset(new MCDataTemplate<double>(strTargetFilename,
-            double(fIsovalue), vScale, vDomainSize, conv, vfColor
+            double(fIsovalue), vScale, vDomainSize, conv, vfColor, iThreads
           )); break;
       }
     }
@@ -1523,38 +1602,38 @@ bool IOManager::ExtractIsosurface(const tuvok::UVFDataset* pSourceData,
       switch (iComponentSize) {
         case  8:
           pMCData.reset(new MCDataTemplate<char>(strTargetFilename,
-            char(fIsovalue), vScale, vDomainSize, conv, vfColor
+            char(fIsovalue), vScale, vDomainSize, conv, vfColor, iThreads
           )); break;
         case 16:
           pMCData.reset(new MCDataTemplate<short>(strTargetFilename,
-            short(fIsovalue), vScale, vDomainSize, conv, vfColor
+            short(fIsovalue), vScale, vDomainSize, conv, vfColor, iThreads
           )); break;
         case 32:
           pMCData.reset(new MCDataTemplate<int>(strTargetFilename,
-            int(fIsovalue), vScale, vDomainSize, conv, vfColor
+            int(fIsovalue), vScale, vDomainSize, conv, vfColor, iThreads
           )); break;
         case 64:
           pMCData.reset(new MCDataTemplate<int64_t>(strTargetFilename,
-            int64_t(fIsovalue), vScale, vDomainSize, conv, vfColor
+            int64_t(fIsovalue), vScale, vDomainSize, conv, vfColor, iThreads
           )); break;
       }
     } else {
       switch (iComponentSize) {
         case  8:
           pMCData.reset(new MCDataTemplate<unsigned char>(strTargetFilename,
-            (unsigned char)(fIsovalue), vScale, vDomainSize, conv, vfColor
+            (unsigned char)(fIsovalue), vScale, vDomainSize, conv, vfColor, iThreads
           )); break;
         case 16:
           pMCData.reset(new MCDataTemplate<unsigned short>(strTargetFilename,
-            (unsigned short)(fIsovalue), vScale, vDomainSize, conv, vfColor
+            (unsigned short)(fIsovalue), vScale, vDomainSize, conv, vfColor, iThreads
           )); break;
         case 32:
           pMCData.reset(new MCDataTemplate<uint32_t>(strTargetFilename,
-            uint32_t(fIsovalue), vScale, vDomainSize, conv, vfColor
+            uint32_t(fIsovalue), vScale, vDomainSize, conv, vfColor, iThreads
           )); break;
         case 64:
           pMCData.reset(new MCDataTemplate<uint64_t>(strTargetFilename,
-            uint64_t(fIsovalue), vScale, vDomainSize, conv, vfColor
+            uint64_t(fIsovalue), vScale, vDomainSize, conv, vfColor, iThreads
           )); break;
       }
     }
@@ -1565,8 +1644,13 @@ bool IOManager::ExtractIsosurface(const tuvok::UVFDataset* pSourceData,
     return false;
   }
 
-  bool bResult = pSourceData->ApplyFunction(iLODlevel,&MCBrick,
-                                            (void*)pMCData.get(), 1);
+  MCData* mc = pMCData.get();
+  bool bResult = pSourceData->ParallelApplyFunction(iLODlevel,
+    [mc](void* pData, const UINT64VECTOR3& vBrickSize,
+         const UINT64VECTOR3& vBrickOffset, size_t iThread) {
+      return mc->PerformMC(pData, UINTVECTOR3(vBrickSize), vBrickOffset,
+                           iThread);
+    }, iThreads, 1);
 
   if (SysTools::FileExists(strTempFilename)) remove (strTempFilename.c_str());
 
@@ -2604,12 +2688,125 @@ IOManager::EvaluateExpression(const std::string& expr,
   CreateUVFFromRDB(out_fn, rdb);
 }
 
+namespace {
+  // TOC blocks hold a single 3D volume of scalars or vectors.
+  bool UpgradableRDB(const RasterDataBlock& rdb) {
+    if(rdb.ulDomainSize.size() < 3 || rdb.ulElementDimension != 1) {
+      return false;
+    }
+    for(size_t i=3; i < rdb.ulDomainSize.size(); ++i) {
+      if(rdb.ulDomainSize[i] != 1) { return false; }
+    }
+    switch(rdb.ulElementBitSize[0][0]) {
+      case 8: case 16: case 32: case 64: return true;
+      default: return false;
+    }
+  }
+
+  ExtendedOctree::COMPONENT_TYPE RDBComponentType(const RasterDataBlock& rdb)
+  {
+    const bool bSigned = rdb.bSignedElement[0][0];
+    const bool bIsFloat = rdb.ulElementBitSize[0][0] !=
+                          rdb.ulElementMantissa[0][0];
+    switch(rdb.ulElementBitSize[0][0]) {
+      case 8:
+        return bSigned ? ExtendedOctree::CT_INT8 : ExtendedOctree::CT_UINT8;
+      case 16:
+        return bSigned ? ExtendedOctree::CT_INT16 : ExtendedOctree::CT_UINT16;
+      case 32:
+        if(bIsFloat) { return ExtendedOctree::CT_FLOAT32; }
+        return bSigned ? ExtendedOctree::CT_INT32 : ExtendedOctree::CT_UINT32;
+      default:
+        if(bIsFloat) { return ExtendedOctree::CT_FLOAT64; }
+        return bSigned ? ExtendedOctree::CT_INT64 : ExtendedOctree::CT_UINT64;
+    }
+  }
+
+  /// @returns the number of bricks of a TOC or raster data block, over all
+  /// LODs: the number of values its max/min block has.
+  uint64_t VolumeBrickCount(const DataBlock& block) {
+    uint64_t iBricks = 0;
+    if(block.GetBlockSemantic() == UVFTables::BS_TOC_BLOCK) {
+      const TOCBlock& toc = dynamic_cast<const TOCBlock&>(block);
+      for(uint64_t l=0; l < toc.GetLoDCount(); ++l) {
+        iBricks += toc.GetBrickCount(l).volume();
+      }
+      return iBricks;
+    }
+    const RasterDataBlock& rdb = dynamic_cast<const RasterDataBlock&>(block);
+    if(rdb.ulLODLevelCount.size() != 1) { return 0; }
+    for(uint64_t l=0; l < rdb.ulLODLevelCount[0]; ++l) {
+      const std::vector<uint64_t>& vCount =
+        rdb.GetBrickCount(std::vector<uint64_t>(1, l));
+      iBricks += std::accumulate(vCount.begin(), vCount.end(), uint64_t(1),
+                                 std::multiplies<uint64_t>());
+    }
+    return iBricks;
+  }
+
+  uint64_t VolumeComponentCount(const DataBlock& block) {
+    if(block.GetBlockSemantic() == UVFTables::BS_TOC_BLOCK) {
+      return dynamic_cast<const TOCBlock&>(block).GetComponentCount();
+    }
+    return dynamic_cast<const RasterDataBlock&>(block).
+      ulElementDimensionSize[0];
+  }
+}
+
 bool IOManager::ReBrickDataset(const string& strSourceFilename,
                                const string& strTargetFilename,
                                const string& strTempDir,
                                const uint64_t iMaxBrickSize,
                                const uint64_t iBrickOverlap,
                                bool bQuantizeTo8Bit) const {
+  if(iMaxBrickSize <= 2*iBrickOverlap) {
+    T_ERROR("Bricks would contain only ghost data (brick size: %llu, "
+            "brick overlap: %llu)", iMaxBrickSize, iBrickOverlap);
+    return false;
+  }
+
+  // volumes in TOC blocks can be rebricked directly, unless we would have
+  // to quantize them.
+  {
+    wstring wstrSource(strSourceFilename.begin(), strSourceFilename.end());
+    UVF source(wstrSource);
+    std::string strProblem;
+    if(UVF::IsUVFFile(wstrSource) &&
+       source.Open(false, false, false, &strProblem)) {
+      bool bDirect = true;
+      bool bHasVolume = false;
+      for(uint64_t i=0; i < source.GetDataBlockCount() && bDirect; ++i) {
+        switch(source.GetDataBlock(i)->GetBlockSemantic()) {
+          case UVFTables::BS_TOC_BLOCK: {
+            const TOCBlock* toc = dynamic_cast<const TOCBlock*>(
+              source.GetDataBlock(i).get()
+            );
+            bDirect = toc != NULL &&
+                      (!bQuantizeTo8Bit || toc->GetComponentTypeSize() == 1);
+            bHasVolume = true;
+            break;
+          }
+          case UVFTables::BS_REG_NDIM_GRID: {
+            const RasterDataBlock* rdb = dynamic_cast<const RasterDataBlock*>(
+              source.GetDataBlock(i).get()
+            );
+            bDirect = rdb != NULL && UpgradableRDB(*rdb) &&
+                      (!bQuantizeTo8Bit || rdb->ulElementBitSize[0][0] == 8);
+            bHasVolume = true;
+            break;
+          }
+          default:
+            break;
+        }
+      }
+      if(bDirect && bHasVolume) {
+        MESSAGE("Rebricking %s directly...", strSourceFilename.c_str());
+        return ReBrickUVFDataset(source, strTargetFilename, strTempDir,
+                                 iMaxBrickSize, iBrickOverlap);
+      }
+    }
+  }
+
   MESSAGE("Rebricking (Phase 1/2)...");
 
   string filenameOnly = SysTools::GetFilename(strSourceFilename);
@@ -2634,6 +2831,207 @@ bool IOManager::ReBrickDataset(const string& strSourceFilename,
   return true;
 }
 
+bool IOManager::UpgradeDataset(const string& strSourceFilename,
+                               const string& strTargetFilename,
+                               const string& strTempDir) const {
+  wstring wstrSource(strSourceFilename.begin(), strSourceFilename.end());
+  UVF source(wstrSource);
+  std::string strProblem;
+  if(!UVF::IsUVFFile(wstrSource) ||
+     !source.Open(false, false, false, &strProblem)) {
+    T_ERROR("Could not open %s: %s", strSourceFilename.c_str(),
+            strProblem.c_str());
+    return false;
+  }
+
+  bool bHasRDB = false;
+  for(uint64_t i=0; i < source.GetDataBlockCount(); ++i) {
+    if(source.GetDataBlock(i)->GetBlockSemantic() !=
+       UVFTables::BS_REG_NDIM_GRID) {
+      continue;
+    }
+    const RasterDataBlock* rdb = dynamic_cast<const RasterDataBlock*>(
+      source.GetDataBlock(i).get()
+    );
+    if(rdb == NULL || !UpgradableRDB(*rdb)) {
+      T_ERROR("Raster data block %u of %s cannot be stored in a TOC block.",
+              static_cast<unsigned>(i), strSourceFilename.c_str());
+      return false;
+    }
+    bHasRDB = true;
+  }
+  if(!bHasRDB) {
+    T_ERROR("%s has no raster data blocks, there is nothing to upgrade.",
+            strSourceFilename.c_str());
+    return false;
+  }
+
+  MESSAGE("Upgrading %s...", strSourceFilename.c_str());
+  return ReBrickUVFDataset(source, strTargetFilename, strTempDir,
+                           m_iBuilderBrickSize, m_iBrickOverlap);
+}
+
+bool IOManager::RDBToTOCBlock(const RasterDataBlock& rdb, TOCBlock& toc,
+                              const string& strTempFile,
+                              const uint64_t iMaxBrickSize,
+                              const uint64_t iBrickOverlap,
+                              std::shared_ptr<MaxMinDataBlock> stats) const {
+  // the finest LOD, with its overlap removed, is all we need: the TOC block
+  // computes its own, coarser LODs.  The bricks of the two blocks do not
+  // line up, so the LOD goes through a flat file rather than brick by brick.
+  const string strFlatFile = strTempFile + ".raw";
+  const std::vector<uint64_t> vFinestLOD(rdb.ulLODLevelCount.size(), 0);
+  if(!rdb.BrickedLODToFlatData(vFinestLOD, strFlatFile, false,
+                               &Controller::Debug::Out())) {
+    T_ERROR("Could not extract the volume to %s.", strFlatFile.c_str());
+    remove(strFlatFile.c_str());
+    return false;
+  }
+
+  // the scale is on the diagonal of the (n+1)x(n+1) domain transformation
+  const size_t iSize = rdb.ulDomainSize.size();
+  const UINT64VECTOR3 vVolumeSize(rdb.ulDomainSize[0], rdb.ulDomainSize[1],
+                                  rdb.ulDomainSize[2]);
+  const DOUBLEVECTOR3 vScale(rdb.dDomainTransformation[0],
+                             rdb.dDomainTransformation[1+(iSize+1)*1],
+                             rdb.dDomainTransformation[2+(iSize+1)*2]);
+
+  const bool bResult = toc.FlatDataToBrickedLOD(strFlatFile, strTempFile,
+    RDBComponentType(rdb), rdb.ulElementDimensionSize[0], vVolumeSize,
+    vScale, UINT64VECTOR3(iMaxBrickSize, iMaxBrickSize, iMaxBrickSize),
+    uint32_t(iBrickOverlap), m_bUseMedianFilter, m_bClampToEdge,
+    size_t(Controller::ConstInstance().SysInfo().GetMaxUsableCPUMem()),
+    stats, &Controller::Debug::Out(),
+    COMPRESSION_TYPE(m_iCompression), m_iCompressionLevel,
+    LAYOUT_TYPE(m_iLayout));
+
+  if(remove(strFlatFile.c_str()) == -1) {
+    WARNING("Unable to delete temp file %s", strFlatFile.c_str());
+  }
+  return bResult;
+}
+
+bool IOManager::ReBrickUVFDataset(const UVF& source,
+                                  const string& strTargetFilename,
+                                  const string& strTempDir,
+                                  const uint64_t iMaxBrickSize,
+                                  const uint64_t iBrickOverlap) const {
+  wstring wstrTarget(strTargetFilename.begin(), strTargetFilename.end());
+  UVF uvfFile(wstrTarget);
+  GlobalHeader uvfGlobalHeader;
+  uvfGlobalHeader.bIsBigEndian = EndianConvert::IsBigEndian();
+  uvfGlobalHeader.ulChecksumSemanticsEntry = UVFTables::CS_MD5;
+  uvfFile.SetGlobalHeader(uvfGlobalHeader);
+
+  // The histograms and metadata do not depend on the bricking and are
+  // copied as they are.  A max/min block is replaced by the statistics of
+  // the new bricks of the volume it describes: the first volume, not yet
+  // taken, with as many bricks and components as the block has values.
+  std::vector<std::shared_ptr<MaxMinDataBlock>> maxmin;
+  std::vector<std::pair<uint64_t, uint64_t>> vLayouts;
+  for(uint64_t i=0; i < source.GetDataBlockCount(); ++i) {
+    const std::shared_ptr<DataBlock> block = source.GetDataBlock(i);
+    if(block->GetBlockSemantic() == UVFTables::BS_TOC_BLOCK ||
+       block->GetBlockSemantic() == UVFTables::BS_REG_NDIM_GRID) {
+      const uint64_t iComponents = VolumeComponentCount(*block);
+      maxmin.push_back(std::shared_ptr<MaxMinDataBlock>(
+        new MaxMinDataBlock(static_cast<size_t>(iComponents))
+      ));
+      vLayouts.push_back(std::make_pair(VolumeBrickCount(*block),
+                                        iComponents));
+    }
+  }
+  std::map<uint64_t, size_t> mMaxMinVolume;  // block index -> volume
+  std::vector<bool> vTaken(maxmin.size(), false);
+  for(uint64_t i=0; i < source.GetDataBlockCount(); ++i) {
+    const std::shared_ptr<DataBlock> block = source.GetDataBlock(i);
+    if(block->GetBlockSemantic() != UVFTables::BS_MAXMIN_VALUES) { continue; }
+    const MaxMinDataBlock& mm = dynamic_cast<const MaxMinDataBlock&>(*block);
+    for(size_t v=0; v < vLayouts.size(); ++v) {
+      if(!vTaken[v] && vLayouts[v].first == mm.GetValueCount() &&
+         vLayouts[v].second == mm.GetComponentCount()) {
+        vTaken[v] = true;
+        mMaxMinVolume[i] = v;
+        break;
+      }
+    }
+    if(mMaxMinVolume.find(i) == mMaxMinVolume.end()) {
+      WARNING("Max/min block %u fits none of the volumes; it is copied as "
+              "it is.", static_cast<unsigned>(i));
+    }
+  }
+
+  size_t iVolume = 0;
+  for(uint64_t i=0; i < source.GetDataBlockCount(); ++i) {
+    const std::shared_ptr<DataBlock> block = source.GetDataBlock(i);
+    switch(block->GetBlockSemantic()) {
+      case UVFTables::BS_TOC_BLOCK:
+      case UVFTables::BS_REG_NDIM_GRID: {
+        std::shared_ptr<TOCBlock> rebricked(
+          new TOCBlock(UVF::ms_ulReaderVersion)
+        );
+        rebricked->strBlockID = block->strBlockID;
+
+        ostringstream tmpfn;
+        tmpfn << strTempDir << iVolume << "rebrick.tmp";
+        bool bOK;
+        const std::shared_ptr<MaxMinDataBlock> stats = maxmin[iVolume];
+        if(block->GetBlockSemantic() == UVFTables::BS_TOC_BLOCK) {
+          const TOCBlock& toc = dynamic_cast<const TOCBlock&>(*block);
+          MESSAGE("Rebricking volume %u...", static_cast<unsigned>(iVolume));
+          bOK = rebricked->BrickedLODToBrickedLOD(toc, tmpfn.str(),
+            UINT64VECTOR3(iMaxBrickSize, iMaxBrickSize, iMaxBrickSize),
+            uint32_t(iBrickOverlap), m_bClampToEdge,
+            size_t(Controller::ConstInstance().SysInfo().GetMaxUsableCPUMem()),
+            stats, &Controller::Debug::Out(),
+            COMPRESSION_TYPE(m_iCompression), m_iCompressionLevel,
+            LAYOUT_TYPE(m_iLayout));
+        } else {
+          const RasterDataBlock& rdb =
+            dynamic_cast<const RasterDataBlock&>(*block);
+          MESSAGE("Converting raster data volume %u to a TOC block...",
+                  static_cast<unsigned>(iVolume));
+          bOK = RDBToTOCBlock(rdb, *rebricked, tmpfn.str(), iMaxBrickSize,
+                              iBrickOverlap, stats);
+        }
+        if(!bOK) {
+          T_ERROR("Rebricking volume %u failed.",
+                  static_cast<unsigned>(iVolume));
+          uvfFile.Close();
+          return false;
+        }
+        ++iVolume;
+        if(!uvfFile.AddDataBlock(rebricked)) {
+          T_ERROR("AddDataBlock failed!");
+          uvfFile.Close();
+          return false;
+        }
+        break;
+      }
+      case UVFTables::BS_MAXMIN_VALUES: {
+        // the blocks are only written by Create, so the statistics of a
+        // volume which comes later in the file will be there by then.
+        const std::map<uint64_t, size_t>::const_iterator v =
+          mMaxMinVolume.find(i);
+        if(v != mMaxMinVolume.end()) {
+          uvfFile.AddDataBlock(maxmin[v->second]);
+        } else {
+          uvfFile.AddConstDataBlock(block);
+        }
+        break;
+      }
+      default:
+        uvfFile.AddConstDataBlock(block);
+        break;
+    }
+  }
+
+  MESSAGE("Writing UVF file...");
+  uvfFile.Create();
+  MESSAGE("Computing checksum...");
+  uvfFile.Close();
+  return true;
+}
 
 void IOManager::CopyToTSB(const Mesh& m, GeometryDataBlock* tsb) const {
   // source data
@@ -55,6 +55,9 @@ class FileStackInfo;
 class RangeInfo;
 class UVF;
 class GeometryDataBlock;
+class MaxMinDataBlock;
+class RasterDataBlock;
+class TOCBlock;
 class TransferFunction1D;
 
 namespace tuvok {
@@ -117,6 +120,14 @@ public:
                       const uint64_t iMaxBrickSize,
                       const uint64_t iBrickOverlap,
                       bool bQuantizeTo8Bit=false) const;
+  /// Converts the raster data blocks of a UVF file written by older versions
+  /// to TOC blocks with the current brick size and overlap.  The finest LOD
+  /// of each volume is extracted to a raw file in strTempDir, so the source
+  /// data are not needed, but there must be room for one uncompressed
+  /// volume.  All other blocks but the max/min values are copied as they are.
+  bool UpgradeDataset(const std::string& strSourceFilename,
+                      const std::string& strTargetFilename,
+                      const std::string& strTempDir) const;
 
   bool ConvertDataset(FileStackInfo* pStack,
                       const std::string& strTargetFilename,
@@ -284,6 +295,22 @@ private:
                                  tuvok::AbstrRenderer*)> m_LoadDS;
 
   void CopyToTSB(const tuvok::Mesh& m, GeometryDataBlock* tsb) const;
+
+  /// Rebricks a UVF file whose volumes are all stored in TOC or raster data
+  /// blocks.  TOC blocks are rebricked from the bricks of the source
+  /// directly; raster data blocks become TOC blocks, see RDBToTOCBlock.
+  bool ReBrickUVFDataset(const UVF& source,
+                         const std::string& strTargetFilename,
+                         const std::string& strTempDir,
+                         const uint64_t iMaxBrickSize,
+                         const uint64_t iBrickOverlap) const;
+  /// Fills 'toc' with the finest LOD of 'rdb', which goes through the flat
+  /// raw file strTempFile+".raw".
+  bool RDBToTOCBlock(const RasterDataBlock& rdb, TOCBlock& toc,
+                     const std::string& strTempFile,
+                     const uint64_t iMaxBrickSize,
+                     const uint64_t iBrickOverlap,
+                     std::shared_ptr<MaxMinDataBlock> stats) const;
 };
 
 #endif // IOMANAGER_H
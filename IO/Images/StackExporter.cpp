@@ -33,6 +33,8 @@
         University of Utah
 */
 #include "StdTuvokDefines.h"
+#include <cstring>
+#include <functional>
 #include <memory>
 
 #ifndef TUVOK_NO_QT
@@ -45,6 +47,8 @@
 #include "Basics/LargeRAWFile.h"
 #include "Basics/nonstd.h"
 #include "Controller/Controller.h"
+#include "Basics/TaskScheduler.h"
+#include "IO/StackDecoder.h"
 
 
 std::vector<std::pair<std::string,std::string>> StackExporter::GetSuportedImageFormats() {
@@ -64,7 +68,7 @@ std::vector<std::pair<std::string,std::string>> StackExporter::GetSuportedImageF
   return formats;
 }
 
-bool StackExporter::WriteImage(unsigned char* pData,
+bool StackExporter::WriteImage(const unsigned char* pData,
                                const std::string& strFilename,
                                const UINT64VECTOR2& vSize,
                                uint64_t iComponentCount) {
@@ -74,32 +78,28 @@ bool StackExporter::WriteImage(unsigned char* pData,
   if (SysTools::ToLowerCase(SysTools::GetExt(strFilename)) == "raw") {
     LargeRAWFile out(strFilename); 
     if (!out.Create()) return false;
-    out.WriteRAW(pData, vSize.area()*iComponentCount);
+    const size_t iSize = size_t(vSize.area()*iComponentCount);
+    const bool bWritten = out.WriteRAW(pData, iSize) == iSize;
     out.Close();
+    return bWritten;
   }
 
 #ifndef TUVOK_NO_QT
   QImage qTargetFile(QSize(int(vSize.x), int(vSize.y)), iComponentCount == 4 ? QImage::Format_ARGB32 : QImage::Format_RGB32);
 
   size_t i = 0;
-  if (iComponentCount == 4) {
-    for (int y = 0;y<int(vSize.y);y++) {
+  for (int y = 0;y<int(vSize.y);y++) {
+    QRgb* pScanline = reinterpret_cast<QRgb*>(qTargetFile.scanLine(y));
+    if (iComponentCount == 4) {
       for (int x = 0;x<int(vSize.x);x++) {
-        qTargetFile.setPixel(x,y,
-                              qRgba(int(pData[i+0]),
-                                    int(pData[i+1]),
-                                    int(pData[i+2]),
-                                    int(pData[i+3])));
+        pScanline[x] = qRgba(int(pData[i+0]), int(pData[i+1]),
+                             int(pData[i+2]), int(pData[i+3]));
         i+=4;
       }
-    }
-  } else {
-    for (int y = 0;y<int(vSize.y);y++) {
+    } else {
       for (int x = 0;x<int(vSize.x);x++) {
-        qTargetFile.setPixel(x,y,
-                              qRgb(int(pData[i+0]),
-                                    int(pData[i+1]),
-                                    int(pData[i+2])));
+        pScanline[x] = qRgb(int(pData[i+0]), int(pData[i+1]),
+                            int(pData[i+2]));
         i+=3;
       }
     }
@@ -112,65 +112,113 @@ bool StackExporter::WriteImage(unsigned char* pData,
 
 }
 
+std::vector<uint32_t> StackExporter::BuildLUT(const TransferFunction1D* pTrans,
+                                              uint64_t iBitWidth,
+                                              float fRescale) {
+  const size_t iTFSize = pTrans->GetSize();
+  std::vector<uint32_t> vColors(iTFSize);
+  for (size_t i = 0;i<iTFSize;++i) {
+    const FLOATVECTOR4 fvColor = pTrans->GetColor(i);
+    const unsigned char rgba[4] = {
+      (unsigned char)(fvColor.x*255), (unsigned char)(fvColor.y*255),
+      (unsigned char)(fvColor.z*255), (unsigned char)(fvColor.w*255)
+    };
+    std::memcpy(&vColors[i], rgba, 4);
+  }
+  // 32bit values are too many to tabulate; those rescale per voxel.
+  if (iBitWidth != 8 && iBitWidth != 16) return vColors;
+
+  std::vector<uint32_t> vLUT(size_t(1) << iBitWidth);
+  for (size_t v = 0;v<vLUT.size();++v) {
+    vLUT[v] = vColors[std::min(size_t(v*fRescale), iTFSize-1)];
+  }
+  return vLUT;
+}
 
-bool StackExporter::WriteSlice(unsigned char* pData,
-                               const TransferFunction1D* pTrans,
+bool StackExporter::WriteSlice(const unsigned char* pData,
+                               const std::vector<uint32_t>& vLUT,
                                uint64_t iBitWidth,
-                               const std::string& strCurrentDiFilename,
+                               const std::string& strFilename,
                                const UINT64VECTOR2& vSize,
                                float fRescale,
-                               uint64_t iComponentCount) {
-    size_t iImageCompCount = (iComponentCount == 3 || iComponentCount == 2) ? 3 : 4;
-
-    using namespace boost; // for uintXX_t types.
-    switch (iComponentCount)  {
-      case 1 : switch (iBitWidth)  {
-                case 8 : ApplyTFInplace(pData, vSize, fRescale, pTrans); break;
-                case 16 : ApplyTFInplace(reinterpret_cast<uint16_t*>(pData),
-                                         vSize, fRescale, pTrans); break;
-                case 32 : ApplyTFInplace(reinterpret_cast<uint32_t*>(pData),
-                                         vSize, fRescale, pTrans); break;
-                default : return false; 
-              }
-              break;
-      case 2 : PadInplace(pData, vSize, 3, 1, 0); break;
-      default : break; // all other cases (RGB & RGBA) are written as they are
-    }
-
-    // write data to disk
-    std::string strCurrentTargetFilename = SysTools::FindNextSequenceName(strCurrentDiFilename);
-
-    return WriteImage(pData,strCurrentTargetFilename, vSize, iImageCompCount);
+                               uint64_t iComponentCount,
+                               std::vector<uint32_t>& vImage) {
+  const size_t iCount = size_t(vSize.area());
+  vImage.resize(iCount);
+  unsigned char* pImage = reinterpret_cast<unsigned char*>(&vImage[0]);
+
+  using namespace boost; // for uintXX_t types.
+  switch (iComponentCount)  {
+    case 1 : switch (iBitWidth)  {
+              case 8 : ApplyLUT(pData, iCount, &vLUT[0], &vImage[0]); break;
+              case 16 : ApplyLUT(reinterpret_cast<const uint16_t*>(pData),
+                                 iCount, &vLUT[0], &vImage[0]); break;
+              case 32 : ApplyLUT(reinterpret_cast<const uint32_t*>(pData),
+                                 iCount, &vLUT[0], vLUT.size(), fRescale,
+                                 &vImage[0]); break;
+              default : return false; 
+            }
+            return WriteImage(pImage, strFilename, vSize, 4);
+    case 2 : Pad(pData, iCount, 2, 1, 0, pImage);
+             return WriteImage(pImage, strFilename, vSize, 3);
+    // all other cases (RGB & RGBA) are written as they are
+    default : return WriteImage(pData, strFilename, vSize, iComponentCount);
+  }
 }
 
 
-void StackExporter::PadInplace(unsigned char* pData,
-                               UINT64VECTOR2 vSize,
-                               unsigned int iStepping,
-                               unsigned int iPadcount,
-                               unsigned char iValue) {
-  assert(iStepping > iPadcount) ;
-
-  for (size_t i = 0;i<vSize.area();++i) {
-     size_t sourcePos = (iStepping - iPadcount) * (vSize.area()-(i+1));
-     size_t targetPos = iStepping * (vSize.area()-(i+1));
-
-     for (unsigned int j = 0;j<iStepping;++j) {
-
-       if ( j < iStepping - iPadcount)
-         pData[targetPos] = pData[sourcePos];
-       else
-         pData[targetPos] = iValue;
-
-       targetPos++;
-       sourcePos++;
-     }
-     
+void StackExporter::Pad(const unsigned char* pData,
+                        size_t iCount,
+                        unsigned int iComponents,
+                        unsigned int iPadcount,
+                        unsigned char iValue,
+                        unsigned char* pTarget) {
+  for (size_t i = 0;i<iCount;++i) {
+    for (unsigned int j = 0;j<iComponents;++j) *pTarget++ = *pData++;
+    for (unsigned int j = 0;j<iPadcount;++j) *pTarget++ = iValue;
   }
-
-
 }
 
+namespace {
+  /// One axis of the volume, seen as a stack of slices.  Slabs of
+  /// consecutive slices are read at once; within a slab, element (row, col)
+  /// of slice k is at k*iSliceStride + row*iRowStride + col*iColStride.
+  struct StackLayout {
+    std::string strName;
+    std::string strTag;
+    uint64_t iSlices;
+    UINT64VECTOR2 vSize;
+    /// reads the slab of 'n' slices starting at 'iFirst'
+    std::function<bool (uint64_t iFirst, uint64_t n, unsigned char*)> read;
+    /// strides of a slab of 'n' slices, in elements
+    std::function<UINT64VECTOR3 (uint64_t n)> strides;
+  };
+
+  /// Gives the images of a stack consecutive names, starting where
+  /// FindNextSequenceName does.  The images are written concurrently, so
+  /// asking for the next free name per image would hand out duplicates.
+  class SequenceNames {
+  public:
+    explicit SequenceNames(const std::string& strFilename)
+      : m_strExt(SysTools::GetExt(strFilename))
+      , m_iFirst(1)
+    {
+      const std::string strFirst = SysTools::RemoveExt(
+        SysTools::FindNextSequenceName(strFilename)
+      );
+      const size_t iSep = strFirst.find_last_of('_');
+      m_strPrefix = strFirst.substr(0, iSep+1);
+      SysTools::FromString(m_iFirst, strFirst.substr(iSep+1));
+    }
+    std::string operator()(uint64_t i) const {
+      return m_strPrefix + SysTools::ToString(m_iFirst+i) + "." + m_strExt;
+    }
+  private:
+    std::string m_strPrefix;
+    std::string m_strExt;
+    uint64_t m_iFirst;
+  };
+}
 
 bool StackExporter::WriteStacks(const std::string& strRAWFilename, 
                                 const std::string& strTargetFilename,
@@ -179,13 +227,14 @@ bool StackExporter::WriteStacks(const std::string& strRAWFilename,
                                 uint64_t iComponentCount,
                                 float fRescale,
                                 UINT64VECTOR3 vDomainSize,
-                                bool bAllDirs) {
+                                bool bAllDirs,
+                                uint64_t iMemBudget) {
   if (iComponentCount > 4)  {
     T_ERROR("Invalid channel count, no more than four components are accepted by the stack exporter.");
     return false;
   }
   
-  size_t iDataByteWith = size_t(iBitWidth/8);
+  const size_t iDataByteWith = size_t(iBitWidth/8);
 
   // convert to 8bit for more than 1 comp data
   if (iBitWidth != 8 && iComponentCount > 1) {
@@ -202,78 +251,142 @@ bool StackExporter::WriteStacks(const std::string& strRAWFilename,
 */
   }
 
+  std::vector<uint32_t> vLUT;
+  if (iComponentCount == 1) {
+    if (iBitWidth != 8 && iBitWidth != 16 && iBitWidth != 32) {
+      T_ERROR("Invalid bit depth, only 8, 16 and 32bit scalar data is accepted by the stack exporter.");
+      return false;
+    }
+    if (!pTrans || pTrans->GetSize() == 0) {
+      T_ERROR("Scalar data needs a transfer function to be exported as images.");
+      return false;
+    }
+    vLUT = BuildLUT(pTrans, iBitWidth, fRescale);
+  }
 
   LargeRAWFile dataSource(strRAWFilename);
   if (!dataSource.Open()) return false;
 
-  size_t iMaxPair = size_t((vDomainSize.x <= vDomainSize.y && vDomainSize.x <= vDomainSize.z) ? vDomainSize.z * vDomainSize.y : (
-                           (vDomainSize.y <= vDomainSize.x && vDomainSize.y <= vDomainSize.z) ? vDomainSize.x * vDomainSize.z : vDomainSize.x * vDomainSize.y));
-
-
-  std::shared_ptr<unsigned char> data(
-    new unsigned char[4*iMaxPair*iDataByteWith],
-    nonstd::DeleteArray<unsigned char>()
-  );
-
-  UINT64VECTOR2 vSize(vDomainSize.z, vDomainSize.y);
-  std::string strCurrentDirTargetFilename = SysTools::AppendFilename(strTargetFilename, "_x");
-  size_t elemSize = iComponentCount*iDataByteWith;
+  const uint64_t elemSize = iComponentCount*iDataByteWith;
+  const UINT64VECTOR3& d = vDomainSize;
+  std::vector<StackLayout> stacks;
 
   if (bAllDirs)  {
-    for (uint64_t x = 0;x<vDomainSize.x;x++) {
-      MESSAGE("Exporting X-Axis Stack. Processing Image %llu of %llu", x+1, vDomainSize.x);
-
-      uint64_t offset = 0;
-      for (uint64_t v = 0;v<vDomainSize.y;v++) {
-        for (uint64_t u = 0;u<vDomainSize.z;u++) {
-          dataSource.SeekPos(elemSize * (x+u*vDomainSize.x*vDomainSize.y+v*vDomainSize.x) );
-          dataSource.ReadRAW(data.get()+offset, elemSize);
-          offset += elemSize;
+    // slice x is (y, z); a slab holds runs of n voxels along x.
+    StackLayout x;
+    x.strName = "X";
+    x.strTag = "_x";
+    x.iSlices = d.x;
+    x.vSize = UINT64VECTOR2(d.z, d.y);
+    x.read = [&](uint64_t iFirst, uint64_t n, unsigned char* pSlab) {
+      for (uint64_t v = 0;v<d.y;v++) {
+        for (uint64_t u = 0;u<d.z;u++) {
+          dataSource.SeekPos(elemSize * (iFirst+u*d.x*d.y+v*d.x));
+          if (dataSource.ReadRAW(pSlab, n*elemSize) != n*elemSize) return false;
+          pSlab += n*elemSize;
         }
       }
-
-      if (!WriteSlice(data.get(), pTrans, iBitWidth, strCurrentDirTargetFilename, vSize, fRescale, iComponentCount)) {
-        T_ERROR("Unable to write stack image %llu.",x);
-        dataSource.Close();
-        return false;
-      }
-    }
-
-    vSize = UINT64VECTOR2(vDomainSize.x, vDomainSize.z);
-    strCurrentDirTargetFilename = SysTools::AppendFilename(strTargetFilename, "_y");
-    for (uint64_t y = 0;y<vDomainSize.y;y++) {
-      MESSAGE("Exporting Y-Axis Stack. Processing Image %llu of %llu", y+1, vDomainSize.y);
-
-      uint64_t offset = 0;
-      for (uint64_t u = 0;u<vDomainSize.z;u++) {
-        dataSource.SeekPos(elemSize * (y*vDomainSize.x+u*vDomainSize.x*vDomainSize.y) );
-        dataSource.ReadRAW(data.get()+offset, vDomainSize.x*elemSize);
-        offset += vDomainSize.x*elemSize;
+      return true;
+    };
+    x.strides = [&](uint64_t n) { return UINT64VECTOR3(1, d.z*n, n); };
+    stacks.push_back(x);
+
+    // slice y is (x, z); a slab holds n scanlines per z.
+    StackLayout y;
+    y.strName = "Y";
+    y.strTag = "_y";
+    y.iSlices = d.y;
+    y.vSize = UINT64VECTOR2(d.x, d.z);
+    y.read = [&](uint64_t iFirst, uint64_t n, unsigned char* pSlab) {
+      for (uint64_t u = 0;u<d.z;u++) {
+        dataSource.SeekPos(elemSize * (iFirst*d.x+u*d.x*d.y));
+        if (dataSource.ReadRAW(pSlab, n*d.x*elemSize) != n*d.x*elemSize) return false;
+        pSlab += n*d.x*elemSize;
       }
+      return true;
+    };
+    y.strides = [&](uint64_t n) { return UINT64VECTOR3(d.x, d.x*n, 1); };
+    stacks.push_back(y);
+  }
 
-      if (!WriteSlice(data.get(), pTrans, iBitWidth, strCurrentDirTargetFilename, vSize, fRescale, iComponentCount)) {
-        T_ERROR("Unable to write stack image %llu.",y);
+  // z slices are contiguous in the file.
+  StackLayout z;
+  z.strName = "Z";
+  z.strTag = "_z";
+  z.iSlices = d.z;
+  z.vSize = UINT64VECTOR2(d.x, d.y);
+  z.read = [&](uint64_t iFirst, uint64_t n, unsigned char* pSlab) {
+    dataSource.SeekPos(elemSize * iFirst*d.x*d.y);
+    return dataSource.ReadRAW(pSlab, n*d.x*d.y*elemSize) == n*d.x*d.y*elemSize;
+  };
+  z.strides = [&](uint64_t) { return UINT64VECTOR3(d.x*d.y, d.x, 1); };
+  stacks.push_back(z);
+
+  for (std::vector<StackLayout>::const_iterator stack = stacks.begin();
+       stack != stacks.end(); ++stack) {
+    const std::string strFilename = bAllDirs
+      ? SysTools::AppendFilename(strTargetFilename, stack->strTag)
+      : strTargetFilename;
+    const SequenceNames names(strFilename);
+
+    // per slice in flight: its share of the slab, a copy in image order and
+    // the converted image.
+    const uint64_t iSliceSize = stack->vSize.area()*elemSize;
+    const uint64_t iSlabSlices = std::min<uint64_t>(
+      stack->iSlices,
+      tuvok::StackSlicesInFlight(2*iSliceSize + 4*stack->vSize.area(),
+                                 iMemBudget)
+    );
+    std::vector<unsigned char> vSlab(size_t(iSlabSlices*iSliceSize));
+    std::vector<std::vector<unsigned char>> vSlices((size_t(iSlabSlices)));
+    std::vector<std::vector<uint32_t>> vImages((size_t(iSlabSlices)));
+
+    for (uint64_t first = 0;first<stack->iSlices;first+=iSlabSlices) {
+      const uint64_t n = std::min(iSlabSlices, stack->iSlices-first);
+      MESSAGE("Exporting %s-Axis Stack. Processing Images %llu to %llu of %llu",
+              stack->strName.c_str(), first+1, first+n, stack->iSlices);
+
+      if (!stack->read(first, n, &vSlab[0])) {
+        T_ERROR("Unable to read slices %llu to %llu from %s.", first, first+n-1,
+                strRAWFilename.c_str());
         dataSource.Close();
         return false;
       }
-    }
-
-    dataSource.SeekPos(0);
-    strCurrentDirTargetFilename = SysTools::AppendFilename(strTargetFilename, "_z");
-  } else {
-    strCurrentDirTargetFilename = strTargetFilename;
-  }
-
-  vSize = UINT64VECTOR2(vDomainSize.x, vDomainSize.y);
-  for (uint64_t z = 0;z<vDomainSize.z;z++) {
-    MESSAGE("Exporting Z-Axis Stack. Processing Image %llu of %llu", z+1, vDomainSize.z);
 
-    dataSource.ReadRAW(data.get(), vDomainSize.x*vDomainSize.y*elemSize);
-
-    if (!WriteSlice(data.get(), pTrans, iBitWidth, strCurrentDirTargetFilename, vSize, fRescale, iComponentCount)) {
-      T_ERROR("Unable to write stack image %llu.",z);
-      dataSource.Close();
-      return false;
+      const UINT64VECTOR3 vStrides = stack->strides(n);
+      const UINT64VECTOR2 vSize = stack->vSize;
+      std::vector<char> ok(size_t(n), 0);
+      tuvok::Controller::Instance().Scheduler().ParallelFor(0, size_t(n), 1,
+        [&](size_t iBegin, size_t iEnd) {
+          for (size_t i = iBegin;i<iEnd;++i) {
+            const unsigned char* pSlice = &vSlab[0] + i*vStrides.x*elemSize;
+            // only the z stack is stored in image order already
+            if (vStrides.y != vSize.x || vStrides.z != 1) {
+              std::vector<unsigned char>& slice = vSlices[i];
+              slice.resize(size_t(iSliceSize));
+              unsigned char* pTarget = &slice[0];
+              for (uint64_t row = 0;row<vSize.y;row++) {
+                for (uint64_t col = 0;col<vSize.x;col++) {
+                  std::memcpy(pTarget,
+                              pSlice + (row*vStrides.y+col*vStrides.z)*elemSize,
+                              size_t(elemSize));
+                  pTarget += elemSize;
+                }
+              }
+              pSlice = &slice[0];
+            }
+            ok[i] = WriteSlice(pSlice, vLUT, iBitWidth, names(first+i), vSize,
+                               fRescale, iComponentCount, vImages[i]) ? 1 : 0;
+          }
+        });
+
+      for (uint64_t i = 0;i<n;i++) {
+        if (!ok[size_t(i)]) {
+          T_ERROR("Unable to write stack image %llu.", first+i);
+          dataSource.Close();
+          return false;
+        }
+      }
     }
   }
 
@@ -37,6 +37,7 @@
 #ifndef STACKEXPORTER_H
 #define STACKEXPORTER_H
 
+#include <algorithm>
 #include <vector>
 #include <string>
 
@@ -50,6 +51,10 @@ public:
 
   static std::vector<std::pair<std::string,std::string>> GetSuportedImageFormats();
 
+  /// Writes the slices of a RAW volume as images.  Slabs of consecutive
+  /// slices are read serially; the slices of a slab are coloured, encoded
+  /// and written concurrently.  'iMemBudget' bounds the memory spent on
+  /// slices in flight.
   static bool WriteStacks(const std::string& strRAWFilename, 
                           const std::string& strTargetFilename,
                           const TransferFunction1D* pTrans,
@@ -57,51 +62,58 @@ public:
                           uint64_t iComponentCount,
                           float fRescale,
                           UINT64VECTOR3 vDomainSize,
-                          bool bAllDirs);
+                          bool bAllDirs,
+                          uint64_t iMemBudget);
 
-  static bool WriteImage(unsigned char* pData,
+  static bool WriteImage(const unsigned char* pData,
                   const std::string& strTargetFilename,
                   const UINT64VECTOR2& vSize,
                   uint64_t iComponentCount);
 protected:
-  template<typename T> static void ApplyTFInplace(T* pData,
-                             UINT64VECTOR2 vSize,
-                             float fRescale,
-                             const TransferFunction1D* pTrans) {
-
-     unsigned char* pCharInterpOfData = (unsigned char*)pData;
-
-     for (size_t i = 0;i<vSize.area();++i) {
-      size_t sourcePos = size_t(vSize.area()-(i+1));
-      size_t targetPos = 4 * sourcePos;
-
-      size_t lookupVal = std::min(size_t(pData[sourcePos]*fRescale),
-                                  pTrans->GetSize()-1);
-      FLOATVECTOR4 fvColor = pTrans->GetColor(lookupVal);
-
-      pCharInterpOfData[targetPos+0] = (unsigned char)(fvColor.x*255);
-      pCharInterpOfData[targetPos+1] = (unsigned char)(fvColor.y*255);
-      pCharInterpOfData[targetPos+2] = (unsigned char)(fvColor.z*255);
-      pCharInterpOfData[targetPos+3] = (unsigned char)(fvColor.w*255);
+  /// Colours of the transfer function as 8bit RGBA, one uint32_t per entry.
+  /// For 8 and 16 bit data the table is indexed by the data value (i.e. the
+  /// rescale is already applied), otherwise by the transfer function index.
+  static std::vector<uint32_t> BuildLUT(const TransferFunction1D* pTrans,
+                                        uint64_t iBitWidth,
+                                        float fRescale);
+
+  template<typename T> static void ApplyLUT(const T* pData,
+                                            size_t iCount,
+                                            const uint32_t* pLUT,
+                                            uint32_t* pTarget) {
+    // a plain gather, which the compiler vectorizes where the ISA has one
+    for (size_t i = 0;i<iCount;++i) {
+      pTarget[i] = pLUT[pData[i]];
     }
+  }
 
+  static void ApplyLUT(const uint32_t* pData,
+                       size_t iCount,
+                       const uint32_t* pLUT,
+                       size_t iLUTSize,
+                       float fRescale,
+                       uint32_t* pTarget) {
+    for (size_t i = 0;i<iCount;++i) {
+      pTarget[i] = pLUT[std::min(size_t(pData[i]*fRescale), iLUTSize-1)];
+    }
   }
 
-  static void PadInplace(unsigned char* pData,
-                  UINT64VECTOR2 vSize,
-                  unsigned int iStepping,
+  static void Pad(const unsigned char* pData,
+                  size_t iCount,
+                  unsigned int iComponents,
                   unsigned int iPadcount,
-                  unsigned char iValue);
-
-  static bool WriteSlice(unsigned char* pData,
-                  const TransferFunction1D* pTrans,
-                  uint64_t iBitWidth,
-                  const std::string& strCurrentDiFilename,
-                  const UINT64VECTOR2& vSize,
-                  float fRescale,
-                  uint64_t iComponentCount);
-
-
+                  unsigned char iValue,
+                  unsigned char* pTarget);
+
+  /// Converts one slice to an image (if necessary) and writes it.
+  static bool WriteSlice(const unsigned char* pData,
+                         const std::vector<uint32_t>& vLUT,
+                         uint64_t iBitWidth,
+                         const std::string& strFilename,
+                         const UINT64VECTOR2& vSize,
+                         float fRescale,
+                         uint64_t iComponentCount,
+                         std::vector<uint32_t>& vImage);
 };
 
 #endif // STACKEXPORTER_H
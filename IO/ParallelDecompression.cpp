@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include "3rdParty/bzip2/bzlib.h"
+#include "3rdParty/zlib/zlib.h"
+
+#include "ParallelDecompression.h"
+#include "Controller/Controller.h"
+#include "Basics/TaskScheduler.h"
+
+namespace tuvok {
+
+namespace {
+  int64_t ftell64(FILE* f) {
+#ifdef _WIN32
+    return _ftelli64(f);
+#else
+    return static_cast<int64_t>(ftello(f));
+#endif
+  }
+  bool fseek64(FILE* f, int64_t pos) {
+#ifdef _WIN32
+    return _fseeki64(f, pos, SEEK_SET) == 0;
+#else
+    return fseeko(f, static_cast<off_t>(pos), SEEK_SET) == 0;
+#endif
+  }
+
+  /// appends up to 'iWindow' - buf.size() bytes from 'in' to 'buf'.
+  /// @returns true if the end of the file was reached.
+  bool fill(FILE* in, std::vector<unsigned char>& buf, size_t iWindow) {
+    const size_t have = buf.size();
+    if(have >= iWindow) { return feof(in) != 0; }
+    buf.resize(iWindow);
+    const size_t got = fread(&buf[have], 1, iWindow-have, in);
+    buf.resize(have+got);
+    return got < iWindow-have;
+  }
+
+  bool write_all(FILE* out, const std::vector<char>& data) {
+    if(data.empty()) { return true; }
+    return fwrite(&data[0], 1, data.size(), out) == data.size();
+  }
+
+  /// the scheduler's workers plus the calling thread.
+  size_t thread_count() {
+    return Controller::Instance().Scheduler().GetThreadCount() + 1;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// bzip2
+// ---------------------------------------------------------------------------
+namespace {
+  const uint64_t BZ_BLOCK_MAGIC = 0x314159265359ULL;
+  const uint64_t BZ_EOS_MAGIC   = 0x177245385090ULL;
+  const uint64_t BZ_MAGIC_MASK  = 0xFFFFFFFFFFFFULL;
+  /// the most a block can decode to: 900k bytes of run length encoded
+  /// input, where every 5 bytes may stand for a run of 255.
+  const size_t BZ_MAX_BLOCK_OUT = 900000 / 5 * 255;
+
+  struct BZMagic {
+    uint64_t bit;  ///< position of the first bit of the magic number
+    bool eos;      ///< end-of-stream (true) or start-of-block (false) marker
+  };
+
+  /// bzip2 writes bits MSB first.
+  unsigned get_bit(const std::vector<unsigned char>& buf, uint64_t pos) {
+    return (buf[size_t(pos/8)] >> (7 - pos%8)) & 1;
+  }
+  uint32_t get_bits32(const std::vector<unsigned char>& buf, uint64_t pos) {
+    uint32_t v = 0;
+    for(unsigned i=0; i < 32; ++i) { v = (v << 1) | get_bit(buf, pos+i); }
+    return v;
+  }
+
+  std::vector<BZMagic> find_magics(const std::vector<unsigned char>& buf) {
+    std::vector<BZMagic> magics;
+    uint64_t reg = 0;
+    uint64_t bit = 0;
+    for(size_t i=0; i < buf.size(); ++i) {
+      for(int b=7; b >= 0; --b, ++bit) {
+        reg = ((reg << 1) | ((buf[i] >> b) & 1)) & BZ_MAGIC_MASK;
+        if(bit < 47) { continue; }
+        if(reg == BZ_BLOCK_MAGIC || reg == BZ_EOS_MAGIC) {
+          BZMagic m = { bit-47, reg == BZ_EOS_MAGIC };
+          magics.push_back(m);
+        }
+      }
+    }
+    return magics;
+  }
+
+  struct BitWriter {
+    BitWriter() : acc(0), n(0) {}
+    void put(unsigned b) {
+      acc = (acc << 1) | (b & 1);
+      if(++n == 8) { data.push_back(char(acc)); acc = 0; n = 0; }
+    }
+    void put(uint64_t v, unsigned bits) {
+      while(bits-- > 0) { put(unsigned((v >> bits) & 1)); }
+    }
+    void flush() { while(n != 0) { put(0u); } }
+
+    std::vector<char> data;
+  private:
+    unsigned acc;
+    unsigned n;
+  };
+
+  /// wraps the block in bits [begin, end) into a standalone bzip2 stream.  A
+  /// stream with a single block has that block's CRC as its combined CRC.
+  std::vector<char> single_block_stream(const std::vector<unsigned char>& buf,
+                                        uint64_t begin, uint64_t end) {
+    BitWriter w;
+    w.data.reserve(size_t((end-begin)/8 + 16));
+    // always claim 900k blocks; decoding smaller blocks with it is fine.
+    w.put(uint64_t('B'), 8); w.put(uint64_t('Z'), 8);
+    w.put(uint64_t('h'), 8); w.put(uint64_t('9'), 8);
+    // the writer is byte aligned here, so copy whole (shifted) bytes first.
+    const unsigned shift = unsigned(begin % 8);
+    const uint64_t iBytes = (end-begin) / 8;
+    const size_t first = size_t(begin / 8);
+    for(uint64_t i=0; i < iBytes; ++i) {
+      unsigned v = unsigned(buf[first+size_t(i)]) << shift;
+      if(shift) { v |= buf[first+size_t(i)+1] >> (8-shift); }
+      w.data.push_back(char(v & 0xFF));
+    }
+    for(uint64_t b=begin+iBytes*8; b < end; ++b) { w.put(get_bit(buf, b)); }
+    w.put(BZ_EOS_MAGIC, 48);
+    w.put(uint64_t(get_bits32(buf, begin+48)), 32);
+    w.flush();
+    return w.data;
+  }
+
+  bool bz_decode(std::vector<char>& stream, std::vector<char>& out) {
+    bz_stream bz;
+    std::memset(&bz, 0, sizeof(bz_stream));
+    if(BZ2_bzDecompressInit(&bz, 0, 0) != BZ_OK) { return false; }
+    bz.next_in = &stream[0];
+    bz.avail_in = static_cast<unsigned>(stream.size());
+    out.resize(1024*1024);
+    size_t produced = 0;
+    int rv;
+    do {
+      if(produced == out.size()) {
+        // more than a block can hold: the data are broken.
+        if(out.size() >= BZ_MAX_BLOCK_OUT) { rv = BZ_DATA_ERROR; break; }
+        out.resize(std::min(BZ_MAX_BLOCK_OUT, out.size()*2));
+      }
+      bz.next_out = &out[produced];
+      bz.avail_out = static_cast<unsigned>(out.size() - produced);
+      rv = BZ2_bzDecompress(&bz);
+      produced = out.size() - bz.avail_out;
+    } while(rv == BZ_OK && (bz.avail_in > 0 || bz.avail_out == 0));
+    BZ2_bzDecompressEnd(&bz);
+    out.resize(produced);
+    return rv == BZ_STREAM_END;
+  }
+}
+
+bool ParallelBZip2Decompress(FILE* in, FILE* out, size_t iInCoreSize) {
+  // a compressed block is at most ~1MB; make sure a window holds several.
+  const size_t iWindow = std::max<size_t>(iInCoreSize, 16*1024*1024);
+  std::vector<unsigned char> buf;
+  buf.reserve(iWindow);
+  // blocks are decoded a batch at a time, so that the decoded data held at
+  // once stays within iInCoreSize (or a single block, if that is larger).
+  const size_t iBatch = std::max<size_t>(1,
+    std::min(2*thread_count(), iInCoreSize / BZ_MAX_BLOCK_OUT)
+  );
+
+  bool bEOF = false;
+  bool bSeenHeader = false;
+  uint64_t iBlocks = 0;
+  do {
+    bEOF = fill(in, buf, iWindow);
+    if(!bSeenHeader) {
+      if(buf.size() < 4 || buf[0] != 'B' || buf[1] != 'Z' || buf[2] != 'h') {
+        T_ERROR("Not a bzip2 stream.");
+        return false;
+      }
+      bSeenHeader = true;
+    }
+
+    const std::vector<BZMagic> magics = find_magics(buf);
+    // every block runs until the next magic number, block or end-of-stream.
+    std::vector<std::pair<uint64_t,uint64_t>> blocks;
+    for(size_t m=0; m+1 < magics.size(); ++m) {
+      if(!magics[m].eos) {
+        blocks.push_back(std::make_pair(magics[m].bit, magics[m+1].bit));
+      }
+    }
+    if(blocks.empty() && !bEOF && buf.size() >= iWindow) {
+      T_ERROR("No complete bzip2 block within %llu bytes.",
+              static_cast<unsigned long long>(iWindow));
+      return false;
+    }
+
+    std::vector<std::vector<char>> decoded(iBatch);
+    for(size_t iFirst=0; iFirst < blocks.size(); iFirst += iBatch) {
+      const size_t n = std::min(iBatch, blocks.size()-iFirst);
+      std::atomic<int> iFailed(0);
+      Controller::Instance().Scheduler().ParallelFor(0, n, 1,
+        [&](size_t iBegin, size_t iEnd) {
+          for(size_t b=iBegin; b < iEnd; ++b) {
+            std::vector<char> stream = single_block_stream(buf,
+              blocks[iFirst+b].first, blocks[iFirst+b].second);
+            if(!bz_decode(stream, decoded[b])) { ++iFailed; }
+          }
+        });
+      if(iFailed > 0) {
+        WARNING("%d bzip2 blocks failed to decode independently.",
+                iFailed.load());
+        return false;
+      }
+      for(size_t b=0; b < n; ++b) {
+        if(!write_all(out, decoded[b])) {
+          T_ERROR("Write of decompressed bzip2 data failed.");
+          return false;
+        }
+      }
+    }
+    iBlocks += blocks.size();
+
+    // keep everything from the last (incomplete) magic onwards.
+    if(magics.empty()) {
+      if(bEOF) { break; }
+      // only keep the tail which might hold the beginning of a magic.
+      buf.erase(buf.begin(), buf.end() - std::min<size_t>(buf.size(), 8));
+    } else {
+      const BZMagic& last = magics.back();
+      if(bEOF) {
+        if(last.eos) { break; }
+        T_ERROR("bzip2 stream is truncated.");
+        return false;
+      }
+      buf.erase(buf.begin(), buf.begin() + size_t(last.bit/8));
+    }
+    MESSAGE("Decompressed %llu bzip2 blocks.",
+            static_cast<unsigned long long>(iBlocks));
+  } while(!bEOF || !buf.empty());
+
+  return iBlocks > 0;
+}
+
+// ---------------------------------------------------------------------------
+// gzip
+// ---------------------------------------------------------------------------
+namespace {
+  enum MemberStatus { MS_DONE, MS_TRUNCATED, MS_ERROR };
+
+  bool gz_signature(const std::vector<unsigned char>& buf, size_t p) {
+    return p+3 < buf.size() && buf[p] == 0x1f && buf[p+1] == 0x8b &&
+           buf[p+2] == Z_DEFLATED && (buf[p+3] & 0xE0) == 0;
+  }
+
+  /// inflates the gzip member starting at 'data'.  zlib parses the header
+  /// and verifies the trailer CRC and length for us.
+  MemberStatus inflate_member(const unsigned char* data, size_t avail,
+                              size_t iMaxOut, std::vector<char>& out,
+                              size_t& consumed) {
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(z_stream));
+    if(inflateInit2(&strm, 16+MAX_WBITS) != Z_OK) { return MS_ERROR; }
+    strm.next_in = const_cast<Bytef*>(data);
+    strm.avail_in = static_cast<uInt>(avail);
+    out.resize(std::min<size_t>(iMaxOut, 1024*1024));
+    size_t produced = 0;
+    int rv;
+    do {
+      if(produced == out.size()) {
+        if(out.size() >= iMaxOut) { rv = Z_BUF_ERROR; break; }
+        out.resize(std::min(iMaxOut, out.size()*2));
+      }
+      strm.next_out = reinterpret_cast<Bytef*>(&out[produced]);
+      strm.avail_out = static_cast<uInt>(out.size() - produced);
+      rv = inflate(&strm, Z_NO_FLUSH);
+      produced = out.size() - strm.avail_out;
+    } while(rv == Z_OK);
+    consumed = static_cast<size_t>(strm.total_in);
+    inflateEnd(&strm);
+    out.resize(produced);
+    if(rv == Z_STREAM_END) { return MS_DONE; }
+    if(rv == Z_BUF_ERROR) { return MS_TRUNCATED; }
+    return MS_ERROR;
+  }
+
+  /// inflates a single member straight from the file into 'out', for members
+  /// which do not fit into our window.  Leaves 'in' just past the member.
+  bool inflate_member_serial(FILE* in, FILE* out) {
+    const int64_t iStart = ftell64(in);
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(z_stream));
+    if(inflateInit2(&strm, 16+MAX_WBITS) != Z_OK) { return false; }
+    const size_t CHUNK = 16*1024*1024;
+    std::vector<unsigned char> inbuf(CHUNK);
+    std::vector<char> outbuf(CHUNK);
+    int rv = Z_OK;
+    do {
+      strm.avail_in = static_cast<uInt>(fread(&inbuf[0], 1, CHUNK, in));
+      if(strm.avail_in == 0) { break; }
+      strm.next_in = &inbuf[0];
+      do {
+        strm.next_out = reinterpret_cast<Bytef*>(&outbuf[0]);
+        strm.avail_out = static_cast<uInt>(CHUNK);
+        rv = inflate(&strm, Z_NO_FLUSH);
+        if(rv != Z_OK && rv != Z_STREAM_END) {
+          inflateEnd(&strm);
+          return false;
+        }
+        const size_t have = CHUNK - strm.avail_out;
+        if(fwrite(&outbuf[0], 1, have, out) != have) {
+          inflateEnd(&strm);
+          return false;
+        }
+      } while(strm.avail_out == 0 && rv != Z_STREAM_END);
+    } while(rv != Z_STREAM_END);
+    const int64_t iEnd = iStart + static_cast<int64_t>(strm.total_in);
+    inflateEnd(&strm);
+    return rv == Z_STREAM_END && fseek64(in, iEnd);
+  }
+}
+
+bool ParallelGZipDecompress(FILE* in, FILE* out, size_t iInCoreSize) {
+  const size_t iWindow = std::max<size_t>(iInCoreSize / 8, 4*1024*1024);
+  std::vector<unsigned char> buf;
+  buf.reserve(iWindow);
+  // one candidate per thread is inflated at a time; together they may hold
+  // iInCoreSize of decoded data.
+  const size_t iBatch = thread_count();
+  const size_t iMaxOut = std::max<size_t>(iInCoreSize / iBatch, 1024*1024);
+  std::vector<std::vector<char>> decoded(iBatch);
+  std::vector<size_t> consumed(iBatch);
+  std::vector<MemberStatus> status(iBatch);
+
+  uint64_t iMembers = 0;
+  bool bEOF = false;
+  while(true) {
+    bEOF = fill(in, buf, iWindow);
+    if(buf.empty()) { break; }
+    if(!gz_signature(buf, 0)) {
+      if(bEOF && iMembers > 0) {
+        WARNING("Ignoring %llu bytes of trailing garbage after the last gzip "
+                "member.", static_cast<unsigned long long>(buf.size()));
+        break;
+      }
+      T_ERROR("Not a gzip member.");
+      return false;
+    }
+
+    std::vector<size_t> candidates;
+    for(size_t p=0; p < buf.size(); ++p) {
+      if(gz_signature(buf, p)) { candidates.push_back(p); }
+    }
+
+    // follow the chain of members which start where the last one ended,
+    // inflating the candidates from there on a batch at a time.  Those
+    // inside a member we already have are not even tried, and we stop at
+    // the first member which does not end within the window.
+    size_t iPos = 0;
+    size_t c = 0;
+    bool bChained = true;
+    MemberStatus first = MS_DONE;
+    while(bChained && c < candidates.size() && candidates[c] == iPos) {
+      const size_t n = std::min(iBatch, candidates.size()-c);
+      Controller::Instance().Scheduler().ParallelFor(0, n, 1,
+        [&](size_t iBegin, size_t iEnd) {
+          for(size_t i=iBegin; i < iEnd; ++i) {
+            status[i] = inflate_member(&buf[candidates[c+i]],
+                                       buf.size() - candidates[c+i], iMaxOut,
+                                       decoded[i], consumed[i]);
+          }
+        });
+      if(iPos == 0) { first = status[0]; }
+      for(size_t i=0; i < n && bChained; ++i) {
+        if(candidates[c+i] < iPos) { continue; }
+        if(candidates[c+i] > iPos || status[i] != MS_DONE) {
+          bChained = false;
+          break;
+        }
+        if(!write_all(out, decoded[i])) {
+          T_ERROR("Write of decompressed gzip data failed.");
+          return false;
+        }
+        ++iMembers;
+        iPos += consumed[i];
+      }
+      c += n;
+      while(c < candidates.size() && candidates[c] < iPos) { ++c; }
+    }
+
+    if(iPos == 0) {
+      // the first member did not fit into the window, or is broken.
+      if(first == MS_ERROR) {
+        T_ERROR("gzip data is invalid or incomplete.");
+        return false;
+      }
+      const int64_t iStart = ftell64(in) - static_cast<int64_t>(buf.size());
+      buf.clear();
+      if(!fseek64(in, iStart) || !inflate_member_serial(in, out)) {
+        T_ERROR("gzip data is invalid or incomplete.");
+        return false;
+      }
+      ++iMembers;
+      continue;
+    }
+    buf.erase(buf.begin(), buf.begin() + iPos);
+    if(bEOF && buf.empty()) { break; }
+    MESSAGE("Decompressed %llu gzip members.",
+            static_cast<unsigned long long>(iMembers));
+  }
+  return iMembers > 0;
+}
+
+}
@@ -0,0 +1,31 @@
+#ifndef TUVOK_PARALLEL_DECOMPRESSION_H
+#define TUVOK_PARALLEL_DECOMPRESSION_H
+
+#include <cstdio>
+
+namespace tuvok {
+
+/// Decompresses the bzip2 data in 'in', starting at its current position,
+/// into 'out'.  bzip2 blocks are self-contained, so we locate them by their
+/// magic numbers, wrap each one into its own single-block stream and decode
+/// them concurrently.  Concatenated streams (pbzip2) are handled as well.
+/// @param iInCoreSize bounds the compressed data held in memory at once, and
+/// the decoded data of the blocks decoded together.
+/// @returns false on error.  This includes the (unlikely) case that a block
+/// magic number appears inside the compressed data, so callers should fall
+/// back to a serial decoder from the original positions.
+bool ParallelBZip2Decompress(FILE* in, FILE* out, size_t iInCoreSize);
+
+/// Decompresses all members of a (possibly multi-member) gzip file, starting
+/// at the current position of 'in', into 'out'.  Members are located by
+/// their header signature and inflated concurrently, one per thread at a
+/// time, from where the last member ended; the gzip trailer CRC rejects
+/// signatures which occur by chance inside the compressed data.  Members
+/// which do not fit into the in-core window, or decode to more than their
+/// share of iInCoreSize, are inflated serially.
+/// @returns false on error; callers should fall back to a serial decoder.
+bool ParallelGZipDecompress(FILE* in, FILE* out, size_t iInCoreSize);
+
+}
+
+#endif // TUVOK_PARALLEL_DECOMPRESSION_H
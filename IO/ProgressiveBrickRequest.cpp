@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <utility>
+#include "ProgressiveBrickRequest.h"
+#include "Dataset.h"
+#include "Controller/Controller.h"
+
+namespace tuvok {
+
+ProgressiveBrickRequest::ProgressiveBrickRequest(const Dataset& ds, size_t ts,
+                                                 size_t iTargetLoD,
+                                                 const FLOATVECTOR3& vMin,
+                                                 const FLOATVECTOR3& vMax,
+                                                 BrickSink sink)
+  : m_Dataset(ds)
+  , m_Sink(sink)
+  , m_iNext(0)
+  , m_iCompletedLoD(ds.GetLODLevelCount())
+  , m_bCancelled(false)
+  , m_bDone(false)
+  , m_bComplete(false)
+  , m_bInSink(false)
+  , m_Scheduler(Controller::Instance().Scheduler())
+{
+  if(ds.GetLODLevelCount() == 0) {
+    Finish(false);
+    return;
+  }
+  iTargetLoD = std::min<size_t>(iTargetLoD, ds.GetLODLevelCount()-1);
+  // start with a single brick: it is all we can deliver right away.
+  const size_t iFirst = std::max(iTargetLoD,
+                                 ds.GetLargestSingleBrickLOD(ts));
+  for(size_t lod = iFirst+1; lod-- > iTargetLoD;) {
+    const std::vector<BrickKey> vLoD = BricksInRegion(ds, ts, lod, vMin,
+                                                      vMax);
+    m_vBricks.insert(m_vBricks.end(), vLoD.begin(), vLoD.end());
+    m_vLastOfLoD.resize(m_vBricks.size(), false);
+    if(!vLoD.empty()) { m_vLastOfLoD.back() = true; }
+  }
+  if(m_vBricks.empty()) {
+    // nothing of the dataset lies in the region; that is complete, too.
+    m_iCompletedLoD = iTargetLoD;
+    Finish(true);
+    return;
+  }
+
+  if(DeliverNext()) {
+    SCOPEDLOCK(m_Guard);
+    Queue();
+  }
+}
+
+ProgressiveBrickRequest::~ProgressiveBrickRequest() {
+  Cancel();
+  // we are done now, so no task queues another one.
+  TaskFuture<void> task;
+  {
+    SCOPEDLOCK(m_Guard);
+    task = m_Task;
+  }
+  if(task.Valid()) { task.Wait(); }
+}
+
+void ProgressiveBrickRequest::Cancel() {
+  SCOPEDLOCK(m_Guard);
+  m_bCancelled = true;
+  Finish(false);
+  // the sink is called without the guard; a call in progress on another
+  // thread must return before we do.  From within the sink, this call is
+  // the one in progress.
+  while(m_bInSink && m_SinkThread != std::this_thread::get_id()) {
+    m_SinkReturned.Wait(m_Guard);
+  }
+}
+
+bool ProgressiveBrickRequest::Wait() {
+  for(;;) {
+    TaskFuture<void> task;
+    {
+      SCOPEDLOCK(m_Guard);
+      // the sink runs on the thread which would have to finish the request.
+      if(m_bDone || (m_bInSink &&
+                     m_SinkThread == std::this_thread::get_id())) {
+        return m_bComplete;
+      }
+      task = m_Task;
+    }
+    // a worker waiting here runs other tasks meanwhile, maybe ours.
+    task.Wait();
+    if(task.Cancelled()) {
+      // the scheduler shut down before delivering everything.
+      SCOPEDLOCK(m_Guard);
+      Finish(false);
+    }
+  }
+}
+
+bool ProgressiveBrickRequest::IsDone() const {
+  SCOPEDLOCK(m_Guard);
+  return m_bDone;
+}
+
+size_t ProgressiveBrickRequest::GetCompletedLoD() const {
+  SCOPEDLOCK(m_Guard);
+  return m_iCompletedLoD;
+}
+
+void ProgressiveBrickRequest::Finish(bool bComplete) {
+  if(m_bDone) { return; }
+  m_bDone = true;
+  m_bComplete = bComplete;
+}
+
+void ProgressiveBrickRequest::Queue() {
+  if(m_bDone) { return; }
+  // the user is looking at the preview and waits for the sharper data.
+  m_Task = m_Scheduler.Submit([this]() {
+    if(DeliverNext()) {
+      SCOPEDLOCK(m_Guard);
+      Queue();
+    }
+  }, TaskScheduler::PRIORITY_INTERACTIVE);
+}
+
+bool ProgressiveBrickRequest::DeliverNext() {
+  BrickKey k;
+  bool bLast;
+  {
+    SCOPEDLOCK(m_Guard);
+    if(m_bDone) { return false; }
+    k = m_vBricks[m_iNext];
+    bLast = m_vLastOfLoD[m_iNext];
+  }
+  // reading is what takes time; a Cancel meanwhile must not wait for it.
+  std::vector<uint8_t> data;
+  const bool bRead = m_Dataset.GetBrick(k, data);
+
+  {
+    SCOPEDLOCK(m_Guard);
+    if(m_bDone) { return false; }
+    if(!bRead) {
+      Finish(false);
+      return false;
+    }
+    ++m_iNext;
+    if(bLast) { m_iCompletedLoD = std::get<1>(k); }
+    m_bInSink = true;
+    m_SinkThread = std::this_thread::get_id();
+  }
+  // without the guard, so that the sink may Cancel, Wait or query us.
+  const bool bMore = m_Sink(k, data, bLast);
+
+  SCOPEDLOCK(m_Guard);
+  m_bInSink = false;
+  m_SinkReturned.WakeAll();
+  if(m_bDone) { return false; }
+  if(!bMore) {
+    m_bCancelled = true;
+    Finish(false);
+    return false;
+  }
+  if(m_iNext == m_vBricks.size()) {
+    Finish(true);
+    return false;
+  }
+  return true;
+}
+
+std::vector<BrickKey>
+ProgressiveBrickRequest::BricksInRegion(const Dataset& ds, size_t ts,
+                                        size_t lod, const FLOATVECTOR3& vMin,
+                                        const FLOATVECTOR3& vMax) {
+  const FLOATVECTOR3 vCenter = (vMin + vMax) * 0.5f;
+  std::vector<std::pair<float, BrickKey>> found;
+  // bricks are indexed linearly within their timestep and LoD, so we visit
+  // just those instead of the whole brick table.
+  const size_t iCount = size_t(ds.GetBrickCount(lod, ts));
+  for(size_t i=0; i < iCount; ++i) {
+    const BrickKey k(ts, lod, i);
+    const BrickMD md = ds.GetBrickMetadata(k);
+    const FLOATVECTOR3 lo = md.center - md.extents * 0.5f;
+    const FLOATVECTOR3 hi = md.center + md.extents * 0.5f;
+    if(lo.x > vMax.x || lo.y > vMax.y || lo.z > vMax.z ||
+       hi.x < vMin.x || hi.y < vMin.y || hi.z < vMin.z) {
+      continue;
+    }
+    const FLOATVECTOR3 d = md.center - vCenter;
+    found.push_back(std::make_pair(d ^ d, k));
+  }
+  std::stable_sort(found.begin(), found.end(),
+    [](const std::pair<float, BrickKey>& a,
+       const std::pair<float, BrickKey>& b) { return a.first < b.first; });
+
+  std::vector<BrickKey> keys;
+  keys.reserve(found.size());
+  for(size_t i=0; i < found.size(); ++i) { keys.push_back(found[i].second); }
+  return keys;
+}
+
+}
@@ -0,0 +1,105 @@
+#ifndef TUVOK_PROGRESSIVE_BRICK_REQUEST_H
+#define TUVOK_PROGRESSIVE_BRICK_REQUEST_H
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Brick.h"
+#include "Basics/TaskScheduler.h"
+#include "Basics/Vectors.h"
+
+namespace tuvok {
+
+class Dataset;
+
+/// Delivers the bricks of a region of a dataset from coarse to fine, so
+/// callers get a preview at once and sharper data as it is read.  The
+/// region at the finest LoD which fits into a single brick is delivered
+/// before the constructor returns; tasks on the controller's task scheduler
+/// then deliver the region at every finer LoD, down to the one asked for,
+/// a brick per task.  Within a LoD the
+/// bricks nearest to the center of the region come first.
+/// When the view changes, cancel the request (or destroy it) and start a
+/// new one.
+class ProgressiveBrickRequest {
+public:
+  /// Receives a brick as raw bytes, as Dataset::GetBrick reads them into a
+  /// vector of uint8_t.  'bLoDDone' is set for the last brick of its LoD:
+  /// the region is complete at that resolution then.  Return false to stop
+  /// the delivery.  Called from a worker of the task scheduler, except for
+  /// the first brick, which comes from the thread creating the request.
+  typedef std::function<bool (const BrickKey&, const std::vector<uint8_t>&,
+                              bool bLoDDone)> BrickSink;
+
+  /// @param ds the dataset; it must outlive the request and allow reading
+  ///           bricks from another thread
+  /// @param ts the timestep to read
+  /// @param iTargetLoD the finest LoD to deliver
+  /// @param vMin, vMax corners of the region, in the (world) space of the
+  ///           bricks' centers and extents
+  ProgressiveBrickRequest(const Dataset& ds, size_t ts, size_t iTargetLoD,
+                          const FLOATVECTOR3& vMin, const FLOATVECTOR3& vMax,
+                          BrickSink sink);
+  /// cancels the request and waits for the loading task.
+  ~ProgressiveBrickRequest();
+
+  /// Stops the delivery: once this returns, the sink is not called again.
+  /// Waits for a call of the sink in progress; may be called from the sink.
+  void Cancel();
+  /// Blocks until every brick was delivered, or the request was cancelled or
+  /// a brick could not be read.  Called from the sink, it cannot wait for
+  /// the task running the sink and returns at once.
+  /// @returns true if every brick was delivered.
+  bool Wait();
+  /// @returns true if the request has finished, for whatever reason.
+  bool IsDone() const;
+  /// @returns the finest LoD at which the whole region was delivered, or the
+  /// dataset's LoD count if none was.
+  size_t GetCompletedLoD() const;
+
+  /// @returns the bricks of a timestep's LoD which overlap the region,
+  /// nearest to the region's center first.
+  static std::vector<BrickKey> BricksInRegion(const Dataset& ds, size_t ts,
+                                              size_t lod,
+                                              const FLOATVECTOR3& vMin,
+                                              const FLOATVECTOR3& vMax);
+
+private:
+  /// reads and delivers the next brick.
+  /// @returns false if there is nothing left to deliver.
+  bool DeliverNext();
+  /// queues the task delivering the next brick, unless we are done; needs
+  /// m_Guard.
+  void Queue();
+  void Finish(bool bComplete);
+
+  const Dataset&            m_Dataset;
+  BrickSink                 m_Sink;
+  /// all bricks to deliver, coarsest LoD first
+  std::vector<BrickKey>     m_vBricks;
+  /// for every brick, whether it is the last one of its LoD
+  std::vector<bool>         m_vLastOfLoD;
+
+  mutable CriticalSection   m_Guard;
+  /// the sink is called without m_Guard; Cancel waits on this for it
+  WaitCondition             m_SinkReturned;
+  size_t                    m_iNext;
+  size_t                    m_iCompletedLoD;
+  bool                      m_bCancelled;
+  bool                      m_bDone;
+  bool                      m_bComplete;
+  bool                      m_bInSink;
+  std::thread::id           m_SinkThread;
+
+  TaskScheduler&            m_Scheduler;
+  /// the latest loading task.
+  TaskFuture<void>          m_Task;
+
+  ProgressiveBrickRequest(const ProgressiveBrickRequest&);
+  ProgressiveBrickRequest& operator=(const ProgressiveBrickRequest&);
+};
+
+}
+
+#endif // TUVOK_PROGRESSIVE_BRICK_REQUEST_H
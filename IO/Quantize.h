@@ -39,6 +39,7 @@
 #include "Basics/BStream.h"
 #include "Basics/LargeRAWFile.h"
 #include "Basics/ctti.h"
+#include "FilteredRAWFile.h"
 #include "UVF/Histogram1DDataBlock.h"
 #include "TuvokSizes.h"
 #include "AbstrConverter.h"
@@ -421,16 +422,36 @@ static bool ApplyMapping(const uint64_t iElems,
   return true;
 }
 
-/// Quantizes an (already-open) file to 'strTargetFilename'.  If 'InputData'
-/// doesn't need any quantization, this might be a no-op.
-/// @returns true if we generated 'strTargetFilename', false if the caller
-/// can just use 'InputData' as-is or on error.
+/// The linear mapping of T values onto the range of U which Quantize and
+/// QuantizeView apply, as found by PrepareQuantization.
 template <typename T, typename U>
-static bool Quantize(LargeRAWFile& InputData,
-                     const BStreamDescriptor& Input,
-                     const std::string& strTargetFilename,
-                     Histogram1DDataBlock* Histogram1D=0,
-                     size_t* iBinCount=0)
+struct LinearQuantization {
+  std::pair<T,T> minmax;
+  size_t hist_size;
+  size_t max_output_val;
+  double fQuantFact;
+  double fQuantFactHist;
+
+  /// @returns false if the mapping only biases the histogram, i.e. the
+  /// data can be used as they are.
+  bool ChangesData() const {
+    return fQuantFact != 1.0 || minmax.first != 0 ||
+           sizeof(T) > 2 || sizeof(T) > sizeof(U);
+  }
+  U HistogramBin(T value) const {
+    return std::min<U>(static_cast<U>(hist_size-1),
+                       static_cast<U>((value-minmax.first) * fQuantFactHist));
+  }
+};
+
+/// Computes the value range of an (already-open) file and the quantization
+/// that maps it onto U.
+/// @returns false if the data do not need any quantization, or on error.
+template <typename T, typename U>
+static bool PrepareQuantization(LargeRAWFile& InputData,
+                                const BStreamDescriptor& Input,
+                                LinearQuantization<T,U>& q,
+                                size_t* iBinCount)
 {
   if (iBinCount) {
     MESSAGE("Resetting bin count to 0.");
@@ -438,12 +459,10 @@ static bool Quantize(LargeRAWFile& InputData,
   }
   // this code won't behave correctly when quantizing to very wide data
   // types.  Make sure we only deal with 8 and 16 bit outputs.
-  size_t hist_size = 4096;
-  if(sizeof(U) == 1) { hist_size = 256; }
+  q.hist_size = 4096;
+  if(sizeof(U) == 1) { q.hist_size = 256; }
   static_assert(sizeof(U) <= 2, "we assume histogram sizes");
 
-  const size_t iCurrentInCoreSizeBytes = AbstrConverter::GetIncoreSize();
-  const size_t iCurrentInCoreElems = iCurrentInCoreSizeBytes / sizeof(T);
   if(!InputData.IsOpen()) {
     T_ERROR("Open the file before you call this.");
     return false;
@@ -451,24 +470,22 @@ static bool Quantize(LargeRAWFile& InputData,
   InputData.SeekStart();
 
   assert(Input.width == sizeof(T));
-  const uint64_t iSize = Input.elements * Input.components * Input.timesteps *
-                         Input.width;
   const uint64_t iElems = Input.elements * Input.components * Input.timesteps;
-  MESSAGE("%s should have %llu bytes.", InputData.GetFilename().c_str(), iSize);
+  MESSAGE("%s should have %llu bytes.", InputData.GetFilename().c_str(),
+          iElems*Input.width);
 
   // figure out min/max
-  std::vector<uint64_t> aHist(hist_size, 0);
-  std::pair<T,T> minmax;
+  std::vector<uint64_t> aHist(q.hist_size, 0);
   const size_t sz = (sizeof(U) == 2 ? 4096 : 256);
-  minmax = io_minmax(raw_data_src<T>(InputData),
-                     UnsignedHistogram<T, sz>(aHist),
-                     TuvokProgress<uint64_t>(iElems), iElems,
-                     iCurrentInCoreSizeBytes);
-  assert(minmax.second >= minmax.first);
+  q.minmax = io_minmax(raw_data_src<T>(InputData),
+                       UnsignedHistogram<T, sz>(aHist),
+                       TuvokProgress<uint64_t>(iElems), iElems,
+                       AbstrConverter::GetIncoreSize());
+  assert(q.minmax.second >= q.minmax.first);
 
   // Unsigned N bit data does not need to be biased/quantized.
-  if(!ctti<T>::is_signed && minmax.second < static_cast<T>(hist_size) &&
-     sizeof(T) <= ((hist_size == 256) ? 1 : 2)) {
+  if(!ctti<T>::is_signed && q.minmax.second < static_cast<T>(q.hist_size) &&
+     sizeof(T) <= ((q.hist_size == 256) ? 1 : 2)) {
     MESSAGE("Returning early; data does not need processing.");
 
     // if we have very few values, let the calling function know
@@ -480,101 +497,136 @@ static bool Quantize(LargeRAWFile& InputData,
     }
     return false;
   }
-  // Reset the histogram.  We'll be quantizing the data.
-  std::fill(aHist.begin(), aHist.end(), 0);
 
   if(iBinCount != NULL) {
-    *iBinCount = bins_needed<T>(minmax);
+    *iBinCount = bins_needed<T>(q.minmax);
     MESSAGE("We need %u bins", static_cast<unsigned>(*iBinCount));
   }
 
-  size_t max_output_val = (1 << (sizeof(U)*8)) - 1;
-  if(hist_size == 256) { max_output_val = 255; }
-  double fQuantFact = QuantizationFactor(max_output_val, minmax.first,
-                                         minmax.second);
-  double fQuantFactHist = QuantizationFactor(hist_size-1, minmax.first,
-                                             minmax.second);
-
-  bool bDataWillbeChanged = fQuantFact != 1.0 || minmax.first != 0 ||
-                            sizeof(T) > 2 || sizeof(T) > sizeof(U);
-
-  LargeRAWFile OutputData(strTargetFilename);
-  // if the only reason for quantization is the histogram computation
-  // we don't need an output file
-  if (bDataWillbeChanged) {
-    OutputData.Create(iSize*sizeof(U));
-    if(!OutputData.IsOpen()) {
-      InputData.Close();
-      T_ERROR("Could not create output file '%s'", strTargetFilename.c_str());
-      return false;
-    }
-  }
+  q.max_output_val = (1 << (sizeof(U)*8)) - 1;
+  if(q.hist_size == 256) { q.max_output_val = 255; }
+  q.fQuantFact = QuantizationFactor(q.max_output_val, q.minmax.first,
+                                    q.minmax.second);
+  q.fQuantFactHist = QuantizationFactor(q.hist_size-1, q.minmax.first,
+                                        q.minmax.second);
+  return true;
+}
 
-  T* pInData = new T[iCurrentInCoreElems];
-  U* pOutData = new U[iCurrentInCoreElems];
+/// Reads 'iElems' values of 'InputData' once to compute the histogram of the
+/// quantized data; also writes the quantized data to 'pOutputData', if given.
+template <typename T, typename U>
+static bool QuantizationPass(LargeRAWFile& InputData, uint64_t iElems,
+                             const LinearQuantization<T,U>& q,
+                             Histogram1DDataBlock* Histogram1D,
+                             LargeRAWFile* pOutputData)
+{
+  const size_t iCurrentInCoreElems = AbstrConverter::GetIncoreSize() /
+                                     sizeof(T);
+  std::vector<uint64_t> aHist(q.hist_size, 0);
+  std::vector<T> data(iCurrentInCoreElems);
+  std::vector<U> output(pOutputData ? iCurrentInCoreElems : 0);
+  const char* operation = pOutputData ? "Quantizing"
+                                      : "Computing quantized histogram";
+  MESSAGE("%s to %u integer values (input range: [%g--%g])", operation,
+          static_cast<unsigned>(q.max_output_val),
+          static_cast<double>(q.minmax.first),
+          static_cast<double>(q.minmax.second));
 
   InputData.SeekStart();
+  raw_data_src<T> ds(InputData);
+  TuvokProgress<uint64_t> progress(iElems);
   uint64_t iPos = 0;
-  uint64_t iLastDisplayedPercent = 0;
-
-  while(iPos < iSize) {
-    size_t iRead = InputData.ReadRAW((unsigned char*)pInData,
-                                     std::min((iSize - iPos)*sizeof(T),
-                                     uint64_t(iCurrentInCoreSizeBytes)))/sizeof(T);
-    if(iRead == 0) { break; } // bail if the read gave us nothing
-
-    // calculate hist + quantize to output file.
-    for(size_t i=0; i < iRead; ++i) {
-      U iNewVal = std::min<U>(static_cast<U>(max_output_val),
-        static_cast<U>((pInData[i]-minmax.first) * fQuantFact)
-      );
-      U iHistIndex = std::min<U>(static_cast<U>(hist_size-1),
-                                 static_cast<U>((pInData[i]-minmax.first) *
-                                   fQuantFactHist)
-      );
-      pOutData[i] = iNewVal;
-      aHist[iHistIndex]++;
+  while(iPos < iElems) {
+    size_t n_records = ds.read(
+      (unsigned char*)(&(data.at(0))),
+      std::min(static_cast<size_t>(iElems-iPos), iCurrentInCoreElems)
+    );
+    if(n_records == 0) {
+      WARNING("Short file during quantization.");
+      break;
     }
-    iPos += static_cast<uint64_t>(iRead);
-
-    if((100*iPos)/iSize > iLastDisplayedPercent) {
-      std::ostringstream qmsg;
-
-      if (fQuantFact == 1.0)
-        if (minmax.first == 0)
-          qmsg << "Computing quantized histogram with " << hist_size
-          << " bins (input range: ["
-          << minmax.first << "--" << minmax.second << "])\n"
-          << (100*iPos)/iSize << "% complete";
-        else
-          qmsg << "Quantizing to " << (minmax.second-minmax.first)+1
-               << " integer values (input range: ["
-               << minmax.first << "--" << minmax.second << ")\n"
-               << (100*iPos)/iSize << "% complete";
-      else
-        qmsg << "Quantizing to " << max_output_val
-             << " integer values (input range: ["
-             << minmax.first << "--" << minmax.second << ")\n"
-             << (100*iPos)/iSize << "% complete";
-      MESSAGE("%s", qmsg.str().c_str());
-      iLastDisplayedPercent = (100*iPos)/iSize;
+    for(size_t i=0; i < n_records; ++i) {
+      aHist[q.HistogramBin(data[i])]++;
     }
-
-    if (bDataWillbeChanged)
-      OutputData.WriteRAW(reinterpret_cast<unsigned char*>(pOutData),
-                          sizeof(U)*iRead);
+    if(pOutputData) {
+      QuantizedRAWFile<T,U>::Map(&data[0], &output[0], n_records,
+                                 q.minmax.first, q.fQuantFact,
+                                 static_cast<U>(q.max_output_val));
+      if(pOutputData->WriteRAW(reinterpret_cast<unsigned char*>(&output[0]),
+                               sizeof(U)*n_records) != sizeof(U)*n_records) {
+        T_ERROR("Writing '%s' failed.", pOutputData->GetFilename().c_str());
+        return false;
+      }
+    }
+    iPos += uint64_t(n_records);
+    progress.notify(operation, iPos);
   }
-
-  delete[] pInData;
-  delete[] pOutData;
   if(Histogram1D) { Histogram1D->SetHistogram(aHist); }
+  return true;
+}
 
-  if (bDataWillbeChanged) {
-    OutputData.Close();
-    return true;
-  } else {
+/// Quantizes an (already-open) file to 'strTargetFilename'.  If 'InputData'
+/// doesn't need any quantization, this might be a no-op.
+/// @returns true if we generated 'strTargetFilename', false if the caller
+/// can just use 'InputData' as-is or on error.
+template <typename T, typename U>
+static bool Quantize(LargeRAWFile& InputData,
+                     const BStreamDescriptor& Input,
+                     const std::string& strTargetFilename,
+                     Histogram1DDataBlock* Histogram1D=0,
+                     size_t* iBinCount=0)
+{
+  LinearQuantization<T,U> q;
+  if(!PrepareQuantization(InputData, Input, q, iBinCount)) { return false; }
+  const uint64_t iElems = Input.elements * Input.components * Input.timesteps;
+
+  // if the only reason for quantization is the histogram computation
+  // we don't need an output file
+  if(!q.ChangesData()) {
+    QuantizationPass<T,U>(InputData, iElems, q, Histogram1D, NULL);
     return false;
   }
+
+  LargeRAWFile OutputData(strTargetFilename);
+  OutputData.Create(iElems*sizeof(U));
+  if(!OutputData.IsOpen()) {
+    InputData.Close();
+    T_ERROR("Could not create output file '%s'", strTargetFilename.c_str());
+    return false;
+  }
+  const bool bWritten = QuantizationPass<T,U>(InputData, iElems, q,
+                                              Histogram1D, &OutputData);
+  OutputData.Close();
+  return bWritten;
+}
+
+/// Streaming variant of Quantize: instead of writing the quantized data to an
+/// intermediate file, returns a read-only view of 'InputData' which quantizes
+/// on the fly.  The input is read twice (value range, histogram) and nothing
+/// is written.
+/// @returns the view, or an empty pointer if the caller can use 'InputData'
+/// as-is.
+template <typename T, typename U>
+static LargeRAWFile_ptr QuantizeView(LargeRAWFile_ptr InputData,
+                                     const BStreamDescriptor& Input,
+                                     Histogram1DDataBlock* Histogram1D=0,
+                                     size_t* iBinCount=0)
+{
+  LinearQuantization<T,U> q;
+  if(!PrepareQuantization(*InputData, Input, q, iBinCount)) {
+    return LargeRAWFile_ptr();
+  }
+  const uint64_t iElems = Input.elements * Input.components * Input.timesteps;
+  // the histogram still needs a full pass, but it only reads.
+  QuantizationPass<T,U>(*InputData, iElems, q, Histogram1D, NULL);
+  if(!q.ChangesData()) { return LargeRAWFile_ptr(); }
+
+  LargeRAWFile_ptr view(
+    new QuantizedRAWFile<T,U>(InputData, q.minmax.first, q.fQuantFact,
+                              q.max_output_val)
+  );
+  view->SeekStart();
+  return view;
 }
 
 /// @returns true if we generated 'strTargetFilename', false if the caller
@@ -53,6 +53,8 @@
 #include "UVF/KeyValuePairDataBlock.h"
 #include "UVF/TOCBlock.h"
 #include "UVF/UVF.h"
+#include "FilteredRAWFile.h"
+#include "ParallelDecompression.h"
 #include "TuvokIOError.h"
 #include "Quantize.h"
 
@@ -79,79 +81,6 @@ namespace {
   }
 }
 
-static std::string convert_endianness(const std::string& strFilename,
-                                      const std::string& strTempDir,
-                                      uint64_t iHeaderSkip,
-                                      unsigned iComponentSize,
-                                      size_t in_core_size)
-{
-  using namespace tuvok::io;
-  if(iComponentSize != 16 && iComponentSize != 32 && iComponentSize != 64) {
-    T_ERROR("Unable to endian convert anything but 16-, 32-, and 64-bit data"
-            "  (input data is %d-bit).", iComponentSize);
-    return "";
-  }
-
-  LargeRAWFile WrongEndianData(strFilename, iHeaderSkip);
-  WrongEndianData.Open(false);
-
-  if(!WrongEndianData.IsOpen()) {
-    T_ERROR("Unable to open source file '%s'", strFilename.c_str());
-    throw DSOpenFailed(strFilename.c_str(), "Unable to open source file",
-                       __FILE__, __LINE__);
-  }
-
-  const std::string tmp_file = strTempDir + SysTools::GetFilename(strFilename) +
-                               ".endianness";
-  LargeRAWFile ConvertedEndianData(tmp_file);
-  ConvertedEndianData.Create();
-
-  if(!ConvertedEndianData.IsOpen()) {
-    WrongEndianData.Close();
-    throw DSOpenFailed(tmp_file.c_str(), "Unable to create file",
-                       __FILE__, __LINE__);
-  }
-  MESSAGE("Performing endianness conversion ...");
-
-  uint64_t byte_length = WrongEndianData.GetCurrentSize();
-  size_t buffer_size = std::min<size_t>(static_cast<size_t>(byte_length),
-                                        static_cast<size_t>(in_core_size));
-  uint64_t bytes_converted = 0;
-
-  std::shared_ptr<unsigned char> buffer(
-    new unsigned char[buffer_size],
-    nonstd::DeleteArray<unsigned char>()
-  );
-
-  while(bytes_converted < byte_length) {
-    using namespace boost;
-    size_t bytes_read = WrongEndianData.ReadRAW(buffer.get(), buffer_size);
-    switch(iComponentSize) {
-      case 16: change_endianness<uint16_t>(buffer.get(), bytes_read); break;
-      case 32: change_endianness<float>(buffer.get(), bytes_read); break;
-      case 64: change_endianness<double>(buffer.get(), bytes_read); break;
-    }
-    size_t bytes_written = ConvertedEndianData.WriteRAW(buffer.get(),
-                                                        bytes_read);
-    if(bytes_read != bytes_written) {
-      WrongEndianData.Close();
-      ConvertedEndianData.Close();
-      remove(tmp_file.c_str());
-      throw IOException("Write failed during endianness conversion.", __FILE__,
-                        __LINE__);
-    }
-    bytes_converted += static_cast<uint64_t>(bytes_written);
-
-    MESSAGE("Performing endianness conversion"
-            "\n%i%% complete",
-            int(float(bytes_converted) / float(byte_length)*100.0f));
-  }
-  WrongEndianData.Close();
-  ConvertedEndianData.Close();
-
-  return tmp_file;
-}
-
 static std::shared_ptr<KeyValuePairDataBlock> metadata(
   const string& strDesc, const string& strSource,
   bool bLittleEndian, bool bSigned, bool bIsFloat,
@@ -202,6 +131,8 @@ quantize(std::shared_ptr<LargeRAWFile> sourceData,
          const bool bQuantizeTo8Bit, Histogram1DDataBlock* Histogram1D)
 {
   bool target = false;
+  // quantizations which only rescale values are applied while reading.
+  std::shared_ptr<LargeRAWFile> view;
 
   BStreamDescriptor bsd;
   bsd.elements = volumeSize;
@@ -242,17 +173,15 @@ quantize(std::shared_ptr<LargeRAWFile> sourceData,
       case 16 :
         MESSAGE("Dataset is 16bit integers (shorts)");
         if(bSigned) {
-          target =
-            Quantize<short, unsigned short>(
-              *sourceData, bsd, tmpQuantizedFile,
-              Histogram1D
+          view =
+            QuantizeView<short, unsigned short>(
+              sourceData, bsd, Histogram1D
             );
         } else {
           size_t iBinCount = 0;
-          target =
-            Quantize<unsigned short, unsigned short>(
-              *sourceData, bsd, tmpQuantizedFile,
-              Histogram1D, &iBinCount
+          view =
+            QuantizeView<unsigned short, unsigned short>(
+              sourceData, bsd, Histogram1D, &iBinCount
             );
           if (iBinCount > 0 && iBinCount <= 256) {
             target =
@@ -277,17 +206,15 @@ quantize(std::shared_ptr<LargeRAWFile> sourceData,
         } else {
           MESSAGE("Dataset is 32bit integers.");
           if(bSigned) {
-            target =
-              Quantize<int32_t, unsigned short>(
-                *sourceData, bsd, tmpQuantizedFile,
-                Histogram1D
+            view =
+              QuantizeView<int32_t, unsigned short>(
+                sourceData, bsd, Histogram1D
               );
           } else {
             size_t iBinCount = 0;
-            target =
-              Quantize<uint32_t, unsigned short>(
-                *sourceData, bsd, tmpQuantizedFile,
-                Histogram1D, &iBinCount
+            view =
+              QuantizeView<uint32_t, unsigned short>(
+                sourceData, bsd, Histogram1D, &iBinCount
               );
             if (iBinCount > 0 && iBinCount <= 256) {
               target =
@@ -314,18 +241,16 @@ quantize(std::shared_ptr<LargeRAWFile> sourceData,
         } else {
           if(bSigned) {
             MESSAGE("Dataset is 64bit integers.");
-            target =
-              Quantize<int64_t, unsigned short>(
-                *sourceData, bsd, tmpQuantizedFile,
-                Histogram1D
+            view =
+              QuantizeView<int64_t, unsigned short>(
+                sourceData, bsd, Histogram1D
               );
           } else {
             MESSAGE("Dataset is 64bit unsigned integers.");
             size_t iBinCount = 0;
-            target =
-              Quantize<uint64_t, unsigned short>(
-                *sourceData, bsd, tmpQuantizedFile,
-                Histogram1D, &iBinCount
+            view =
+              QuantizeView<uint64_t, unsigned short>(
+                sourceData, bsd, Histogram1D, &iBinCount
               );
             if (iBinCount > 0 && iBinCount <= 256) {
               target =
@@ -347,6 +272,9 @@ quantize(std::shared_ptr<LargeRAWFile> sourceData,
     rv->Open(false);
     return rv;
   }
+  if(view) {
+    return view;
+  }
   return sourceData;
 }
 
@@ -487,22 +415,20 @@ bool RAWConverter::ConvertRAWDataset(const string& strFilename,
 
   std::shared_ptr<LargeRAWFile> sourceData;
 
+  MESSAGE("source data with %llu-byte header skip", iHeaderSkip);
+  sourceData = std::shared_ptr<LargeRAWFile>(
+    new LargeRAWFile(strFilename, iHeaderSkip)
+  );
   if (bConvertEndianness) {
-    // the new data source is the endian-converted file.
-    size_t core_size = static_cast<size_t>(iTargetBrickSize*iTargetBrickSize*
-                                           iTargetBrickSize * iComponentSize/8);
-    string tmpEndianConvertedFile =
-      convert_endianness(strFilename, strTempDir, iHeaderSkip, iComponentSize,
-                         core_size);
-    iHeaderSkip = 0;  // the new file is straight raw without any header
-    MESSAGE("temporary source data; no header skip.");
-    sourceData = std::shared_ptr<LargeRAWFile>(
-      new TempFile(tmpEndianConvertedFile)
-    );
-  } else {
-    MESSAGE("non-temp source data, with %llu-byte header skip", iHeaderSkip);
+    // swap while reading instead of writing a converted copy first.
+    if(iComponentSize != 16 && iComponentSize != 32 && iComponentSize != 64) {
+      T_ERROR("Unable to endian convert anything but 16-, 32-, and 64-bit "
+              "data (input data is %d-bit).", iComponentSize);
+      return false;
+    }
+    MESSAGE("Performing endianness conversion on the fly.");
     sourceData = std::shared_ptr<LargeRAWFile>(
-      new LargeRAWFile(strFilename, iHeaderSkip)
+      new EndianSwappedRAWFile(sourceData, iComponentSize/8)
     );
   }
   sourceData->Open(false);
@@ -722,6 +648,24 @@ bool RAWConverter::ExtractGZIPDataset(const string& strFilename,
     return false;
   }
 
+  if(ParallelGZipDecompress(f_compressed, f_inflated, GetIncoreSize())) {
+    fclose(f_compressed);
+    fclose(f_inflated);
+    MESSAGE("Decompression successful.");
+    return true;
+  }
+
+  // start over with the serial decoder, which handles a single member only.
+  WARNING("Parallel decompression failed, retrying serially.");
+  f_inflated = freopen(strUncompressedFile.c_str(), "wb", f_inflated);
+  if(f_inflated == NULL ||
+     fseek(f_compressed, static_cast<long>(iHeaderSkip), SEEK_SET) != 0) {
+    T_ERROR("Could not restart decompression of %s", strFilename.c_str());
+    fclose(f_compressed);
+    if(f_inflated) { fclose(f_inflated); }
+    return false;
+  }
+
   gz_skip_header(f_compressed); // always needed?
 
   ret = gz_inflate(f_compressed, f_inflated);
@@ -852,6 +796,22 @@ bool RAWConverter::ExtractBZIP2Dataset(const string& strFilename,
     return false;
   }
 
+  if(ParallelBZip2Decompress(f_compressed, f_inflated, iCurrentIncoreSize)) {
+    fclose(f_inflated);
+    fclose(f_compressed);
+    return true;
+  }
+
+  WARNING("Parallel decompression failed, retrying serially.");
+  f_inflated = freopen(strUncompressedFile.c_str(), "wb", f_inflated);
+  if(f_inflated == NULL ||
+     fseek(f_compressed, static_cast<long>(iHeaderSkip), SEEK_SET) != 0) {
+    T_ERROR("Could not restart decompression of %s", strFilename.c_str());
+    fclose(f_compressed);
+    if(f_inflated) { fclose(f_inflated); }
+    return false;
+  }
+
   bzf = BZ2_bzReadOpen(&bz_err, f_compressed, 0, 0, NULL, 0);
   if(bz_err_test(bz_err)) {
     T_ERROR("Bzip library error occurred; bailing.");
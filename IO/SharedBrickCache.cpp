@@ -0,0 +1,609 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "SharedBrickCache.h"
+#include "Controller/Controller.h"
+#ifdef DETECTED_OS_LINUX
+# include <ctime>
+# include <fcntl.h>
+# include <pthread.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+namespace tuvok {
+
+#ifdef DETECTED_OS_LINUX
+
+namespace {
+  const char MAGIC[8] = { 'T','V','K','S','H','M','0','1' };
+  const uint32_t NIL = 0xffffffffu;
+  const uint32_t MAX_SHARDS = 16;
+  // slots are page aligned, so every brick sits in its own pages.
+  const uint64_t SLOT_ALIGNMENT = 4096;
+  const uint64_t LINE = 64;
+  // how long we wait for another process to finish loading a brick before
+  // we check whether it is still alive, and for a new segment to be set up.
+  const long WAIT_MS = 200;
+  const unsigned SETUP_TRIES = 50;
+
+  enum { SLOT_FREE=0, SLOT_LOADING, SLOT_READY };
+
+  /// start of the segment.  Shard regions follow, then the brick slots.
+  struct Header {
+    char     magic[8];
+    uint32_t iReady;          ///< set last by the creator
+    uint32_t iShards;
+    uint32_t iSlotsPerShard;
+    uint32_t iTableSize;      ///< per shard, a power of two
+    uint64_t iSlotBytes;
+    uint64_t iSegmentBytes;
+    uint64_t iShardOffset;
+    uint64_t iShardBytes;     ///< stride of the shard regions
+    uint64_t iDataOffset;
+  };
+
+  struct Entry {
+    uint64_t iSource[2];
+    uint64_t iTimestep;
+    uint64_t iLOD;
+    uint64_t iBrick;
+    uint64_t iHash;
+    uint64_t iBytes;
+    uint32_t iPins;
+    uint32_t iState;
+    uint32_t iReferenced;     ///< CLOCK bit
+    uint32_t iNextFree;
+    uint32_t iGeneration;     ///< bumped whenever the slot is freed
+    /// robust; held by the thread filling the slot while it does.  A pid
+    /// could belong to an unrelated process, e.g. in another PID namespace,
+    /// but the owner's death always shows as EOWNERDEAD.
+    pthread_mutex_t loader;
+  };
+
+  /// followed by its Entry array and its open addressed hash table, which
+  /// holds entry indices.
+  struct Shard {
+    pthread_mutex_t mutex;
+    pthread_cond_t  loaded;
+    uint32_t        iHand;
+    uint32_t        iFree;
+    uint32_t        iCount;
+  };
+
+  uint64_t Align(uint64_t v, uint64_t a) { return (v + a-1) / a * a; }
+
+  /// FNV-1a; unlike std::hash it is the same for every build, which all
+  /// processes sharing a segment rely on.
+  uint64_t Hash(const std::string& s,
+                uint64_t h = 14695981039346656037ULL) {
+    for(size_t i=0; i < s.size(); ++i) {
+      h ^= static_cast<unsigned char>(s[i]);
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  uint64_t Mix(uint64_t h) {
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+  }
+
+  uint64_t KeyHash(const uint64_t iSource[2], const BrickKey& k) {
+    uint64_t h = Mix(iSource[0] ^ iSource[1]);
+    h = Mix(h ^ uint64_t(std::get<0>(k)));
+    h = Mix(h ^ uint64_t(std::get<1>(k)));
+    return Mix(h ^ uint64_t(std::get<2>(k)));
+  }
+
+  /// everything that must not change for the cached bricks to be valid.
+  /// Device and inode make it independent of the path a process uses.
+  std::string Identity(const std::string& strSource,
+                       const std::string& strVariant) {
+    std::ostringstream id;
+    id << strVariant;
+    struct stat st;
+    if(stat(strSource.c_str(), &st) == 0) {
+      id << "|" << uint64_t(st.st_dev) << "|" << uint64_t(st.st_ino)
+         << "|" << uint64_t(st.st_size) << "|" << uint64_t(st.st_mtime);
+    } else {
+      id << "|" << strSource;
+    }
+    return id.str();
+  }
+
+  std::string SegmentName(const std::string& strName) {
+    std::ostringstream name;
+    name << "/tuvok-" << std::hex << Hash(strName);
+    return name.str();
+  }
+
+  /// @returns false if the process loading 'entry' died.  Called with the
+  /// shard's lock held, for SLOT_LOADING entries only.
+  bool LoaderAlive(Entry& entry) {
+    const int r = pthread_mutex_trylock(&entry.loader);
+    if(r == EBUSY) { return true; }
+    if(r == EOWNERDEAD) { pthread_mutex_consistent(&entry.loader); }
+    if(r == 0 || r == EOWNERDEAD) { pthread_mutex_unlock(&entry.loader); }
+    return false;
+  }
+
+  void Sleep(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+  }
+}
+
+struct SharedBrickCache::Segment {
+  Segment(void* p, size_t len) : base(static_cast<char*>(p)), len(len) {}
+  ~Segment() { munmap(base, len); }
+
+  Header& header() const { return *reinterpret_cast<Header*>(base); }
+  Shard& shard(uint32_t s) const {
+    return *reinterpret_cast<Shard*>(base + header().iShardOffset +
+                                     s * header().iShardBytes);
+  }
+  Entry* entries(uint32_t s) const {
+    return reinterpret_cast<Entry*>(reinterpret_cast<char*>(&shard(s)) +
+                                    Align(sizeof(Shard), LINE));
+  }
+  uint32_t* table(uint32_t s) const {
+    return reinterpret_cast<uint32_t*>(entries(s) +
+                                       header().iSlotsPerShard);
+  }
+  char* slot(uint32_t s, uint32_t e) const {
+    return base + header().iDataOffset +
+           (uint64_t(s) * header().iSlotsPerShard + e) * header().iSlotBytes;
+  }
+
+  char*  base;
+  size_t len;
+};
+
+namespace {
+  typedef SharedBrickCache::Segment Segment;
+
+  void Insert(const Segment& seg, uint32_t s, uint32_t e) {
+    const uint32_t mask = seg.header().iTableSize - 1;
+    uint32_t* table = seg.table(s);
+    uint32_t p = uint32_t(seg.entries(s)[e].iHash) & mask;
+    while(table[p] != NIL) { p = (p+1) & mask; }
+    table[p] = e;
+  }
+
+  uint32_t Lookup(const Segment& seg, uint32_t s, const uint64_t iSource[2],
+                  const BrickKey& k, uint64_t iHash) {
+    const uint32_t mask = seg.header().iTableSize - 1;
+    const uint32_t* table = seg.table(s);
+    const Entry* entries = seg.entries(s);
+    for(uint32_t p = uint32_t(iHash) & mask; table[p] != NIL;
+        p = (p+1) & mask) {
+      const Entry& x = entries[table[p]];
+      if(x.iHash == iHash && x.iSource[0] == iSource[0] &&
+         x.iSource[1] == iSource[1] && x.iTimestep == std::get<0>(k) &&
+         x.iLOD == std::get<1>(k) && x.iBrick == std::get<2>(k)) {
+        return table[p];
+      }
+    }
+    return NIL;
+  }
+
+  /// removes 'e' from the hash table, shifting later entries of its probe
+  /// sequence back so lookups need no tombstones.
+  void Unlink(const Segment& seg, uint32_t s, uint32_t e) {
+    const uint32_t mask = seg.header().iTableSize - 1;
+    uint32_t* table = seg.table(s);
+    const Entry* entries = seg.entries(s);
+    uint32_t i = uint32_t(entries[e].iHash) & mask;
+    while(table[i] != e) {
+      if(table[i] == NIL) { return; }
+      i = (i+1) & mask;
+    }
+    for(uint32_t j = (i+1) & mask; table[j] != NIL; j = (j+1) & mask) {
+      const uint32_t home = uint32_t(entries[table[j]].iHash) & mask;
+      // move it unless its home lies cyclically in (i, j].
+      const bool stays = (i <= j) ? (i < home && home <= j)
+                                  : (i < home || home <= j);
+      if(!stays) {
+        table[i] = table[j];
+        i = j;
+      }
+    }
+    table[i] = NIL;
+  }
+
+  void Free(const Segment& seg, uint32_t s, uint32_t e) {
+    Shard& shard = seg.shard(s);
+    Entry& entry = seg.entries(s)[e];
+    Unlink(seg, s, e);
+    entry.iState = SLOT_FREE;
+    entry.iPins = 0;
+    entry.iGeneration++;
+    entry.iNextFree = shard.iFree;
+    shard.iFree = e;
+    shard.iCount--;
+  }
+
+  /// a free slot, or the next unpinned one the CLOCK hand finds.
+  uint32_t Allocate(const Segment& seg, uint32_t s) {
+    Shard& shard = seg.shard(s);
+    Entry* entries = seg.entries(s);
+    const uint32_t n = seg.header().iSlotsPerShard;
+    if(shard.iFree == NIL) {
+      for(uint32_t step=0; step < 2*n; ++step) {
+        const uint32_t e = shard.iHand;
+        shard.iHand = (shard.iHand + 1) % n;
+        Entry& entry = entries[e];
+        if(entry.iState != SLOT_READY || entry.iPins > 0) { continue; }
+        if(entry.iReferenced) { entry.iReferenced = 0; continue; }
+        Free(seg, s, e);
+        break;
+      }
+      if(shard.iFree == NIL) { return NIL; }
+    }
+    const uint32_t e = shard.iFree;
+    shard.iFree = entries[e].iNextFree;
+    shard.iCount++;
+    return e;
+  }
+
+  /// after a process died holding the shard's lock: the table or the free
+  /// list may be half updated, so both are rebuilt from the entries.
+  /// Slots the dead process was loading are dropped.
+  void Repair(const Segment& seg, uint32_t s) {
+    Shard& shard = seg.shard(s);
+    Entry* entries = seg.entries(s);
+    const uint32_t n = seg.header().iSlotsPerShard;
+    memset(seg.table(s), 0xff, seg.header().iTableSize * sizeof(uint32_t));
+    shard.iFree = NIL;
+    shard.iCount = 0;
+    shard.iHand %= n;
+    for(uint32_t e=n; e-- > 0;) {
+      Entry& entry = entries[e];
+      if(entry.iState == SLOT_LOADING && !LoaderAlive(entry)) {
+        entry.iState = SLOT_FREE;
+        entry.iGeneration++;
+      }
+      if(entry.iState == SLOT_FREE) {
+        entry.iPins = 0;
+        entry.iNextFree = shard.iFree;
+        shard.iFree = e;
+      } else {
+        Insert(seg, s, e);
+        shard.iCount++;
+      }
+    }
+  }
+
+  /// holds a shard's lock; repairs the shard if the last owner died.
+  class ShardLock {
+  public:
+    ShardLock(const Segment& seg, uint32_t s) : m_Seg(seg), m_iShard(s),
+                                                m_bLocked(false) { Lock(); }
+    ~ShardLock() { if(m_bLocked) { Unlock(); } }
+
+    void Lock() {
+      if(pthread_mutex_lock(&m_Seg.shard(m_iShard).mutex) == EOWNERDEAD) {
+        Recover();
+      }
+      m_bLocked = true;
+    }
+    void Unlock() {
+      m_bLocked = false;
+      pthread_mutex_unlock(&m_Seg.shard(m_iShard).mutex);
+    }
+    /// waits until a brick of the shard is loaded, or for 'ms'.
+    void Wait(long ms) {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      ts.tv_nsec += (ms % 1000) * 1000000L;
+      ts.tv_sec += ms / 1000 + ts.tv_nsec / 1000000000L;
+      ts.tv_nsec %= 1000000000L;
+      Shard& shard = m_Seg.shard(m_iShard);
+      if(pthread_cond_timedwait(&shard.loaded, &shard.mutex, &ts) ==
+         EOWNERDEAD) {
+        Recover();
+      }
+    }
+
+  private:
+    void Recover() {
+      WARNING("A process died while holding the lock of shared brick "
+              "cache shard %u; repairing it.", m_iShard);
+      Repair(m_Seg, m_iShard);
+      pthread_mutex_consistent(&m_Seg.shard(m_iShard).mutex);
+    }
+
+    const Segment& m_Seg;
+    const uint32_t m_iShard;
+    bool           m_bLocked;
+  };
+
+  /// deleter of the pointers we hand out.  It holds on to the mapping, and
+  /// leaves slots alone which were freed (by a Repair) in the meantime.
+  struct Unpin {
+    std::shared_ptr<Segment> seg;
+    uint32_t s, e, gen;
+    void operator()(const void*) const {
+      ShardLock lock(*seg, s);
+      Entry& entry = seg->entries(s)[e];
+      if(entry.iGeneration == gen && entry.iPins > 0) { entry.iPins--; }
+    }
+  };
+
+  std::shared_ptr<const void> Pinned(const std::shared_ptr<Segment>& seg,
+                                     uint32_t s, uint32_t e) {
+    Unpin unpin = { seg, s, e, seg->entries(s)[e].iGeneration };
+    return std::shared_ptr<const void>(seg->slot(s, e), unpin);
+  }
+
+  bool InitShard(const Segment& seg, uint32_t s) {
+    Shard& shard = seg.shard(s);
+    pthread_mutexattr_t ma;
+    pthread_condattr_t ca;
+    pthread_mutexattr_init(&ma);
+    pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+    pthread_condattr_init(&ca);
+    pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    bool ok = pthread_mutex_init(&shard.mutex, &ma) == 0 &&
+              pthread_cond_init(&shard.loaded, &ca) == 0;
+    const uint32_t n = seg.header().iSlotsPerShard;
+    Entry* entries = seg.entries(s);
+    for(uint32_t e=0; e < n; ++e) {
+      entries[e].iState = SLOT_FREE;
+      entries[e].iNextFree = e+1 < n ? e+1 : NIL;
+      ok = ok && pthread_mutex_init(&entries[e].loader, &ma) == 0;
+    }
+    pthread_condattr_destroy(&ca);
+    pthread_mutexattr_destroy(&ma);
+    shard.iFree = 0;
+    shard.iHand = 0;
+    shard.iCount = 0;
+    memset(seg.table(s), 0xff, seg.header().iTableSize * sizeof(uint32_t));
+    return ok;
+  }
+
+  /// lays out and initializes a segment we just created.
+  std::shared_ptr<Segment> Create(int fd, uint64_t iMaxBytes,
+                                  uint64_t iSlotBytes) {
+    Header h;
+    memset(&h, 0, sizeof(Header));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.iSlotBytes = iSlotBytes;
+    const uint64_t iSlots = iMaxBytes / iSlotBytes;
+    h.iShards = uint32_t(std::min<uint64_t>(MAX_SHARDS, iSlots));
+    if(h.iShards == 0) { return std::shared_ptr<Segment>(); }
+    h.iSlotsPerShard = uint32_t(std::min<uint64_t>(iSlots / h.iShards,
+                                                   NIL / 2));
+    h.iTableSize = 1;
+    while(h.iTableSize < 2 * h.iSlotsPerShard) { h.iTableSize *= 2; }
+    h.iShardOffset = Align(sizeof(Header), LINE);
+    h.iShardBytes = Align(Align(sizeof(Shard), LINE) +
+                          h.iSlotsPerShard * sizeof(Entry) +
+                          h.iTableSize * sizeof(uint32_t), LINE);
+    h.iDataOffset = Align(h.iShardOffset + h.iShards * h.iShardBytes,
+                          SLOT_ALIGNMENT);
+    h.iSegmentBytes = h.iDataOffset +
+                      uint64_t(h.iShards) * h.iSlotsPerShard * iSlotBytes;
+
+    // reserve the memory now: running out of it later would be a SIGBUS.
+    if(posix_fallocate(fd, 0, off_t(h.iSegmentBytes)) != 0) {
+      WARNING("Could not reserve %llu bytes of shared memory.",
+              static_cast<unsigned long long>(h.iSegmentBytes));
+      return std::shared_ptr<Segment>();
+    }
+    void* p = mmap(NULL, size_t(h.iSegmentBytes), PROT_READ|PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    if(p == MAP_FAILED) { return std::shared_ptr<Segment>(); }
+    std::shared_ptr<Segment> seg(new Segment(p, size_t(h.iSegmentBytes)));
+    memcpy(p, &h, sizeof(Header));
+    for(uint32_t s=0; s < h.iShards; ++s) {
+      if(!InitShard(*seg, s)) { return std::shared_ptr<Segment>(); }
+    }
+    __atomic_store_n(&seg->header().iReady, 1u, __ATOMIC_RELEASE);
+    return seg;
+  }
+
+  /// maps a segment another process created, once it is set up.
+  std::shared_ptr<Segment> Join(int fd) {
+    for(unsigned i=0; i < SETUP_TRIES; ++i, Sleep(WAIT_MS/10)) {
+      struct stat st;
+      if(fstat(fd, &st) != 0) { break; }
+      if(uint64_t(st.st_size) < sizeof(Header)) { continue; }
+      void* p = mmap(NULL, size_t(st.st_size), PROT_READ|PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+      if(p == MAP_FAILED) { break; }
+      std::shared_ptr<Segment> seg(new Segment(p, size_t(st.st_size)));
+      const Header& h = seg->header();
+      if(__atomic_load_n(&h.iReady, __ATOMIC_ACQUIRE) == 0) { continue; }
+      if(memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+         h.iSegmentBytes > uint64_t(st.st_size)) {
+        break;
+      }
+      return seg;
+    }
+    return std::shared_ptr<Segment>();
+  }
+}
+
+SharedBrickCache::SharedBrickCache(const std::string& strName,
+                                   const std::string& strSource,
+                                   const std::string& strVariant,
+                                   uint64_t iMaxBytes, uint64_t iSlotBytes)
+{
+  const std::string id = Identity(strSource, strVariant);
+  m_iSource[0] = Hash(id);
+  m_iSource[1] = Hash(id, 0x84222325cbf29ce4ULL);
+
+  const std::string shm = SegmentName(strName);
+  const uint64_t iSlot = Align(iSlotBytes, SLOT_ALIGNMENT);
+  if(iSlot == 0) { return; }
+  int fd = shm_open(shm.c_str(), O_RDWR|O_CREAT|O_EXCL, 0600);
+  if(fd >= 0) {
+    m_pSegment = Create(fd, iMaxBytes, iSlot);
+    if(!m_pSegment) { shm_unlink(shm.c_str()); }
+  } else if(errno == EEXIST &&
+            (fd = shm_open(shm.c_str(), O_RDWR, 0600)) >= 0) {
+    m_pSegment = Join(fd);
+    if(!m_pSegment) {
+      WARNING("Shared brick cache %s is not usable; remove it to start "
+              "over.", shm.c_str());
+    } else if(m_pSegment->header().iSlotBytes < iSlotBytes) {
+      WARNING("Bricks of %s are too large for shared brick cache %s.",
+              strSource.c_str(), shm.c_str());
+      m_pSegment.reset();
+    }
+  }
+  if(fd >= 0) { close(fd); }
+  if(m_pSegment) {
+    MESSAGE("Using shared brick cache %s: %llu MB, %u bricks held.",
+            shm.c_str(),
+            static_cast<unsigned long long>(GetCapacity() >> 20),
+            static_cast<unsigned>(GetBrickCount()));
+  }
+}
+
+SharedBrickCache::~SharedBrickCache() { }
+
+std::shared_ptr<const void>
+SharedBrickCache::Find(const BrickKey& k, size_t iBytes,
+                       const std::function<bool (void*)>* load) {
+  if(!IsOpen()) { return std::shared_ptr<const void>(); }
+  const Segment& seg = *m_pSegment;
+  if(iBytes == 0 || iBytes > seg.header().iSlotBytes) {
+    return std::shared_ptr<const void>();
+  }
+  const uint64_t iHash = KeyHash(m_iSource, k);
+  const uint32_t s = uint32_t((iHash >> 32) % seg.header().iShards);
+  Shard& shard = seg.shard(s);
+  Entry* entries = seg.entries(s);
+
+  ShardLock lock(seg, s);
+  for(;;) {
+    uint32_t e = Lookup(seg, s, m_iSource, k, iHash);
+    if(e != NIL) {
+      Entry& entry = entries[e];
+      if(entry.iState == SLOT_READY) {
+        if(entry.iBytes != iBytes) { return std::shared_ptr<const void>(); }
+        entry.iPins++;
+        entry.iReferenced = 1;
+        return Pinned(m_pSegment, s, e);
+      }
+      // somebody is loading it; wait, unless it died doing so.
+      if(load == NULL) { return std::shared_ptr<const void>(); }
+      if(!LoaderAlive(entry)) {
+        Free(seg, s, e);
+      } else {
+        lock.Wait(WAIT_MS);
+      }
+      continue;
+    }
+    if(load == NULL) { return std::shared_ptr<const void>(); }
+
+    e = Allocate(seg, s);
+    if(e == NIL) { return std::shared_ptr<const void>(); }
+    Entry& entry = entries[e];
+    entry.iSource[0] = m_iSource[0];
+    entry.iSource[1] = m_iSource[1];
+    entry.iTimestep = std::get<0>(k);
+    entry.iLOD = std::get<1>(k);
+    entry.iBrick = std::get<2>(k);
+    entry.iHash = iHash;
+    entry.iBytes = iBytes;
+    entry.iPins = 1;
+    entry.iState = SLOT_LOADING;
+    entry.iReferenced = 1;
+    Insert(seg, s, e);
+    const uint32_t gen = entry.iGeneration;
+    // only a process which died right after its load left this locked.
+    if(pthread_mutex_lock(&entry.loader) == EOWNERDEAD) {
+      pthread_mutex_consistent(&entry.loader);
+    }
+
+    // the slot is ours (a Repair keeps it, since we are alive), so it is
+    // filled without holding the lock.
+    lock.Unlock();
+    bool bLoaded = false;
+    try {
+      bLoaded = (*load)(seg.slot(s, e));
+    } catch(...) {
+      lock.Lock();
+      pthread_mutex_unlock(&entry.loader);
+      if(entry.iGeneration == gen) { Free(seg, s, e); }
+      pthread_cond_broadcast(&shard.loaded);
+      throw;
+    }
+    lock.Lock();
+    pthread_mutex_unlock(&entry.loader);
+    pthread_cond_broadcast(&shard.loaded);
+    if(entry.iGeneration != gen) { return std::shared_ptr<const void>(); }
+    if(!bLoaded) {
+      Free(seg, s, e);
+      return std::shared_ptr<const void>();
+    }
+    entry.iState = SLOT_READY;
+    return Pinned(m_pSegment, s, e);
+  }
+}
+
+uint64_t SharedBrickCache::GetCapacity() const {
+  if(!IsOpen()) { return 0; }
+  const Header& h = m_pSegment->header();
+  return uint64_t(h.iShards) * h.iSlotsPerShard * h.iSlotBytes;
+}
+
+size_t SharedBrickCache::GetBrickCount() const {
+  if(!IsOpen()) { return 0; }
+  size_t n = 0;
+  for(uint32_t s=0; s < m_pSegment->header().iShards; ++s) {
+    ShardLock lock(*m_pSegment, s);
+    n += m_pSegment->shard(s).iCount;
+  }
+  return n;
+}
+
+void SharedBrickCache::Remove(const std::string& strName) {
+  shm_unlink(SegmentName(strName).c_str());
+}
+
+#else
+
+// robust, process shared mutexes are needed to survive crashing processes.
+struct SharedBrickCache::Segment { };
+
+SharedBrickCache::SharedBrickCache(const std::string&, const std::string&,
+                                   const std::string&, uint64_t, uint64_t)
+{
+  m_iSource[0] = m_iSource[1] = 0;
+}
+SharedBrickCache::~SharedBrickCache() { }
+
+std::shared_ptr<const void>
+SharedBrickCache::Find(const BrickKey&, size_t,
+                       const std::function<bool (void*)>*) {
+  return std::shared_ptr<const void>();
+}
+uint64_t SharedBrickCache::GetCapacity() const { return 0; }
+size_t SharedBrickCache::GetBrickCount() const { return 0; }
+void SharedBrickCache::Remove(const std::string&) { }
+
+#endif
+
+std::shared_ptr<const void> SharedBrickCache::Acquire(const BrickKey& k,
+                                                      size_t iBytes) {
+  return Find(k, iBytes, NULL);
+}
+
+std::shared_ptr<const void>
+SharedBrickCache::AcquireOrLoad(const BrickKey& k, size_t iBytes,
+                                const std::function<bool (void*)>& load) {
+  return Find(k, iBytes, &load);
+}
+
+}
@@ -0,0 +1,79 @@
+#ifndef TUVOK_SHARED_BRICK_CACHE_H
+#define TUVOK_SHARED_BRICK_CACHE_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include "Brick.h"
+
+namespace tuvok {
+
+/// Brick cache in POSIX shared memory, for hosts which run many processes
+/// (render workers, batch scripts) on the same datasets: the first process
+/// to need a brick reads and decodes it into the shared segment, all others
+/// use that copy.  Bricks are keyed by the identity of their file (device,
+/// inode, size and modification time) and their BrickKey, so any number of
+/// datasets can share one segment and its byte budget.
+/// The segment is split into shards, each with its own process-shared lock,
+/// hash table and CLOCK eviction; bricks which are handed out are pinned and
+/// never evicted.  A process which dies while loading a brick is noticed by
+/// the processes waiting for it, through a robust lock it holds meanwhile
+/// rather than its pid, which does not identify it across PID namespaces.  Pins held by a process which dies are
+/// lost, which only costs capacity until the segment is removed.
+/// Segments are private to the user who creates them.  Only available on
+/// Linux, which has robust process-shared mutexes; IsOpen() is false on
+/// other systems.
+class SharedBrickCache {
+public:
+  /// @param strName names the segment; caches with the same name share it
+  /// @param strSource the file the bricks come from
+  /// @param strVariant distinguishes different brickings/types of a source
+  /// @param iMaxBytes size of the segment, if we are the first to create it
+  /// @param iSlotBytes size of the largest brick we will be asked to store
+  SharedBrickCache(const std::string& strName, const std::string& strSource,
+                   const std::string& strVariant, uint64_t iMaxBytes,
+                   uint64_t iSlotBytes);
+  ~SharedBrickCache();
+
+  /// @returns false if the segment could not be created or attached to.
+  bool IsOpen() const { return m_pSegment.get() != NULL; }
+
+  /// @returns the brick, pinned in the segment, or an empty pointer if no
+  /// process has it with exactly 'iBytes'.  The brick stays pinned while the
+  /// pointer (or a copy of it) lives; that may outlive the cache object.
+  std::shared_ptr<const void> Acquire(const BrickKey& k, size_t iBytes);
+  /// Like Acquire, but if no process has the brick, 'load' is called to fill
+  /// a free slot of 'iBytes' with it.  Processes which ask for the brick
+  /// meanwhile wait for it instead of loading it themselves.  Returns an
+  /// empty pointer if the brick cannot be cached (it is too large, every
+  /// slot is pinned or 'load' failed); read the brick yourself then.
+  std::shared_ptr<const void> AcquireOrLoad(
+    const BrickKey& k, size_t iBytes,
+    const std::function<bool (void*)>& load
+  );
+
+  /// @returns the size of the segment's slots, in bytes.
+  uint64_t GetCapacity() const;
+  /// @returns the number of bricks held, for all sources.
+  size_t GetBrickCount() const;
+
+  /// Removes the segment from the system.  Processes attached to it keep
+  /// using it; new caches with the same name get a new segment.
+  static void Remove(const std::string& strName);
+
+  struct Segment;
+
+private:
+  std::shared_ptr<const void> Find(const BrickKey& k, size_t iBytes,
+                                   const std::function<bool (void*)>* load);
+
+  std::shared_ptr<Segment> m_pSegment;
+  uint64_t                 m_iSource[2]; ///< hash of the source's identity
+
+  SharedBrickCache(const SharedBrickCache&);
+  SharedBrickCache& operator=(const SharedBrickCache&);
+};
+
+}
+
+#endif // TUVOK_SHARED_BRICK_CACHE_H
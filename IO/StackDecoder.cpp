@@ -0,0 +1,54 @@
+#include <algorithm>
+#include "StackDecoder.h"
+#include "Basics/TaskScheduler.h"
+#include "Controller/Controller.h"
+
+namespace tuvok {
+
+size_t StackSlicesInFlight(uint64_t iSliceSize, uint64_t iMemBudget) {
+  // the scheduler's workers and the calling thread decode.
+  const uint64_t iThreads =
+    Controller::Instance().Scheduler().GetThreadCount() + 1;
+  // two slices per thread keeps every one busy while we write.
+  uint64_t n = 2*iThreads;
+  if(iSliceSize > 0) { n = std::min(n, iMemBudget / iSliceSize); }
+  return static_cast<size_t>(std::max<uint64_t>(n, 1));
+}
+
+bool DecodeStack(size_t iSlices, SliceDecoder decode, std::ostream& os,
+                 size_t iMaxInFlight, const std::string& strTarget) {
+  iMaxInFlight = std::max<size_t>(iMaxInFlight, 1);
+  std::vector<std::vector<char>> slices(std::min(iMaxInFlight, iSlices));
+
+  for(size_t first=0; first < iSlices; first += slices.size()) {
+    const size_t n = std::min(slices.size(), iSlices-first);
+    std::vector<char> ok(n, 0);
+    Controller::Instance().Scheduler().ParallelFor(0, n, 1,
+      [&](size_t iBegin, size_t iEnd) {
+        for(size_t i=iBegin; i < iEnd; ++i) {
+          ok[i] = decode(first+i, slices[i]) ? 1 : 0;
+        }
+      }
+    );
+
+    for(size_t i=0; i < n; ++i) {
+      if(!ok[i]) {
+        T_ERROR("Decoding slice %u failed.", static_cast<unsigned>(first+i));
+        return false;
+      }
+      if(!slices[i].empty()) {
+        os.write(&slices[i][0], std::streamsize(slices[i].size()));
+      }
+      if(!os) {
+        T_ERROR("Writing slice %u to %s failed.",
+                static_cast<unsigned>(first+i), strTarget.c_str());
+        return false;
+      }
+    }
+    MESSAGE("Creating intermediate file %s\n%u%%", strTarget.c_str(),
+            static_cast<unsigned>((100*(first+n))/iSlices));
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,28 @@
+#ifndef TUVOK_STACK_DECODER_H
+#define TUVOK_STACK_DECODER_H
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace tuvok {
+
+/// Decodes slice 'i' of a stack into the given buffer.  Called concurrently
+/// for different slices, so it must not touch shared state.
+typedef std::function<bool (size_t, std::vector<char>&)> SliceDecoder;
+
+/// Decodes the 'iSlices' slices of a stack concurrently and writes them to
+/// 'os' in stack (i.e. z) order, regardless of the order in which decoding
+/// finished.  At most 'iMaxInFlight' decoded slices are held in memory.
+/// @returns false if any slice failed to decode or could not be written.
+bool DecodeStack(size_t iSlices, SliceDecoder decode, std::ostream& os,
+                 size_t iMaxInFlight, const std::string& strTarget);
+
+/// Number of slices worth decoding concurrently, given the size of one slice
+/// and the memory we may spend on decoded slices.
+size_t StackSlicesInFlight(uint64_t iSliceSize, uint64_t iMemBudget);
+
+}
+
+#endif // TUVOK_STACK_DECODER_H
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include "TimestepPrefetcher.h"
+#include "Controller/Controller.h"
+
+namespace tuvok {
+
+TimestepPrefetcher::TimestepPrefetcher(BrickReader read, size_t iTimesteps,
+                                       size_t iLookahead, uint64_t iMemBudget)
+  : m_Read(read)
+  , m_iTimesteps(std::max<size_t>(iTimesteps, 1))
+  , m_iLookahead(std::min(iLookahead, m_iTimesteps-1))
+  , m_iMemBudget(iMemBudget)
+  , m_iCurrent(0)
+  , m_iMemUsed(0)
+  , m_Scheduler(Controller::Instance().Scheduler())
+  , m_bLoading(false)
+{
+}
+
+TimestepPrefetcher::~TimestepPrefetcher() {
+  TaskFuture<void> loader;
+  {
+    // once cancelled, the loader does not queue itself again.
+    SCOPEDLOCK(m_Guard);
+    m_Cancel.Cancel();
+    loader = m_Loader;
+  }
+  if(loader.Valid()) { loader.Wait(); }
+}
+
+bool TimestepPrefetcher::IsAhead(size_t ts) const {
+  // playback usually loops, so the timestep after the last is the first.
+  const size_t iDistance = (ts + m_iTimesteps - m_iCurrent) % m_iTimesteps;
+  return iDistance > 0 && iDistance <= m_iLookahead;
+}
+
+void TimestepPrefetcher::Evict() {
+  for(BrickMap::iterator b = m_Bricks.begin(); b != m_Bricks.end();) {
+    if(IsAhead(std::get<0>(b->first)) ||
+       std::get<0>(b->first) == m_iCurrent) {
+      ++b;
+    } else {
+      m_iMemUsed -= b->second.size();
+      b = m_Bricks.erase(b);
+    }
+  }
+}
+
+void TimestepPrefetcher::SetTimestep(size_t ts) {
+  {
+    SCOPEDLOCK(m_Guard);
+    ts %= m_iTimesteps;
+    if(ts == m_iCurrent) { return; }
+    m_iCurrent = ts;
+
+    // what was asked for during the previous timestep is our best guess for
+    // the next ones.  Keep the old guess if nothing was rendered meanwhile.
+    if(!m_vRequested.empty()) {
+      m_vWorkingSet.swap(m_vRequested);
+      m_vRequested.clear();
+      m_Requested.clear();
+    }
+
+    Evict();
+    // nearest timestep first; within a timestep, keep the render order.
+    m_Queue.clear();
+    for(size_t d=1; d <= m_iLookahead; ++d) {
+      const size_t t = (m_iCurrent + d) % m_iTimesteps;
+      for(std::vector<BrickKey>::const_iterator b = m_vWorkingSet.begin();
+          b != m_vWorkingSet.end(); ++b) {
+        const BrickKey k(t, std::get<1>(*b), std::get<2>(*b));
+        if(m_Bricks.find(k) == m_Bricks.end()) { m_Queue.push_back(k); }
+      }
+    }
+    Kick();
+  }
+}
+
+bool TimestepPrefetcher::Take(const BrickKey& k, std::vector<uint8_t>& data) {
+  {
+    SCOPEDLOCK(m_Guard);
+    if(std::get<0>(k) == m_iCurrent) {
+      const BrickKey spatial(0, std::get<1>(k), std::get<2>(k));
+      if(m_Requested.insert(spatial).second) {
+        m_vRequested.push_back(spatial);
+      }
+    }
+
+    BrickMap::iterator b = m_Bricks.find(k);
+    if(b == m_Bricks.end()) { return false; }
+    // the brick ends up on the GPU; there is no point in keeping a copy.
+    data.swap(b->second);
+    m_iMemUsed -= data.size();
+    m_Bricks.erase(b);
+    // we may have been waiting for memory to become available.
+    Kick();
+  }
+  return true;
+}
+
+uint64_t TimestepPrefetcher::MemoryUsed() const {
+  SCOPEDLOCK(m_Guard);
+  return m_iMemUsed;
+}
+
+bool TimestepPrefetcher::HaveWork() const {
+  return !m_Queue.empty() && m_iMemUsed < m_iMemBudget;
+}
+
+void TimestepPrefetcher::Kick() {
+  if(m_bLoading || m_Cancel.Cancelled() || !HaveWork()) { return; }
+  m_bLoading = true;
+  m_Loader = m_Scheduler.Submit([this]() { Load(); },
+                                TaskScheduler::PRIORITY_BACKGROUND, m_Cancel);
+}
+
+void TimestepPrefetcher::Load() {
+  BrickKey k;
+  {
+    SCOPEDLOCK(m_Guard);
+    if(!HaveWork()) {
+      m_bLoading = false;
+      return;
+    }
+    k = m_Queue.front();
+    m_Queue.pop_front();
+  }
+
+  // on failure the render thread will read (and complain about) the brick
+  // itself; the debug output is not ours to use from a worker.
+  std::vector<uint8_t> data;
+  const bool bRead = m_Read(k, data);
+
+  SCOPEDLOCK(m_Guard);
+  m_bLoading = false;
+  // playback may have moved on while we were reading.
+  if(bRead && (IsAhead(std::get<0>(k)) || std::get<0>(k) == m_iCurrent)) {
+    if(m_iMemUsed + data.size() > m_iMemBudget) {
+      m_Queue.clear();
+    } else {
+      m_iMemUsed += data.size();
+      m_Bricks[k].swap(data);
+    }
+  }
+  // a task per brick, so that interactive work can overtake us in between.
+  Kick();
+}
+
+}
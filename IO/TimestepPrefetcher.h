@@ -0,0 +1,86 @@
+#ifndef TUVOK_TIMESTEP_PREFETCHER_H
+#define TUVOK_TIMESTEP_PREFETCHER_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Brick.h"
+#include "Basics/TaskScheduler.h"
+
+namespace tuvok {
+
+/// Loads the bricks of upcoming timesteps in the background while the
+/// current one is rendered, one brick per background task on the
+/// controller's task scheduler.  Which bricks to load is learned from the
+/// requests made for the current timestep: during playback the renderer asks
+/// for the same LoDs and bricks in the next timestep, too.
+class TimestepPrefetcher {
+public:
+  /// Reads the raw data of one brick.  Called from a worker of the task
+  /// scheduler, so it must synchronize with other readers of the same file.
+  typedef std::function<bool (const BrickKey&, std::vector<uint8_t>&)>
+    BrickReader;
+
+  /// @param iTimesteps number of timesteps in the dataset
+  /// @param iLookahead number of timesteps beyond the current one to load
+  /// @param iMemBudget bytes we may hold in prefetched bricks
+  TimestepPrefetcher(BrickReader read, size_t iTimesteps, size_t iLookahead,
+                     uint64_t iMemBudget);
+  ~TimestepPrefetcher();
+
+  /// Playback moved to timestep 'ts': drops the bricks which are no longer
+  /// ahead of playback and queues those of the following timesteps.
+  void SetTimestep(size_t ts);
+
+  /// Hands out a prefetched brick if we have it.  Every call is also noted as
+  /// a request for the current timestep, to guide the next prefetch.
+  /// @returns false if the brick must be read by the caller.
+  bool Take(const BrickKey& k, std::vector<uint8_t>& data);
+
+  /// @returns the number of bytes currently held in prefetched bricks.
+  uint64_t MemoryUsed() const;
+
+private:
+  /// queues the loader unless it is queued or running; needs m_Guard.
+  void Kick();
+  /// the loader task: loads one brick and queues itself again.
+  void Load();
+  /// @returns true if a brick is queued and there is room for it.
+  bool HaveWork() const;
+  /// @returns true if 'ts' is one of the timesteps we prefetch.
+  bool IsAhead(size_t ts) const;
+  void Evict();
+
+  typedef std::unordered_map<BrickKey, std::vector<uint8_t>, BKeyHash>
+    BrickMap;
+  typedef std::unordered_set<BrickKey, BKeyHash> KeySet;
+
+  BrickReader               m_Read;
+  const size_t              m_iTimesteps;
+  const size_t              m_iLookahead;
+  const uint64_t            m_iMemBudget;
+
+  mutable CriticalSection   m_Guard;
+  size_t                    m_iCurrent;
+  uint64_t                  m_iMemUsed;
+  BrickMap                  m_Bricks;
+  std::deque<BrickKey>      m_Queue;
+  /// LoD and brick index (timestep 0) of the bricks we prefetch per timestep
+  std::vector<BrickKey>     m_vWorkingSet;
+  /// requests seen for the current timestep, in the order they came in
+  std::vector<BrickKey>     m_vRequested;
+  KeySet                    m_Requested;
+
+  TaskScheduler&            m_Scheduler;
+  CancelToken               m_Cancel;
+  /// set while the loader is queued or running.
+  bool                      m_bLoading;
+  TaskFuture<void>          m_Loader;
+};
+
+}
+
+#endif // TUVOK_TIMESTEP_PREFETCHER_H
@@ -75,7 +75,7 @@ static void fill_buffer_from_file(std::vector<char>& buf, const char *fn,
 struct j_implementation : public JPEG::j_impl {
   // the reference to jpg_error avoids an 'unused function' warning.
   j_implementation() { (void)jpg_error; }
-  void set_data(const std::vector<char>&) { }
+  bool set_data(const std::vector<char>&) { return false; }
   virtual ~j_implementation() { }
   std::vector<char> data;       ///< hunk of memory we'll read the jpeg from.
   bool started;                 ///< whether we've started decompressing
@@ -101,18 +101,20 @@ struct j_implementation : public JPEG::j_impl {
   // Expects to get the entire JPEG buffer, but only reads the header.
   // After calling this, it is safe to query the JPEG metadata from
   // this->jinfo.
-  // Copies the data from the argument.
-  void set_data(const std::vector<char>& mem) {
+  // Copies the data from the argument.  Does not log; the caller reports
+  // failures, if it wants to.
+  bool set_data(const std::vector<char>& mem) {
+    if(mem.empty()) { return false; }
     this->data = mem;
     this->jinfo.src->bytes_in_buffer = this->data.size();
     this->jinfo.src->next_input_byte = &(this->data.at(0));
     if(jpeg_read_header(&(this->jinfo), TRUE) != JPEG_HEADER_OK) {
-      T_ERROR("Could not read JPEG header, bailing...");
-      return;
+      return false;
     }
     if(jpeg_start_decompress(&(this->jinfo))) {
       started = true;
     }
+    return true;
   }
 
   virtual ~j_implementation() {
@@ -140,7 +142,9 @@ JPEG::JPEG(const std::string &fn, std::streamoff offset) :
     T_ERROR("No data in %s", fn.c_str());
     return;
   }
-  this->initialize();
+  if(!this->initialize()) {
+    T_ERROR("Could not read JPEG header of %s", fn.c_str());
+  }
 }
 
 JPEG::JPEG(const std::vector<char>& buf) :
@@ -213,25 +217,29 @@ const char* JPEG::data()
 #endif // TUVOK_NO_IO
 }
 
-void JPEG::initialize()
+bool JPEG::initialize()
 {
   j_implementation *jimpl = dynamic_cast<j_implementation*>(this->jpeg_impl);
 
   jimpl->jinfo.src->fill_input_buffer = fill_input_buffer;
-  jimpl->set_data(this->buffer);
+  if(!jimpl->set_data(this->buffer)) { return false; }
 
   this->w = jimpl->jinfo.output_width;
   this->h = jimpl->jinfo.output_height;
   this->bpp = jimpl->jinfo.output_components;
+  return true;
 }
 
 /// Overly complex, too much so to be worth explaining.  Basically JPEG will
-/// call this when it runs out of data to process.  In our case this should
-/// never happen, because we read the whole JPEG before giving it to the
-/// library -- all the data are already resident.
-boolean fill_input_buffer(j_decompress_ptr)
+/// call this when it runs out of data to process.  We read the whole JPEG
+/// before giving it to the library, so this only happens for truncated data;
+/// like libjpeg's own sources, we then hand out an end-of-image marker so
+/// that decoding stops.  Does not log: we may run on a decoder thread.
+boolean fill_input_buffer(j_decompress_ptr jinfo)
 {
-  T_ERROR("unexpected fill_input_buffer");
+  static const JOCTET eoi[2] = { JOCTET(0xFF), JOCTET(JPEG_EOI) };
+  jinfo->src->next_input_byte = eoi;
+  jinfo->src->bytes_in_buffer = 2;
   return TRUE;
 }
 
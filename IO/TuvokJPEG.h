@@ -55,7 +55,8 @@ class JPEG {
     /// Loads a JPEG from a file, starting at the given offset.
     JPEG(const std::string &, std::streamoff offset=0);
 
-    /// Loads a JPEG from an in-memory buffer.
+    /// Loads a JPEG from an in-memory buffer.  Does not log, so it may be
+    /// used on worker threads; check valid() instead.
     JPEG(const std::vector<char>& buf);
     ~JPEG();
 
@@ -90,7 +91,8 @@ class JPEG {
     JPEG();
 
     /// Sets up jpeg_impl.  Reads header information.
-    void initialize();
+    /// @returns false if the header could not be read.
+    bool initialize();
 
   private:
     size_t w, h;
@@ -22,9 +22,14 @@
  DEALINGS IN THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <stdexcept>
 #include "ExtendedOctree.h"
+#include "Basics/MemMappedFile.h"
 #include "Basics/nonstd.h"
+#include "Basics/Threads.h"
 #include "Basics/Timer.h"
 #include "Controller/Controller.h"
 #include "Controller/StackTimer.h"
@@ -58,6 +63,38 @@ void ExtendedOctree::InitLzmaCompression()
   }
 }
 
+namespace {
+  // below this, reading the whole ToC takes about as long as mapping it
+  const uint64_t LAZY_TOC_MIN_BRICKS = 65536;
+  // ToC entries read per call in ReadTOC
+  const size_t TOC_BLOCK_ENTRIES = 65536;
+
+  // the ToC is stored unaligned and in the byte order of the machine that
+  // wrote it, which is assumed to be ours (see WriteHeader)
+  template<class T> T Load(const uint8_t*& p) {
+    T value;
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+  }
+  template<class T> void Store(uint8_t*& p, T value) {
+    memcpy(p, &value, sizeof(T));
+    p += sizeof(T);
+  }
+
+  void DecodeTOCEntries(const uint8_t* p, size_t iCount, TOCEntry* pEntries) {
+    for (size_t i = 0;i<iCount;i++) {
+      TOCEntry& e = pEntries[i];
+      e.m_iOffset = Load<uint64_t>(p);
+      e.m_iLength = Load<uint64_t>(p);
+      e.m_eCompression = static_cast<COMPRESSION_TYPE>(Load<uint32_t>(p));
+      e.m_iValidLength = Load<uint64_t>(p);
+      e.m_iAtlasSize.x = Load<uint32_t>(p);
+      e.m_iAtlasSize.y = Load<uint32_t>(p);
+    }
+  }
+}
+
 /*
  Open (string):
  
@@ -65,12 +102,12 @@ void ExtendedOctree::InitLzmaCompression()
  constructed from the given string
  */
 bool ExtendedOctree::Open(std::string filename, uint64_t iOffset,
-                          uint64_t iUVFFileVersion) {
+                          uint64_t iUVFFileVersion, bool bLazyTOC) {
   LargeRAWFile_ptr inFile(new LargeRAWFile(filename));
   if (!inFile->Open()) {
     return false;
   }
-  return Open(inFile, iOffset, iUVFFileVersion);
+  return Open(inFile, iOffset, iUVFFileVersion, bLazyTOC);
 }
 
 /*
@@ -83,12 +120,15 @@ bool ExtendedOctree::Open(std::string filename, uint64_t iOffset,
  which contains per brick information about their sizes, compression 
  methods and offsets in the file. After reading the global information
  about the level of detail, it can be computed.
+ Large datasets have millions of bricks, so the ToC is read in big blocks;
+ with bLazyTOC it is only mapped and each LoD is decoded on first use.
 */
 bool ExtendedOctree::Open(LargeRAWFile_ptr pLargeRAWFile, uint64_t iOffset,
-                          uint64_t iUVFFileVersion) {
+                          uint64_t iUVFFileVersion, bool bLazyTOC) {
   if (!pLargeRAWFile->IsOpen()) return false;
   m_pLargeRAWFile = pLargeRAWFile;
   m_iOffset = iOffset;
+  m_pLazyTOC.reset();
 
   const bool isBE = EndianConvert::IsBigEndian();
 
@@ -136,34 +176,115 @@ bool ExtendedOctree::Open(LargeRAWFile_ptr pLargeRAWFile, uint64_t iOffset,
   ComputeMetadata();
   uint64_t iOverallBrickCount = ComputeBrickCount();
 
-  // read brick TOC
+  // read brick TOC; version 0 files store no offsets, so we need to look at
+  // all entries right away to compute them
+  m_vTOC.clear();
   m_vTOC.resize(size_t(iOverallBrickCount));
-  if (m_iVersion > 0) {
-    for (size_t i = 0;i<iOverallBrickCount;i++) {
-      m_pLargeRAWFile->ReadData(m_vTOC[i].m_iOffset, isBE);
-      m_pLargeRAWFile->ReadData(m_vTOC[i].m_iLength, isBE);
-      uint32_t comp;
-      m_pLargeRAWFile->ReadData(comp, isBE);
-      m_vTOC[i].m_eCompression = static_cast<COMPRESSION_TYPE>(comp);
-      m_pLargeRAWFile->ReadData(m_vTOC[i].m_iValidLength, isBE);
-      m_pLargeRAWFile->ReadData(m_vTOC[i].m_iAtlasSize.x, isBE);
-      m_pLargeRAWFile->ReadData(m_vTOC[i].m_iAtlasSize.y, isBE);
+  if (bLazyTOC && m_iVersion > 0 && iOverallBrickCount >= LAZY_TOC_MIN_BRICKS &&
+      MapTOC(iOverallBrickCount)) {
+    return true;
+  }
+  return ReadTOC(iOverallBrickCount);
+}
+
+/*
+ ReadTOC:
+
+ Reads the ToC in blocks of TOC_BLOCK_ENTRIES and decodes them from the
+ buffer, rather than issuing a read call per field of every brick.
+*/
+bool ExtendedOctree::ReadTOC(uint64_t iBrickCount) {
+  // version 0 stores just length and compression
+  const size_t iEntrySize = m_iVersion > 0
+    ? TOCEntry::SizeInFile(m_iVersion)
+    : sizeof(uint64_t /*m_iLength*/) + sizeof(uint32_t /*m_eCompression*/);
+  std::vector<uint8_t> buffer(size_t(std::min<uint64_t>(iBrickCount,
+                                                        TOC_BLOCK_ENTRIES)) *
+                              iEntrySize);
+  uint64_t iLoDOffset = ComputeHeaderSize();
+  for (uint64_t iFirst = 0;iFirst<iBrickCount;iFirst += TOC_BLOCK_ENTRIES) {
+    const size_t iCount = size_t(std::min<uint64_t>(iBrickCount-iFirst,
+                                                    TOC_BLOCK_ENTRIES));
+    if (m_pLargeRAWFile->ReadRAW(&buffer[0], iCount*iEntrySize) !=
+        iCount*iEntrySize) {
+      return false;
     }
-  } else {
-    uint64_t iLoDOffset = ComputeHeaderSize();
-    for (size_t i = 0;i<iOverallBrickCount;i++) {
-      m_vTOC[i].m_iOffset = iLoDOffset;
-      m_pLargeRAWFile->ReadData(m_vTOC[i].m_iLength, isBE);
-      uint32_t comp;
-      m_pLargeRAWFile->ReadData(comp, isBE);
-      m_vTOC[i].m_eCompression = static_cast<COMPRESSION_TYPE>(comp);
-      iLoDOffset += m_vTOC[i].m_iLength;
+    TOCEntry* pEntries = &m_vTOC[size_t(iFirst)];
+    if (m_iVersion > 0) {
+      DecodeTOCEntries(&buffer[0], iCount, pEntries);
+    } else {
+      const uint8_t* p = &buffer[0];
+      for (size_t i = 0;i<iCount;i++) {
+        pEntries[i].m_iOffset = iLoDOffset;
+        pEntries[i].m_iLength = Load<uint64_t>(p);
+        pEntries[i].m_eCompression =
+          static_cast<COMPRESSION_TYPE>(Load<uint32_t>(p));
+        iLoDOffset += pEntries[i].m_iLength;
+      }
     }
   }
+  return true;
+}
+
+/// a ToC mapped by a lazy Open, and which of its LoDs are decoded already
+struct ExtendedOctree::LazyTOC {
+  std::unique_ptr<MemMappedFile>        file;
+  std::unique_ptr<std::atomic<bool>[]>  decoded;
+  tuvok::CriticalSection                guard;
+};
+
+/*
+ MapTOC:
+
+ Maps the ToC instead of reading it; only the pages of the LoDs that are
+ actually used will be touched. The file position is moved behind the ToC
+ as if it had been read.
+*/
+bool ExtendedOctree::MapTOC(uint64_t iBrickCount) {
+  const uint64_t iTOCPos = m_pLargeRAWFile->GetPos();
+  const uint64_t iTOCSize = iBrickCount * TOCEntry::SizeInFile(m_iVersion);
+
+  std::shared_ptr<LazyTOC> lazy(new LazyTOC());
+  lazy->file.reset(new MemMappedFile(m_pLargeRAWFile->GetFilename(),
+                                     MMFILE_ACCESS_READONLY, 0,
+                                     m_pLargeRAWFile->GetHeaderSize() + iTOCPos,
+                                     iTOCSize));
+  if (!lazy->file->IsOpen() ||
+      lazy->file->GetFileLength() <
+        m_pLargeRAWFile->GetHeaderSize() + iTOCPos + iTOCSize) {
+    return false;
+  }
+  lazy->decoded.reset(new std::atomic<bool>[m_vLODTable.size()]);
+  for (size_t i = 0;i<m_vLODTable.size();i++) lazy->decoded[i] = false;
 
+  m_pLargeRAWFile->SeekPos(iTOCPos + iTOCSize);
+  m_pLazyTOC = lazy;
   return true;
 }
 
+void ExtendedOctree::DecodeLazyTOC(uint64_t iLoD) const {
+  LazyTOC& lazy = *m_pLazyTOC;
+  if (lazy.decoded[size_t(iLoD)]) return;
+
+  SCOPEDLOCK(lazy.guard);
+  if (lazy.decoded[size_t(iLoD)]) return;
+  const LODInfo& l = m_vLODTable[size_t(iLoD)];
+  const uint8_t* p = static_cast<const uint8_t*>(lazy.file->GetDataPointer()) +
+                     l.m_iLoDOffset * TOCEntry::SizeInFile(m_iVersion);
+  DecodeTOCEntries(p, size_t(l.m_iLODBrickCount.volume()),
+                   &m_vTOC[size_t(l.m_iLoDOffset)]);
+  lazy.decoded[size_t(iLoD)] = true;
+}
+
+/*
+ LoadTOC:
+
+ Decodes all LoDs a lazy Open did not decode yet
+*/
+void ExtendedOctree::LoadTOC() const {
+  for (uint64_t i = 0;i<m_vLODTable.size();i++) LoadTOC(i);
+}
+
 /*
  Close:
  
@@ -295,10 +416,12 @@ DOUBLEVECTOR3 ExtendedOctree::GetBrickAspect(const UINT64VECTOR4& vBrickCoords)
 
 
 const TOCEntry& ExtendedOctree::GetBrickToCData(const UINT64VECTOR4& vBrickCoords) const {
+  LoadTOC(vBrickCoords.w);
   return m_vTOC[size_t(BrickCoordsToIndex(vBrickCoords))];
 }
 
 const TOCEntry& ExtendedOctree::GetBrickToCData(size_t index) const {
+  if (m_pLazyTOC) LoadTOC(IndexToBrickCoords(index).w);
   return m_vTOC[index];
 }
 
@@ -306,19 +429,20 @@ const TOCEntry& ExtendedOctree::GetBrickToCData(size_t index) const {
  GetBrickData (scalar):
  
  Reads a brick from file and decompresses it if necessary. No magic here it 
- simply seeks to the position in the file, which is the header offset + the 
- brick-offset from the header, and then reads the data. Finally, checks if
- decompression is required.
+ simply reads the data at the header offset + the brick-offset from the
+ header. Finally, checks if decompression is required. The read does not touch
+ the file position, so several threads may fetch bricks at the same time.
 */ 
 void ExtendedOctree::GetBrickData(uint8_t* pData, uint64_t index) const {
 
   tuvok::Controller::Instance().IncrementPerfCounter(PERF_EO_BRICKS, 1.0);
+  if (m_pLazyTOC) LoadTOC(IndexToBrickCoords(index).w);
 
   if(m_vTOC[size_t(index)].m_eCompression == CT_NONE) {
     // not compressed, just read it directly into the buffer.
     tuvok::StackTimer t(PERF_EO_DISK_READ);
-    m_pLargeRAWFile->SeekPos(m_iOffset+m_vTOC[size_t(index)].m_iOffset);
-    m_pLargeRAWFile->ReadRAW(pData, m_vTOC[size_t(index)].m_iLength);
+    m_pLargeRAWFile->ReadAt(m_iOffset+m_vTOC[size_t(index)].m_iOffset, pData,
+                            m_vTOC[size_t(index)].m_iLength);
     return;
   }
 
@@ -331,24 +455,39 @@ void ExtendedOctree::GetBrickData(uint8_t* pData, uint64_t index) const {
 
   std::shared_ptr<uint8_t> buf(new uint8_t[uncompressedSize],
                                nonstd::DeleteArray<uint8_t>());
-  std::shared_ptr<uint8_t> out(pData, nonstd::null_deleter());
   TimedStatement(PERF_EO_DISK_READ,
-    m_pLargeRAWFile->SeekPos(m_iOffset+m_vTOC[size_t(index)].m_iOffset);
-    m_pLargeRAWFile->ReadRAW(buf.get(), m_vTOC[size_t(index)].m_iLength);
+    m_pLargeRAWFile->ReadAt(m_iOffset+m_vTOC[size_t(index)].m_iOffset,
+                            buf.get(), m_vTOC[size_t(index)].m_iLength);
   );
   tuvok::StackTimer decompress(PERF_EO_DECOMPRESSION);
+  DecompressBrick(buf, pData, index);
+}
+
+void ExtendedOctree::DecompressBrick(std::shared_ptr<uint8_t> payload,
+                                     uint8_t* pData, uint64_t index) const {
+  if(m_vTOC[size_t(index)].m_eCompression == CT_NONE) {
+    memcpy(pData, payload.get(), size_t(m_vTOC[size_t(index)].m_iLength));
+    return;
+  }
+
+  const size_t uncompressedSize =
+    this->ComputeBrickSize(this->IndexToBrickCoords(index)).volume() *
+    this->GetComponentCount() *
+    this->GetComponentTypeSize();
+
+  std::shared_ptr<uint8_t> out(pData, nonstd::null_deleter());
   switch (m_vTOC[size_t(index)].m_eCompression) {
   case CT_ZLIB:
-    zDecompress(buf, out, uncompressedSize);
+    zDecompress(payload, out, uncompressedSize);
     break;
   case CT_LZMA:
-    lzmaDecompress(buf, out, uncompressedSize, m_lzmaProps);
+    lzmaDecompress(payload, out, uncompressedSize, m_lzmaProps);
     break;
   case CT_LZ4:
-    lz4Decompress(buf, out, uncompressedSize);
+    lz4Decompress(payload, out, uncompressedSize);
     break;
   case CT_BZLIB:
-    bzDecompress(buf, size_t(m_vTOC[size_t(index)].m_iLength),
+    bzDecompress(payload, size_t(m_vTOC[size_t(index)].m_iLength),
                  out, uncompressedSize);
     break;
   case CT_LZHAM:
@@ -530,15 +669,24 @@ void ExtendedOctree::WriteHeader(LargeRAWFile_ptr pLargeRAWFile,
     m_pLargeRAWFile->WriteData(m_iCompressionLevel, isBE);
   }
 
-  // write ToC
+  // write ToC, in blocks like ReadTOC reads it
   if (m_iVersion > 0) {
-    for (size_t i = 0;i<m_vTOC.size();i++) {
-      m_pLargeRAWFile->WriteData(m_vTOC[i].m_iOffset, isBE);
-      m_pLargeRAWFile->WriteData(m_vTOC[i].m_iLength, isBE);
-      m_pLargeRAWFile->WriteData(uint32_t(m_vTOC[i].m_eCompression), isBE);
-      m_pLargeRAWFile->WriteData(m_vTOC[i].m_iValidLength, isBE);
-      m_pLargeRAWFile->WriteData(m_vTOC[i].m_iAtlasSize.x, isBE);
-      m_pLargeRAWFile->WriteData(m_vTOC[i].m_iAtlasSize.y, isBE);
+    LoadTOC();
+    const size_t iEntrySize = TOCEntry::SizeInFile(m_iVersion);
+    std::vector<uint8_t> buffer(std::min(m_vTOC.size(), TOC_BLOCK_ENTRIES) *
+                                iEntrySize);
+    for (size_t iFirst = 0;iFirst<m_vTOC.size();iFirst += TOC_BLOCK_ENTRIES) {
+      const size_t iCount = std::min(m_vTOC.size()-iFirst, TOC_BLOCK_ENTRIES);
+      uint8_t* p = &buffer[0];
+      for (size_t i = iFirst;i<iFirst+iCount;i++) {
+        Store(p, m_vTOC[i].m_iOffset);
+        Store(p, m_vTOC[i].m_iLength);
+        Store(p, uint32_t(m_vTOC[i].m_eCompression));
+        Store(p, m_vTOC[i].m_iValidLength);
+        Store(p, m_vTOC[i].m_iAtlasSize.x);
+        Store(p, m_vTOC[i].m_iAtlasSize.y);
+      }
+      m_pLargeRAWFile->WriteRAW(&buffer[0], iCount*iEntrySize);
     }
   } else {
     for (size_t i = 0;i<m_vTOC.size();i++) {
@@ -591,7 +739,7 @@ bool ExtendedOctree::ReOpenRW() {
   m_pLargeRAWFile->Close();
 
   // re-open in read/write mode
-  if (m_pLargeRAWFile->Open(true)) {
+  if (!m_pLargeRAWFile->Open(true)) {
     
     // if opening in rw failed, return to read only mode
     m_pLargeRAWFile->Open(false);
@@ -155,18 +155,29 @@ public:
     @param  pLargeRAWFile the file the header is read from, file must be open already
     @param  iOffset the bytes to be skipped from the beginning of the file to get to the octree header
     @param  iUVFFileVersion UVF file version
+    @param  bLazyTOC if true, large ToCs are mapped into memory and the entries of a LoD are only decoded when they are first needed
     @return returns false if something went wrong trying to read from the file
   */
-  bool Open(LargeRAWFile_ptr pLargeRAWFile, uint64_t iOffset, uint64_t iUVFFileVersion);
+  bool Open(LargeRAWFile_ptr pLargeRAWFile, uint64_t iOffset, uint64_t iUVFFileVersion,
+            bool bLazyTOC=false);
 
   /**
     Reads the header information from an file skipping iOffset bytes at the beginning
     @param  filename the name of the input file
     @param  iOffset the bytes to be skipped from the beginning of the file to get to the octree header
     @param  iUVFFileVersion UVF file version
+    @param  bLazyTOC see above
     @return returns false if something went wrong trying to read from the file
   */
-  bool Open(std::string filename, uint64_t iOffset, uint64_t iUVFFileVersion);
+  bool Open(std::string filename, uint64_t iOffset, uint64_t iUVFFileVersion,
+            bool bLazyTOC=false);
+
+  /**
+    Decodes the parts of the ToC a lazy Open skipped. Must be called before
+    the tree is handed to the ExtendedOctreeConverter, which works on the
+    whole ToC.
+  */
+  void LoadTOC() const;
 
 
   /**
@@ -347,8 +358,13 @@ private:
   /// pointer to the data file
   LargeRAWFile_ptr m_pLargeRAWFile;
 
-  /// the table of contents of the file, it holds the metadata for all bricks
-  std::vector<TOCEntry> m_vTOC;
+  /// the table of contents of the file, it holds the metadata for all bricks;
+  /// mutable as a lazy Open fills it in on first use
+  mutable std::vector<TOCEntry> m_vTOC;
+
+  /// the mapped ToC of a lazy Open, NULL otherwise
+  struct LazyTOC;
+  std::shared_ptr<LazyTOC> m_pLazyTOC;
 
   /// table of LoD metadata
   std::vector<LODInfo> m_vLODTable;
@@ -366,6 +382,29 @@ private:
   */
   void ComputeMetadata();
 
+  /**
+    Reads the ToC, which starts at the current position of the file, in a few large blocks
+    @param  iBrickCount the number of ToC entries
+    @return false if the file ends before the ToC does
+  */
+  bool ReadTOC(uint64_t iBrickCount);
+
+  /**
+    Maps the ToC, which starts at the current position of the file, for LoadTOC to decode later
+    @param  iBrickCount the number of ToC entries
+    @return false if the file could not be mapped
+  */
+  bool MapTOC(uint64_t iBrickCount);
+
+  /**
+    Decodes the ToC entries of a LoD if a lazy Open skipped them
+    @param  iLoD the level to decode
+  */
+  void LoadTOC(uint64_t iLoD) const {
+    if (m_pLazyTOC) DecodeLazyTOC(iLoD);
+  }
+  void DecodeLazyTOC(uint64_t iLoD) const;
+
   /**
     Computes the size of the header, as the header contains the brick ToC it varies from dataset to dataset
     @return the size of the header
@@ -402,6 +441,16 @@ private:
   */
   void GetBrickData(uint8_t* pData, uint64_t index) const;
 
+  /**
+    expands the payload of a brick as it is stored on disk into its raw data,
+    does not touch the file so it may be called concurrently
+    @param payload the m_iLength bytes of the brick as they are stored on disk, in a buffer as large as the raw data (the decompressors may read ahead)
+    @param pData the raw (uncompressed) data of the brick, the user has to make sure pData is big enough to hold the data
+    @param index the index of the brick in the LoD table
+  */
+  void DecompressBrick(std::shared_ptr<uint8_t> payload, uint8_t* pData,
+                       uint64_t index) const;
+
   /** 
     returns true iff the large raw file holding this tree's
     data is is currently in RW mode
@@ -24,6 +24,10 @@
 
 // for find_if
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <list>
 #include <memory>
 #include <map>
 #include <unordered_map>
@@ -33,6 +37,7 @@
 #include "Basics/Timer.h"
 #include "Basics/PerfCounter.h"
 #include "Basics/nonstd.h"
+#include "Basics/TaskScheduler.h"
 #include "Controller/Controller.h"
 #include "DebugOut/AbstrDebugOut.h"
 #include "ExtendedOctreeConverter.h"
@@ -240,6 +245,20 @@ bool ExtendedOctreeConverter::Convert(LargeRAWFile_ptr pLargeRAWFileIn,
         break;
     }
   }
+  FinishTree(e, pLargeRAWFileOut, iOutOffset);
+  return true;
+}
+
+/*
+  FinishTree:
+
+  Everything that remains to be done once all bricks of a tree are in
+  place: compute the brick statistics, compress and reorder the bricks as
+  requested, write the header and cut off the temporary data at the end.
+*/
+void ExtendedOctreeConverter::FinishTree(ExtendedOctree& e,
+                                         LargeRAWFile_ptr pLargeRAWFileOut,
+                                         uint64_t iOutOffset) {
   // write bricks in the cache to disk
   FlushCache(e);
   {
@@ -275,10 +294,245 @@ bool ExtendedOctreeConverter::Convert(LargeRAWFile_ptr pLargeRAWFileIn,
   pLargeRAWFileOut->Truncate(iOutOffset + e.m_iSize);
 
   m_fProgress = 1.0f;
+}
+
+class ExtendedOctreeConverter::SourceBrickCache {
+public:
+  SourceBrickCache(const ExtendedOctree& source, uint64_t iMemLimit) :
+    m_Source(source),
+    m_iMaxBricks(std::max<uint64_t>(1, iMemLimit /
+                                       (source.m_iBrickSize.volume() *
+                                        source.GetComponentTypeSize() *
+                                        source.GetComponentCount())))
+  {}
+
+  /// @returns the (decompressed) data of the given brick of the source
+  std::vector<uint8_t>& Get(const UINT64VECTOR4& vBrickCoords) {
+    const uint64_t index = m_Source.BrickCoordsToIndex(vBrickCoords);
+    const auto cached = m_Index.find(index);
+    if (cached != m_Index.end()) {
+      m_Bricks.splice(m_Bricks.begin(), m_Bricks, cached->second);
+      return m_Bricks.front().second;
+    }
+
+    if (m_Bricks.size() >= m_iMaxBricks) {
+      // recycle the memory of the least recently used brick
+      m_Index.erase(m_Bricks.back().first);
+      m_Bricks.splice(m_Bricks.begin(), m_Bricks, std::prev(m_Bricks.end()));
+    } else {
+      m_Bricks.push_front(Entry());
+    }
+    Entry& e = m_Bricks.front();
+    e.first = index;
+    e.second.resize(size_t(m_Source.ComputeBrickSize(vBrickCoords).volume() *
+                           m_Source.GetComponentTypeSize() *
+                           m_Source.GetComponentCount()));
+    m_Source.GetBrickData(&e.second[0], vBrickCoords);
+    m_Index[index] = m_Bricks.begin();
+    return e.second;
+  }
+
+private:
+  typedef std::pair<uint64_t, std::vector<uint8_t>> Entry;
+
+  const ExtendedOctree& m_Source;
+  const uint64_t m_iMaxBricks;
+  /// most recently used brick first
+  std::list<Entry> m_Bricks;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> m_Index;
+};
+
+/*
+  ReBrick:
+
+  Works like Convert, but takes the bricks from an existing tree instead
+  of a raw file. The LoD sizes depend only on the volume size, so each LoD
+  of the new tree is cut from the same LoD of the source tree and no LoD
+  is computed again.
+*/
+bool ExtendedOctreeConverter::ReBrick(const ExtendedOctree& source,
+                                      LargeRAWFile_ptr pLargeRAWFileOut,
+                                      uint64_t iOutOffset,
+                                      BrickStatVec* stats,
+                                      COMPRESSION_TYPE compression,
+                                      uint32_t iCompressionLevel,
+                                      bool bClampToEdge,
+                                      LAYOUT_TYPE layout) {
+  m_pBrickStatVec = stats;
+  m_fProgress = 0.0f;
+
+  ExtendedOctree e;
+
+  // compute metadata
+  e.m_eComponentType = source.m_eComponentType;
+  e.m_iComponentCount = source.m_iComponentCount;
+  e.m_vVolumeSize = source.m_vVolumeSize;
+  e.m_vVolumeAspect = source.m_vVolumeAspect;
+  e.m_iBrickSize = m_vBrickSize;
+  e.m_iOverlap = m_iOverlap;
+  e.m_iOffset = iOutOffset;
+  e.m_pLargeRAWFile = pLargeRAWFileOut;
+  e.m_iCompressionLevel = iCompressionLevel;
+  e.ComputeMetadata();
+
+  if (e.GetLODCount() != source.GetLODCount()) {
+    m_Progress.Error(_func_, "Source tree has %llu LoDs, expected %llu.",
+                     static_cast<unsigned long long>(source.GetLODCount()),
+                     static_cast<unsigned long long>(e.GetLODCount()));
+    return false;
+  }
+
+  m_eCompression = compression;
+  m_eLayout = layout;
+
+  // the source bricks get half of our memory, the write cache the rest
+  const uint64_t iSourceCacheSize = m_iMemLimit/2;
+  m_iMemLimit -= iSourceCacheSize;
+  SetupCache(e);
+  m_iMemLimit += iSourceCacheSize;
+  SourceBrickCache cache(source, iSourceCacheSize);
+
+  std::vector<uint8_t> vData;
+  const uint64_t iBrickCount = e.ComputeBrickCount();
+  uint64_t iBricksDone = 0;
+  uint64_t iCurrentOutOffset = e.ComputeHeaderSize();
+  for (uint64_t LoD = 0;LoD<e.GetLODCount();LoD++) {
+    const UINT64VECTOR3 bricksInThisLoD = e.GetBrickCount(LoD);
+    for (uint64_t z = 0;z<bricksInThisLoD.z;z++) {
+      for (uint64_t y = 0;y<bricksInThisLoD.y;y++) {
+        for (uint64_t x = 0;x<bricksInThisLoD.x;x++) {
+          const UINT64VECTOR4 coords(x,y,z,LoD);
+          const uint64_t iUncompressedBrickSize =
+            e.ComputeBrickSize(coords).volume() *
+            e.GetComponentTypeSize() *
+            e.GetComponentCount();
+          TOCEntry t = {iCurrentOutOffset, iUncompressedBrickSize, CT_NONE,
+                        iUncompressedBrickSize, UINTVECTOR2(0,0)};
+          e.m_vTOC.push_back(t);
+
+          GetSourceTreeBrick(vData, e, source, cache, coords, bClampToEdge);
+          SetBrick(&(vData[0]), e, coords);
+
+          iCurrentOutOffset += iUncompressedBrickSize;
+          ++iBricksDone;
+        }
+        m_fProgress = MathTools::lerp(float(iBricksDone) / iBrickCount,
+                                      0.0f,1.0f, 0.0f,0.8f);
+        const std::string msg = m_pProgressTimer->GetProgressMessage(m_fProgress);
+        m_Progress.Message(_func_, "Rebricking LOD %u ... %5.2f%% (%s)",
+                           static_cast<unsigned>(LoD), m_fProgress*100.0f,
+                           msg.c_str());
+      }
+    }
+  }
 
+  FinishTree(e, pLargeRAWFileOut, iOutOffset);
   return true;
 }
 
+/*
+  GetSourceTreeBrick:
+
+  Fills a brick of the new tree from the bricks of the source tree that
+  intersect it. Only the non-overlap part of the source bricks is used, so
+  every voxel is copied from the one brick that owns it. Voxels outside of
+  the volume are zero or clamped, as in GetInputBrick.
+*/
+void ExtendedOctreeConverter::GetSourceTreeBrick(std::vector<uint8_t>& vData,
+                                                 ExtendedOctree &tree,
+                                                 const ExtendedOctree& source,
+                                                 SourceBrickCache& cache,
+                                                 const UINT64VECTOR4& coords,
+                                                 bool bClampToEdge) {
+  const UINT64VECTOR3 vBrickSize = tree.ComputeBrickSize(coords);
+  const size_t iVoxelSize = tree.GetComponentTypeSize() *
+                            size_t(tree.GetComponentCount());
+  const size_t iBrickBytes = size_t(vBrickSize.volume()) * iVoxelSize;
+  vData.resize(iBrickBytes);
+  // with bClampToEdge every voxel is written below
+  if (!bClampToEdge)
+    memset(&vData[0], 0, iBrickBytes);
+
+  const UINT64VECTOR3 vLoDSize = tree.GetLoDSize(coords.w);
+  const uint32_t iSourceOverlap = source.GetOverlap();
+  UINT64VECTOR3 vCore, vSourceCore, vStart, vFirst, vEnd;
+  for (size_t i = 0;i<3;i++) {
+    vCore[i] = m_vBrickSize[i] - 2*m_iOverlap;
+    vSourceCore[i] = source.m_iBrickSize[i] - 2*iSourceOverlap;
+    // first non-overlap voxel of the brick, and the voxels of the LoD the
+    // brick covers including its overlap
+    vStart[i] = coords[i] * vCore[i];
+    vFirst[i] = vStart[i] > m_iOverlap ? vStart[i] - m_iOverlap : 0;
+    vEnd[i] = std::min(vStart[i] + vBrickSize[i] - m_iOverlap, vLoDSize[i]);
+  }
+
+  const UINT64VECTOR3 vFirstBrick(vFirst.x / vSourceCore.x,
+                                  vFirst.y / vSourceCore.y,
+                                  vFirst.z / vSourceCore.z);
+  const UINT64VECTOR3 vLastBrick((vEnd.x-1) / vSourceCore.x,
+                                 (vEnd.y-1) / vSourceCore.y,
+                                 (vEnd.z-1) / vSourceCore.z);
+  for (uint64_t z = vFirstBrick.z;z<=vLastBrick.z;z++) {
+    for (uint64_t y = vFirstBrick.y;y<=vLastBrick.y;y++) {
+      for (uint64_t x = vFirstBrick.x;x<=vLastBrick.x;x++) {
+        const UINT64VECTOR4 sourceCoords(x,y,z, coords.w);
+        const UINT64VECTOR3 vSourceStart(x*vSourceCore.x, y*vSourceCore.y,
+                                         z*vSourceCore.z);
+
+        // the part of the source brick's core that lies in our brick
+        UINT64VECTOR3 vFrom, vTo;
+        for (size_t i = 0;i<3;i++) {
+          vFrom[i] = std::max(vFirst[i], vSourceStart[i]);
+          vTo[i] = std::min(vEnd[i], vSourceStart[i] + vSourceCore[i]);
+        }
+
+        CopyBrickToBrick(cache.Get(sourceCoords),
+                         source.ComputeBrickSize(sourceCoords),
+                         vData, vBrickSize,
+                         vFrom - vSourceStart + UINT64VECTOR3(iSourceOverlap,
+                                                              iSourceOverlap,
+                                                              iSourceOverlap),
+                         vFrom + UINT64VECTOR3(m_iOverlap, m_iOverlap,
+                                               m_iOverlap) - vStart,
+                         vTo - vFrom, iVoxelSize);
+      }
+    }
+  }
+
+  if (!bClampToEdge) return;
+
+  // Replicate the outermost voxels of the volume into the part of the brick
+  // that lies outside of it.  This is not necessarily the overlap of the
+  // boundary bricks only: if the last brick is thinner than the overlap the
+  // one before it reaches out of the volume, too.
+  const UINT64VECTOR3 vIn(vFirst + UINT64VECTOR3(m_iOverlap, m_iOverlap,
+                                                 m_iOverlap) - vStart);
+  const UINT64VECTOR3 vInEnd(vEnd + UINT64VECTOR3(m_iOverlap, m_iOverlap,
+                                                  m_iOverlap) - vStart);
+  const size_t iLine = size_t(vBrickSize.x) * iVoxelSize;
+  const size_t iSlice = size_t(vBrickSize.y) * iLine;
+  for (uint64_t z = vIn.z;z<vInEnd.z;z++) {
+    for (uint64_t y = vIn.y;y<vInEnd.y;y++) {
+      uint8_t* pLine = &vData[size_t(z)*iSlice + size_t(y)*iLine];
+      for (uint64_t x = 0;x<vIn.x;x++)
+        memcpy(pLine + x*iVoxelSize, pLine + vIn.x*iVoxelSize, iVoxelSize);
+      for (uint64_t x = vInEnd.x;x<vBrickSize.x;x++)
+        memcpy(pLine + x*iVoxelSize, pLine + (vInEnd.x-1)*iVoxelSize,
+               iVoxelSize);
+    }
+    uint8_t* pSlice = &vData[size_t(z)*iSlice];
+    for (uint64_t y = 0;y<vIn.y;y++)
+      memcpy(pSlice + y*iLine, pSlice + vIn.y*iLine, iLine);
+    for (uint64_t y = vInEnd.y;y<vBrickSize.y;y++)
+      memcpy(pSlice + y*iLine, pSlice + (vInEnd.y-1)*iLine, iLine);
+  }
+  for (uint64_t z = 0;z<vIn.z;z++)
+    memcpy(&vData[size_t(z)*iSlice], &vData[size_t(vIn.z)*iSlice], iSlice);
+  for (uint64_t z = vInEnd.z;z<vBrickSize.z;z++)
+    memcpy(&vData[size_t(z)*iSlice], &vData[size_t(vInEnd.z-1)*iSlice],
+           iSlice);
+}
+
 /*
   GetInputBrick:
 
@@ -461,8 +715,28 @@ void ExtendedOctreeConverter::ClampToEdge(std::vector<uint8_t>& vData,
   }
 }
 
+namespace {
+  /// number of bricks we decompress at once: one for each worker of the
+  /// scheduler and one for the calling thread
+  size_t DecodeBatchSize() {
+    return tuvok::Controller::Instance().Scheduler().GetThreadCount() + 1;
+  }
+
+  uint64_t PayloadHash(const uint8_t* pData, uint64_t iLength) {
+    // FNV-1a; we only use it to find candidates, matches are compared fully.
+    uint64_t h = 14695981039346656037ULL;
+    for(uint64_t i=0; i < iLength; ++i) {
+      h = (h ^ pData[i]) * 1099511628211ULL;
+    }
+    return h;
+  }
+}
+
 /// Computes max min statistics for each brick and rewrites 
 /// it using compression, if desired.
+/// Compressed bricks whose payload was already written (empty space, or
+/// regions that do not change between the timesteps of a simulation) are
+/// not written again; their ToC entry points to the first copy instead.
 void ExtendedOctreeConverter::ComputeStatsAndCompressAll(ExtendedOctree& tree)
 {
   FlushCache(tree); // be sure we've got everything on disk.
@@ -494,8 +768,13 @@ void ExtendedOctreeConverter::ComputeStatsAndCompressAll(ExtendedOctree& tree)
                            m_fProgress*100.0f, msg.c_str());
       }
     }
+    tree.m_iSize = tree.m_vTOC.back().m_iOffset + tree.m_vTOC.back().m_iLength;
   } else {
-    std::array<uint8_t, 5> lzmaProps;
+    // payload hash -> index of the bricks written with that hash
+    std::unordered_multimap<uint64_t, size_t> written;
+    std::shared_ptr<uint8_t> other(new uint8_t[maxbricksize],
+                                   nonstd::DeleteArray<uint8_t>());
+    uint64_t iWriteOffset = tree.m_vTOC.empty() ? 0 : tree.m_vTOC[0].m_iOffset;
 
     // foreach brick:
     //   load it up
@@ -507,31 +786,8 @@ void ExtendedOctreeConverter::ComputeStatsAndCompressAll(ExtendedOctree& tree)
       BrickStat(m_pBrickStatVec, i, BrickData.get(), BrickSize(tree, i),
                 tree.m_iComponentCount, tree.m_eComponentType);
 
-      uint64_t newlen = 0;
-      switch (m_eCompression) {
-      case CT_ZLIB:
-        newlen = zCompress(BrickData, BrickSize(tree, i), compressed,
-                           tree.m_iCompressionLevel); // 0..9 (0 no comp)
-        break;
-      case CT_LZMA:
-        newlen = lzmaCompress(BrickData, BrickSize(tree, i), compressed,
-                              lzmaProps, tree.m_iCompressionLevel - 1); // 0..9
-        assert(lzmaProps == tree.m_lzmaProps);
-        break;
-      case CT_LZ4:
-        newlen = lz4Compress(BrickData, BrickSize(tree, i), compressed,
-                             tree.m_iCompressionLevel); // 1..17
-        break;
-      case CT_BZLIB:
-        newlen = bzCompress(BrickData, BrickSize(tree, i), compressed,
-                            tree.m_iCompressionLevel); // 1..9
-        break;
-      case CT_LZHAM:
-        throw std::runtime_error("lzham compression format is not supported anymore by Tuvok");
-        break;
-      default:
-        throw std::runtime_error("unknown compression format");
-      }
+      const uint64_t newlen = CompressBrick(tree, m_eCompression, BrickData,
+                                            BrickSize(tree, i), compressed);
       std::shared_ptr<uint8_t> data;
 
       if(newlen < BrickSize(tree, i)) {
@@ -543,12 +799,37 @@ void ExtendedOctreeConverter::ComputeStatsAndCompressAll(ExtendedOctree& tree)
         tree.m_vTOC[i].m_eCompression = CT_NONE;
         data = BrickData;
       }
-      if(i > 0) {
-        tree.m_vTOC[i].m_iOffset = tree.m_vTOC[i-1].m_iOffset +
-                                   tree.m_vTOC[i-1].m_iLength;
+
+      // uncompressed bricks are never shared: Atalasify rewrites those in
+      // place.
+      bool bShared = false;
+      uint64_t hash = 0;
+      if(tree.m_vTOC[i].m_eCompression != CT_NONE) {
+        hash = PayloadHash(data.get(), tree.m_vTOC[i].m_iLength);
+        auto range = written.equal_range(hash);
+        for(auto w = range.first; w != range.second && !bShared; ++w) {
+          const TOCEntry& e = tree.m_vTOC[w->second];
+          if(e.m_iLength != tree.m_vTOC[i].m_iLength ||
+             e.m_eCompression != tree.m_vTOC[i].m_eCompression) {
+            continue;
+          }
+          tree.m_pLargeRAWFile->SeekPos(e.m_iOffset);
+          tree.m_pLargeRAWFile->ReadRAW(other.get(), e.m_iLength);
+          if(memcmp(other.get(), data.get(), size_t(e.m_iLength)) == 0) {
+            tree.m_vTOC[i].m_iOffset = e.m_iOffset;
+            bShared = true;
+          }
+        }
+      }
+      if(!bShared) {
+        tree.m_vTOC[i].m_iOffset = iWriteOffset;
+        tree.m_pLargeRAWFile->SeekPos(iWriteOffset);
+        tree.m_pLargeRAWFile->WriteRAW(data.get(), tree.m_vTOC[i].m_iLength);
+        iWriteOffset += tree.m_vTOC[i].m_iLength;
+        if(tree.m_vTOC[i].m_eCompression != CT_NONE) {
+          written.insert(std::make_pair(hash, i));
+        }
       }
-      tree.m_pLargeRAWFile->SeekPos(tree.m_vTOC[i].m_iOffset);
-      tree.m_pLargeRAWFile->WriteRAW(data.get(), tree.m_vTOC[i].m_iLength);
       
       if (i % iReportInterval == 0) {
         m_fProgress = float(i) / tree.m_vTOC.size();
@@ -557,10 +838,11 @@ void ExtendedOctreeConverter::ComputeStatsAndCompressAll(ExtendedOctree& tree)
                            m_fProgress*100.0f, msg.c_str());
       }
     }
-  }
 
-  // do not forget to set new octree size
-  tree.m_iSize = tree.m_vTOC.back().m_iOffset + tree.m_vTOC.back().m_iLength;
+    // do not forget to set new octree size; shared bricks mean the last
+    // entry in the ToC need not be the last one in the file.
+    tree.m_iSize = iWriteOffset;
+  }
 }
 
 std::shared_ptr<uint8_t>
@@ -589,34 +871,8 @@ ExtendedOctreeConverter::Fetch(ExtendedOctree& tree,
     if (m_eCompression != CT_NONE) {
       std::shared_ptr<uint8_t> pCompressed;
       // *Compress will always create a buffer sized like the input data
-      uint64_t iCompressed = 0;
-      switch (m_eCompression) {
-      case CT_ZLIB:
-        iCompressed = zCompress(pData, record.m_iLength, pCompressed,
-                                tree.m_iCompressionLevel); // 0..9 (0 no comp)
-        break;
-      case CT_LZMA: {
-        // we only use the encoded props for safety checks
-        // they should be identical for all bricks of the tree
-        std::array<uint8_t, 5> props;
-        iCompressed = lzmaCompress(pData, record.m_iLength, pCompressed,
-                                   props, tree.m_iCompressionLevel - 1); // 0..9
-        assert(props == tree.m_lzmaProps);
-        break; }
-      case CT_LZ4:
-        iCompressed = lz4Compress(pData, record.m_iLength, pCompressed,
-                                  tree.m_iCompressionLevel); // 1..17
-        break;
-      case CT_BZLIB:
-        iCompressed = bzCompress(pData, record.m_iLength, pCompressed,
-                                 tree.m_iCompressionLevel); // 1..9
-        break;
-      case CT_LZHAM:
-        throw std::runtime_error("lzham compression format is not supported anymore by Tuvok");
-        break;
-      default:
-        throw std::runtime_error("unknown compression format");
-      }
+      const uint64_t iCompressed = CompressBrick(tree, m_eCompression, pData,
+                                                 record.m_iLength, pCompressed);
       if (iCompressed < record.m_iLength) {
         if (!pBuffer) {
           pData.reset(new uint8_t[iCompressed], nonstd::DeleteArray<uint8_t>());
@@ -691,9 +947,21 @@ void ExtendedOctreeConverter::ComputeStatsCompressAndPermuteAll(ExtendedOctree&
     // the domain of the current level (brickCounter == brickCount)
     uint64_t brickCounter = 0;
     uint64_t layoutIndex  = 0;
+    // positions are decoded in batches; no batch reaches further than the
+    // bricks still missing, as every index might hit one of them
+    std::vector<UINT64VECTOR3> positions;
+    size_t nextPosition = 0;
     while (brickCounter < brickCount)
     {
-      UINT64VECTOR3 const position = pLayout->GetSpatialPosition(layoutIndex++);
+      if (nextPosition == positions.size()) {
+        positions.resize(size_t(std::min<uint64_t>(brickCount - brickCounter,
+                                                   4096)));
+        pLayout->GetSpatialPositions(layoutIndex, positions.size(),
+                                     &positions[0]);
+        layoutIndex += positions.size();
+        nextPosition = 0;
+      }
+      UINT64VECTOR3 const position = positions[nextPosition++];
       if (position.x < domain.x &&
           position.y < domain.y &&
           position.z < domain.z)
@@ -951,6 +1219,37 @@ uint64_t ExtendedOctreeConverter::BrickSize(const ExtendedOctree& tree,
   return tree.m_vTOC[index].m_iLength;
 }
 
+uint64_t ExtendedOctreeConverter::CompressBrick(
+  const ExtendedOctree& tree, COMPRESSION_TYPE eCompression,
+  std::shared_ptr<uint8_t> pData, uint64_t length,
+  std::shared_ptr<uint8_t>& compressed)
+{
+  switch (eCompression) {
+  case CT_ZLIB:
+    return zCompress(pData, size_t(length), compressed,
+                     tree.m_iCompressionLevel); // 0..9 (0 no comp)
+  case CT_LZMA: {
+    // we only use the encoded props for safety checks
+    // they should be identical for all bricks of the tree
+    std::array<uint8_t, 5> props;
+    const uint64_t iCompressed = lzmaCompress(pData, size_t(length),
+                                              compressed, props,
+                                              tree.m_iCompressionLevel - 1); // 0..9
+    assert(props == tree.m_lzmaProps);
+    return iCompressed; }
+  case CT_LZ4:
+    return lz4Compress(pData, size_t(length), compressed,
+                       tree.m_iCompressionLevel); // 1..17
+  case CT_BZLIB:
+    return bzCompress(pData, size_t(length), compressed,
+                      tree.m_iCompressionLevel); // 1..9
+  case CT_LZHAM:
+    throw std::runtime_error("lzham compression format is not supported anymore by Tuvok");
+  default:
+    throw std::runtime_error("unknown compression format");
+  }
+}
+
 void ExtendedOctreeConverter::BrickStat(
   BrickStatVec* bs, uint64_t index, const uint8_t* pData, uint64_t length,
   size_t components, enum ExtendedOctree::COMPONENT_TYPE type
@@ -1421,6 +1720,8 @@ void ExtendedOctreeConverter::PermuteInputData(ExtendedOctree &tree, LargeRAWFil
  tree. This method is very simple, it iterates over all bricks of the given
  LoD level (x,y,z for-loops) and for each brick it writes it's non-overlap
  values into the target file. Index magic is explained inside the function.
+ The bricks are decompressed concurrently, a batch at a time, the writes
+ happen in brick order from the calling thread.
 */
 bool ExtendedOctreeConverter::ExportToRAW(const ExtendedOctree &tree,
                                  const LargeRAWFile_ptr pLargeRAWFile,
@@ -1428,65 +1729,57 @@ bool ExtendedOctreeConverter::ExportToRAW(const ExtendedOctree &tree,
   if (iLODLevel >= tree.GetLODCount()) return false;
 
   const size_t iVoxelSize =tree. GetComponentTypeSize() * size_t(tree.m_iComponentCount);
-  uint8_t *pBrickData = new uint8_t[size_t(tree.m_iBrickSize.volume() * iVoxelSize)];
-
   const UINT64VECTOR3 outSize = tree.m_vLODTable[size_t(iLODLevel)].m_iLODPixelSize;
-
-  UINT64VECTOR3 bricksToExport = tree.GetBrickCount(iLODLevel);
-  for (uint64_t z = 0;z<bricksToExport.z;++z) {
-    for (uint64_t y = 0;y<bricksToExport.y;++y) {
-      for (uint64_t x = 0;x<bricksToExport.x;++x) {
-        const UINT64VECTOR4 coords(x,y,z, iLODLevel);
-        const UINT64VECTOR3 brickSize = tree.ComputeBrickSize(coords);
-
-        tree.GetBrickData(pBrickData, coords);
-
-        // compute the length of a scanline that is the non-overlap size
-        // times the size of a voxel
-        const size_t iLineSize = (size_t(brickSize.x)-tree.m_iOverlap*2) *iVoxelSize;
-
-        for (uint64_t bz = 0;bz<brickSize.z-2*tree.m_iOverlap;++bz) {
-          for (uint64_t by = 0;by<brickSize.y-2*tree.m_iOverlap;++by) {
-
-            // the offset into the target file is computed as follows:
-            // first the global offset into the file as specified by the user
-            // plus the scanline coordinate within th current brick (by, by)
-            // and the coordinates of the non-overlap part of the current
-            // brick x,y,z as usual x is used as is y is multiplied with x size
-            // z is multiplied with x- times y-size, since we are placing the
-            // brick inside the output file we have to use outSize
-            // finally we multiply the brick voxels with the voxelsize to
-            // get the offset in bytes
-            const uint64_t iOutOffset =  iOffset +
-              (
-                (    (x*(tree.m_iBrickSize.x-tree.m_iOverlap*2))) +
-                ((by+(y*(tree.m_iBrickSize.y-tree.m_iOverlap*2))) * outSize.x) +
-                ((bz+(z*(tree.m_iBrickSize.z-tree.m_iOverlap*2))) * outSize.x * outSize.y)
-              ) * iVoxelSize;
-
-            // the offset in the source data is computed as follows:
-            // skip the overlap in the scanline then skip to the current line by
-            // and the current slice by also skip their overlap as usual
-            // x is used as is, y is multiplied with x size, and
-            // z is multiplied with x- times y-size, since we are offsetting in
-            // inside the brick  we have to use brick's size
-            // finally we multiply the brick voxels with the voxel size to
-            // get the offset in bytes
-            const uint64_t iInOffset = (
-                                     tree.m_iOverlap  +
-                                ((by+tree.m_iOverlap) * brickSize.x) +
-                                ((bz+tree.m_iOverlap) * brickSize.x * brickSize.y)
-                               ) * iVoxelSize;
-
-            pLargeRAWFile->SeekPos(iOutOffset);
-            pLargeRAWFile->WriteRAW(pBrickData + iInOffset, iLineSize);
-          }
+  const UINT64VECTOR3 vOverlap(tree.m_iOverlap*2, tree.m_iOverlap*2,
+                               tree.m_iOverlap*2);
+
+  const uint64_t iFirst = tree.BrickCoordsToIndex(UINT64VECTOR4(0,0,0, iLODLevel));
+  const uint64_t iBrickCount = tree.GetBrickCount(iLODLevel).volume();
+  std::vector<std::vector<uint8_t>> vBricks(DecodeBatchSize());
+
+  for (uint64_t b = 0;b<iBrickCount;b+=vBricks.size()) {
+    const size_t n = size_t(std::min<uint64_t>(vBricks.size(), iBrickCount-b));
+    if (!DecodeBricks(tree, iFirst+b, n, tree.m_iOverlap, vBricks)) return false;
+
+    for (size_t i = 0;i<n;++i) {
+      const UINT64VECTOR4 coords = tree.IndexToBrickCoords(iFirst+b+i);
+      // the decoded brick holds its non-overlap part only
+      const UINT64VECTOR3 coreSize = tree.ComputeBrickSize(coords) - vOverlap;
+
+      // compute the length of a scanline that is the non-overlap size
+      // times the size of a voxel
+      const size_t iLineSize = size_t(coreSize.x) * iVoxelSize;
+
+      for (uint64_t bz = 0;bz<coreSize.z;++bz) {
+        for (uint64_t by = 0;by<coreSize.y;++by) {
+
+          // the offset into the target file is computed as follows:
+          // first the global offset into the file as specified by the user
+          // plus the scanline coordinate within th current brick (by, by)
+          // and the coordinates of the non-overlap part of the current
+          // brick x,y,z as usual x is used as is y is multiplied with x size
+          // z is multiplied with x- times y-size, since we are placing the
+          // brick inside the output file we have to use outSize
+          // finally we multiply the brick voxels with the voxelsize to
+          // get the offset in bytes
+          const uint64_t iOutOffset =  iOffset +
+            (
+              (    (coords.x*(tree.m_iBrickSize.x-tree.m_iOverlap*2))) +
+              ((by+(coords.y*(tree.m_iBrickSize.y-tree.m_iOverlap*2))) * outSize.x) +
+              ((bz+(coords.z*(tree.m_iBrickSize.z-tree.m_iOverlap*2))) * outSize.x * outSize.y)
+            ) * iVoxelSize;
+
+          // the offset in the source data is simply the scanline (by, bz)
+          // in the non-overlap part of the brick
+          const uint64_t iInOffset = (by + bz * coreSize.y) * iLineSize;
+
+          pLargeRAWFile->SeekPos(iOutOffset);
+          pLargeRAWFile->WriteRAW(&vBricks[i][0] + iInOffset, iLineSize);
         }
       }
     }
   }
 
-  delete [] pBrickData;
   return true;
 }
 
@@ -1517,6 +1810,8 @@ bool ExtendedOctreeConverter::ExportToRAW(const ExtendedOctree &tree,
  This method simply iterates over all bricks of the given LoD
  level (x,y,z for-loops) and for each brick it writes hands the
  brick with (possibly modified) overlap to the supplied function.
+ The bricks are decompressed concurrently, a batch at a time, but the
+ function is called in brick order from the calling thread.
 */
 bool ExtendedOctreeConverter::ApplyFunction(const ExtendedOctree &tree, uint64_t iLODLevel,
                                             bool (*brickFunc)(void* pData,
@@ -1528,34 +1823,148 @@ bool ExtendedOctreeConverter::ApplyFunction(const ExtendedOctree &tree, uint64_t
   if (iLODLevel >= tree.GetLODCount() || iOverlap > tree.m_iOverlap) return false;
 
   uint32_t skipOverlap = tree.m_iOverlap-iOverlap;
+  const UINT64VECTOR3 vCoreSize = tree.m_iBrickSize -
+                                  UINT64VECTOR3(tree.m_iOverlap*2,
+                                                tree.m_iOverlap*2,
+                                                tree.m_iOverlap*2);
+
+  const uint64_t iFirst = tree.BrickCoordsToIndex(UINT64VECTOR4(0,0,0, iLODLevel));
+  const uint64_t iBrickCount = tree.GetBrickCount(iLODLevel).volume();
+  std::vector<std::vector<uint8_t>> vBricks(DecodeBatchSize());
+
+  for (uint64_t b = 0;b<iBrickCount;b+=vBricks.size()) {
+    const size_t n = size_t(std::min<uint64_t>(vBricks.size(), iBrickCount-b));
+    if (!DecodeBricks(tree, iFirst+b, n, skipOverlap, vBricks)) return false;
+
+    for (size_t i = 0;i<n;++i) {
+      const UINT64VECTOR4 coords = tree.IndexToBrickCoords(iFirst+b+i);
+      const UINT64VECTOR3 brickSize = tree.ComputeBrickSize(coords);
+
+      // the offset is that of the first non-overlap voxel of the brick
+      if(!brickFunc(&vBricks[i][0], brickSize-(2*skipOverlap), 
+                    coords.xyz()*vCoreSize, pUserContext)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
 
-  const size_t iVoxelSize = tree.GetComponentTypeSize() * size_t(tree.m_iComponentCount);
-  uint8_t *pBrickData = new uint8_t[size_t(tree.m_iBrickSize.volume() * iVoxelSize)];
+/*
+ ParallelApplyFunction:
+
+ Like ApplyFunction, but the bricks of a batch are decompressed and handed
+ to the function concurrently, on the controller's task scheduler: the
+ thread that decompresses a brick also calls the function on it, so one
+ brick is processed while the next ones are still being decompressed.  The
+ compressed bricks are still read from the file one after the other, a
+ batch at a time.  Once a brick failed, no further bricks are started.
+*/
+bool ExtendedOctreeConverter::ParallelApplyFunction(const ExtendedOctree &tree,
+                                                    uint64_t iLODLevel,
+                                                    const ParallelBrickFunc& brickFunc,
+                                                    size_t iThreads,
+                                                    uint32_t iOverlap) {
+  if (iLODLevel >= tree.GetLODCount() || iOverlap > tree.m_iOverlap) return false;
 
-  UINT64VECTOR3 bricksToExport = tree.GetBrickCount(iLODLevel);
-  for (uint64_t z = 0;z<bricksToExport.z;++z) {
-    for (uint64_t y = 0;y<bricksToExport.y;++y) {
-      for (uint64_t x = 0;x<bricksToExport.x;++x) {
-        const UINT64VECTOR4 coords(x,y,z, iLODLevel);
+  const uint32_t skipOverlap = tree.m_iOverlap-iOverlap;
+  const UINT64VECTOR3 vCoreSize = tree.m_iBrickSize -
+                                  UINT64VECTOR3(tree.m_iOverlap*2,
+                                                tree.m_iOverlap*2,
+                                                tree.m_iOverlap*2);
+
+  const uint64_t iFirst = tree.BrickCoordsToIndex(UINT64VECTOR4(0,0,0, iLODLevel));
+  const uint64_t iBrickCount = tree.GetBrickCount(iLODLevel).volume();
+  const size_t iThreadCount = std::max<size_t>(iThreads, 1);
+  // a few bricks per thread, so a thread that got a cheap brick picks up
+  // another one instead of waiting for the rest of the batch
+  std::vector<std::vector<uint8_t>> vBricks(iThreadCount*4);
+  std::vector<std::shared_ptr<uint8_t>> vPayloads(vBricks.size());
+  tuvok::TaskScheduler& scheduler = tuvok::Controller::Instance().Scheduler();
+  // set as soon as a brick fails, so that the rest is not even decompressed
+  tuvok::CancelToken failed;
+
+  for (uint64_t b = 0;b<iBrickCount;b+=vBricks.size()) {
+    const size_t n = size_t(std::min<uint64_t>(vBricks.size(), iBrickCount-b));
+    ReadBricks(tree, iFirst+b, n, vPayloads);
+
+    // one range per lane: the lane is the thread index brickFunc gets, and
+    // it processes bricks until none are left
+    std::atomic<size_t> iNext(0);
+    scheduler.ParallelFor(0, iThreadCount, 1,
+                          [&](size_t iThread, size_t) {
+      for (size_t i = iNext++;i<n && !failed.Cancelled();i = iNext++) {
+        const UINT64VECTOR4 coords = tree.IndexToBrickCoords(iFirst+b+i);
         const UINT64VECTOR3 brickSize = tree.ComputeBrickSize(coords);
-
-        tree.GetBrickData(pBrickData, coords);
-        if (skipOverlap != 0) 
-          VolumeTools::RemoveBoundary(pBrickData, brickSize,
-                                      iVoxelSize, skipOverlap);
-
-        if(!brickFunc(pBrickData, brickSize-(2*skipOverlap), 
-                      coords.xyz()*(tree.m_iBrickSize-(4*skipOverlap)),pUserContext)) {
-          delete [] pBrickData;
-          return false;
+        try {
+          if (!DecodeBrick(tree, iFirst+b+i, skipOverlap, vPayloads[i],
+                           vBricks[i]) ||
+              !brickFunc(&vBricks[i][0], brickSize-(2*skipOverlap),
+                         coords.xyz()*vCoreSize, iThread)) {
+            failed.Cancel();
+          }
+        } catch (const std::exception&) {
+          failed.Cancel();
         }
+        vPayloads[i].reset();
       }
-    }
+    });
+    if (failed.Cancelled()) return false;
+  }
+  return true;
+}
+
+void ExtendedOctreeConverter::ReadBricks(const ExtendedOctree& tree,
+                                         uint64_t iFirst, size_t n,
+                                         std::vector<std::shared_ptr<uint8_t>>& vPayloads) {
+  tuvok::Controller::Instance().IncrementPerfCounter(PERF_EO_BRICKS, double(n));
+  for (size_t i = 0;i<n;++i) {
+    const TOCEntry& e = tree.m_vTOC[size_t(iFirst+i)];
+    const size_t iBrickBytes = size_t(BrickSize(tree, iFirst+i));
+    vPayloads[i].reset(new uint8_t[iBrickBytes], nonstd::DeleteArray<uint8_t>());
+    tree.m_pLargeRAWFile->SeekPos(tree.m_iOffset + e.m_iOffset);
+    tree.m_pLargeRAWFile->ReadRAW(vPayloads[i].get(), e.m_iLength);
+  }
+}
+
+bool ExtendedOctreeConverter::DecodeBrick(const ExtendedOctree& tree,
+                                          uint64_t index, uint32_t iRemove,
+                                          std::shared_ptr<uint8_t> pPayload,
+                                          std::vector<uint8_t>& vBrick) {
+  const size_t iVoxelSize = tree.GetComponentTypeSize() * size_t(tree.m_iComponentCount);
+  vBrick.resize(size_t(BrickSize(tree, index)));
+  try {
+    tree.DecompressBrick(pPayload, &vBrick[0], index);
+  } catch (const std::exception&) {
+    return false;
+  }
+  if (iRemove != 0) {
+    const UINT64VECTOR3 brickSize = tree.ComputeBrickSize(tree.IndexToBrickCoords(index));
+    VolumeTools::RemoveBoundary(&vBrick[0], brickSize, iVoxelSize, iRemove);
+    vBrick.resize(size_t((brickSize-(2*iRemove)).volume()) * iVoxelSize);
   }
-  delete [] pBrickData;
   return true;
 }
 
+bool ExtendedOctreeConverter::DecodeBricks(const ExtendedOctree& tree,
+                                           uint64_t iFirst, size_t n,
+                                           uint32_t iRemove,
+                                           std::vector<std::vector<uint8_t>>& vBricks) {
+  // the file is read one brick after the other, only the decompression
+  // happens concurrently
+  std::vector<std::shared_ptr<uint8_t>> vPayloads(n);
+  ReadBricks(tree, iFirst, n, vPayloads);
+
+  std::vector<char> ok(n, 0);
+  tuvok::Controller::Instance().Scheduler().ParallelFor(0, n, 1,
+                                                        [&](size_t iBegin,
+                                                            size_t iEnd) {
+    for (size_t i = iBegin;i<iEnd;++i) {
+      ok[i] = DecodeBrick(tree, iFirst+i, iRemove, vPayloads[i], vBricks[i]) ? 1 : 0;
+    }
+  });
+  return std::find(ok.begin(), ok.end(), 0) == ok.end();
+}
 
 void ExtendedOctreeConverter::Atalasify(const ExtendedOctree &tree,
                                          const UINT64VECTOR4& vBrickCoords,
@@ -1786,3 +2195,270 @@ bool ExtendedOctreeConverter::DeAtalasify(ExtendedOctree &tree) {
   return true;
 }
 
+
+namespace {
+  enum CropClass { CROP_KEPT, CROP_REMOVED, CROP_INTERSECTED };
+
+  /// @returns true if voxel (x,y,z) of a LoD of the given size is on the
+  /// clipped side of the plane; overlap voxels outside the volume are clamped
+  /// to it, so they share the fate of the border voxel they replicate.
+  bool IsClipped(const PLANE<float>& plane, int64_t x, int64_t y, int64_t z,
+                 const UINT64VECTOR3& vLoDSize) {
+    const int64_t cx = std::min<int64_t>(std::max<int64_t>(x, 0), vLoDSize.x-1);
+    const int64_t cy = std::min<int64_t>(std::max<int64_t>(y, 0), vLoDSize.y-1);
+    const int64_t cz = std::min<int64_t>(std::max<int64_t>(z, 0), vLoDSize.z-1);
+    FLOATVECTOR3 normCoords(float(cx) / float(vLoDSize.x),
+                            float(cy) / float(vLoDSize.y),
+                            float(cz) / float(vLoDSize.z));
+    normCoords -= FLOATVECTOR3(0.5, 0.5, 0.5);
+    return plane.clip(normCoords);
+  }
+}
+
+bool ExtendedOctreeConverter::CropInPlace(ExtendedOctree &tree,
+                                          const PLANE<float>& plane,
+                                          const std::string& strTempFile,
+                                          BrickStatVec* pStats,
+                                          std::vector<size_t>* pChanged)
+{
+  CropPlan plan;
+  if (!PrepareCrop(tree, plane, strTempFile, plan) ||
+      !CommitCrop(tree, plan))
+    return false;
+  if (pStats) pStats->swap(plan.stats);
+  if (pChanged) pChanged->swap(plan.vChanged);
+  return true;
+}
+
+ExtendedOctreeConverter::CropPlan::~CropPlan()
+{
+  if (pStage) pStage->Delete();
+}
+
+bool ExtendedOctreeConverter::PrepareCrop(ExtendedOctree &tree,
+                                          const PLANE<float>& plane,
+                                          const std::string& strTempFile,
+                                          CropPlan& plan)
+{
+  BrickStatVec* pStats = &plan.stats;
+  const size_t iVoxelSize = tree.GetComponentTypeSize() *
+                            size_t(tree.m_iComponentCount);
+  const UINT64VECTOR3 vCoreSize = tree.m_iBrickSize -
+                                  UINT64VECTOR3(2*tree.m_iOverlap,
+                                                2*tree.m_iOverlap,
+                                                2*tree.m_iOverlap);
+
+  // the method the tree was compressed with; bricks which did not compress
+  // well are stored uncompressed regardless
+  COMPRESSION_TYPE eCompression = CT_NONE;
+
+  // classify all bricks by the corners of their voxel range: as both sides
+  // of the plane are convex, a brick with all corners on one side lies
+  // completely on that side
+  std::vector<uint8_t> vClass(tree.m_vTOC.size(), CROP_KEPT);
+  // offset -> number of bricks stored there, and how many of those change
+  std::map<uint64_t, size_t> users, changedUsers;
+  for (size_t i = 0; i < tree.m_vTOC.size(); ++i) {
+    const TOCEntry& e = tree.m_vTOC[i];
+    // atlantified bricks would need to be converted back first
+    if (e.m_iAtlasSize.area() != 0) return false;
+    if (e.m_eCompression != CT_NONE) eCompression = e.m_eCompression;
+    users[e.m_iOffset]++;
+
+    const UINT64VECTOR4 coords = tree.IndexToBrickCoords(i);
+    const UINT64VECTOR3 vLoDSize = tree.GetLoDSize(coords.w);
+    const UINT64VECTOR3 vBrickSize = tree.ComputeBrickSize(coords);
+    const int64_t x0 = int64_t(coords.x*vCoreSize.x) - tree.m_iOverlap;
+    const int64_t y0 = int64_t(coords.y*vCoreSize.y) - tree.m_iOverlap;
+    const int64_t z0 = int64_t(coords.z*vCoreSize.z) - tree.m_iOverlap;
+
+    size_t iClippedCorners = 0;
+    for (size_t c = 0; c < 8; ++c) {
+      if (IsClipped(plane,
+                    x0 + ((c & 1) ? int64_t(vBrickSize.x)-1 : 0),
+                    y0 + ((c & 2) ? int64_t(vBrickSize.y)-1 : 0),
+                    z0 + ((c & 4) ? int64_t(vBrickSize.z)-1 : 0),
+                    vLoDSize)) {
+        ++iClippedCorners;
+      }
+    }
+    if (iClippedCorners == 0) continue;
+    vClass[i] = (iClippedCorners == 8) ? CROP_REMOVED : CROP_INTERSECTED;
+    changedUsers[e.m_iOffset]++;
+  }
+
+  if (changedUsers.empty()) return true;
+
+  LargeRAWFile_ptr pStage(new LargeRAWFile(strTempFile));
+  if (!pStage->Create()) return false;
+  plan.pStage = pStage;
+
+  std::vector<CropPlan::StagedBrick>& staged = plan.staged;
+  std::vector<std::pair<size_t, size_t>>& aliases = plan.aliases;
+  // uncompressed byte size -> position of its zero brick in 'staged'
+  std::map<uint64_t, size_t> zeroBricks;
+
+  const size_t iMaxBrickBytes = size_t(tree.m_iBrickSize.volume()*iVoxelSize);
+  std::shared_ptr<uint8_t> pData(new uint8_t[iMaxBrickBytes],
+                                 nonstd::DeleteArray<uint8_t>());
+  std::shared_ptr<uint8_t> pCompressed;
+  uint64_t iStagePos = 0;
+
+  for (size_t i = 0; i < tree.m_vTOC.size(); ++i) {
+    if (vClass[i] == CROP_KEPT) continue;
+
+    const TOCEntry& e = tree.m_vTOC[i];
+    const UINT64VECTOR4 coords = tree.IndexToBrickCoords(i);
+    const UINT64VECTOR3 vBrickSize = tree.ComputeBrickSize(coords);
+    const uint64_t iBrickBytes = vBrickSize.volume() * iVoxelSize;
+
+    if (vClass[i] == CROP_REMOVED) {
+      if (pStats) {
+        const size_t iFirst = size_t(i * tree.m_iComponentCount);
+        if (pStats->size() < iFirst + tree.m_iComponentCount)
+          pStats->resize(iFirst + size_t(tree.m_iComponentCount));
+        for (size_t c = 0; c < tree.m_iComponentCount; ++c)
+          (*pStats)[iFirst + c] = BrickStats<double>(0, 0);
+      }
+      // uncompressed bricks are never shared, see ComputeStatsAndCompressAll
+      if (eCompression != CT_NONE) {
+        std::map<uint64_t, size_t>::const_iterator z =
+          zeroBricks.find(iBrickBytes);
+        if (z != zeroBricks.end()) {
+          aliases.push_back(std::make_pair(i, z->second));
+          continue;
+        }
+      }
+      memset(pData.get(), 0, size_t(iBrickBytes));
+    } else {
+      tree.GetBrickData(pData.get(), i);
+
+      const UINT64VECTOR3 vLoDSize = tree.GetLoDSize(coords.w);
+      const int64_t x0 = int64_t(coords.x*vCoreSize.x) - tree.m_iOverlap;
+      const int64_t y0 = int64_t(coords.y*vCoreSize.y) - tree.m_iOverlap;
+      const int64_t z0 = int64_t(coords.z*vCoreSize.z) - tree.m_iOverlap;
+      uint8_t* pVoxel = pData.get();
+      for (uint64_t z = 0; z < vBrickSize.z; ++z) {
+        for (uint64_t y = 0; y < vBrickSize.y; ++y) {
+          for (uint64_t x = 0; x < vBrickSize.x; ++x, pVoxel += iVoxelSize) {
+            if (IsClipped(plane, x0+int64_t(x), y0+int64_t(y), z0+int64_t(z),
+                          vLoDSize))
+              memset(pVoxel, 0, iVoxelSize);
+          }
+        }
+      }
+      if (pStats)
+        BrickStat(pStats, i, pData.get(), iBrickBytes,
+                  size_t(tree.m_iComponentCount), tree.m_eComponentType);
+    }
+
+    TOCEntry newEntry = e;
+    newEntry.m_iLength = iBrickBytes;
+    newEntry.m_eCompression = CT_NONE;
+    const uint8_t* pPayload = pData.get();
+    if (eCompression != CT_NONE) {
+      const uint64_t iCompressed = CompressBrick(tree, eCompression, pData,
+                                                 iBrickBytes, pCompressed);
+      if (iCompressed < iBrickBytes) {
+        newEntry.m_iLength = iCompressed;
+        newEntry.m_eCompression = eCompression;
+        pPayload = pCompressed.get();
+      }
+    }
+
+
+    if (vClass[i] == CROP_REMOVED && eCompression != CT_NONE)
+      zeroBricks[iBrickBytes] = staged.size();
+    const CropPlan::StagedBrick s = {i, iStagePos, newEntry};
+    staged.push_back(s);
+    pStage->SeekPos(iStagePos);
+    pStage->WriteRAW(pPayload, newEntry.m_iLength);
+    iStagePos += newEntry.m_iLength;
+  }
+
+  // the space of every old payload no unchanged brick refers to anymore may
+  // be reused: offset -> length
+  std::map<uint64_t, uint64_t> freed;
+  for (size_t i = 0; i < tree.m_vTOC.size(); ++i) {
+    const TOCEntry& e = tree.m_vTOC[i];
+    if (vClass[i] != CROP_KEPT &&
+        users[e.m_iOffset] == changedUsers[e.m_iOffset])
+      freed[e.m_iOffset] = e.m_iLength;
+  }
+
+  // put bricks back where they were if they still fit, this keeps the
+  // layout on disk intact; the remainder of the old space stays free
+  std::vector<bool> placed(staged.size(), false);
+  for (size_t s = 0; s < staged.size(); ++s) {
+    TOCEntry& newEntry = staged[s].entry;
+    std::map<uint64_t, uint64_t>::iterator f = freed.find(newEntry.m_iOffset);
+    if (f == freed.end() || f->second < newEntry.m_iLength) continue;
+    const uint64_t iRest = f->second - newEntry.m_iLength;
+    freed.erase(f);
+    if (iRest > 0) freed[newEntry.m_iOffset + newEntry.m_iLength] = iRest;
+    placed[s] = true;
+  }
+
+  // bricks that grew go into the smallest free space they fit into, e.g.
+  // that of a removed brick which now refers to the shared zero brick
+  std::multimap<uint64_t, uint64_t> freeBySize;
+  for (std::map<uint64_t, uint64_t>::const_iterator f = freed.begin();
+       f != freed.end(); ++f)
+    freeBySize.insert(std::make_pair(f->second, f->first));
+  for (size_t s = 0; s < staged.size(); ++s) {
+    if (placed[s]) continue;
+    TOCEntry& newEntry = staged[s].entry;
+    std::multimap<uint64_t, uint64_t>::iterator f =
+      freeBySize.lower_bound(newEntry.m_iLength);
+    if (f == freeBySize.end()) return false;
+    const uint64_t iRest = f->first - newEntry.m_iLength;
+    newEntry.m_iOffset = f->second;
+    freeBySize.erase(f);
+    if (iRest > 0)
+      freeBySize.insert(std::make_pair(iRest,
+                                       newEntry.m_iOffset+newEntry.m_iLength));
+  }
+
+  for (size_t i = 0; i < vClass.size(); ++i)
+    if (vClass[i] != CROP_KEPT) plan.vChanged.push_back(i);
+  return true;
+}
+
+bool ExtendedOctreeConverter::CommitCrop(ExtendedOctree &tree, CropPlan& plan)
+{
+  if (plan.staged.empty()) return true;
+
+  // everything fits, now move the new bricks into place
+  bool bTreeWasInRWModeAlready = tree.IsInRWMode();
+  if (!bTreeWasInRWModeAlready && !tree.ReOpenRW()) return false;
+
+  const size_t iVoxelSize = tree.GetComponentTypeSize() *
+                            size_t(tree.m_iComponentCount);
+  std::vector<uint8_t> vData(size_t(tree.m_iBrickSize.volume()*iVoxelSize));
+  const std::vector<CropPlan::StagedBrick>& staged = plan.staged;
+  const std::vector<std::pair<size_t, size_t>>& aliases = plan.aliases;
+  for (size_t s = 0; s < staged.size(); ++s) {
+    const TOCEntry& newEntry = staged[s].entry;
+    plan.pStage->SeekPos(staged[s].iStagePos);
+    plan.pStage->ReadRAW(&vData[0], newEntry.m_iLength);
+    tree.m_pLargeRAWFile->SeekPos(tree.m_iOffset + newEntry.m_iOffset);
+    tree.m_pLargeRAWFile->WriteRAW(&vData[0], newEntry.m_iLength);
+    tree.m_vTOC[staged[s].iIndex] = newEntry;
+  }
+  for (size_t a = 0; a < aliases.size(); ++a) {
+    TOCEntry& e = tree.m_vTOC[aliases[a].first];
+    const TOCEntry& zero = staged[aliases[a].second].entry;
+    e.m_iOffset = zero.m_iOffset;
+    e.m_iLength = zero.m_iLength;
+    e.m_eCompression = zero.m_eCompression;
+  }
+  plan.pStage->Delete();
+  plan.pStage.reset();
+
+  // write updated ToC to file
+  tree.WriteHeader(tree.m_pLargeRAWFile, tree.m_iOffset);
+
+  if (!bTreeWasInRWModeAlready)
+    if (!tree.ReOpenR()) return false;
+  return true;
+}
@@ -143,6 +143,32 @@ public:
                bool bComputeMedian,
                bool bClampToEdge,
                LAYOUT_TYPE layout);
+  /**
+    Builds a tree with this converter's brick size and overlap from an
+    existing tree.  Each LoD of the new tree is assembled from the same LoD
+    of the source tree (both have the same LoDs, as these only depend on
+    the volume size), so nothing is downsampled again and the volume is
+    never flattened.  Source bricks are kept in a cache which uses at most
+    half of the memory limit.
+
+    @param source the tree to rebrick
+    @param pLargeRAWOutFile a large raw-file pointer to the target file for the processed data
+    @param iOutOffset bytes to precede the data in the target file
+    @param stats pointer to a vector to store the statistics of each brick, can be set to NULL to disable statistics computation
+    @param compression the desired compression method
+    @param iCompressionLevel if compression is used the higher the level the more the compression (e.g. LZMA: 0..9)
+    @param bClampToEdge use outer values to fill border (uses zeros otherwise)
+    @param layout brick ordering on disk
+    @return true if the conversion succeeded
+  */
+  bool ReBrick(const ExtendedOctree& source,
+               LargeRAWFile_ptr pLargeRAWOutFile, uint64_t iOutOffset,
+               BrickStatVec* stats,
+               COMPRESSION_TYPE compression,
+               uint32_t iCompressionLevel,
+               bool bClampToEdge,
+               LAYOUT_TYPE layout);
+
   /**
     Call this method from a second thread during the conversion to check on the progress of the operation
   */
@@ -283,6 +309,107 @@ public:
                                               void* pUserContext),
                             void* pUserContext, uint32_t iOverlap=0);
 
+  /**
+   Called concurrently for different bricks by ParallelApplyFunction, the
+   function may modify the brick data
+
+   @param pData the data of the brick
+   @param vBrickSize the size of the brick including the requested overlap
+   @param vBrickOffset the position of the first non-overlap voxel of the brick in the LoD
+   @param iThread index of the calling thread, smaller than the thread count
+          given to ParallelApplyFunction, e.g. to pick a per-thread context
+   @return false to stop the traversal
+   */
+  typedef std::function<bool (void* pData,
+                              const UINT64VECTOR3& vBrickSize,
+                              const UINT64VECTOR3& vBrickOffset,
+                              size_t iThread)> ParallelBrickFunc;
+
+  /**
+   Decompresses the bricks of a specific LoD Level on up to iThreads threads
+   and hands each one to the given function on the thread that decompressed it
+
+   @param tree the octree to be processed
+   @param iLODLevel the level to be processed
+   @param brickFunc user function executed on the data, see ParallelBrickFunc
+   @param iThreads maximum number of concurrent calls to brickFunc
+   @param iOverlap number of overlap voxels to be included in the bricks
+   @return true iff all calls to brickFunc succeeded
+   */
+  static bool ParallelApplyFunction(const ExtendedOctree &tree,
+                                    uint64_t iLODLevel,
+                                    const ParallelBrickFunc& brickFunc,
+                                    size_t iThreads, uint32_t iOverlap=0);
+
+  /**
+   Zeroes all voxels on the clipped side of a plane, in-place. Bricks that
+   lie completely on the kept side are not touched, bricks that lie
+   completely on the clipped side are replaced by a single shared zero brick
+   (if the tree is compressed) and only bricks intersected by the plane are
+   decompressed, cropped and recompressed. Every LoD is cropped by the plane
+   in its own coordinates, so coarse bricks are not downsampled again.
+   The new bricks are staged in a temporary file first and then written to
+   the space of the bricks they replace; if that space is not large enough,
+   the tree is not modified. This is PrepareCrop followed by CommitCrop.
+
+   @param tree the octree to be cropped, bricks must not be atlantified
+   @param plane the clip plane in normalized coordinates, i.e. every LoD
+          spans [-0.5, 0.5) along each axis
+   @param strTempFile filename of the temporary staging file
+   @param pStats if not NULL receives the statistics of the changed bricks
+   @param pChanged if not NULL receives the indices of the changed bricks
+   @return true iff the tree was cropped
+   */
+  static bool CropInPlace(ExtendedOctree &tree, const PLANE<float>& plane,
+                          const std::string& strTempFile,
+                          BrickStatVec* pStats,
+                          std::vector<size_t>* pChanged);
+
+  /// The bricks a crop replaces, staged but not yet written to the tree.
+  /// Its staging file is deleted with it.
+  struct CropPlan {
+    struct StagedBrick {
+      size_t   iIndex;
+      uint64_t iStagePos;
+      TOCEntry entry;
+    };
+    CropPlan() {}
+    ~CropPlan();
+
+    LargeRAWFile_ptr pStage;
+    /// new bricks, in the order they were written to the staging file
+    std::vector<StagedBrick> staged;
+    /// removed bricks and the position in 'staged' of their zero brick
+    std::vector<std::pair<size_t, size_t>> aliases;
+    /// indices of the changed bricks
+    std::vector<size_t> vChanged;
+    /// statistics of the changed bricks
+    BrickStatVec stats;
+
+  private:
+    CropPlan(const CropPlan&);
+    CropPlan& operator=(const CropPlan&);
+  };
+
+  /**
+   The first half of CropInPlace: computes and stages the cropped bricks and
+   finds a place for each in the tree, but leaves the tree alone. Several
+   trees can thus be prepared and then committed only if all of them fit.
+
+   @param plan receives the staged bricks
+   @return false if the cropped bricks do not fit into the tree
+   */
+  static bool PrepareCrop(ExtendedOctree &tree, const PLANE<float>& plane,
+                          const std::string& strTempFile, CropPlan& plan);
+
+  /**
+   The second half of CropInPlace: writes the bricks staged by PrepareCrop
+   into 'tree', which must not have changed since.
+
+   @return false on I/O errors, which may leave the tree partially cropped
+   */
+  static bool CommitCrop(ExtendedOctree &tree, CropPlan& plan);
+
 public:
   /*! \brief A single brick cache entry
    *
@@ -398,6 +525,14 @@ private:
   /// where to write progress information
   AbstrDebugOut& m_Progress;
 
+  /// LRU cache of decompressed bricks of the tree we rebrick from
+  class SourceBrickCache;
+
+  /// Computes the statistics, compresses and permutes the bricks and writes
+  /// the header once all bricks of the tree are in place.
+  void FinishTree(ExtendedOctree& e, LargeRAWFile_ptr pLargeRAWFileOut,
+                  uint64_t iOutOffset);
+
   /// Computes max min statistics for each brick and rewrites 
   /// it using compression, if desired.
   void ComputeStatsAndCompressAll(ExtendedOctree& tree);
@@ -474,6 +609,21 @@ private:
                      uint64_t iInOffset, const UINT64VECTOR4& coords,
                      bool bClampToEdge);
 
+  /**
+    Assembles a brick from the bricks of the same LoD in another tree
+
+    @param vData vector to store the brick data
+    @param tree target extended octree (used to extract metadata)
+    @param source the tree to copy the voxels from
+    @param cache the bricks of 'source' we read so far
+    @param coords brick coordinates of the brick to be assembled
+    @param bClampToEdge use outer values to fill border (uses zeroes otherwise)
+  */
+  void GetSourceTreeBrick(std::vector<uint8_t>& vData,
+                          ExtendedOctree &tree, const ExtendedOctree& source,
+                          SourceBrickCache& cache, const UINT64VECTOR4& coords,
+                          bool bClampToEdge);
+
   /**
     This method reorders the large input raw file into smaller bricks
     of maximum size m_vBrickSize with an overlap of m_iOverlap i.e.
@@ -558,6 +708,57 @@ private:
   /// Computes the number of bytes required to store the (uncompressed) brick.
   static uint64_t BrickSize(const ExtendedOctree&, uint64_t index);
 
+  /**
+    Reads the compressed bricks [iFirst, iFirst+n) one after the other
+
+    @param tree the octree to read from
+    @param iFirst index of the first brick to read
+    @param n number of bricks to read, vPayloads must hold at least n pointers
+    @param vPayloads receives the compressed bricks
+  */
+  static void ReadBricks(const ExtendedOctree& tree, uint64_t iFirst,
+                         size_t n,
+                         std::vector<std::shared_ptr<uint8_t>>& vPayloads);
+
+  /**
+    Decompresses a brick read by ReadBricks, keeping only part of its overlap;
+    may be called concurrently for different bricks
+
+    @param tree the octree the brick belongs to
+    @param index index of the brick
+    @param iRemove number of overlap voxels to remove on each side
+    @param pPayload the compressed brick
+    @param vBrick receives the brick, resized to its size
+    @return false if the brick could not be decompressed
+  */
+  static bool DecodeBrick(const ExtendedOctree& tree, uint64_t index,
+                          uint32_t iRemove, std::shared_ptr<uint8_t> pPayload,
+                          std::vector<uint8_t>& vBrick);
+
+  /**
+    Reads the bricks [iFirst, iFirst+n) one after the other and decompresses
+    them concurrently, keeping only part of their overlap
+
+    @param tree the octree to read from
+    @param iFirst index of the first brick to decode
+    @param n number of bricks to decode, vBricks must hold at least n buffers
+    @param iRemove number of overlap voxels to remove on each side
+    @param vBricks receives the bricks, resized to the size of each
+    @return false if a brick could not be decompressed
+  */
+  static bool DecodeBricks(const ExtendedOctree& tree, uint64_t iFirst,
+                           size_t n, uint32_t iRemove,
+                           std::vector<std::vector<uint8_t>>& vBricks);
+
+  /// Compresses 'length' bytes of brick data with the given method and the
+  /// compression level of the tree.
+  /// @return the size of the compressed data in 'compressed'
+  static uint64_t CompressBrick(const ExtendedOctree& tree,
+                                COMPRESSION_TYPE eCompression,
+                                std::shared_ptr<uint8_t> pData,
+                                uint64_t length,
+                                std::shared_ptr<uint8_t>& compressed);
+
   /// computes the brick stats for the given brick
   static void BrickStat(
     BrickStatVec* bs, uint64_t index, const uint8_t* pData, uint64_t length,
@@ -0,0 +1,85 @@
+#pragma once
+
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <cstdint>
+
+// PDEP/PEXT interleave 21 bits in a single instruction, but only where the
+// compiler may assume BMI2 (-mbmi2, -march=haswell, /arch:AVX2).  AMD chips
+// before Zen 3 run them in microcode; builds for those are better served by
+// the magic bits below.
+#if (defined(__x86_64__) || defined(_M_X64)) && \
+    (defined(__BMI2__) || defined(__AVX2__))
+# include <immintrin.h>
+# define MORTON_USE_BMI2
+#endif
+
+/**
+  3D Morton (z-order) codes of up to 21 bits per axis.  Bit i of x, y and z
+  goes to bit 3i, 3i+1 and 3i+2 of the code.
+  */
+namespace Morton {
+
+/// Mask of the code bits taken by the x axis
+const uint64_t XMask = 0x1249249249249249ULL;
+
+/**
+  Spread the lower 21 bits of a value to every third bit
+  @param v value, bits beyond the 21st are ignored
+  @return v's bits at positions 0, 3, 6, ..., 60
+  */
+inline uint64_t Spread(uint64_t v) {
+#ifdef MORTON_USE_BMI2
+  return _pdep_u64(v, XMask);
+#else
+  v &= 0x1fffffULL;
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v <<  8) & 0x100f00f00f00f00fULL;
+  v = (v | v <<  4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v <<  2) & XMask;
+  return v;
+#endif
+}
+
+/**
+  Gather every third bit of a value, the inverse of Spread
+  @param v value, only bits 0, 3, 6, ..., 60 are used
+  @return the gathered 21 bits
+  */
+inline uint64_t Compact(uint64_t v) {
+#ifdef MORTON_USE_BMI2
+  return _pext_u64(v, XMask);
+#else
+  v &= XMask;
+  v = (v ^ v >>  2) & 0x10c30c30c30c30c3ULL;
+  v = (v ^ v >>  4) & 0x100f00f00f00f00fULL;
+  v = (v ^ v >>  8) & 0x1f0000ff0000ffULL;
+  v = (v ^ v >> 16) & 0x1f00000000ffffULL;
+  v = (v ^ v >> 32) & 0x1fffffULL;
+  return v;
+#endif
+}
+
+/**
+  Interleave the lower 21 bits of three coordinates
+  @return 63 bit Morton code
+  */
+inline uint64_t Encode(uint64_t x, uint64_t y, uint64_t z) {
+  return Spread(x) | Spread(y) << 1 | Spread(z) << 2;
+}
+
+/**
+  Split a Morton code into its three coordinates
+  @param code 63 bit Morton code, the highest bit is ignored
+  */
+inline void Decode(uint64_t code, uint64_t& x, uint64_t& y, uint64_t& z) {
+  x = Compact(code);
+  y = Compact(code >> 1);
+  z = Compact(code >> 2);
+}
+
+} // namespace Morton
+
+#endif // MORTON_H
@@ -1,9 +1,11 @@
+#include <cassert>
+#include <cmath>
 #include <cstring>
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
 #include "VolumeTools.h"
-#include "Hilbert.h"
+#include "Morton.h"
 
 using namespace VolumeTools;
 
@@ -13,18 +15,29 @@ Layout::Layout(UINT64VECTOR3 const& vDomainSize)
 
 bool Layout::ExceedsDomain(UINT64VECTOR3 const& vSpatialPosition)
 {
-  assert(vSpatialPosition.x < m_vDomainSize.x);
-  assert(vSpatialPosition.y < m_vDomainSize.y);
-  assert(vSpatialPosition.z < m_vDomainSize.z);
-  if (vSpatialPosition.x <= m_vDomainSize.x)
+  if (vSpatialPosition.x >= m_vDomainSize.x)
     return true;
-  if (vSpatialPosition.y <= m_vDomainSize.y)
+  if (vSpatialPosition.y >= m_vDomainSize.y)
     return true;
-  if (vSpatialPosition.z <= m_vDomainSize.z)
+  if (vSpatialPosition.z >= m_vDomainSize.z)
     return true;
   return false;
 }
 
+void Layout::GetLinearIndices(UINT64VECTOR3 const* pSpatialPositions,
+                              size_t iCount, uint64_t* pLinearIndices)
+{
+  for (size_t i = 0; i < iCount; ++i)
+    pLinearIndices[i] = GetLinearIndex(pSpatialPositions[i]);
+}
+
+void Layout::GetSpatialPositions(uint64_t iFirstIndex, size_t iCount,
+                                 UINT64VECTOR3* pSpatialPositions)
+{
+  for (size_t i = 0; i < iCount; ++i)
+    pSpatialPositions[i] = GetSpatialPosition(iFirstIndex + i);
+}
+
 ScanlineLayout::ScanlineLayout(UINT64VECTOR3 const& vDomainSize)
   : Layout(vDomainSize)
 {}
@@ -47,6 +60,27 @@ UINT64VECTOR3 ScanlineLayout::GetSpatialPosition(uint64_t iLinearIndex)
   return vPosition;
 }
 
+void ScanlineLayout::GetSpatialPositions(uint64_t iFirstIndex, size_t iCount,
+                                         UINT64VECTOR3* pSpatialPositions)
+{
+  if (iCount == 0)
+    return;
+
+  // divide once, then just count through the domain
+  UINT64VECTOR3 vPosition = ScanlineLayout::GetSpatialPosition(iFirstIndex);
+  for (size_t i = 0; i < iCount; ++i)
+  {
+    pSpatialPositions[i] = vPosition;
+    if (++vPosition.x == m_vDomainSize.x) {
+      vPosition.x = 0;
+      if (++vPosition.y == m_vDomainSize.y) {
+        vPosition.y = 0;
+        ++vPosition.z;
+      }
+    }
+  }
+}
+
 MortonLayout::MortonLayout(UINT64VECTOR3 const& vDomainSize)
   : Layout(vDomainSize)
 {}
@@ -60,19 +94,9 @@ uint64_t MortonLayout::GetLinearIndex(UINT64VECTOR3 const& vSpatialPosition)
 
   // we use the z-order curve, so we have to interlace the bits
   // of the 3d spatial position to obtain a linear 1d index
-  uint64_t const iIterations = (sizeof(uint64_t) * 8) / 3;
-  uint64_t iIndex = 0;
-
-  for (uint64_t i = 0; i < iIterations; ++i)
-  {
-    uint64_t const bit = 1u << i;
-
-    iIndex |= (vSpatialPosition.x & bit) << ((i * 2) + 0);
-    iIndex |= (vSpatialPosition.y & bit) << ((i * 2) + 1);
-    iIndex |= (vSpatialPosition.z & bit) << ((i * 2) + 2);
-  }
-
-  return iIndex;
+  return Morton::Encode(vSpatialPosition.x,
+                        vSpatialPosition.y,
+                        vSpatialPosition.z);
 }
 
 UINT64VECTOR3 MortonLayout::GetSpatialPosition(uint64_t iLinearIndex)
@@ -81,47 +105,142 @@ UINT64VECTOR3 MortonLayout::GetSpatialPosition(uint64_t iLinearIndex)
 
   // we use the z-order curve, so we have to deinterlace the bits
   // of the 1d linear index to obtain the 3d spatial position
-  uint64_t const iIterations = (sizeof(uint64_t) * 8) / 3;
-  UINT64VECTOR3 vPosition(0, 0, 0);
+  UINT64VECTOR3 vPosition;
+  Morton::Decode(iLinearIndex, vPosition.x, vPosition.y, vPosition.z);
+  return vPosition;
+}
 
-  for (uint64_t i = 0u; i < iIterations; ++i)
+void MortonLayout::GetLinearIndices(UINT64VECTOR3 const* pSpatialPositions,
+                                    size_t iCount, uint64_t* pLinearIndices)
+{
+  for (size_t i = 0; i < iCount; ++i)
   {
-    vPosition.x |= (iLinearIndex & 1u) << i;
-    vPosition.y |= (iLinearIndex & 2u) << i;
-    vPosition.z |= (iLinearIndex & 4u) << i;
+    UINT64VECTOR3 const& v = pSpatialPositions[i];
+    if (ExceedsDomain(v))
+      throw std::runtime_error("spatial position out of domain bounds");
+    pLinearIndices[i] = Morton::Encode(v.x, v.y, v.z);
+  }
+}
 
-    iLinearIndex >>= 3u;
+void MortonLayout::GetSpatialPositions(uint64_t iFirstIndex, size_t iCount,
+                                       UINT64VECTOR3* pSpatialPositions)
+{
+  for (size_t i = 0; i < iCount; ++i)
+  {
+    UINT64VECTOR3& v = pSpatialPositions[i];
+    Morton::Decode(iFirstIndex + i, v.x, v.y, v.z);
   }
+}
 
-  vPosition.y >>= 1u;
-  vPosition.z >>= 2u;
+namespace {
 
-  return vPosition;
-}
+  // The Hilbert curve as a state machine over octants: each state is one of
+  // the 12 orientations the curve takes in a sub cube.  Entries hold the
+  // 3 bit output of a level in bits 0-2 and the state of the next finer
+  // level in bits 3-6.  The tables were derived from Hilbert::Curve<3, n>,
+  // which starts in state 0 for every n; the layout test checks both agree.
+
+  // [state][octant, as x | y << 1 | z << 2] -> index digit | next << 3
+  uint8_t const HilbertEncodeTable[12][8] = {
+    {  8, 17, 27, 18, 47, 38, 28, 37 },
+    { 16, 71,  1, 62, 51, 52,  2, 61 },
+    {  0, 75, 95, 76,  9, 10, 86, 85 },
+    { 66,  3, 65, 80, 77,  4, 78, 55 },
+    { 46, 45, 49, 50,  7, 68, 88, 67 },
+    { 84, 83,  5, 58, 39, 72,  6, 57 },
+    { 90, 29, 11, 12, 89, 30, 32, 79 },
+    { 70, 15, 69, 92, 73, 40, 74, 91 },
+    { 36, 63, 35, 24, 13, 14, 82, 81 },
+    { 42, 41, 53, 54, 19, 56, 20, 31 },
+    { 94, 25, 23, 64, 93, 26, 44, 43 },
+    { 60, 21, 87, 22, 59, 34, 48, 33 }
+  };
+
+  // [state][index digit] -> octant | next << 3
+  uint8_t const HilbertDecodeTable[12][8] = {
+    {  8, 17, 19, 26, 30, 39, 37, 44 },
+    { 16,  2,  6, 52, 53, 63, 59, 65 },
+    {  0, 12, 13, 73, 75, 87, 86, 90 },
+    { 83, 66, 64,  1,  5, 76, 78, 55 },
+    { 94, 50, 51, 71, 69, 41, 40,  4 },
+    { 77, 63, 59, 81, 80,  2,  6, 36 },
+    { 38, 92, 88, 10, 11, 25, 29, 79 },
+    { 45, 76, 78, 95, 91, 66, 64,  9 },
+    { 27, 87, 86, 34, 32, 12, 13, 57 },
+    { 61, 41, 40, 20, 22, 50, 51, 31 },
+    { 67, 25, 29, 47, 46, 92, 88, 18 },
+    { 54, 39, 37, 60, 56, 17, 19, 82 }
+  };
+
+  inline uint64_t HilbertEncode(size_t nBits, UINT64VECTOR3 const& v)
+  {
+    // the octant of every level, finest in the lowest three bits
+    uint64_t const iOctants = Morton::Encode(v.x, v.y, v.z);
+    uint64_t iIndex = 0;
+    uint8_t iState = 0;
+    for (size_t i = nBits; i-- > 0;)
+    {
+      uint8_t const e = HilbertEncodeTable[iState][(iOctants >> (3 * i)) & 7];
+      iIndex = (iIndex << 3) | (e & 7);
+      iState = e >> 3;
+    }
+    return iIndex;
+  }
+
+  inline void HilbertDecode(size_t nBits, uint64_t iIndex, UINT64VECTOR3& v)
+  {
+    uint64_t iOctants = 0;
+    uint8_t iState = 0;
+    for (size_t i = nBits; i-- > 0;)
+    {
+      uint8_t const e = HilbertDecodeTable[iState][(iIndex >> (3 * i)) & 7];
+      iOctants = (iOctants << 3) | (e & 7);
+      iState = e >> 3;
+    }
+    Morton::Decode(iOctants, v.x, v.y, v.z);
+  }
+
+} // anonymous namespace
 
 HilbertLayout::HilbertLayout(UINT64VECTOR3 const& vDomainSize)
   : Layout(vDomainSize)
   , m_iBits(size_t(ceil(log(double(vDomainSize.maxVal()))/log(2.0))))
-{}
+{
+  // the index has to fit 64 bits
+  assert(m_iBits <= 21);
+}
 
 uint64_t HilbertLayout::GetLinearIndex(UINT64VECTOR3 const& vSpatialPosition)
 {
   if (ExceedsDomain(vSpatialPosition))
     throw std::runtime_error("spatial position out of domain bounds");
 
-  std::array<uint64_t, 3> v = {{
-    vSpatialPosition.x,
-    vSpatialPosition.y,
-    vSpatialPosition.z
-  }};
-  return Hilbert::Encode(m_iBits, v);
+  return HilbertEncode(m_iBits, vSpatialPosition);
 }
 
 UINT64VECTOR3 HilbertLayout::GetSpatialPosition(uint64_t iLinearIndex)
 {
-  std::array<uint64_t, 3> v = {{0, 0, 0}};
-  Hilbert::Decode(m_iBits, iLinearIndex, v);
-  return UINT64VECTOR3(v[0], v[1], v[2]);
+  UINT64VECTOR3 vPosition;
+  HilbertDecode(m_iBits, iLinearIndex, vPosition);
+  return vPosition;
+}
+
+void HilbertLayout::GetLinearIndices(UINT64VECTOR3 const* pSpatialPositions,
+                                     size_t iCount, uint64_t* pLinearIndices)
+{
+  for (size_t i = 0; i < iCount; ++i)
+  {
+    if (ExceedsDomain(pSpatialPositions[i]))
+      throw std::runtime_error("spatial position out of domain bounds");
+    pLinearIndices[i] = HilbertEncode(m_iBits, pSpatialPositions[i]);
+  }
+}
+
+void HilbertLayout::GetSpatialPositions(uint64_t iFirstIndex, size_t iCount,
+                                        UINT64VECTOR3* pSpatialPositions)
+{
+  for (size_t i = 0; i < iCount; ++i)
+    HilbertDecode(m_iBits, iFirstIndex + i, pSpatialPositions[i]);
 }
 
 namespace {
@@ -157,6 +276,13 @@ UINT64VECTOR3 RandomLayout::GetSpatialPosition(uint64_t iLinearIndex)
   return ScanlineLayout::GetSpatialPosition(iIndex);
 }
 
+void RandomLayout::GetSpatialPositions(uint64_t iFirstIndex, size_t iCount,
+                                       UINT64VECTOR3* pSpatialPositions)
+{
+  // consecutive indices are scattered, so the scanline walk does not apply
+  Layout::GetSpatialPositions(iFirstIndex, iCount, pSpatialPositions);
+}
+
 UINTVECTOR2 VolumeTools::Fit1DIndexTo2DArray(uint64_t iMax1DIndex,
                                              uint32_t iMax2DArraySize) {
   // check if 1D index exceeds given 2D array
@@ -36,6 +36,25 @@ namespace VolumeTools {
       */
     virtual UINT64VECTOR3 GetSpatialPosition(uint64_t iLinearIndex) = 0;
 
+    /**
+      Convert spatial 3D brick positions to linear indices
+      @param pSpatialPositions iCount spatial 3D positions
+      @param iCount number of positions to convert
+      @param pLinearIndices receives iCount linear indices
+      @throws std::runtime_error if a position exceeds domain boundaries
+      */
+    virtual void GetLinearIndices(UINT64VECTOR3 const* pSpatialPositions,
+                                  size_t iCount, uint64_t* pLinearIndices);
+
+    /**
+      Convert a run of consecutive linear indices to spatial 3D brick positions
+      @param iFirstIndex linear index of the first position
+      @param iCount number of indices to convert
+      @param pSpatialPositions receives iCount spatial 3D positions
+      */
+    virtual void GetSpatialPositions(uint64_t iFirstIndex, size_t iCount,
+                                     UINT64VECTOR3* pSpatialPositions);
+
   protected:
     /**
       Test if spatial 3D brick position is not part of the domain
@@ -52,6 +71,8 @@ namespace VolumeTools {
     ScanlineLayout(UINT64VECTOR3 const& vDomainSize);
     uint64_t GetLinearIndex(UINT64VECTOR3 const& vSpatialPosition);
     UINT64VECTOR3 GetSpatialPosition(uint64_t iLinearIndex);
+    void GetSpatialPositions(uint64_t iFirstIndex, size_t iCount,
+                             UINT64VECTOR3* pSpatialPositions);
   };
 
   // NOTICE: The current implementation works for cubic power of two domains.
@@ -67,6 +88,10 @@ namespace VolumeTools {
     MortonLayout(UINT64VECTOR3 const& vDomainSize);
     uint64_t GetLinearIndex(UINT64VECTOR3 const& vSpatialPosition);
     UINT64VECTOR3 GetSpatialPosition(uint64_t iLinearIndex);
+    void GetLinearIndices(UINT64VECTOR3 const* pSpatialPositions,
+                          size_t iCount, uint64_t* pLinearIndices);
+    void GetSpatialPositions(uint64_t iFirstIndex, size_t iCount,
+                             UINT64VECTOR3* pSpatialPositions);
   };
 
   // NOTICE: The current implementation works for cubic power of two domains.
@@ -78,11 +103,18 @@ namespace VolumeTools {
   //         Information Processing Letters, 105(5), 155--163, February 2008.
   // SEE:    http://web.cs.dal.ca/~chamilto/hilbert/ipl.pdf
   //         http://web.cs.dal.ca/~chamilto/hilbert/index.html
+  //
+  // The curve is the one of Hilbert::Curve<3, nBits>, walked with a state
+  // table instead of the bit transposes of the reference implementation.
   class HilbertLayout : public Layout {
   public:
     HilbertLayout(UINT64VECTOR3 const& vDomainSize);
     uint64_t GetLinearIndex(UINT64VECTOR3 const& vSpatialPosition);
     UINT64VECTOR3 GetSpatialPosition(uint64_t iLinearIndex);
+    void GetLinearIndices(UINT64VECTOR3 const* pSpatialPositions,
+                          size_t iCount, uint64_t* pLinearIndices);
+    void GetSpatialPositions(uint64_t iFirstIndex, size_t iCount,
+                             UINT64VECTOR3* pSpatialPositions);
   private:
     size_t m_iBits;
   };
@@ -92,6 +124,8 @@ namespace VolumeTools {
     RandomLayout(UINT64VECTOR3 const& vDomainSize);
     uint64_t GetLinearIndex(UINT64VECTOR3 const& vSpatialPosition);
     UINT64VECTOR3 GetSpatialPosition(uint64_t iLinearIndex);
+    void GetSpatialPositions(uint64_t iFirstIndex, size_t iCount,
+                             UINT64VECTOR3* pSpatialPositions);
   private:
     std::vector<uint64_t> m_vLookUp;
   };
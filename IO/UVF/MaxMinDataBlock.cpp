@@ -193,3 +193,20 @@ void MaxMinDataBlock::SetDataFromFlatVector(BrickStatVec& source, uint64_t iComp
     }
   }
 }
+
+void MaxMinDataBlock::UpdateFromFlatVector(const BrickStatVec& source,
+                                           const std::vector<size_t>& vBricks) {
+  for (size_t b = 0;b<vBricks.size();++b) {
+    const size_t i = vBricks[b];
+    for (size_t j = 0;j<m_iComponentCount;++j) {
+      m_vfMaxMinData[i][j].minScalar = source[i*m_iComponentCount+j].minScalar;
+      m_vfMaxMinData[i][j].maxScalar = source[i*m_iComponentCount+j].maxScalar;
+    }
+  }
+
+  // the changed bricks may have held the global extrema
+  ResetGlobal();
+  for (size_t i = 0;i<m_vfMaxMinData.size();++i)
+    for (size_t j = 0;j<m_iComponentCount;++j)
+      m_GlobalMaxMin[j].Merge(m_vfMaxMinData[i][j]);
+}
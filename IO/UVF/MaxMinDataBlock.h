@@ -27,6 +27,11 @@ public:
   void StartNewValue();
   void MergeData(const std::vector<DOUBLEVECTOR4>& fMaxMinData);
   void SetDataFromFlatVector(BrickStatVec& source, uint64_t iComponentCount);
+  /// Replaces the scalar ranges of the given bricks, e.g. after their data
+  /// changed; 'source' is laid out as for SetDataFromFlatVector.  The
+  /// gradient ranges of these bricks are kept.
+  void UpdateFromFlatVector(const BrickStatVec& source,
+                            const std::vector<size_t>& vBricks);
 
   const tuvok::MinMaxBlock& GetGlobalValue(size_t iComponent=0) const {
     return m_GlobalMaxMin[iComponent];
@@ -35,6 +40,10 @@ public:
   size_t GetComponentCount() const {
     return m_iComponentCount;
   }
+  /// @returns the number of bricks there are values for.
+  size_t GetValueCount() const {
+    return m_vfMaxMinData.size();
+  }
 
 protected:
   std::vector<tuvok::MinMaxBlock> m_GlobalMaxMin;
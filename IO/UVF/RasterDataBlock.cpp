@@ -63,6 +63,9 @@ RasterDataBlock::RasterDataBlock(const RasterDataBlock &other) :
   m_vBrickCount = other.m_vBrickCount;
   m_vBrickOffsets = other.m_vBrickOffsets;
   m_vBrickSizes = other.m_vBrickSizes;
+  m_vLODBrickStart = other.m_vLODBrickStart;
+  m_vFlatBrickOffset = other.m_vFlatBrickOffset;
+  m_vFlatBrickBytes = other.m_vFlatBrickBytes;
 }
 
 
@@ -92,6 +95,9 @@ RasterDataBlock& RasterDataBlock::operator=(const RasterDataBlock& other)  {
   m_vBrickCount = other.m_vBrickCount;
   m_vBrickOffsets = other.m_vBrickOffsets;
   m_vBrickSizes = other.m_vBrickSizes;
+  m_vLODBrickStart = other.m_vLODBrickStart;
+  m_vFlatBrickOffset = other.m_vFlatBrickOffset;
+  m_vFlatBrickBytes = other.m_vFlatBrickBytes;
 
   m_pTempFile = LargeRAWFile_ptr();
   m_pSourceFile = other.m_pSourceFile;
@@ -288,23 +294,30 @@ uint64_t RasterDataBlock::CopyToFile(LargeRAWFile_ptr pStreamFile, uint64_t iOff
  */
 vector<vector<uint64_t>> RasterDataBlock::GenerateCartesianProduct(const vector<vector<uint64_t>>& vElements, uint64_t iIndex)  const {
   vector<vector<uint64_t>> vResult;
-  if (iIndex == vElements.size()-1) {
-    for (size_t i = 0;i<vElements[vElements.size()-1].size();i++) {
-      vector<uint64_t> v;
-      v.push_back(vElements[vElements.size()-1][i]);
-      vResult.push_back(v);
-    }
-  } else {
-    vector<vector<uint64_t>> vTmpResult = GenerateCartesianProduct(vElements,iIndex+1);
-    for (size_t j = 0;j<vTmpResult.size();j++) {
-      for (size_t i = 0;i<vElements[size_t(iIndex)].size();i++) {
-        vector<uint64_t> v;
-        v.push_back(vElements[size_t(iIndex)][i]);
-
-        for (size_t k = 0;k<vTmpResult[j].size();k++) v.push_back(vTmpResult[j][k]);
-
-        vResult.push_back(v);
+  const size_t iFirst = size_t(iIndex);
+  if (iFirst >= vElements.size()) return vResult;
+
+  size_t iCount = 1;
+  for (size_t i = iFirst;i<vElements.size();i++) iCount *= vElements[i].size();
+  if (iCount == 0) return vResult;
+
+  // count through the combinations like an odometer, the first element
+  // varying fastest
+  vector<size_t> vDigits(vElements.size()-iFirst, 0);
+  vector<uint64_t> v(vDigits.size());
+  for (size_t i = 0;i<v.size();i++) v[i] = vElements[iFirst+i][0];
+
+  vResult.reserve(iCount);
+  for (size_t j = 0;j<iCount;j++) {
+    vResult.push_back(v);
+    for (size_t i = 0;i<vDigits.size();i++) {
+      const vector<uint64_t>& vDim = vElements[iFirst+i];
+      if (++vDigits[i] < vDim.size()) {
+        v[i] = vDim[vDigits[i]];
+        break;
       }
+      vDigits[i] = 0;
+      v[i] = vDim[0];
     }
   }
 
@@ -394,22 +407,17 @@ uint64_t RasterDataBlock::ComputeLODLevelSizeAndOffsetTables(const vector<uint64
 
 
 uint64_t RasterDataBlock::ComputeLODLevelSize(const vector<uint64_t>& vReducedDomainSize) const {
-  uint64_t ulSize = 0;
-
   // compute the size of a single data element
   uint64_t uiBitsPerElement = ComputeElementSize();
 
-  // compute brick layout
+  // the bricks are the cartesian product of the per-dimension brick sizes,
+  // so their total size is the product of the per-dimension sums
   vector<vector<uint64_t>> vBricks = ComputeBricks(vReducedDomainSize);
-  vector<vector<uint64_t>> vBrickPermutation = GenerateCartesianProduct(vBricks);
 
-  ulSize = 0;
-  for (size_t i = 0;i<vBrickPermutation.size();i++) {
-    uint64_t ulBrickSize = vBrickPermutation[i][0];
-    for (size_t j = 1;j<vBrickPermutation[i].size();j++) {
-      ulBrickSize *= vBrickPermutation[i][j];
-    }
-    ulSize += ulBrickSize;
+  uint64_t ulSize = 1;
+  for (size_t i = 0;i<vBricks.size();i++) {
+    ulSize *= std::accumulate(vBricks[i].begin(), vBricks[i].end(),
+                              uint64_t(0));
   }
 
   return  ulSize * uiBitsPerElement;
@@ -506,9 +514,37 @@ uint64_t RasterDataBlock::ComputeDataSizeAndOffsetTables() {
     if (i<vLODCombis.size()-1) m_vLODOffsets[i+1] = m_vLODOffsets[i] + iLODLevelSize;
   }
 
+  BuildFlatTables();
+
   return iDataSize/8;
 }
 
+void RasterDataBlock::BuildFlatTables() {
+  const uint64_t iBytesPerElement = ComputeElementSize()/8;
+
+  size_t iBrickCount = 0;
+  for (size_t i = 0;i<m_vBrickSizes.size();i++) iBrickCount += m_vBrickSizes[i].size();
+
+  m_vLODBrickStart.clear();
+  m_vLODBrickStart.reserve(m_vBrickSizes.size()+1);
+  m_vFlatBrickOffset.clear();
+  m_vFlatBrickOffset.reserve(iBrickCount);
+  m_vFlatBrickBytes.clear();
+  m_vFlatBrickBytes.reserve(iBrickCount);
+
+  m_vLODBrickStart.push_back(0);
+  for (size_t i = 0;i<m_vBrickSizes.size();i++) {
+    for (size_t j = 0;j<m_vBrickSizes[i].size();j++) {
+      m_vFlatBrickOffset.push_back(GetLocalDataPointerOffset(i,j)/8);
+      m_vFlatBrickBytes.push_back(
+        std::accumulate(m_vBrickSizes[i][j].begin(), m_vBrickSizes[i][j].end(),
+                        iBytesPerElement, std::multiplies<uint64_t>())
+      );
+    }
+    m_vLODBrickStart.push_back(m_vFlatBrickOffset.size());
+  }
+}
+
 uint64_t RasterDataBlock::RecompLODIndexCount() const {
   uint64_t ulLODIndexCount = 1;
   for (size_t i = 0;i<ulLODGroups.size();i++) if (ulLODGroups[i] >= ulLODIndexCount) ulLODIndexCount = ulLODGroups[i]+1;
@@ -1182,34 +1218,67 @@ void RasterDataBlock::CleanupTemp() {
   if (m_pTempFile != LargeRAWFile_ptr()) m_pTempFile->Delete();
 }
 
-namespace {
-  template<typename T>
-  void size_vector_for_io(std::vector<T>& v, size_t sz)
-  {
-    v.resize(sz / sizeof(T));
-  }
+bool
+RasterDataBlock::BrickIndex(const std::vector<uint64_t>& vLOD,
+                            const std::vector<uint64_t>& vBrick,
+                            uint64_t& iLODIndex, uint64_t& iBrickIndex) const
+{
+  if (vLOD.size() != ulLODLevelCount.size()) return false;
+  iLODIndex = Serialize(vLOD, ulLODLevelCount);
+  if (iLODIndex >= m_vBrickCount.size()) return false;
+
+  const vector<uint64_t>& vBrickCount = m_vBrickCount[size_t(iLODIndex)];
+  if (vBrick.size() != vBrickCount.size()) return false;
+  iBrickIndex = Serialize(vBrick, vBrickCount);
+  const uint64_t count = std::accumulate(vBrickCount.begin(),
+                                         vBrickCount.end(),
+                                         static_cast<uint64_t>(1),
+                                         std::multiplies<uint64_t>());
+  return iBrickIndex < count;
 }
 
 size_t
 RasterDataBlock::GetBrickByteSize(const std::vector<uint64_t>& vLOD,
                                   const std::vector<uint64_t>& vBrick) const
 {
-  vector<uint64_t> vSize = GetBrickSize(vLOD,vBrick);
-  uint64_t iSize = ComputeElementSize()/8;
-  for (size_t i = 0;i<vSize.size();i++) iSize *= vSize[i];
-  return static_cast<size_t>(iSize);
+  uint64_t iLODIndex, iBrickIndex;
+  if (!BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex)) return 0;
+  return GetBrickByteSize(iLODIndex, iBrickIndex);
+}
+
+size_t
+RasterDataBlock::GetBrickByteSize(uint64_t iLODIndex,
+                                  uint64_t iBrickIndex) const
+{
+  if (iLODIndex+1 >= m_vLODBrickStart.size()) return 0;
+  const uint64_t iFlat = m_vLODBrickStart[size_t(iLODIndex)] + iBrickIndex;
+  if (iFlat >= m_vLODBrickStart[size_t(iLODIndex)+1]) return 0;
+  return static_cast<size_t>(m_vFlatBrickBytes[size_t(iFlat)]);
+}
+
+LargeRAWFile_ptr
+RasterDataBlock::BrickFile(const std::vector<uint64_t>& vLOD,
+                           const std::vector<uint64_t>& vBrick,
+                           uint64_t& iOffset) const
+{
+  uint64_t iLODIndex, iBrickIndex;
+  if (!BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex)) {
+    return LargeRAWFile_ptr();
+  }
+  return BrickFile(iLODIndex, iBrickIndex, iOffset);
 }
 
 LargeRAWFile_ptr
-RasterDataBlock::SeekToBrick(const std::vector<uint64_t>& vLOD,
-                             const std::vector<uint64_t>& vBrick) const
+RasterDataBlock::BrickFile(uint64_t iLODIndex, uint64_t iBrickIndex,
+                           uint64_t& iOffset) const
 {
   if (m_pTempFile == LargeRAWFile_ptr() && 
       m_pStreamFile == LargeRAWFile_ptr()) return LargeRAWFile_ptr();
-  if (m_vLODOffsets.empty()) { return LargeRAWFile_ptr(); }
+  if (iLODIndex+1 >= m_vLODBrickStart.size()) { return LargeRAWFile_ptr(); }
 
   LargeRAWFile_ptr  pStreamFile;
-  uint64_t iOffset = GetLocalDataPointerOffset(vLOD, vBrick)/8;
+  iOffset = m_vFlatBrickOffset[size_t(m_vLODBrickStart[size_t(iLODIndex)] +
+                                      iBrickIndex)];
 
   if (m_pStreamFile) {
     // add global offset
@@ -1220,7 +1289,6 @@ RasterDataBlock::SeekToBrick(const std::vector<uint64_t>& vLOD,
   } else {
     pStreamFile = m_pTempFile;
   }
-  pStreamFile->SeekPos(iOffset);
   return pStreamFile;
 }
 
@@ -1228,10 +1296,22 @@ bool RasterDataBlock::GetData(uint8_t* vData, size_t bytes,
                               const std::vector<uint64_t>& vLOD,
                               const std::vector<uint64_t>& vBrick) const
 {
-  LargeRAWFile_ptr pStreamFile = SeekToBrick(vLOD, vBrick);
+  uint64_t iOffset;
+  LargeRAWFile_ptr pStreamFile = BrickFile(vLOD, vBrick, iOffset);
   if(!pStreamFile) { return false; }
 
-  pStreamFile->ReadRAW(vData, bytes);
+  pStreamFile->ReadAt(iOffset, vData, bytes);
+  return true;
+}
+
+bool RasterDataBlock::GetData(uint8_t* pData, size_t bytes,
+                              uint64_t iLODIndex, uint64_t iBrickIndex) const
+{
+  uint64_t iOffset;
+  LargeRAWFile_ptr pStreamFile = BrickFile(iLODIndex, iBrickIndex, iOffset);
+  if(!pStreamFile) { return false; }
+
+  pStreamFile->ReadAt(iOffset, pData, bytes);
   return true;
 }
 
@@ -1247,95 +1327,78 @@ bool RasterDataBlock::ValidLOD(const std::vector<uint64_t>& vLOD) const
 bool RasterDataBlock::ValidBrickIndex(const std::vector<uint64_t>& vLOD,
                                       const std::vector<uint64_t>& vBrick) const
 {
-  const uint64_t lod = Serialize(vLOD, ulLODLevelCount);
-  const size_t lod_s = static_cast<size_t>(lod);
-  if(lod_s >= m_vBrickSizes.size()) { return false; }
-
-  const uint64_t b_idx = Serialize(vBrick, m_vBrickCount[lod_s]);
-  const size_t b_idx_s = static_cast<size_t>(b_idx);
-  const uint64_t count = std::accumulate(m_vBrickCount[lod_s].begin(),
-                                       m_vBrickCount[lod_s].end(),
-                                       static_cast<uint64_t>(1),
-                                       std::multiplies<uint64_t>());
-  if(b_idx_s >= count) { return false; }
-
-  return true;
+  uint64_t iLODIndex, iBrickIndex;
+  return BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex);
 }
 
+// The typed reads serialize the brick position once and then read through
+// the flat tables, see the index based GetData.
 bool RasterDataBlock::GetData(std::vector<uint8_t>& vData,
                               const std::vector<uint64_t>& vLOD,
                               const std::vector<uint64_t>& vBrick) const
 {
-  if(!ValidBrickIndex(vLOD, vBrick)) { return false; }
-  size_t iSize = GetBrickByteSize(vLOD, vBrick);
-  size_vector_for_io(vData, iSize);
-  return GetData(&vData[0], iSize, vLOD, vBrick);
+  uint64_t iLODIndex, iBrickIndex;
+  if(!BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex)) { return false; }
+  return GetData(vData, iLODIndex, iBrickIndex);
 }
 bool RasterDataBlock::GetData(std::vector<int8_t>& vData,
                               const std::vector<uint64_t>& vLOD,
                               const std::vector<uint64_t>& vBrick) const
 {
-  if(!ValidBrickIndex(vLOD, vBrick)) { return false; }
-  const size_t bytes = GetBrickByteSize(vLOD, vBrick);
-  size_vector_for_io(vData, bytes);
-  return GetData(reinterpret_cast<uint8_t*>(&vData[0]), bytes, vLOD, vBrick);
+  uint64_t iLODIndex, iBrickIndex;
+  if(!BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex)) { return false; }
+  return GetData(vData, iLODIndex, iBrickIndex);
 }
 
 bool RasterDataBlock::GetData(std::vector<uint16_t>& vData,
                               const std::vector<uint64_t>& vLOD,
                               const std::vector<uint64_t>& vBrick) const
 {
-  if(!ValidBrickIndex(vLOD, vBrick)) { return false; }
-  const size_t bytes = GetBrickByteSize(vLOD, vBrick);
-  size_vector_for_io(vData, bytes);
-  return GetData(reinterpret_cast<uint8_t*>(&vData[0]), bytes, vLOD, vBrick);
+  uint64_t iLODIndex, iBrickIndex;
+  if(!BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex)) { return false; }
+  return GetData(vData, iLODIndex, iBrickIndex);
 }
 bool RasterDataBlock::GetData(std::vector<int16_t>& vData,
                               const std::vector<uint64_t>& vLOD,
                               const std::vector<uint64_t>& vBrick) const
 {
-  if(!ValidBrickIndex(vLOD, vBrick)) { return false; }
-  const size_t bytes = GetBrickByteSize(vLOD, vBrick);
-  size_vector_for_io(vData, bytes);
-  return GetData(reinterpret_cast<uint8_t*>(&vData[0]), bytes, vLOD, vBrick);
+  uint64_t iLODIndex, iBrickIndex;
+  if(!BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex)) { return false; }
+  return GetData(vData, iLODIndex, iBrickIndex);
 }
 
 bool RasterDataBlock::GetData(std::vector<uint32_t>& vData,
                               const std::vector<uint64_t>& vLOD,
                               const std::vector<uint64_t>& vBrick) const
 {
-  if(!ValidBrickIndex(vLOD, vBrick)) { return false; }
-  const size_t bytes = GetBrickByteSize(vLOD, vBrick);
-  size_vector_for_io(vData, bytes);
-  return GetData(reinterpret_cast<uint8_t*>(&vData[0]), bytes, vLOD, vBrick);
+  uint64_t iLODIndex, iBrickIndex;
+  if(!BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex)) { return false; }
+  return GetData(vData, iLODIndex, iBrickIndex);
 }
 bool RasterDataBlock::GetData(std::vector<int32_t>& vData,
                               const std::vector<uint64_t>& vLOD,
                               const std::vector<uint64_t>& vBrick) const
 {
-  if(!ValidBrickIndex(vLOD, vBrick)) { return false; }
-  const size_t bytes = GetBrickByteSize(vLOD, vBrick);
-  size_vector_for_io(vData, bytes);
-  return GetData(reinterpret_cast<uint8_t*>(&vData[0]), bytes, vLOD, vBrick);
+  uint64_t iLODIndex, iBrickIndex;
+  if(!BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex)) { return false; }
+  return GetData(vData, iLODIndex, iBrickIndex);
 }
 
 bool RasterDataBlock::GetData(std::vector<float>& vData,
                               const std::vector<uint64_t>& vLOD,
                               const std::vector<uint64_t>& vBrick) const
 {
-  if(!ValidBrickIndex(vLOD, vBrick)) { return false; }
-  const size_t bytes = GetBrickByteSize(vLOD, vBrick);
-  size_vector_for_io(vData, bytes);
-  return GetData(reinterpret_cast<uint8_t*>(&vData[0]), bytes, vLOD, vBrick);
+  uint64_t iLODIndex, iBrickIndex;
+  if(!BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex)) { return false; }
+  return GetData(vData, iLODIndex, iBrickIndex);
 }
 bool RasterDataBlock::GetData(std::vector<double>& vData,
                               const std::vector<uint64_t>& vLOD,
                               const std::vector<uint64_t>& vBrick) const
 {
-  if(!ValidBrickIndex(vLOD, vBrick)) { return false; }
-  const size_t bytes = GetBrickByteSize(vLOD, vBrick);
-  size_vector_for_io(vData, bytes);
-  return GetData(reinterpret_cast<uint8_t*>(&vData[0]), bytes, vLOD, vBrick);
+  uint64_t iLODIndex, iBrickIndex;
+  if(!BrickIndex(vLOD, vBrick, iLODIndex, iBrickIndex)) { return false; }
+  return GetData(vData, iLODIndex, iBrickIndex);
 }
 
 bool RasterDataBlock::Settable() const {
@@ -1348,17 +1411,20 @@ bool RasterDataBlock::SetData( int8_t* pData, const vector<uint64_t>& vLOD,
                               const vector<uint64_t>& vBrick) {
   if(!Settable()) { return false; }
 
-  SeekToBrick(vLOD, vBrick);
+  uint64_t iOffset;
+  if(!BrickFile(vLOD, vBrick, iOffset)) { return false; }
   uint64_t sz = GetBrickByteSize(vLOD, vBrick);
-  return m_pStreamFile->WriteRAW(reinterpret_cast<uint8_t*>(pData), sz) == sz;
+  return m_pStreamFile->WriteAt(iOffset, reinterpret_cast<uint8_t*>(pData),
+                                sz) == sz;
 }
 bool RasterDataBlock::SetData(uint8_t* pData, const vector<uint64_t>& vLOD,
                               const vector<uint64_t>& vBrick) {
   if(!Settable()) { return false; }
 
-  SeekToBrick(vLOD, vBrick);
+  uint64_t iOffset;
+  if(!BrickFile(vLOD, vBrick, iOffset)) { return false; }
   uint64_t sz = GetBrickByteSize(vLOD, vBrick);
-  return m_pStreamFile->WriteRAW(pData, sz) == sz;;
+  return m_pStreamFile->WriteAt(iOffset, pData, sz) == sz;
 }
 
 bool RasterDataBlock::SetData(int16_t* pData,
@@ -1367,9 +1433,11 @@ bool RasterDataBlock::SetData(int16_t* pData,
 {
   if(!Settable()) { return false; }
 
-  SeekToBrick(vLOD, vBrick);
+  uint64_t iOffset;
+  if(!BrickFile(vLOD, vBrick, iOffset)) { return false; }
   uint64_t sz = GetBrickByteSize(vLOD, vBrick);
-  return m_pStreamFile->WriteRAW(reinterpret_cast<uint8_t*>(pData), sz) == sz;
+  return m_pStreamFile->WriteAt(iOffset, reinterpret_cast<uint8_t*>(pData),
+                                sz) == sz;
 }
 bool RasterDataBlock::SetData(uint16_t* pData,
                               const std::vector<uint64_t>& vLOD,
@@ -1377,9 +1445,11 @@ bool RasterDataBlock::SetData(uint16_t* pData,
 {
   if(!Settable()) { return false; }
 
-  SeekToBrick(vLOD, vBrick);
+  uint64_t iOffset;
+  if(!BrickFile(vLOD, vBrick, iOffset)) { return false; }
   uint64_t sz = GetBrickByteSize(vLOD, vBrick);
-  return m_pStreamFile->WriteRAW(reinterpret_cast<uint8_t*>(pData), sz) == sz;
+  return m_pStreamFile->WriteAt(iOffset, reinterpret_cast<uint8_t*>(pData),
+                                sz) == sz;
 }
 
 bool RasterDataBlock::SetData(int32_t* pData,
@@ -1388,9 +1458,11 @@ bool RasterDataBlock::SetData(int32_t* pData,
 {
   if(!Settable()) { return false; }
 
-  SeekToBrick(vLOD, vBrick);
+  uint64_t iOffset;
+  if(!BrickFile(vLOD, vBrick, iOffset)) { return false; }
   uint64_t sz = GetBrickByteSize(vLOD, vBrick);
-  return m_pStreamFile->WriteRAW(reinterpret_cast<uint8_t*>(pData), sz) == sz;
+  return m_pStreamFile->WriteAt(iOffset, reinterpret_cast<uint8_t*>(pData),
+                                sz) == sz;
 }
 bool RasterDataBlock::SetData(uint32_t* pData,
                               const std::vector<uint64_t>& vLOD,
@@ -1398,9 +1470,11 @@ bool RasterDataBlock::SetData(uint32_t* pData,
 {
   if(!Settable()) { return false; }
 
-  SeekToBrick(vLOD, vBrick);
+  uint64_t iOffset;
+  if(!BrickFile(vLOD, vBrick, iOffset)) { return false; }
   uint64_t sz = GetBrickByteSize(vLOD, vBrick);
-  return m_pStreamFile->WriteRAW(reinterpret_cast<uint8_t*>(pData), sz) == sz;
+  return m_pStreamFile->WriteAt(iOffset, reinterpret_cast<uint8_t*>(pData),
+                                sz) == sz;
 }
 
 bool RasterDataBlock::SetData(float* pData,
@@ -1409,9 +1483,11 @@ bool RasterDataBlock::SetData(float* pData,
 {
   if(!Settable()) { return false; }
 
-  SeekToBrick(vLOD, vBrick);
+  uint64_t iOffset;
+  if(!BrickFile(vLOD, vBrick, iOffset)) { return false; }
   uint64_t sz = GetBrickByteSize(vLOD, vBrick);
-  return m_pStreamFile->WriteRAW(reinterpret_cast<uint8_t*>(pData), sz) == sz;
+  return m_pStreamFile->WriteAt(iOffset, reinterpret_cast<uint8_t*>(pData),
+                                sz) == sz;
 }
 bool RasterDataBlock::SetData(double* pData,
                               const std::vector<uint64_t>& vLOD,
@@ -1419,9 +1495,11 @@ bool RasterDataBlock::SetData(double* pData,
 {
   if(!Settable()) { return false; }
 
-  SeekToBrick(vLOD, vBrick);
+  uint64_t iOffset;
+  if(!BrickFile(vLOD, vBrick, iOffset)) { return false; }
   uint64_t sz = GetBrickByteSize(vLOD, vBrick);
-  return m_pStreamFile->WriteRAW(reinterpret_cast<uint8_t*>(pData), sz) == sz;
+  return m_pStreamFile->WriteAt(iOffset, reinterpret_cast<uint8_t*>(pData),
+                                sz) == sz;
 }
 
 void RasterDataBlock::ResetFile(LargeRAWFile_ptr raw)
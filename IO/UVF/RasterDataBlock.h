@@ -155,6 +155,26 @@ public:
   bool GetData(std::vector<double>& vData,
                const std::vector<uint64_t>& vLOD,
                const std::vector<uint64_t>& vBrick) const;
+
+  /// Reads brick 'iBrickIndex' of the LOD with index 'iLODIndex' without
+  /// building any index vectors.  LODs and bricks are numbered like
+  /// Serialize does, the first LOD group / dimension varying fastest; with a
+  /// single LOD group the LOD index is the LOD itself.
+  template<typename T>
+  bool GetData(std::vector<T>& vData, uint64_t iLODIndex,
+               uint64_t iBrickIndex) const {
+    const size_t bytes = GetBrickByteSize(iLODIndex, iBrickIndex);
+    if(bytes == 0) { return false; }
+    vData.resize(bytes / sizeof(T));
+    return GetData(reinterpret_cast<uint8_t*>(&vData[0]), bytes, iLODIndex,
+                   iBrickIndex);
+  }
+  bool GetData(uint8_t* pData, size_t bytes, uint64_t iLODIndex,
+               uint64_t iBrickIndex) const;
+  /// @returns the size of the given brick in bytes, 0 if there is no such
+  /// brick.
+  size_t GetBrickByteSize(uint64_t iLODIndex, uint64_t iBrickIndex) const;
+
   bool SetData(int8_t* pData, const std::vector<uint64_t>& vLOD,
                const std::vector<uint64_t>& vBrick);
   bool SetData(uint8_t* pData, const std::vector<uint64_t>& vLOD,
@@ -273,6 +293,12 @@ protected:
   std::vector<std::vector<uint64_t>> m_vBrickCount;
   std::vector<std::vector<uint64_t>> m_vBrickOffsets;
   std::vector<std::vector<std::vector<uint64_t>>> m_vBrickSizes;
+  /// the tables above flattened for the read path: brick b of LOD l is entry
+  /// m_vLODBrickStart[l]+b, offsets are in bytes from the start of the data
+  std::vector<uint64_t> m_vLODBrickStart;
+  std::vector<uint64_t> m_vFlatBrickOffset;
+  std::vector<uint64_t> m_vFlatBrickBytes;
+  void BuildFlatTables();
 
   uint64_t Serialize(const std::vector<uint64_t>& vec,
                      const std::vector<uint64_t>& vSizes) const;
@@ -351,8 +377,16 @@ protected:
                          const std::vector<uint64_t>& vPrefixProd,
                          const std::vector<uint64_t>& vBrickPrefixProduct) const;
 private:
-  LargeRAWFile_ptr SeekToBrick(const std::vector<uint64_t>& vLOD,
-                            const std::vector<uint64_t>& vBrick) const;
+  /// @returns the file holding the brick and, in 'iOffset', where in it.
+  LargeRAWFile_ptr BrickFile(const std::vector<uint64_t>& vLOD,
+                             const std::vector<uint64_t>& vBrick,
+                             uint64_t& iOffset) const;
+  LargeRAWFile_ptr BrickFile(uint64_t iLODIndex, uint64_t iBrickIndex,
+                             uint64_t& iOffset) const;
+  /// serializes 'vLOD' and 'vBrick'; false if they name no brick.
+  bool BrickIndex(const std::vector<uint64_t>& vLOD,
+                  const std::vector<uint64_t>& vBrick,
+                  uint64_t& iLODIndex, uint64_t& iBrickIndex) const;
   bool GetData(unsigned char*, size_t bytes,
                const std::vector<uint64_t>& vLOD,
                const std::vector<uint64_t>& vBrick) const;
@@ -52,7 +52,9 @@ uint64_t TOCBlock::GetHeaderFromFile(LargeRAWFile_ptr pStreamFile,
   m_iOffsetToOctree = iOffset +
                       DataBlock::GetHeaderFromFile(pStreamFile, iOffset,
                                                    bIsBigEndian);
-  if(m_ExtendedOctree.Open(pStreamFile, m_iOffsetToOctree, m_iUVFFileVersion) == false) {
+  // most uses only look at a few LoDs; don't decode all of a large ToC.
+  if(m_ExtendedOctree.Open(pStreamFile, m_iOffsetToOctree, m_iUVFFileVersion,
+                           true) == false) {
     throw std::ios_base::failure("opening octree failed.");
   }
   return pStreamFile->GetPos() - iOffset;
@@ -185,6 +187,79 @@ bool TOCBlock::FlatDataToBrickedLOD(
   return m_ExtendedOctree.Open(m_strDeleteTempFile, 0, m_iUVFFileVersion);
 }
 
+bool TOCBlock::BrickedLODToBrickedLOD(
+  const TOCBlock& source, const std::string& strTempFile,
+  const UINT64VECTOR3& vMaxBrickSize,
+  uint32_t iOverlap,
+  bool bClampToEdge,
+  size_t iCacheSize,
+  std::shared_ptr<MaxMinDataBlock> pMaxMinDatBlock,
+  AbstrDebugOut* debugOut,
+  COMPRESSION_TYPE ct,
+  uint32_t iCompressionLevel,
+  LAYOUT_TYPE lt
+) {
+  m_vMaxBrickSize = vMaxBrickSize;
+  m_iOverlap = iOverlap;
+
+  assert(m_vMaxBrickSize[0] > 2*m_iOverlap);
+  assert(m_vMaxBrickSize[1] > 2*m_iOverlap);
+  assert(m_vMaxBrickSize[2] > 2*m_iOverlap);
+  assert(debugOut != NULL);
+
+  LargeRAWFile_ptr outFile(new LargeRAWFile(strTempFile));
+  if (!outFile->Create()) {
+    debugOut->Error(_func_, "Could not create tempfile '%s'",
+                    strTempFile.c_str());
+    return false;
+  }
+  m_pStreamFile = outFile;
+  m_strDeleteTempFile = strTempFile;
+  ExtendedOctreeConverter c(m_vMaxBrickSize, m_iOverlap, iCacheSize,
+                            *debugOut);
+  BrickStatVec statsVec;
+
+  source.m_ExtendedOctree.LoadTOC();
+  if(!c.ReBrick(source.m_ExtendedOctree, outFile, 0, &statsVec, ct,
+                iCompressionLevel, bClampToEdge, lt)) {
+    debugOut->Error(_func_, "ExtOctree reported failed rebricking.");
+    return false;
+  }
+  outFile->Close(); // note, needed before the 'Open' below!
+
+  pMaxMinDatBlock->SetDataFromFlatVector(statsVec,
+                                         source.GetComponentCount());
+  debugOut->Message(_func_, "opening UVF '%s'", m_strDeleteTempFile.c_str());
+  return m_ExtendedOctree.Open(m_strDeleteTempFile, 0, m_iUVFFileVersion);
+}
+
+bool TOCBlock::CropInPlace(const PLANE<float>& plane,
+                           const std::string& strTempFile,
+                           MaxMinDataBlock* pMaxMinDatBlock) {
+  ExtendedOctreeConverter::CropPlan plan;
+  return PrepareCrop(plane, strTempFile, plan) &&
+         CommitCrop(plan, pMaxMinDatBlock);
+}
+
+bool TOCBlock::PrepareCrop(const PLANE<float>& plane,
+                           const std::string& strTempFile,
+                           ExtendedOctreeConverter::CropPlan& plan) {
+  m_ExtendedOctree.LoadTOC();
+  return ExtendedOctreeConverter::PrepareCrop(m_ExtendedOctree, plane,
+                                              strTempFile, plan);
+}
+
+bool TOCBlock::CommitCrop(ExtendedOctreeConverter::CropPlan& plan,
+                          MaxMinDataBlock* pMaxMinDatBlock) {
+  if (!ExtendedOctreeConverter::CommitCrop(m_ExtendedOctree, plan)) {
+    return false;
+  }
+  if (pMaxMinDatBlock) {
+    pMaxMinDatBlock->UpdateFromFlatVector(plan.stats, plan.vChanged);
+  }
+  return true;
+}
+
 bool TOCBlock::BrickedLODToFlatData(
   uint64_t iLoD,
   const std::string& strTargetFile,
@@ -211,6 +286,7 @@ bool TOCBlock::BrickedLODToFlatData(uint64_t iLoD,
                                     LargeRAWFile_ptr pTargetFile,
                                     bool bAppend, AbstrDebugOut*) const {
   uint64_t iOffset = bAppend ? pTargetFile->GetCurrentSize() : 0;
+  m_ExtendedOctree.LoadTOC();
   return ExtendedOctreeConverter::ExportToRAW(m_ExtendedOctree, pTargetFile,
                                               iLoD, iOffset);
 }
@@ -225,11 +301,24 @@ bool TOCBlock::ApplyFunction(uint64_t iLoD,
                              void* pUserContext,
                              uint32_t iOverlap,
                              AbstrDebugOut*) const {
+  m_ExtendedOctree.LoadTOC();
   return ExtendedOctreeConverter::ApplyFunction(m_ExtendedOctree, iLoD,
                                                 brickFunc, pUserContext,
                                                 iOverlap);
 }
 
+bool TOCBlock::ParallelApplyFunction(
+  uint64_t iLoD,
+  const ExtendedOctreeConverter::ParallelBrickFunc& brickFunc,
+  size_t iThreads,
+  uint32_t iOverlap
+) const {
+  m_ExtendedOctree.LoadTOC();
+  return ExtendedOctreeConverter::ParallelApplyFunction(m_ExtendedOctree, iLoD,
+                                                        brickFunc, iThreads,
+                                                        iOverlap);
+}
+
 void TOCBlock::GetData(uint8_t* pData, UINT64VECTOR4 coordinates) const {
   m_ExtendedOctree.GetBrickData(pData, coordinates);
 }
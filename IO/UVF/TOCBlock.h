@@ -5,6 +5,7 @@
 
 #include "DataBlock.h"
 #include "ExtendedOctree/ExtendedOctree.h"
+#include "ExtendedOctree/ExtendedOctreeConverter.h"
 
 class AbstrDebugOut;
 class MaxMinDataBlock;
@@ -61,6 +62,35 @@ public:
                             uint32_t iCompressionLevel=4,
                             LAYOUT_TYPE lt=LT_SCANLINE);
 
+  /// Fills this block with the volume of 'source', bricked anew with the
+  /// given brick size and overlap.  The LoDs of 'source' are reused as they
+  /// are, the volume is never flattened.
+  bool BrickedLODToBrickedLOD(const TOCBlock& source,
+                              const std::string& strTempFile,
+                              const UINT64VECTOR3& vMaxBrickSize,
+                              uint32_t iOverlap,
+                              bool bClampToEdge,
+                              size_t iCacheSize,
+                              std::shared_ptr<MaxMinDataBlock>
+                                pMaxMinDatBlock,
+                              AbstrDebugOut* pDebugOut,
+                              COMPRESSION_TYPE ct=CT_ZLIB,
+                              uint32_t iCompressionLevel=4,
+                              LAYOUT_TYPE lt=LT_SCANLINE);
+
+  /// Zeroes the voxels on the clipped side of 'plane' (in normalized volume
+  /// coordinates) without rewriting the bricks the plane does not touch, see
+  /// ExtendedOctreeConverter::CropInPlace.  The ranges of the changed bricks
+  /// are updated in 'pMaxMinDatBlock', if given.
+  bool CropInPlace(const PLANE<float>& plane, const std::string& strTempFile,
+                   MaxMinDataBlock* pMaxMinDatBlock);
+  /// CropInPlace in two steps, so that several blocks can be staged before
+  /// any of them is changed; see ExtendedOctreeConverter::PrepareCrop.
+  bool PrepareCrop(const PLANE<float>& plane, const std::string& strTempFile,
+                   ExtendedOctreeConverter::CropPlan& plan);
+  bool CommitCrop(ExtendedOctreeConverter::CropPlan& plan,
+                  MaxMinDataBlock* pMaxMinDatBlock);
+
   bool BrickedLODToFlatData(uint64_t iLoD,
                             const std::string& strTargetFile,
                             bool bAppend = false, AbstrDebugOut* pDebugOut=NULL) const;
@@ -79,6 +109,14 @@ public:
                      uint32_t iOverlap=0,
                      AbstrDebugOut* pDebugOut=NULL) const;
 
+  /// Like ApplyFunction, but 'brickFunc' is called concurrently from up to
+  /// 'iThreads' threads, see ExtendedOctreeConverter::ParallelBrickFunc.
+  bool ParallelApplyFunction(uint64_t iLoD,
+                             const ExtendedOctreeConverter::ParallelBrickFunc&
+                               brickFunc,
+                             size_t iThreads,
+                             uint32_t iOverlap=0) const;
+
   void GetData(uint8_t* pData, UINT64VECTOR4 coordinates) const;
 
   uint64_t GetLoDCount() const;
@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include "DebugOut/AsyncDebugOut.h"
+
+using tuvok::TaskScheduler;
+
+namespace {
+  // remembers what it was asked to print; optionally slow.
+  class RecordingOut : public AbstrDebugOut {
+  public:
+    RecordingOut(std::vector<std::string>& lines, unsigned delay_ms=0)
+      : m_Lines(lines), m_iDelay(delay_ms) {
+      SetOutput(true, true, true, true);
+    }
+    virtual void printf(enum DebugChannel, const char* source,
+                        const char* msg) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(m_iDelay));
+      m_Lines.push_back(std::string(source) + ": " + msg);
+    }
+    virtual void printf(const char* s) const { m_Lines.push_back(s); }
+  private:
+    std::vector<std::string>& m_Lines;
+    unsigned m_iDelay;
+  };
+
+  // every thread's messages arrive, in the order each thread logged them.
+  void order() {
+    std::vector<std::string> lines;
+    {
+      // room for everything: nothing is dropped.
+      TaskScheduler scheduler(2);
+      AsyncDebugOut out(new RecordingOut(lines), scheduler, 4096);
+      std::vector<std::thread> threads;
+      for(int t=0; t < 4; ++t) {
+        threads.push_back(std::thread([&out, t]() {
+          for(int i=0; i < 1000; ++i) {
+            char msg[32];
+            snprintf(msg, sizeof(msg), "%d %04d", t, i);
+            out.printf(AbstrDebugOut::CHANNEL_MESSAGE, "t", msg);
+          }
+        }));
+      }
+      for(size_t t=0; t < threads.size(); ++t) { threads[t].join(); }
+      out.Flush();
+      TS_ASSERT_EQUALS(lines.size(), 4000U);
+      TS_ASSERT_EQUALS(out.Dropped(AbstrDebugOut::CHANNEL_MESSAGE), 0U);
+    }
+    std::vector<int> next(4, 0);
+    for(size_t i=0; i < lines.size(); ++i) {
+      int t = -1, n = -1;
+      TS_ASSERT_EQUALS(sscanf(lines[i].c_str(), "t: %d %d", &t, &n), 2);
+      TS_ASSERT(t >= 0 && t < 4);
+      if(t < 0 || t >= 4) { continue; }
+      TS_ASSERT_EQUALS(n, next[t]);
+      ++next[t];
+    }
+  }
+
+  // a slow output makes us drop messages, and say so.
+  void drops() {
+    std::vector<std::string> lines;
+    uint64_t iDropped = 0;
+    TaskScheduler scheduler(2);
+    {
+      AsyncDebugOut out(new RecordingOut(lines, 5), scheduler, 4);
+      for(int i=0; i < 100; ++i) {
+        out.printf(AbstrDebugOut::CHANNEL_WARNING, "t", "burst");
+      }
+      iDropped = out.Dropped(AbstrDebugOut::CHANNEL_WARNING);
+    }
+    TS_ASSERT(iDropped > 0U);
+    bool bReported = false;
+    for(size_t i=0; i < lines.size(); ++i) {
+      bReported |= lines[i].find("dropped") != std::string::npos;
+    }
+    TS_ASSERT(bReported);
+  }
+
+  // nothing runs while there is nothing to write.
+  void idle() {
+    std::vector<std::string> lines;
+    TaskScheduler scheduler(2);
+    AsyncDebugOut out(new RecordingOut(lines), scheduler, 16);
+    out.printf(AbstrDebugOut::CHANNEL_ERROR, "t", "before");
+    out.Flush();
+    const std::clock_t c0 = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const double fCPU = double(std::clock() - c0) / CLOCKS_PER_SEC;
+    TS_ASSERT(fCPU < 0.1);
+    out.printf(AbstrDebugOut::CHANNEL_ERROR, "t", "after");
+    out.Flush();
+    TS_ASSERT_EQUALS(lines.size(), 2U);
+    TS_ASSERT_EQUALS(lines.back(), "t: after");
+  }
+}
+
+class AsyncDebugOutTests : public CxxTest::TestSuite {
+public:
+  void test_order() { order(); }
+  void test_drops() { drops(); }
+  void test_idle() { idle(); }
+};
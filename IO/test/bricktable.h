@@ -0,0 +1,118 @@
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include "BrickTable.h"
+
+using namespace tuvok;
+
+namespace {
+  BrickTable::value_type brick(size_t ts, size_t lod, size_t idx, float c) {
+    BrickMD md;
+    md.center = FLOATVECTOR3(c, c, c);
+    md.extents = FLOATVECTOR3(1, 1, 1);
+    md.n_voxels = UINTVECTOR3(8, 8, 8);
+    return std::make_pair(BrickKey(ts, lod, idx), md);
+  }
+
+  // a 10x6x1 domain in bricks of 4x4x1 voxels: 3x2x1 bricks.
+  BrickTable::Grid grid(size_t ts, size_t lod) {
+    BrickTable::Grid g;
+    g.iTimestep = ts;
+    g.iLOD = lod;
+    g.vDomainSize = UINT64VECTOR3(10, 6, 1);
+    g.vBrickCount = UINT64VECTOR3(3, 2, 1);
+    g.vCore = UINTVECTOR3(4, 4, 1);
+    g.iOverlap = 1;
+    g.vVoxelSize = FLOATVECTOR3(1, 1, 1);
+    g.vOrigin = FLOATVECTOR3(-5, -3, -0.5f);
+    return g;
+  }
+
+  void mk_table(BrickTable& table) {
+    table.insert(brick(0, 1, 0, 1));
+    table.insert(grid(0, 0));
+    table.insert(brick(1, 0, 0, 2));
+    table.insert(grid(1, 1));
+    // known keys are not added again, neither one by one nor in a grid.
+    table.insert(brick(0, 1, 0, 3));
+    table.insert(brick(0, 0, 2, 3));
+    table.insert(grid(0, 0));
+  }
+
+  // bricks added one by one come first, then the grids in brick order.
+  void order() {
+    BrickTable table;
+    mk_table(table);
+    TS_ASSERT_EQUALS(table.size(), BrickTable::size_type(14));
+    TS_ASSERT_EQUALS(table.count(0, 0), BrickTable::size_type(6));
+    TS_ASSERT_EQUALS(table.count(0, 1), BrickTable::size_type(1));
+    TS_ASSERT_EQUALS(table.count(1, 0), BrickTable::size_type(1));
+    TS_ASSERT_EQUALS(table.count(1, 1), BrickTable::size_type(6));
+    TS_ASSERT_EQUALS(table.count(2, 0), BrickTable::size_type(0));
+
+    std::vector<BrickKey> expected;
+    expected.push_back(BrickKey(0, 1, 0));
+    expected.push_back(BrickKey(1, 0, 0));
+    for(size_t i=0; i < 6; ++i) { expected.push_back(BrickKey(0, 0, i)); }
+    for(size_t i=0; i < 6; ++i) { expected.push_back(BrickKey(1, 1, i)); }
+    std::vector<BrickKey> keys;
+    for(BrickTable::const_iterator b = table.begin(); b != table.end(); ++b) {
+      keys.push_back(b->first);
+    }
+    TS_ASSERT(keys == expected);
+    TS_ASSERT_EQUALS(table.begin()->second.center[0], 1.0f);
+  }
+
+  // explicit bricks are found in the index, grid bricks are computed.
+  void find() {
+    BrickTable table;
+    mk_table(table);
+    BrickTable::const_iterator b = table.find(BrickKey(0, 1, 0));
+    TS_ASSERT(b != table.end());
+    TS_ASSERT_EQUALS(b->second.center[0], 1.0f);
+
+    // x brick 1 and y brick 1: voxels 4..7 and 4..5 of the domain.
+    b = table.find(BrickKey(0, 0, 4));
+    TS_ASSERT(b != table.end());
+    TS_ASSERT(b->first == BrickKey(0, 0, 4));
+    TS_ASSERT(b->second.n_voxels == UINTVECTOR3(6, 4, 3));
+    TS_ASSERT(b->second.extents == FLOATVECTOR3(4, 2, 1));
+    TS_ASSERT(b->second.center == FLOATVECTOR3(1, 2, 0));
+
+    // iteration goes on from a found brick into the next grid.
+    std::vector<BrickKey> rest;
+    for(; b != table.end(); ++b) { rest.push_back(b->first); }
+    TS_ASSERT_EQUALS(rest.size(), 8U);
+    TS_ASSERT(rest.front() == BrickKey(0, 0, 4));
+    TS_ASSERT(rest[2] == BrickKey(1, 1, 0));
+    TS_ASSERT(rest.back() == BrickKey(1, 1, 5));
+
+    TS_ASSERT(table.find(BrickKey(0, 0, 6)) == table.end());
+    TS_ASSERT(table.find(BrickKey(1, 0, 1)) == table.end());
+    TS_ASSERT(table.find(BrickKey(2, 0, 0)) == table.end());
+
+    table.clear();
+    TS_ASSERT(table.empty());
+    TS_ASSERT(table.begin() == table.end());
+    TS_ASSERT(table.find(BrickKey(0, 0, 4)) == table.end());
+  }
+
+  // every copy of an iterator holds its own brick.
+  void copies() {
+    BrickTable table;
+    mk_table(table);
+    BrickTable::const_iterator a = table.find(BrickKey(0, 0, 0));
+    BrickTable::const_iterator b = a++;
+    TS_ASSERT(b->first == BrickKey(0, 0, 0));
+    TS_ASSERT(a->first == BrickKey(0, 0, 1));
+    TS_ASSERT(b->second.n_voxels == UINTVECTOR3(6, 6, 3));
+    TS_ASSERT(a->second.n_voxels == UINTVECTOR3(6, 6, 3));
+    TS_ASSERT(a->second.center[0] != b->second.center[0]);
+  }
+}
+
+class BrickTableTests : public CxxTest::TestSuite {
+public:
+  void test_order() { order(); }
+  void test_find() { find(); }
+  void test_copies() { copies(); }
+};
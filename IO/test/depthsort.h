@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include "Renderer/RenderMesh.h"
+
+using namespace tuvok;
+
+namespace {
+  // sorting does not need any of the GL parts.
+  class SortMesh : public RenderMesh {
+  public:
+    SortMesh(const Mesh& m) : RenderMesh(m) {}
+    virtual void InitRenderer() {}
+    virtual void RenderOpaqueGeometry() {}
+    virtual void RenderTransGeometryFront() {}
+    virtual void RenderTransGeometryBehind() {}
+    virtual void RenderTransGeometryInside() {}
+  };
+
+  // 'n' small, transparent triangles scattered over [-1,1]^3
+  Mesh random_mesh(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> offset(-0.01f, 0.01f);
+    VertVec vertices;
+    IndexVec indices;
+    for(size_t t=0; t < n; ++t) {
+      const FLOATVECTOR3 c(pos(rng), pos(rng), pos(rng));
+      for(size_t v=0; v < 3; ++v) {
+        indices.push_back(uint32_t(vertices.size()));
+        vertices.push_back(c + FLOATVECTOR3(offset(rng), offset(rng),
+                                            offset(rng)));
+      }
+    }
+    return Mesh(vertices, NormVec(), TexCoordVec(), ColorVec(), indices,
+                IndexVec(), IndexVec(), IndexVec(), false, false, "random",
+                Mesh::MT_TRIANGLES, FLOATVECTOR4(1,1,1,0.5f));
+  }
+
+  bool is_sorted(const SortIndexPVec& list, bool bOver) {
+    for(size_t i=1; i < list.size(); ++i) {
+      if(bOver ? DistanceSortOver(list[i], list[i-1])
+               : DistanceSortUnder(list[i], list[i-1])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool same_elements(SortIndexPVec a, SortIndexPVec b) {
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    return a == b;
+  }
+
+  // random lists of all sizes, with duplicates and negative depths.
+  void sort_random() {
+    SortMesh mesh(random_mesh(1, 1));
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> depth(-100.0f, 100.0f);
+    const size_t sizes[] = { 0, 1, 2, 17, 255, 256, 1000, 100000 };
+    for(size_t s=0; s < sizeof(sizes)/sizeof(sizes[0]); ++s) {
+      SortIndexVec polys(sizes[s], SortIndex(0, &mesh));
+      SortIndexPVec list;
+      for(size_t i=0; i < polys.size(); ++i) {
+        polys[i].fDepth = (i % 5 == 0) ? 1.0f : depth(rng);
+        list.push_back(&polys[i]);
+      }
+      for(int over=0; over < 2; ++over) {
+        SortIndexPVec sorted(list);
+        SortByDepth(sorted, over != 0);
+        TS_ASSERT(is_sorted(sorted, over != 0));
+        TS_ASSERT(same_elements(sorted, list));
+      }
+    }
+  }
+
+  // a sorted list with a few elements out of place.
+  void sort_nearly_sorted() {
+    SortMesh mesh(random_mesh(1, 1));
+    const size_t N = 50000;
+    SortIndexVec polys(N, SortIndex(0, &mesh));
+    SortIndexPVec list;
+    for(size_t i=0; i < N; ++i) {
+      polys[i].fDepth = float(i) * 0.5f;
+      list.push_back(&polys[i]);
+    }
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<size_t> idx(0, N-1);
+    for(size_t i=0; i < 100; ++i) {
+      const size_t j = idx(rng);
+      std::swap(list[j], list[std::min(N-1, j+3)]);
+    }
+    SortIndexPVec sorted(list);
+    SortByDepth(sorted, false);
+    TS_ASSERT(is_sorted(sorted, false));
+    TS_ASSERT(same_elements(sorted, list));
+  }
+
+  // the lists of a mesh stay sorted while the viewer moves around.
+  void mesh_lists() {
+    SortMesh mesh(random_mesh(20000, 3));
+    mesh.SetVolumeAABB(FLOATVECTOR3(-0.25f,-0.25f,-0.25f),
+                       FLOATVECTOR3( 0.25f, 0.25f, 0.25f));
+    const FLOATVECTOR3 path[] = {
+      FLOATVECTOR3(0.1f, 0.2f, 2.0f), FLOATVECTOR3(0.11f, 0.2f, 2.0f),
+      FLOATVECTOR3(0.12f, 0.21f, 1.99f), FLOATVECTOR3(2.0f, 0.2f, 0.1f),
+      FLOATVECTOR3(0.0f, 0.0f, 0.0f), FLOATVECTOR3(-3.0f, -3.0f, -3.0f)
+    };
+    for(size_t p=0; p < sizeof(path)/sizeof(path[0]); ++p) {
+      mesh.SetUserPos(path[p]);
+      mesh.EnableOverSorting(p % 2 == 0);
+      const SortIndexPVec& front = mesh.GetFrontPointList(true);
+      const SortIndexPVec& in = mesh.GetInPointList(true);
+      const SortIndexPVec& behind = mesh.GetBehindPointList(true);
+      TS_ASSERT(is_sorted(front, p % 2 == 0));
+      TS_ASSERT(is_sorted(in, p % 2 == 0));
+      TS_ASSERT(is_sorted(behind, p % 2 == 0));
+      TS_ASSERT_EQUALS(front.size() + in.size() + behind.size(), 20000U);
+      for(size_t i=0; i < in.size(); ++i) {
+        TS_ASSERT_DELTA(in[i]->fDepth,
+                        (path[p] - in[i]->m_centroid).length(), 1e-4f);
+      }
+    }
+  }
+
+  // not a test as such: reports how long sorting takes while the viewer
+  // moves in small steps, compared to std::sort.
+  void sort_timing() {
+    SortMesh mesh(random_mesh(300000, 5));
+    mesh.SetVolumeAABB(FLOATVECTOR3(-2,-2,-2), FLOATVECTOR3(2,2,2));
+    typedef std::chrono::high_resolution_clock clock;
+    double fEngine = 0, fStd = 0;
+    for(size_t frame=0; frame < 20; ++frame) {
+      const float a = float(frame) * 0.005f;
+      mesh.SetUserPos(FLOATVECTOR3(std::sin(a), 0.1f, std::cos(a)) * 0.5f);
+
+      SortIndexPVec copy(mesh.GetInPointList(false));
+      clock::time_point t0 = clock::now();
+      std::sort(copy.begin(), copy.end(), DistanceSortUnder);
+      clock::time_point t1 = clock::now();
+      mesh.GetInPointList(true);
+      clock::time_point t2 = clock::now();
+
+      fStd += std::chrono::duration<double, std::milli>(t1-t0).count();
+      fEngine += std::chrono::duration<double, std::milli>(t2-t1).count();
+      TS_ASSERT(is_sorted(mesh.GetInPointList(true), false));
+    }
+    std::ostringstream trace;
+    trace << "sorting 300k triangles for 20 frames: " << fEngine
+          << "ms, std::sort: " << fStd << "ms";
+    TS_TRACE(trace.str());
+  }
+}
+
+class DepthSortTests : public CxxTest::TestSuite {
+public:
+  void test_random() { sort_random(); }
+  void test_nearly_sorted() { sort_nearly_sorted(); }
+  void test_mesh_lists() { mesh_lists(); }
+  void test_timing() { sort_timing(); }
+};
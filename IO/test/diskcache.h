@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <fstream>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include "DiskBrickCache.h"
+
+using namespace tuvok;
+
+namespace {
+  const char* source() { return "diskcache-source.raw"; }
+
+  void mk_source(const char* contents) {
+    std::ofstream ofs(source(), std::ios::trunc | std::ios::binary);
+    ofs << contents;
+  }
+
+  std::vector<uint8_t> brick(uint8_t value, size_t n=1000) {
+    return std::vector<uint8_t>(n, value);
+  }
+
+  bool has(DiskBrickCache& cache, size_t i, uint8_t value, size_t n=1000) {
+    std::vector<uint8_t> data(n, 0);
+    return cache.Lookup(BrickKey(0, 0, i), &data[0], n) &&
+           data == brick(value, n);
+  }
+
+  // four slots of one page each.
+  DiskBrickCache* mk_cache() {
+    return new DiskBrickCache(".", source(), "test", 4*4096, 1000);
+  }
+
+  void round_trip() {
+    mk_source("round trip");
+    std::unique_ptr<DiskBrickCache> cache(mk_cache());
+    TS_ASSERT(cache->IsOpen());
+    TS_ASSERT(!has(*cache, 0, 1));
+    TS_ASSERT(cache->Store(BrickKey(0, 0, 0), &brick(1)[0], 1000));
+    TS_ASSERT(cache->Store(BrickKey(0, 0, 1), &brick(2, 500)[0], 500));
+    TS_ASSERT(has(*cache, 0, 1));
+    TS_ASSERT(has(*cache, 1, 2, 500));
+    // the size must match, too.
+    TS_ASSERT(!has(*cache, 1, 2, 1000));
+    TS_ASSERT_EQUALS(cache->GetBrickCount(), 2U);
+    TS_ASSERT_EQUALS(cache->GetSize(), 1500U);
+    // bricks larger than a slot are not stored.
+    TS_ASSERT(!cache->Store(BrickKey(0, 0, 2), &brick(3, 5000)[0], 5000));
+    cache.reset();
+    remove(source());
+  }
+
+  // the least recently used brick goes first.
+  void eviction() {
+    mk_source("eviction");
+    std::unique_ptr<DiskBrickCache> cache(mk_cache());
+    for(size_t i=0; i < 4; ++i) {
+      TS_ASSERT(cache->Store(BrickKey(0, 0, i), &brick(uint8_t(i))[0], 1000));
+    }
+    TS_ASSERT(has(*cache, 0, 0));
+    TS_ASSERT(cache->Store(BrickKey(0, 0, 4), &brick(4)[0], 1000));
+    TS_ASSERT_EQUALS(cache->GetBrickCount(), 4U);
+    TS_ASSERT(has(*cache, 0, 0));
+    TS_ASSERT(!has(*cache, 1, 1));
+    TS_ASSERT(has(*cache, 2, 2));
+    TS_ASSERT(has(*cache, 4, 4));
+    cache.reset();
+    remove(source());
+  }
+
+  // the next session finds the bricks, unless the source changed.
+  void reopen() {
+    mk_source("reopen");
+    std::unique_ptr<DiskBrickCache> cache(mk_cache());
+    TS_ASSERT(cache->Store(BrickKey(0, 0, 7), &brick(7)[0], 1000));
+    TS_ASSERT(cache->Store(BrickKey(0, 0, 8), &brick(8)[0], 1000));
+    cache.reset();
+    cache.reset(mk_cache());
+    TS_ASSERT_EQUALS(cache->GetBrickCount(), 2U);
+    TS_ASSERT(has(*cache, 7, 7));
+    TS_ASSERT(has(*cache, 8, 8));
+    cache.reset();
+
+    mk_source("reopen, but changed");
+    cache.reset(mk_cache());
+    TS_ASSERT(cache->IsOpen());
+    TS_ASSERT_EQUALS(cache->GetBrickCount(), 0U);
+    TS_ASSERT(!has(*cache, 7, 7));
+    cache.reset();
+    remove(source());
+  }
+
+  // a second user of the same cache stays away from its files.
+  void exclusive() {
+    mk_source("exclusive");
+    std::unique_ptr<DiskBrickCache> cache(mk_cache());
+    TS_ASSERT(cache->Store(BrickKey(0, 0, 0), &brick(1)[0], 1000));
+    {
+      std::unique_ptr<DiskBrickCache> other(mk_cache());
+      TS_ASSERT(!other->IsOpen());
+      TS_ASSERT(!other->Store(BrickKey(0, 0, 1), &brick(2)[0], 1000));
+    }
+    TS_ASSERT(has(*cache, 0, 1));
+    TS_ASSERT(cache->Store(BrickKey(0, 0, 1), &brick(2)[0], 1000));
+    cache.reset();
+    cache.reset(mk_cache());
+    TS_ASSERT(cache->IsOpen());
+    TS_ASSERT_EQUALS(cache->GetBrickCount(), 2U);
+    cache.reset();
+    remove(source());
+  }
+}
+
+class DiskCacheTests : public CxxTest::TestSuite {
+public:
+  void test_round_trip() { round_trip(); }
+  void test_eviction() { eviction(); }
+  void test_reopen() { reopen(); }
+  void test_exclusive() { exclusive(); }
+};
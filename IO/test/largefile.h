@@ -1,5 +1,7 @@
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 #include <functional>
 #include <vector>
@@ -10,6 +12,10 @@
 #include "LargeFileC.h"
 #include "LargeFileFD.h"
 #include "LargeFileMMap.h"
+#include "LargeFileURing.h"
+#include "ParallelDecompression.h"
+#include "3rdParty/bzip2/bzlib.h"
+#include "3rdParty/zlib/zlib.h"
 
 #include "util-test.h"
 
@@ -502,6 +508,143 @@ namespace {
       TS_ASSERT_EQUALS(data[0], VALUE[0]);
     }
   }
+
+  // reads unaligned ranges through io_uring, both directly and through the
+  // page cache; many are enqueue'd first, so they are submitted in batches.
+  void lf_uring_direct(bool direct) {
+    std::ofstream ofs;
+    const std::string tmpf = mk_tmpfile(ofs, std::ios::out | std::ios::binary);
+    clean f = cleanup(tmpf);
+    const size_t N = 256*1024;
+    for(uint64_t i=0; i < N; ++i) {
+      ofs.write(reinterpret_cast<const char*>(&i), sizeof(uint64_t));
+    }
+    ofs.close();
+
+    const uint64_t header = 3*sizeof(uint64_t);
+    LargeFileURing lf(tmpf, std::ios::in, header, 0, direct);
+    TS_ASSERT(lf.is_open());
+    if(!lf.uring()) {
+      MESSAGE("io_uring unavailable; testing the fallback only.");
+    }
+    // sizes from a few elements up to more than a registered buffer holds.
+    const size_t counts[] = { 1, 7, 512, 4096, 100000 };
+    std::vector<std::pair<uint64_t, size_t>> ranges;
+    for(size_t i=0; i < 40; ++i) {
+      const size_t n = counts[i % 5];
+      ranges.push_back(std::make_pair((i*7919) % (N-header/8-n), n));
+    }
+    for(size_t i=0; i < ranges.size(); ++i) {
+      lf.enqueue(ranges[i].first*sizeof(uint64_t),
+                 ranges[i].second*sizeof(uint64_t));
+    }
+    for(size_t i=ranges.size(); i-- > 0; ) {
+      const uint64_t offset = ranges[i].first*sizeof(uint64_t);
+      const size_t len = ranges[i].second*sizeof(uint64_t);
+      std::shared_ptr<const void> mem = lf.rd(offset, len);
+      TS_ASSERT_EQUALS(lf.gcount(), len);
+      const uint64_t* data = static_cast<const uint64_t*>(mem.get());
+      for(size_t j=0; j < ranges[i].second; ++j) {
+        if(data[j] != ranges[i].first + j + header/8) {
+          TS_FAIL("read wrong data");
+          break;
+        }
+      }
+    }
+    // reading past EOF gives what is there.
+    std::shared_ptr<const void> tail = lf.rd((N-header/8-2)*sizeof(uint64_t),
+                                             4*sizeof(uint64_t));
+    TS_ASSERT_EQUALS(lf.gcount(), 2*sizeof(uint64_t));
+    TS_ASSERT_EQUALS(static_cast<const uint64_t*>(tail.get())[1], N-1);
+  }
+}
+
+namespace {
+  // 'len' bytes; random ones if 'noise', otherwise a short repeating text.
+  std::vector<char> mk_payload(size_t len, bool noise) {
+    std::vector<char> data(len);
+    uint32_t x = 2463534242u;
+    for(size_t i=0; i < len; ++i) {
+      if(noise) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        data[i] = char(x >> 24);
+      } else {
+        data[i] = "tuvok volume rendering "[i % 23];
+      }
+    }
+    return data;
+  }
+
+  void append_gzip_member(std::vector<char>& file,
+                          const std::vector<char>& data) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(z_stream));
+    TS_ASSERT_EQUALS(deflateInit2(&strm, 6, Z_DEFLATED, 16+MAX_WBITS, 8,
+                                  Z_DEFAULT_STRATEGY), Z_OK);
+    std::vector<char> member(deflateBound(&strm, uLong(data.size())) + 32);
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(&data[0]));
+    strm.avail_in = uInt(data.size());
+    strm.next_out = reinterpret_cast<Bytef*>(&member[0]);
+    strm.avail_out = uInt(member.size());
+    TS_ASSERT_EQUALS(deflate(&strm, Z_FINISH), Z_STREAM_END);
+    file.insert(file.end(), member.begin(), member.begin() + strm.total_out);
+    deflateEnd(&strm);
+  }
+
+  // runs 'decompress' on 'compressed' and compares the result to 'expected'.
+  void check_decompress(bool (*decompress)(FILE*, FILE*, size_t),
+                        const std::vector<char>& compressed,
+                        const std::vector<char>& expected,
+                        size_t iInCoreSize) {
+    FILE* in = std::tmpfile();
+    FILE* out = std::tmpfile();
+    TS_ASSERT(in != NULL && out != NULL);
+    if(in == NULL || out == NULL) { return; }
+    fwrite(&compressed[0], 1, compressed.size(), in);
+    rewind(in);
+    TS_ASSERT(decompress(in, out, iInCoreSize));
+    std::vector<char> back(expected.size() + 1);
+    rewind(out);
+    TS_ASSERT_EQUALS(fread(&back[0], 1, back.size(), out), expected.size());
+    back.resize(expected.size());
+    TS_ASSERT(back == expected);
+    fclose(in);
+    fclose(out);
+  }
+
+  // many small bzip2 blocks, decoded a few at a time or all at once.
+  void decompress_bzip2() {
+    std::vector<char> data = mk_payload(1024*1024, true);
+    const std::vector<char> text = mk_payload(2*1024*1024, false);
+    data.insert(data.end(), text.begin(), text.end());
+    std::vector<char> compressed(data.size() + data.size()/50 + 600);
+    unsigned int len = static_cast<unsigned int>(compressed.size());
+    TS_ASSERT_EQUALS(BZ2_bzBuffToBuffCompress(&compressed[0], &len, &data[0],
+                       static_cast<unsigned int>(data.size()), 1, 0, 0),
+                     BZ_OK);
+    compressed.resize(len);
+    check_decompress(tuvok::ParallelBZip2Decompress, compressed, data, 1);
+    check_decompress(tuvok::ParallelBZip2Decompress, compressed, data,
+                     size_t(1) << 30);
+  }
+
+  // members which span windows, and one which decodes to more than its
+  // share of memory, between small ones.
+  void decompress_gzip() {
+    std::vector<char> compressed, data;
+    const std::vector<char> payloads[] = {
+      mk_payload(1000, false), mk_payload(3*1024*1024, true),
+      mk_payload(5000, true), mk_payload(8*1024*1024, false),
+      mk_payload(3*1024*1024, true), mk_payload(10, false)
+    };
+    for(size_t i=0; i < sizeof(payloads)/sizeof(payloads[0]); ++i) {
+      append_gzip_member(compressed, payloads[i]);
+      data.insert(data.end(), payloads[i].begin(), payloads[i].end());
+    }
+    check_decompress(tuvok::ParallelGZipDecompress, compressed, data, 1);
+    check_decompress(tuvok::ParallelGZipDecompress, compressed, data,
+                     size_t(1) << 30);
+  }
 }
 
 class LargeFileTests : public CxxTest::TestSuite {
@@ -560,4 +703,21 @@ public:
   void test_c_truncate() { lf_generic_truncate<LargeFileC>(); }
   void test_c_wroffset() { lf_generic_wroffset<LargeFileC>(); }
   void test_c_rdoffset() { lf_generic_rdoffset<LargeFileC>(); }
+
+  void test_uring_open() { lf_generic_open<LargeFileURing>(); }
+  void test_uring_read() { lf_generic_read<LargeFileURing>(); }
+  void test_uring_write() { lf_generic_write<LargeFileURing>(); }
+  void test_uring_write_only() { lf_generic_write_only<LargeFileURing>(); }
+  void test_uring_header() { lf_generic_header<LargeFileURing>(); }
+  void test_uring_large_header() { lf_generic_large_header<LargeFileURing>(); }
+  void test_uring_enqueue() { lf_generic_enqueue<LargeFileURing>(); }
+  void test_uring_reopen() { lf_generic_reopen<LargeFileURing>(); }
+  void test_uring_rw_single() { lf_generic_rw_single<LargeFileURing>(); }
+  void test_uring_truncate() { lf_generic_truncate<LargeFileURing>(); }
+  void test_uring_wroffset() { lf_generic_wroffset<LargeFileURing>(); }
+  void test_uring_rdoffset() { lf_generic_rdoffset<LargeFileURing>(); }
+  void test_uring_buffered() { lf_uring_direct(false); }
+  void test_uring_direct() { lf_uring_direct(true); }
+  void test_decompress_bzip2() { decompress_bzip2(); }
+  void test_decompress_gzip() { decompress_gzip(); }
 };
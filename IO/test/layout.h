@@ -0,0 +1,165 @@
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include "UVF/ExtendedOctree/VolumeTools.h"
+#include "UVF/ExtendedOctree/Hilbert.h"
+
+using namespace VolumeTools;
+
+namespace {
+  // the bit-by-bit interleave the Morton layout used to do.
+  uint64_t morton_bits(UINT64VECTOR3 const& v) {
+    uint64_t iIndex = 0;
+    for(uint64_t i=0; i < 21; ++i) {
+      uint64_t const bit = uint64_t(1) << i;
+      iIndex |= (v.x & bit) << (i*2 + 0);
+      iIndex |= (v.y & bit) << (i*2 + 1);
+      iIndex |= (v.z & bit) << (i*2 + 2);
+    }
+    return iIndex;
+  }
+
+  UINT64VECTOR3 random_position(uint64_t iMax) {
+    return UINT64VECTOR3(uint64_t(rand()) % iMax, uint64_t(rand()) % iMax,
+                         uint64_t(rand()) % iMax);
+  }
+
+  void morton() {
+    const uint64_t n = uint64_t(1) << 21;
+    MortonLayout layout(UINT64VECTOR3(n, n, n));
+    srand(42);
+    for(size_t i=0; i < 100000; ++i) {
+      const UINT64VECTOR3 v = random_position(n);
+      const uint64_t iIndex = layout.GetLinearIndex(v);
+      TS_ASSERT_EQUALS(iIndex, morton_bits(v));
+      TS_ASSERT_EQUALS(layout.GetSpatialPosition(iIndex), v);
+    }
+    const UINT64VECTOR3 vMax(n-1, n-1, n-1);
+    TS_ASSERT_EQUALS(layout.GetLinearIndex(vMax), (uint64_t(1) << 63) - 1);
+    TS_ASSERT_EQUALS(layout.GetSpatialPosition((uint64_t(1) << 63) - 1),
+                     vMax);
+  }
+
+  // the state tables walk the same curve as the reference implementation.
+  void hilbert() {
+    srand(42);
+    for(size_t iBits=0; iBits <= 21; ++iBits) {
+      const uint64_t n = uint64_t(1) << iBits;
+      HilbertLayout layout(UINT64VECTOR3(n, n, n));
+      const size_t iTests = iBits <= 4 ? size_t(n*n*n) : 20000;
+      for(size_t i=0; i < iTests; ++i) {
+        const uint64_t iIndex = iBits <= 4 ? uint64_t(i) :
+          morton_bits(random_position(n));
+        std::array<uint64_t, 3> p = {{0, 0, 0}};
+        Hilbert::Decode(iBits, iIndex, p);
+        const UINT64VECTOR3 v(p[0], p[1], p[2]);
+        TS_ASSERT_EQUALS(layout.GetSpatialPosition(iIndex), v);
+        TS_ASSERT_EQUALS(layout.GetLinearIndex(v), iIndex);
+        TS_ASSERT_EQUALS(Hilbert::Encode(iBits, p), iIndex);
+      }
+    }
+  }
+
+  // batches give what the single conversions give.
+  void batches() {
+    const UINT64VECTOR3 vDomain(8, 4, 6);
+    std::vector<std::shared_ptr<Layout>> layouts;
+    layouts.push_back(std::make_shared<ScanlineLayout>(vDomain));
+    layouts.push_back(std::make_shared<MortonLayout>(vDomain));
+    layouts.push_back(std::make_shared<HilbertLayout>(vDomain));
+    layouts.push_back(std::make_shared<RandomLayout>(vDomain));
+    for(size_t l=0; l < layouts.size(); ++l) {
+      std::vector<UINT64VECTOR3> positions(150);
+      layouts[l]->GetSpatialPositions(37, positions.size(), &positions[0]);
+      for(size_t i=0; i < positions.size(); ++i) {
+        TS_ASSERT_EQUALS(positions[i], layouts[l]->GetSpatialPosition(37+i));
+      }
+
+      std::vector<UINT64VECTOR3> inside;
+      for(uint64_t z=0; z < vDomain.z; ++z)
+        for(uint64_t y=0; y < vDomain.y; ++y)
+          for(uint64_t x=0; x < vDomain.x; ++x)
+            inside.push_back(UINT64VECTOR3(x, y, z));
+      std::vector<uint64_t> indices(inside.size());
+      layouts[l]->GetLinearIndices(&inside[0], inside.size(), &indices[0]);
+      for(size_t i=0; i < inside.size(); ++i) {
+        TS_ASSERT_EQUALS(indices[i], layouts[l]->GetLinearIndex(inside[i]));
+      }
+    }
+  }
+
+  void out_of_domain() {
+    const UINT64VECTOR3 vDomain(4, 4, 4);
+    MortonLayout morton(vDomain);
+    HilbertLayout hilbert(vDomain);
+    const UINT64VECTOR3 vInside(3, 3, 3);
+    const UINT64VECTOR3 vOutside(1, 4, 1);
+    TS_ASSERT_THROWS_NOTHING(morton.GetLinearIndex(vInside));
+    TS_ASSERT_THROWS_NOTHING(hilbert.GetLinearIndex(vInside));
+    TS_ASSERT_THROWS(morton.GetLinearIndex(vOutside), std::runtime_error);
+    TS_ASSERT_THROWS(hilbert.GetLinearIndex(vOutside), std::runtime_error);
+    uint64_t iIndex;
+    TS_ASSERT_THROWS(hilbert.GetLinearIndices(&vOutside, 1, &iIndex),
+                     std::runtime_error);
+  }
+
+  void timing() {
+    typedef std::chrono::high_resolution_clock clock;
+    const size_t iBits = 10;
+    const uint64_t n = uint64_t(1) << iBits;
+    const size_t iCount = 1 << 22;
+    MortonLayout morton(UINT64VECTOR3(n, n, n));
+    HilbertLayout hilbert(UINT64VECTOR3(n, n, n));
+    std::vector<UINT64VECTOR3> positions(iCount);
+    uint64_t iSum = 0;
+
+    clock::time_point t0 = clock::now();
+    for(size_t i=0; i < iCount; ++i) {
+      std::array<uint64_t, 3> p;
+      Hilbert::Decode(iBits, uint64_t(i), p);
+      iSum += p[0] + p[1] + p[2];
+    }
+    clock::time_point t1 = clock::now();
+    hilbert.GetSpatialPositions(0, iCount, &positions[0]);
+    clock::time_point t2 = clock::now();
+    for(size_t i=0; i < iCount; ++i) {
+      std::array<uint64_t, 3> p = {{
+        positions[i].x, positions[i].y, positions[i].z
+      }};
+      iSum += Hilbert::Encode(iBits, p);
+    }
+    clock::time_point t3 = clock::now();
+    std::vector<uint64_t> indices(iCount);
+    hilbert.GetLinearIndices(&positions[0], iCount, &indices[0]);
+    clock::time_point t4 = clock::now();
+    for(size_t i=0; i < iCount; ++i) {
+      iSum += morton_bits(positions[i]);
+    }
+    clock::time_point t5 = clock::now();
+    morton.GetLinearIndices(&positions[0], iCount, &indices[0]);
+    clock::time_point t6 = clock::now();
+    TS_ASSERT(iSum != 0);
+
+    typedef std::chrono::duration<double, std::milli> ms;
+    std::ostringstream trace;
+    trace << "4M points, 10 bits per axis: hilbert decode "
+          << ms(t2-t1).count() << "ms (reference " << ms(t1-t0).count()
+          << "ms), hilbert encode " << ms(t4-t3).count() << "ms (reference "
+          << ms(t3-t2).count() << "ms), morton encode " << ms(t6-t5).count()
+          << "ms (bit loop " << ms(t5-t4).count() << "ms)";
+    TS_TRACE(trace.str());
+  }
+}
+
+class LayoutTests : public CxxTest::TestSuite {
+public:
+  void test_morton() { morton(); }
+  void test_hilbert() { hilbert(); }
+  void test_batches() { batches(); }
+  void test_out_of_domain() { out_of_domain(); }
+  void test_timing() { timing(); }
+};
@@ -0,0 +1,204 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include "DebugOut/AbstrDebugOut.h"
+#include "UVF/ExtendedOctree/ExtendedOctreeConverter.h"
+
+namespace {
+  class QuietOut : public AbstrDebugOut {
+  public:
+    virtual void printf(enum DebugChannel, const char*, const char*) {}
+    virtual void printf(const char*) const {}
+  };
+
+  // brick offset -> brick size and contents
+  typedef std::tuple<uint64_t, uint64_t, uint64_t> Offset;
+  typedef std::map<Offset, std::pair<UINT64VECTOR3, std::vector<uint8_t>>>
+    BrickMap;
+
+  void store(BrickMap& bricks, void* pData, const UINT64VECTOR3& vSize,
+             const UINT64VECTOR3& vOffset) {
+    const uint8_t* p = static_cast<const uint8_t*>(pData);
+    bricks[Offset(vOffset.x, vOffset.y, vOffset.z)] = std::make_pair(
+      vSize, std::vector<uint8_t>(p, p + vSize.volume()*sizeof(uint16_t))
+    );
+  }
+
+  bool store_serial(void* pData, const UINT64VECTOR3& vSize,
+                    const UINT64VECTOR3& vOffset, void* pContext) {
+    store(*static_cast<BrickMap*>(pContext), pData, vSize, vOffset);
+    return true;
+  }
+
+  // a 70x45x33 uint16 volume which does not divide into the bricks evenly,
+  // compressed so that decompression actually runs concurrently.
+  void mk_octree(const char* filename) {
+    const UINT64VECTOR3 vVolume(70, 45, 33);
+    std::vector<uint16_t> data(size_t(vVolume.volume()));
+    for(size_t i=0; i < data.size(); ++i) {
+      data[i] = (i%7 == 0) ? uint16_t((i*2654435761u) >> 7) : uint16_t(i/97);
+    }
+    FILE* f = fopen("octree.raw", "wb");
+    TS_ASSERT(f != NULL);
+    fwrite(&data[0], sizeof(uint16_t), data.size(), f);
+    fclose(f);
+
+    QuietOut quiet;
+    ExtendedOctreeConverter conv(UINT64VECTOR3(16,16,16), 2, 1<<20, quiet);
+    BrickStatVec stats;
+    TS_ASSERT(conv.Convert("octree.raw", 0, ExtendedOctree::CT_UINT16, 1,
+                           vVolume, DOUBLEVECTOR3(1,1,1), filename, 0, &stats,
+                           CT_LZ4, 1, false, false, LT_SCANLINE));
+    remove("octree.raw");
+  }
+
+  // the parallel traversal sees exactly the bricks the serial one sees.
+  void parallel_apply() {
+    mk_octree("octree.oct");
+    ExtendedOctree tree;
+    TS_ASSERT(tree.Open("octree.oct", 0, 5));
+    const size_t iThreads = 3;
+    for(uint64_t lod=0; lod < tree.GetLODCount(); ++lod) {
+      for(uint32_t overlap=0; overlap <= 2; ++overlap) {
+        BrickMap serial;
+        TS_ASSERT(ExtendedOctreeConverter::ApplyFunction(tree, lod,
+                    &store_serial, &serial, overlap));
+
+        BrickMap parallel;
+        std::mutex guard;
+        bool bThreadInRange = true;
+        TS_ASSERT(ExtendedOctreeConverter::ParallelApplyFunction(tree, lod,
+          [&](void* pData, const UINT64VECTOR3& vSize,
+              const UINT64VECTOR3& vOffset, size_t iThread) {
+            std::lock_guard<std::mutex> lock(guard);
+            bThreadInRange &= iThread < iThreads;
+            store(parallel, pData, vSize, vOffset);
+            return true;
+          }, iThreads, overlap));
+        TS_ASSERT(bThreadInRange);
+        TS_ASSERT_EQUALS(serial.size(), size_t(tree.GetBrickCount(lod).volume()));
+        TS_ASSERT(serial == parallel);
+      }
+    }
+    tree.Close();
+    remove("octree.oct");
+  }
+
+  // a failing or throwing brick function fails the traversal, but neither
+  // takes the process down.
+  void parallel_apply_failure() {
+    mk_octree("octree.oct");
+    ExtendedOctree tree;
+    TS_ASSERT(tree.Open("octree.oct", 0, 5));
+    TS_ASSERT(!ExtendedOctreeConverter::ParallelApplyFunction(tree, 0,
+      [](void*, const UINT64VECTOR3&, const UINT64VECTOR3& vOffset, size_t) {
+        return vOffset.x == 0;
+      }, 4));
+    TS_ASSERT(!ExtendedOctreeConverter::ParallelApplyFunction(tree, 0,
+      [](void*, const UINT64VECTOR3&, const UINT64VECTOR3& vOffset,
+         size_t) -> bool {
+        if(vOffset.y > 0) { throw std::runtime_error("brick failed"); }
+        return true;
+      }, 4));
+    tree.Close();
+    remove("octree.oct");
+  }
+
+  std::vector<char> contents(const char* filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(ifs),
+                             std::istreambuf_iterator<char>());
+  }
+
+  bool exists(const char* filename) {
+    return std::ifstream(filename).good();
+  }
+
+  // the voxels with x >= 35 are zeroed, the others are kept.
+  void check_cropped(const BrickMap& before, const BrickMap& after) {
+    TS_ASSERT_EQUALS(before.size(), after.size());
+    for(BrickMap::const_iterator b = before.begin(), a = after.begin();
+        b != before.end() && a != after.end(); ++b, ++a) {
+      TS_ASSERT(b->first == a->first);
+      const UINT64VECTOR3 vSize = b->second.first;
+      const uint16_t* pOld =
+        reinterpret_cast<const uint16_t*>(&b->second.second[0]);
+      const uint16_t* pNew =
+        reinterpret_cast<const uint16_t*>(&a->second.second[0]);
+      size_t iWrong = 0;
+      for(uint64_t i=0; i < vSize.volume(); ++i) {
+        const uint64_t x = std::get<0>(b->first) + i % vSize.x;
+        iWrong += pNew[i] != (x >= 35 ? 0 : pOld[i]);
+      }
+      TS_ASSERT_EQUALS(iWrong, 0U);
+    }
+  }
+
+  // preparing a crop does not touch the tree; committing it crops exactly
+  // the clipped voxels.
+  void crop_in_place() {
+    mk_octree("octree.oct");
+    ExtendedOctree tree;
+    TS_ASSERT(tree.Open("octree.oct", 0, 5));
+    BrickMap before;
+    TS_ASSERT(ExtendedOctreeConverter::ApplyFunction(tree, 0, &store_serial,
+                                                     &before, 0));
+    const std::vector<char> original = contents("octree.oct");
+    const PLANE<float> plane(1, 0, 0, 0);
+
+    {
+      ExtendedOctreeConverter::CropPlan plan;
+      TS_ASSERT(ExtendedOctreeConverter::PrepareCrop(tree, plane,
+                                                     "octree.stage", plan));
+      TS_ASSERT(!plan.staged.empty());
+      TS_ASSERT(exists("octree.stage"));
+    }
+    // an abandoned plan leaves neither changes nor its staging file behind.
+    TS_ASSERT(!exists("octree.stage"));
+    TS_ASSERT(contents("octree.oct") == original);
+
+    ExtendedOctreeConverter::CropPlan plan;
+    TS_ASSERT(ExtendedOctreeConverter::PrepareCrop(tree, plane,
+                                                   "octree.stage", plan));
+    TS_ASSERT(contents("octree.oct") == original);
+    TS_ASSERT(ExtendedOctreeConverter::CommitCrop(tree, plan));
+    TS_ASSERT(!exists("octree.stage"));
+    TS_ASSERT(!plan.vChanged.empty());
+    TS_ASSERT(plan.vChanged.size() < tree.GetBrickCount(0).volume());
+    tree.Close();
+
+    // the changes are on disk.
+    ExtendedOctree cropped;
+    TS_ASSERT(cropped.Open("octree.oct", 0, 5));
+    BrickMap after;
+    TS_ASSERT(ExtendedOctreeConverter::ApplyFunction(cropped, 0, &store_serial,
+                                                     &after, 0));
+    check_cropped(before, after);
+
+    // cropping again changes nothing but the bricks on the plane.
+    BrickStatVec stats;
+    std::vector<size_t> vChanged;
+    TS_ASSERT(ExtendedOctreeConverter::CropInPlace(cropped, plane,
+                                                   "octree.stage", &stats,
+                                                   &vChanged));
+    BrickMap again;
+    TS_ASSERT(ExtendedOctreeConverter::ApplyFunction(cropped, 0, &store_serial,
+                                                     &again, 0));
+    TS_ASSERT(again == after);
+    cropped.Close();
+    remove("octree.oct");
+  }
+}
+
+class OctreeTests : public CxxTest::TestSuite {
+public:
+  void test_parallel_apply() { parallel_apply(); }
+  void test_parallel_apply_failure() { parallel_apply_failure(); }
+  void test_crop_in_place() { crop_in_place(); }
+};
@@ -0,0 +1,239 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include "BrickedDataset.h"
+#include "ProgressiveBrickRequest.h"
+
+using namespace tuvok;
+
+namespace {
+  // an octree of 'lods' levels over [-1,1]^3, LoD 0 being the finest.
+  // Every brick holds a single byte: its LoD.
+  class PyramidDS : public BrickedDataset {
+  public:
+    PyramidDS(size_t lods, unsigned delay_ms=0) : m_iReads(0), m_iLoDs(lods),
+                                                  m_iDelay(delay_ms) {
+      for(size_t lod=0; lod < lods; ++lod) {
+        const size_t n = size_t(1) << (lods-1 - lod);
+        const float ext = 2.0f / n;
+        for(size_t i=0; i < n*n*n; ++i) {
+          BrickMD md;
+          md.center = FLOATVECTOR3(-1 + ext * (i % n + 0.5f),
+                                   -1 + ext * (i / n % n + 0.5f),
+                                   -1 + ext * (i / (n*n) + 0.5f));
+          md.extents = FLOATVECTOR3(ext, ext, ext);
+          md.n_voxels = UINTVECTOR3(1,1,1);
+          AddBrick(BrickKey(0, lod, i), md);
+        }
+      }
+    }
+    mutable size_t m_iReads;
+
+    virtual bool GetBrick(const BrickKey& k, std::vector<uint8_t>& v) const {
+      ++m_iReads;
+      std::this_thread::sleep_for(std::chrono::milliseconds(m_iDelay));
+      v.assign(1, uint8_t(std::get<1>(k)));
+      return true;
+    }
+    virtual bool GetBrick(const BrickKey&, std::vector<int8_t>&) const {
+      return false;
+    }
+    virtual bool GetBrick(const BrickKey&, std::vector<uint16_t>&) const {
+      return false;
+    }
+    virtual bool GetBrick(const BrickKey&, std::vector<int16_t>&) const {
+      return false;
+    }
+    virtual bool GetBrick(const BrickKey&, std::vector<uint32_t>&) const {
+      return false;
+    }
+    virtual bool GetBrick(const BrickKey&, std::vector<int32_t>&) const {
+      return false;
+    }
+    virtual bool GetBrick(const BrickKey&, std::vector<float>&) const {
+      return false;
+    }
+    virtual bool GetBrick(const BrickKey&, std::vector<double>&) const {
+      return false;
+    }
+    virtual unsigned GetLODLevelCount() const { return unsigned(m_iLoDs); }
+    virtual float MaxGradientMagnitude() const { return 0; }
+    virtual UINT64VECTOR3 GetDomainSize(const size_t, const size_t) const {
+      return UINT64VECTOR3(1,1,1);
+    }
+    virtual UINTVECTOR3 GetBrickOverlapSize() const {
+      return UINTVECTOR3(0,0,0);
+    }
+    virtual UINT64VECTOR3 GetEffectiveBrickSize(const BrickKey&) const {
+      return UINT64VECTOR3(1,1,1);
+    }
+    virtual unsigned GetBitWidth() const { return 8; }
+    virtual uint64_t GetComponentCount() const { return 1; }
+    virtual bool GetIsSigned() const { return false; }
+    virtual bool GetIsFloat() const { return false; }
+    virtual bool IsSameEndianness() const { return true; }
+    virtual std::pair<double,double> GetRange() const {
+      return std::make_pair(0.0, 255.0);
+    }
+    virtual bool Export(uint64_t, const std::string&, bool) const {
+      return false;
+    }
+    virtual bool ApplyFunction(uint64_t, bool (*)(void*, const UINT64VECTOR3&,
+                                                  const UINT64VECTOR3&, void*),
+                               void*, uint64_t) const {
+      return false;
+    }
+    virtual Dataset* Create(const std::string&, uint64_t, bool) const {
+      return NULL;
+    }
+    virtual MinMaxBlock MaxMinForKey(const BrickKey&) const {
+      return MinMaxBlock();
+    }
+
+  private:
+    size_t m_iLoDs;
+    unsigned m_iDelay;
+  };
+
+  struct Delivery {
+    BrickKey key;
+    uint8_t value;
+    bool bLoDDone;
+  };
+
+  // the whole region arrives, coarse to fine, the preview at once.
+  void coarse_to_fine() {
+    PyramidDS ds(4);
+    std::vector<Delivery> got;
+    ProgressiveBrickRequest req(ds, 0, 0, FLOATVECTOR3(-1,-1,-1),
+                                FLOATVECTOR3(1,1,1),
+      [&got](const BrickKey& k, const std::vector<uint8_t>& v, bool bDone) {
+        Delivery d = { k, v[0], bDone };
+        got.push_back(d);
+        return true;
+      });
+    TS_ASSERT(!got.empty());
+    TS_ASSERT_EQUALS(std::get<1>(got[0].key), 3U);
+    TS_ASSERT(req.Wait());
+    TS_ASSERT(req.IsDone());
+    TS_ASSERT_EQUALS(req.GetCompletedLoD(), 0U);
+    TS_ASSERT_EQUALS(got.size(), 1U + 8U + 64U + 512U);
+    size_t iDone = 0;
+    for(size_t i=1; i < got.size(); ++i) {
+      TS_ASSERT(std::get<1>(got[i].key) <= std::get<1>(got[i-1].key));
+      TS_ASSERT_EQUALS(got[i].value, std::get<1>(got[i].key));
+      if(got[i-1].bLoDDone) {
+        ++iDone;
+        TS_ASSERT_EQUALS(std::get<1>(got[i].key)+1,
+                         std::get<1>(got[i-1].key));
+      }
+    }
+    TS_ASSERT_EQUALS(iDone, 3U);
+    TS_ASSERT(got.back().bLoDDone);
+  }
+
+  // only bricks overlapping the region are read, nearest ones first.
+  void region() {
+    PyramidDS ds(3);
+    std::vector<BrickKey> keys = ProgressiveBrickRequest::BricksInRegion(
+      ds, 0, 0, FLOATVECTOR3(0.1f,0.1f,0.1f), FLOATVECTOR3(0.6f,0.6f,0.6f));
+    TS_ASSERT_EQUALS(keys.size(), 8U);
+    // the center of the region lies in brick (2,2,2) of the 4^3 grid.
+    TS_ASSERT_EQUALS(std::get<2>(keys[0]), size_t(2 + 2*4 + 2*16));
+
+    std::vector<BrickKey> outside = ProgressiveBrickRequest::BricksInRegion(
+      ds, 0, 0, FLOATVECTOR3(2,2,2), FLOATVECTOR3(3,3,3));
+    TS_ASSERT(outside.empty());
+    ProgressiveBrickRequest none(ds, 0, 0, FLOATVECTOR3(2,2,2),
+                                 FLOATVECTOR3(3,3,3),
+      [](const BrickKey&, const std::vector<uint8_t>&, bool) {
+        return true;
+      });
+    TS_ASSERT(none.Wait());
+    TS_ASSERT_EQUALS(ds.m_iReads, 0U);
+  }
+
+  // nothing is delivered after a cancel, from the sink or from outside.
+  void cancel() {
+    PyramidDS ds(5);
+    size_t iCalls = 0;
+    ProgressiveBrickRequest stop(ds, 0, 0, FLOATVECTOR3(-1,-1,-1),
+                                 FLOATVECTOR3(1,1,1),
+      [&iCalls](const BrickKey&, const std::vector<uint8_t>&, bool) {
+        return ++iCalls < 10;
+      });
+    TS_ASSERT(!stop.Wait());
+    TS_ASSERT_EQUALS(iCalls, 10U);
+
+    PyramidDS slow(5, 1);
+    size_t iOutside = 0;
+    ProgressiveBrickRequest req(slow, 0, 0, FLOATVECTOR3(-1,-1,-1),
+                                FLOATVECTOR3(1,1,1),
+      [&iOutside](const BrickKey&, const std::vector<uint8_t>&, bool) {
+        ++iOutside;
+        return true;
+      });
+    req.Cancel();
+    const size_t iSeen = iOutside;
+    TS_ASSERT(!req.Wait());
+    TS_ASSERT_EQUALS(iOutside, iSeen);
+    TS_ASSERT(iSeen >= 1U);
+  }
+
+  // the sink may query, wait for and cancel its own request.
+  void reentrant() {
+    PyramidDS ds(4, 1);
+    std::atomic<ProgressiveBrickRequest*> self(NULL);
+    size_t iCalls = 0, iCancelledAt = 0;
+    ProgressiveBrickRequest req(ds, 0, 0, FLOATVECTOR3(-1,-1,-1),
+                                FLOATVECTOR3(1,1,1),
+      [&](const BrickKey&, const std::vector<uint8_t>&, bool) {
+        ++iCalls;
+        ProgressiveBrickRequest* r = self.load();
+        if(r == NULL || iCancelledAt != 0) { return true; }
+        TS_ASSERT(!r->IsDone());
+        TS_ASSERT(!r->Wait());
+        r->Cancel();
+        iCancelledAt = iCalls;
+        return true;
+      });
+    self = &req;
+    TS_ASSERT(!req.Wait());
+    TS_ASSERT(iCancelledAt > 0U);
+    TS_ASSERT_EQUALS(iCalls, iCancelledAt);
+  }
+
+  // a Cancel from outside returns only once the sink returned.
+  void cancel_waits_for_sink() {
+    PyramidDS ds(4);
+    std::atomic<bool> bInSink(false);
+    std::atomic<size_t> iCalls(0);
+    ProgressiveBrickRequest req(ds, 0, 0, FLOATVECTOR3(-1,-1,-1),
+                                FLOATVECTOR3(1,1,1),
+      [&](const BrickKey&, const std::vector<uint8_t>&, bool) {
+        if(++iCalls == 1) { return true; } // from the constructor
+        bInSink = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        bInSink = false;
+        return true;
+      });
+    while(!bInSink && !req.IsDone()) { std::this_thread::yield(); }
+    req.Cancel();
+    TS_ASSERT(!bInSink);
+    const size_t iSeen = iCalls;
+    TS_ASSERT(!req.Wait());
+    TS_ASSERT_EQUALS(size_t(iCalls), iSeen);
+  }
+}
+
+class ProgressiveTests : public CxxTest::TestSuite {
+public:
+  void test_coarse_to_fine() { coarse_to_fine(); }
+  void test_region() { region(); }
+  void test_cancel() { cancel(); }
+  void test_reentrant() { reentrant(); }
+  void test_cancel_waits_for_sink() { cancel_waits_for_sink(); }
+};
@@ -10,6 +10,7 @@
 #include "AbstrConverter.h"
 #include "Controller/Controller.h"
 #include "UVF/Histogram1DDataBlock.h"
+#include "../FilteredRAWFile.h"
 #include "../Quantize.h"
 
 #include "util-test.h"
@@ -264,6 +265,125 @@ void verify_8b_type() {
   }
 }
 
+template<typename T>
+std::string mk_ramp(size_t n, T start, T step, bool bSwap) {
+  std::ofstream dataf;
+  const std::string fn = mk_tmpfile(dataf, std::ios::out | std::ios::binary);
+  for(size_t i=0; i < n; ++i) {
+    T val = static_cast<T>(start + static_cast<T>(i)*step);
+    if(bSwap) { val = EndianConvert::Swap<T>(val); }
+    gen_constant<T>(dataf, 1, val);
+  }
+  return fn;
+}
+
+template<typename T>
+std::vector<T> read_all(const std::string& fn, size_t n) {
+  std::vector<T> data(n, 0);
+  std::ifstream ifs(fn.c_str(), std::ios::in | std::ios::binary);
+  ifs.read(reinterpret_cast<char*>(&data[0]), n*sizeof(T));
+  TS_ASSERT_EQUALS(static_cast<size_t>(ifs.gcount()), n*sizeof(T));
+  return data;
+}
+
+// QuantizeView yields what Quantize writes, no matter how it is read, and
+// the same histogram.  With bSwap, the input is stored in the other byte
+// order and read through an EndianSwappedRAWFile first, like
+// RAWConverter::ConvertRAWDataset does.
+template<typename T>
+void verify_view(T start, T step, bool bSwap) {
+  const size_t N_VALUES = 1000;
+  const std::string fn = mk_ramp<T>(N_VALUES, start, step, false);
+  const std::string swappedfn = mk_ramp<T>(N_VALUES, start, step, true);
+  std::string outfn;
+  {
+    std::ofstream dataf;
+    outfn = mk_tmpfile(dataf, std::ios::out | std::ios::binary);
+  }
+  clean fclean = cleanup(fn).add(swappedfn).add(outfn);
+
+  BStreamDescriptor bsd;
+  bsd.elements = N_VALUES;
+  bsd.components = 1;
+  bsd.width = sizeof(T);
+  bsd.is_signed = ctti<T>::is_signed;
+  bsd.fp = std::is_floating_point<T>::value;
+  bsd.big_endian = EndianConvert::IsBigEndian();
+  bsd.timesteps = 1;
+
+  Histogram1DDataBlock refhist;
+  bool bWritten;
+  {
+    LargeRAWFile input(fn); input.Open(false);
+    bWritten = Quantize<T, unsigned short>(input, bsd, outfn, &refhist);
+  }
+
+  Histogram1DDataBlock hist;
+  LargeRAWFile_ptr source(new LargeRAWFile(bSwap ? swappedfn : fn));
+  TS_ASSERT(source->Open(false));
+  if(bSwap) {
+    source = LargeRAWFile_ptr(new EndianSwappedRAWFile(source, sizeof(T)));
+  }
+  LargeRAWFile_ptr view = QuantizeView<T, unsigned short>(source, bsd, &hist);
+  TS_ASSERT(refhist.GetHistogram() == hist.GetHistogram());
+  TS_ASSERT_EQUALS(bWritten, view != LargeRAWFile_ptr());
+  if(!view) { return; }
+
+  const std::vector<unsigned short> ref =
+    read_all<unsigned short>(outfn, N_VALUES);
+  TS_ASSERT_EQUALS(view->GetCurrentSize(), N_VALUES*sizeof(unsigned short));
+
+  std::vector<unsigned short> data(N_VALUES, 0);
+  view->SeekStart();
+  TS_ASSERT_EQUALS(view->ReadRAW(reinterpret_cast<unsigned char*>(&data[0]),
+                                 N_VALUES*sizeof(unsigned short)),
+                   N_VALUES*sizeof(unsigned short));
+  TS_ASSERT(data == ref);
+
+  // positions are in units of the output.
+  std::vector<unsigned short> part(10, 0);
+  view->SeekPos(500*sizeof(unsigned short));
+  view->ReadRAW(reinterpret_cast<unsigned char*>(&part[0]),
+                part.size()*sizeof(unsigned short));
+  TS_ASSERT(std::equal(part.begin(), part.end(), ref.begin()+500));
+  TS_ASSERT_EQUALS(view->GetPos(), 510*sizeof(unsigned short));
+
+  // a read across the end returns what is there.
+  std::fill(part.begin(), part.end(), 0);
+  TS_ASSERT_EQUALS(view->ReadAt((N_VALUES-4)*sizeof(unsigned short),
+                                reinterpret_cast<unsigned char*>(&part[0]),
+                                part.size()*sizeof(unsigned short)),
+                   4*sizeof(unsigned short));
+  TS_ASSERT(std::equal(part.begin(), part.begin()+4, ref.end()-4));
+}
+
+// the swapped view reads the other byte order sequentially and at random.
+template<typename T>
+void verify_endian_view() {
+  const size_t N_VALUES = 1000;
+  const std::string fn = mk_ramp<T>(N_VALUES, T(1), T(77), true);
+  clean fclean = cleanup(fn);
+
+  LargeRAWFile_ptr source(new LargeRAWFile(fn));
+  TS_ASSERT(source->Open(false));
+  EndianSwappedRAWFile view(source, sizeof(T));
+  TS_ASSERT(!view.IsWritable());
+  TS_ASSERT_EQUALS(view.GetCurrentSize(), N_VALUES*sizeof(T));
+
+  std::vector<T> data(N_VALUES, 0);
+  view.SeekStart();
+  TS_ASSERT_EQUALS(view.ReadRAW(reinterpret_cast<unsigned char*>(&data[0]),
+                                N_VALUES*sizeof(T)), N_VALUES*sizeof(T));
+  for(size_t i=0; i < N_VALUES; ++i) {
+    TS_ASSERT_EQUALS(data[i], static_cast<T>(1 + static_cast<T>(i)*77));
+  }
+  T val = 0;
+  TS_ASSERT_EQUALS(view.ReadAt(123*sizeof(T),
+                               reinterpret_cast<unsigned char*>(&val),
+                               sizeof(T)), sizeof(T));
+  TS_ASSERT_EQUALS(val, static_cast<T>(1 + 123*77));
+}
+
 class QuantizeTests : public CxxTest::TestSuite {
 public:
   void test_byte() { verify_type<tbyte>(); }
@@ -281,4 +401,16 @@ public:
   void test_8b_ushort() { verify_8b_type<unsigned short>(); }
   void test_8b_int() { verify_8b_type<int>(); }
   void test_8b_uint() { verify_8b_type<unsigned int>(); }
+
+  void test_view_short() { verify_view<short>(-64, 1, false); }
+  void test_view_ushort() { verify_view<unsigned short>(0, 1, false); }
+  void test_view_int() { verify_view<int>(-300000, 523, false); }
+  void test_view_uint() { verify_view<unsigned int>(7, 1000, false); }
+  void test_view_swapped_int() { verify_view<int>(-300000, 523, true); }
+  void test_view_swapped_ushort() {
+    verify_view<unsigned short>(100, 60, true);
+  }
+  void test_endian_view_ushort() { verify_endian_view<unsigned short>(); }
+  void test_endian_view_uint() { verify_endian_view<unsigned int>(); }
+  void test_endian_view_uint64() { verify_endian_view<uint64_t>(); }
 };
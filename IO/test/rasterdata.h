@@ -0,0 +1,133 @@
+#include <cstdint>
+#include <fstream>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include "UVF/RasterDataBlock.h"
+#include "util-test.h"
+
+namespace {
+  void average(const std::vector<uint64_t>& vSource, uint64_t iTarget,
+               const void* pIn, void* pOut) {
+    const uint16_t* in = static_cast<const uint16_t*>(pIn);
+    double sum = 0;
+    for(size_t i=0; i < vSource.size(); ++i) { sum += in[vSource[i]]; }
+    static_cast<uint16_t*>(pOut)[iTarget] = uint16_t(sum / vSource.size());
+  }
+
+  // exposes the offset tables, which the UVF reader normally builds.
+  struct TableRDB : public RasterDataBlock {
+    uint64_t Tables() { return ComputeDataSizeAndOffsetTables(); }
+    // where the vector based lookup finds a brick, in bytes
+    uint64_t Offset(const std::vector<uint64_t>& vLOD,
+                    const std::vector<uint64_t>& vBrick) const {
+      return GetLocalDataPointerOffset(vLOD, vBrick)/8;
+    }
+    // where the index based read path looks for it
+    uint64_t FlatOffset(uint64_t l, uint64_t iBrick) const {
+      return m_vFlatBrickOffset[size_t(m_vLODBrickStart[size_t(l)]+iBrick)];
+    }
+    uint64_t FlatBytes(uint64_t l, uint64_t iBrick) const {
+      return m_vFlatBrickBytes[size_t(m_vLODBrickStart[size_t(l)]+iBrick)];
+    }
+  };
+
+  // a 3D ushort volume with uneven brick counts and 4 LODs.
+  void mk_rdb(RasterDataBlock& rdb, std::vector<uint16_t>& src) {
+    rdb.ulDomainSemantics.assign(3, UVFTables::DS_X);
+    rdb.ulDomainSize.push_back(137);
+    rdb.ulDomainSize.push_back(70);
+    rdb.ulDomainSize.push_back(53);
+    rdb.ulBrickSize.assign(3, 32);
+    rdb.ulBrickOverlap.assign(3, 2);
+    rdb.ulLODDecFactor.assign(3, 2);
+    rdb.ulLODGroups.assign(3, 0);
+    rdb.ulLODLevelCount.push_back(4);
+    rdb.SetIdentityTransformation();
+    rdb.SetTypeToUShort(UVFTables::ES_CT);
+
+    src.resize(137*70*53);
+    for(size_t i=0; i < src.size(); ++i) {
+      src[i] = uint16_t((i*2654435761u) >> 7);
+    }
+  }
+
+  // the index based reads find the same bricks as the vector based ones.
+  void fast_path() {
+    TableRDB rdb;
+    std::vector<uint16_t> src;
+    mk_rdb(rdb, src);
+    std::ofstream ofs;
+    const std::string tmpf = mk_tmpfile(ofs, std::ios::out|std::ios::binary);
+    ofs.close();
+    clean f = cleanup(tmpf);
+    TS_ASSERT(rdb.FlatDataToBrickedLOD(&src[0], tmpf, average, NULL));
+
+    for(uint64_t l=0; l < 4; ++l) {
+      const std::vector<uint64_t> vLOD(1, l);
+      const std::vector<uint64_t> count = rdb.GetBrickCount(vLOD);
+      uint64_t iBrick = 0;
+      for(uint64_t z=0; z < count[2]; ++z) {
+        for(uint64_t y=0; y < count[1]; ++y) {
+          for(uint64_t x=0; x < count[0]; ++x, ++iBrick) {
+            std::vector<uint64_t> vBrick(3);
+            vBrick[0] = x; vBrick[1] = y; vBrick[2] = z;
+            std::vector<uint16_t> a, b;
+            TS_ASSERT(rdb.GetData(a, vLOD, vBrick));
+            TS_ASSERT(rdb.GetData(b, l, iBrick));
+            TS_ASSERT(a == b);
+            const std::vector<uint64_t>& size = rdb.GetBrickSize(vLOD,
+                                                                 vBrick);
+            TS_ASSERT_EQUALS(a.size(), size_t(size[0]*size[1]*size[2]));
+            // the flat tables must agree with the vector based offsets, and
+            // the bricks of a LOD follow each other without gaps.
+            TS_ASSERT_EQUALS(rdb.FlatOffset(l, iBrick),
+                             rdb.Offset(vLOD, vBrick));
+            TS_ASSERT_EQUALS(rdb.FlatBytes(l, iBrick),
+                             size[0]*size[1]*size[2]*sizeof(uint16_t));
+            if(iBrick > 0) {
+              TS_ASSERT_EQUALS(rdb.FlatOffset(l, iBrick),
+                               rdb.FlatOffset(l, iBrick-1) +
+                               rdb.FlatBytes(l, iBrick-1));
+            }
+          }
+        }
+      }
+      std::vector<uint16_t> none;
+      TS_ASSERT(!rdb.GetData(none, l, iBrick));
+      std::vector<uint64_t> vBrick(3, 0);
+      vBrick[2] = count[2];
+      TS_ASSERT(!rdb.ValidBrickIndex(vLOD, vBrick));
+    }
+    std::vector<uint16_t> none;
+    TS_ASSERT(!rdb.GetData(none, 4, 0));
+
+    // the finest LOD comes back out as it went in.
+    const std::string flat = tmpf + ".raw";
+    TS_ASSERT(rdb.BrickedLODToFlatData(std::vector<uint64_t>(1, 0), flat));
+    std::ifstream ifs(flat.c_str(), std::ios::binary);
+    std::vector<uint16_t> back(src.size());
+    ifs.read(reinterpret_cast<char*>(&back[0]), back.size()*sizeof(uint16_t));
+    TS_ASSERT_EQUALS(size_t(ifs.gcount()), back.size()*sizeof(uint16_t));
+    TS_ASSERT(back == src);
+    ifs.close();
+    remove(flat.c_str());
+  }
+
+  // the size computed without tables agrees with the tables.
+  void data_size() {
+    TableRDB rdb;
+    std::vector<uint16_t> src;
+    mk_rdb(rdb, src);
+    rdb.ulDomainSize.assign(3, 2048);
+    rdb.ulLODLevelCount[0] = 8;
+    const uint64_t iSize = rdb.ComputeDataSize();
+    TS_ASSERT_EQUALS(iSize, rdb.Tables());
+    TS_ASSERT_EQUALS(iSize, 23807031552ULL);
+  }
+}
+
+class RasterDataTests : public CxxTest::TestSuite {
+public:
+  void test_fast_path() { fast_path(); }
+  void test_data_size() { data_size(); }
+};
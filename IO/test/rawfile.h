@@ -0,0 +1,122 @@
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include "Basics/LargeRAWFile.h"
+#include "util-test.h"
+
+namespace {
+  // the value stored at element 'i' of the test files.
+  uint32_t pattern(uint64_t i) { return uint32_t(i * 2654435761u) ^ 0x5a5a; }
+
+  const size_t ELEMS = 1024*1024;
+
+  std::string tmp_pattern(size_t iHeader) {
+    std::ofstream ofs;
+    const std::string tmpf = mk_tmpfile(ofs, std::ios::out | std::ios::binary);
+    gen_constant<uint8_t>(ofs, iHeader, 0xFF);
+    for(size_t i=0; i < ELEMS; ++i) {
+      const uint32_t v = pattern(i);
+      ofs.write(reinterpret_cast<const char*>(&v), sizeof(uint32_t));
+    }
+    ofs.close();
+    return tmpf;
+  }
+
+  // every thread reads random ranges of one shared file and checks them.
+  void concurrent_reads() {
+    const size_t HEADER = 17;
+    const std::string tmpf = tmp_pattern(HEADER);
+    clean f = cleanup(tmpf);
+
+    LargeRAWFile raw(tmpf, HEADER);
+    TS_ASSERT(raw.Open(false));
+    std::atomic<size_t> iErrors(0);
+    std::vector<std::thread> threads;
+    for(unsigned t=0; t < 8; ++t) {
+      threads.push_back(std::thread([&raw, &iErrors, t]() {
+        std::mt19937 rng(t);
+        std::uniform_int_distribution<size_t> pos(0, ELEMS-1);
+        std::vector<uint32_t> buf(4096);
+        for(size_t n=0; n < 2000; ++n) {
+          const size_t iFirst = pos(rng);
+          const size_t iCount = std::min(buf.size(), ELEMS - iFirst);
+          const size_t iBytes = iCount * sizeof(uint32_t);
+          if(raw.ReadAt(iFirst*sizeof(uint32_t),
+                        reinterpret_cast<unsigned char*>(&buf[0]),
+                        iBytes) != iBytes) {
+            ++iErrors;
+            continue;
+          }
+          for(size_t i=0; i < iCount; ++i) {
+            if(buf[i] != pattern(iFirst+i)) { ++iErrors; break; }
+          }
+        }
+      }));
+    }
+    for(size_t t=0; t < threads.size(); ++t) { threads[t].join(); }
+    TS_ASSERT_EQUALS(iErrors.load(), 0U);
+
+    // reads beyond the end are short, not garbage.
+    uint32_t tail[4];
+    TS_ASSERT_EQUALS(raw.ReadAt((ELEMS-2)*sizeof(uint32_t),
+                                reinterpret_cast<unsigned char*>(tail),
+                                sizeof(tail)), 2*sizeof(uint32_t));
+    TS_ASSERT_EQUALS(tail[1], pattern(ELEMS-1));
+    raw.Close();
+  }
+
+  // threads write disjoint blocks of one file at once; each reads its block
+  // back right away while the others keep writing.
+  void concurrent_writes() {
+    std::ofstream ofs;
+    const std::string tmpf = mk_tmpfile(ofs, std::ios::out | std::ios::binary);
+    ofs.close();
+    clean f = cleanup(tmpf);
+
+    LargeRAWFile raw(tmpf);
+    TS_ASSERT(raw.Create(ELEMS*sizeof(uint32_t)));
+    const size_t BLOCK = 1024;
+    const unsigned THREADS = 8;
+    std::atomic<size_t> iErrors(0);
+    std::vector<std::thread> threads;
+    for(unsigned t=0; t < THREADS; ++t) {
+      threads.push_back(std::thread([&raw, &iErrors, t]() {
+        std::vector<uint32_t> buf(BLOCK), back(BLOCK);
+        for(size_t b=t; b < ELEMS/BLOCK; b += THREADS) {
+          for(size_t i=0; i < BLOCK; ++i) { buf[i] = pattern(b*BLOCK+i); }
+          const uint64_t iPos = b*BLOCK*sizeof(uint32_t);
+          const size_t iBytes = BLOCK*sizeof(uint32_t);
+          if(raw.WriteAt(iPos, reinterpret_cast<unsigned char*>(&buf[0]),
+                         iBytes) != iBytes ||
+             raw.ReadAt(iPos, reinterpret_cast<unsigned char*>(&back[0]),
+                        iBytes) != iBytes ||
+             buf != back) {
+            ++iErrors;
+          }
+        }
+      }));
+    }
+    for(size_t t=0; t < threads.size(); ++t) { threads[t].join(); }
+    TS_ASSERT_EQUALS(iErrors.load(), 0U);
+
+    // the usual sequential interface sees the same data.
+    std::vector<uint32_t> all(ELEMS);
+    raw.Read(&all[0], ELEMS, 0, 0);
+    raw.Close();
+    size_t iMismatches = 0;
+    for(size_t i=0; i < ELEMS; ++i) {
+      if(all[i] != pattern(i)) { ++iMismatches; }
+    }
+    TS_ASSERT_EQUALS(iMismatches, 0U);
+  }
+}
+
+class RAWFileTests : public CxxTest::TestSuite {
+public:
+  void test_concurrent_reads() { concurrent_reads(); }
+  void test_concurrent_writes() { concurrent_writes(); }
+};
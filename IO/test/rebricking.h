@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <fstream>
@@ -7,6 +8,9 @@
 #include "DynamicBrickingDS.h"
 #include "RAWConverter.h"
 #include "uvfDataset.h"
+#include "UVF/MaxMinDataBlock.h"
+#include "UVF/RasterDataBlock.h"
+#include "UVF/UVF.h"
 #include "util-test.h"
 
 static const std::array<std::array<uint16_t, 8>, 8> data = {{
@@ -501,6 +505,116 @@ void tmulti_component() {
   }
 }
 
+// the 8x8x1 test data in a raster data block, as older versions stored it.
+static void mk_rdb_uvf(const char* uvf) {
+  std::shared_ptr<RasterDataBlock> rdb(new RasterDataBlock());
+  rdb->strBlockID = "8x8x1 raster data";
+  rdb->ulDomainSemantics.push_back(UVFTables::DS_X);
+  rdb->ulDomainSemantics.push_back(UVFTables::DS_Y);
+  rdb->ulDomainSemantics.push_back(UVFTables::DS_Z);
+  rdb->ulDomainSize.push_back(8);
+  rdb->ulDomainSize.push_back(8);
+  rdb->ulDomainSize.push_back(1);
+  rdb->ulBrickSize.assign(3, 16);
+  rdb->ulBrickOverlap.assign(3, 2);
+  rdb->ulLODDecFactor.assign(3, 2);
+  rdb->ulLODGroups.assign(3, 0);
+  rdb->ulLODLevelCount.push_back(1);
+  rdb->SetIdentityTransformation();
+  rdb->SetTypeToUShort(UVFTables::ES_CT);
+
+  std::shared_ptr<MaxMinDataBlock> maxmin(new MaxMinDataBlock(1));
+  TS_ASSERT(rdb->FlatDataToBrickedLOD(data[0].data(), "rdb.tmp",
+                                      CombineAverage<uint16_t, 1>,
+                                      SimpleMaxMin<uint16_t, 1>, maxmin));
+
+  const std::string strUVF(uvf);
+  UVF file(std::wstring(strUVF.begin(), strUVF.end()));
+  GlobalHeader header;
+  header.bIsBigEndian = EndianConvert::IsBigEndian();
+  header.ulChecksumSemanticsEntry = UVFTables::CS_MD5;
+  file.SetGlobalHeader(header);
+  TS_ASSERT(file.AddDataBlock(rdb));
+  TS_ASSERT(file.AddDataBlock(maxmin));
+  TS_ASSERT(file.Create());
+  file.Close();
+}
+
+// the (single) brick of 'uvf' holds the 8x8x1 test data, surrounded by
+// 'overlap' ghost voxels on each side.
+static void verify_8x8(const char* uvf, unsigned overlap) {
+  std::shared_ptr<UVFDataset> ds(new UVFDataset(uvf, 1024, false, false));
+  TS_ASSERT_EQUALS(ds->GetBrickCount(0, 0), 1U);
+  const BrickKey bk(0,0,0);
+  const UINTVECTOR3 bs = ds->GetBrickMetadata(bk).n_voxels;
+  TS_ASSERT_EQUALS(bs, UINTVECTOR3(8+2*overlap, 8+2*overlap, 1+2*overlap));
+  std::vector<uint16_t> d;
+  if(!ds->GetBrick(bk, d)) { TS_FAIL("reading brick data failed"); return; }
+  TS_ASSERT_EQUALS(d.size(), bs.volume());
+  const size_t slice_sz = bs[0] * bs[1];
+  for(size_t y=0; y < 8; ++y) {
+    for(size_t x=0; x < 8; ++x) {
+      const size_t idx = slice_sz*overlap + (y+overlap)*bs[0] + x+overlap;
+      TS_ASSERT_EQUALS(d[idx], data[y][x]);
+    }
+  }
+  // the max/min values must describe the new bricks.
+  TS_ASSERT_DELTA(ds->GetRange().first, 0.0, 0.001);
+  TS_ASSERT_DELTA(ds->GetRange().second, 63.0, 0.001);
+  TS_ASSERT_DELTA(ds->MaxMinForKey(bk).maxScalar, 63.0, 0.001);
+}
+
+// upgrading turns the raster data block into a TOC block with the bricking
+// the IO manager is configured for.
+void tupgrade() {
+  const IOManager& iom = Controller::Const().IOMan();
+  mk_rdb_uvf("rdb.uvf");
+  TS_ASSERT(iom.UpgradeDataset("rdb.uvf", "upgraded.uvf", "."));
+  verify_8x8("upgraded.uvf", unsigned(iom.GetBrickOverlap()));
+  remove("rdb.uvf");
+  remove("rdb.tmp");
+  remove("upgraded.uvf");
+}
+
+// rebricking a raster data block goes through the same conversion.
+void trebrick_rdb() {
+  const IOManager& iom = Controller::Const().IOMan();
+  mk_rdb_uvf("rdb.uvf");
+  TS_ASSERT(iom.ReBrickDataset("rdb.uvf", "rebricked.uvf", ".", 16, 3));
+  verify_8x8("rebricked.uvf", 3);
+  remove("rdb.uvf");
+  remove("rdb.tmp");
+  remove("rebricked.uvf");
+}
+
+// rebricking a TOC block: the max/min values must describe the new bricks.
+void trebrick_toc() {
+  const IOManager& iom = Controller::Const().IOMan();
+  mk8x8("abc");
+  mk_uvf("abc", "toc.uvf");
+  TS_ASSERT(iom.ReBrickDataset("toc.uvf", "rebricked.uvf", ".", 8, 2));
+  {
+    std::shared_ptr<UVFDataset> ds(new UVFDataset("rebricked.uvf", 1024,
+                                                  false, false));
+    TS_ASSERT_EQUALS(ds->GetBrickCount(0, 0), 4U);
+    for(size_t b=0; b < ds->GetBrickCount(0, 0); ++b) {
+      const BrickKey bk(0,0,b);
+      std::vector<uint8_t> d;
+      if(!ds->GetBrick(bk, d)) { TS_FAIL("reading brick data failed"); }
+      if(d.empty()) { continue; }
+      const MinMaxBlock mm = ds->MaxMinForKey(bk);
+      TS_ASSERT_DELTA(mm.minScalar, *std::min_element(d.begin(), d.end()),
+                      0.001);
+      TS_ASSERT_DELTA(mm.maxScalar, *std::max_element(d.begin(), d.end()),
+                      0.001);
+    }
+    TS_ASSERT_DELTA(ds->GetRange().first, 0.0, 0.001);
+    TS_ASSERT_DELTA(ds->GetRange().second, 63.0, 0.001);
+  }
+  remove("toc.uvf");
+  remove("rebricked.uvf");
+}
+
 class RebrickerTests : public CxxTest::TestSuite {
 public:
   void test_simple() { tsimple(); }
@@ -525,4 +639,7 @@ public:
   void test_engine_four() { tengine_four(); }
   void test_rmi_bench() { rmi_bench(); }
   void test_rescale() { trescale(); }
+  void test_upgrade() { tupgrade(); }
+  void test_rebrick_rdb() { trebrick_rdb(); }
+  void test_rebrick_toc() { trebrick_toc(); }
 };
@@ -0,0 +1,166 @@
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#ifdef __linux__
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+#include <cxxtest/TestSuite.h>
+#include "SharedBrickCache.h"
+#include "util-test.h"
+
+using namespace tuvok;
+
+namespace {
+// the cache is only implemented on Linux; elsewhere it is never open.
+#ifdef __linux__
+  const uint64_t SLOT = 4096;
+
+  std::string segment_name() {
+    std::ostringstream name;
+    name << "tuvok-test-" << getpid();
+    return name.str();
+  }
+
+  bool fill(void* p, unsigned char v) {
+    memset(p, v, SLOT);
+    return true;
+  }
+
+  // bricks are shared between caches, and evicted only when unpinned.
+  void share_and_evict() {
+    std::ofstream ofs;
+    const std::string src = mk_tmpfile(ofs, std::ios::out);
+    ofs.close();
+    clean f = cleanup(src);
+    const std::string name = segment_name();
+    SharedBrickCache::Remove(name);
+
+    SharedBrickCache a(name, src, "", 64*SLOT, SLOT);
+    SharedBrickCache b(name, src, "", 1024*SLOT, SLOT);
+    SharedBrickCache other(name, src, "other", 64*SLOT, SLOT);
+    TS_ASSERT(a.IsOpen() && b.IsOpen() && other.IsOpen());
+    TS_ASSERT_EQUALS(b.GetCapacity(), 64*SLOT);
+
+    const BrickKey k(0, 1, 2);
+    std::shared_ptr<const void> pin = a.AcquireOrLoad(k, SLOT,
+      std::bind(fill, std::placeholders::_1, 42));
+    TS_ASSERT(pin);
+    std::shared_ptr<const void> hit = b.Acquire(k, SLOT);
+    TS_ASSERT(hit);
+    TS_ASSERT_EQUALS(static_cast<const unsigned char*>(hit.get())[0], 42);
+    TS_ASSERT(!b.Acquire(k, SLOT/2));
+    TS_ASSERT(!other.Acquire(k, SLOT));
+    TS_ASSERT(!a.Acquire(BrickKey(0, 1, 3), SLOT));
+    TS_ASSERT(!a.AcquireOrLoad(BrickKey(0, 1, 3), SLOT*2,
+              std::bind(fill, std::placeholders::_1, 1)));
+
+    // many more bricks than slots: the pinned one must survive.
+    for(size_t i=0; i < 200; ++i) {
+      TS_ASSERT(b.AcquireOrLoad(BrickKey(1, 0, i), SLOT,
+                std::bind(fill, std::placeholders::_1, 7)));
+    }
+    TS_ASSERT_EQUALS(static_cast<const unsigned char*>(pin.get())[SLOT-1],
+                     42);
+    TS_ASSERT(a.Acquire(k, SLOT));
+    TS_ASSERT(b.GetBrickCount() <= 64U);
+    SharedBrickCache::Remove(name);
+  }
+
+  // a brick is loaded once, however many processes ask for it.
+  void one_load() {
+    std::ofstream ofs;
+    const std::string src = mk_tmpfile(ofs, std::ios::out);
+    ofs.close();
+    clean f = cleanup(src);
+    const std::string name = segment_name();
+    SharedBrickCache::Remove(name);
+    const BrickKey k(0, 0, 0);
+
+    // every load writes a byte to the pipe.
+    int loads[2];
+    TS_ASSERT_EQUALS(pipe(loads), 0);
+    std::vector<pid_t> children;
+    for(size_t c=0; c < 4; ++c) {
+      const pid_t pid = fork();
+      if(pid == 0) {
+        close(loads[0]);
+        SharedBrickCache cache(name, src, "", 16*SLOT, SLOT);
+        bool bOk = cache.IsOpen();
+        for(size_t i=0; i < 50 && bOk; ++i) {
+          std::shared_ptr<const void> p = cache.AcquireOrLoad(k, SLOT,
+            [&loads](void* d) {
+              const char c = 'l';
+              const bool bWritten = write(loads[1], &c, 1) == 1;
+              usleep(100000);
+              return bWritten && fill(d, 9);
+            });
+          bOk = p && static_cast<const unsigned char*>(p.get())[0] == 9;
+        }
+        _exit(bOk ? 0 : 1);
+      }
+      children.push_back(pid);
+    }
+    close(loads[1]);
+    // once a child claimed the slot, we must not load the brick either.
+    char c;
+    TS_ASSERT_EQUALS(read(loads[0], &c, 1), 1);
+    size_t iLoads = 0;
+    {
+      SharedBrickCache cache(name, src, "", 16*SLOT, SLOT);
+      TS_ASSERT(cache.IsOpen());
+      std::shared_ptr<const void> p = cache.AcquireOrLoad(k, SLOT,
+        [&iLoads](void* d) { ++iLoads; return fill(d, 9); });
+      TS_ASSERT(p);
+    }
+    for(size_t c=0; c < children.size(); ++c) {
+      int status = 1;
+      waitpid(children[c], &status, 0);
+      TS_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    TS_ASSERT_EQUALS(iLoads, 0U);
+    // nor did any other child.
+    TS_ASSERT_EQUALS(read(loads[0], &c, 1), 0);
+    close(loads[0]);
+    SharedBrickCache::Remove(name);
+  }
+
+  // a process dying while it loads a brick does not block the others.
+  void dead_loader() {
+    std::ofstream ofs;
+    const std::string src = mk_tmpfile(ofs, std::ios::out);
+    ofs.close();
+    clean f = cleanup(src);
+    const std::string name = segment_name();
+    SharedBrickCache::Remove(name);
+    const BrickKey k(0, 0, 0);
+
+    SharedBrickCache cache(name, src, "", 16*SLOT, SLOT);
+    const pid_t pid = fork();
+    if(pid == 0) {
+      SharedBrickCache child(name, src, "", 16*SLOT, SLOT);
+      child.AcquireOrLoad(k, SLOT, [](void*) { _exit(0); return false; });
+      _exit(1);
+    }
+    int status = 1;
+    waitpid(pid, &status, 0);
+    std::shared_ptr<const void> p = cache.AcquireOrLoad(k, SLOT,
+      std::bind(fill, std::placeholders::_1, 3));
+    TS_ASSERT(p);
+    TS_ASSERT_EQUALS(static_cast<const unsigned char*>(p.get())[0], 3);
+    SharedBrickCache::Remove(name);
+  }
+#else
+  void share_and_evict() { }
+  void one_load() { }
+  void dead_loader() { }
+#endif
+}
+
+class SharedCacheTests : public CxxTest::TestSuite {
+public:
+  void test_share_and_evict() { share_and_evict(); }
+  void test_one_load() { one_load(); }
+  void test_dead_loader() { dead_loader(); }
+};
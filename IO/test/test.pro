@@ -52,7 +52,7 @@ contains(QMAKE_PRL_CONFIG, shared) {
 }
 
 #TEST_HEADERS=quantize.h largefile.h rebricking.h cbi.h bcache.h
-TEST_HEADERS=quantize.h largefile.h rebricking.h bcache.h
+TEST_HEADERS=quantize.h largefile.h rawfile.h rasterdata.h rebricking.h bcache.h sharedcache.h progressive.h depthsort.h layout.h asyncdebugout.h octree.h diskcache.h bricktable.h
 
 TG_PARAMS=--have-eh --abort-on-fail --no-static-init --error-printer
 alltests.target = alltests.cpp
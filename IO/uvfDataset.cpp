@@ -42,6 +42,7 @@
 #include "UVF/KeyValuePairDataBlock.h"
 #include "UVF/Histogram2DDataBlock.h"
 #include "UVF/GeometryDataBlock.h"
+#include "UVF/TOCBlock.h"
 #include "uvfMesh.h"
 
 using namespace boost;
@@ -216,6 +217,10 @@ void UVFDataset::Open(bool bVerify, bool bReadWrite, bool bMustBeSameVersion) {
 }
 
 void UVFDataset::Close() {
+  // stop reading before the file goes away.
+  m_pPrefetcher.reset();
+  m_pDiskCache.reset();
+  m_pSharedCache.reset();
   delete m_pDatasetFile;
 
   for(std::vector<Timestep*>::iterator ts = m_timesteps.begin();
@@ -244,45 +249,28 @@ void UVFDataset::ComputeMetadataTOC(size_t timestep) {
   const TOCBlock* pVolumeDataBlock = ts->GetDB();
   m_DomainScale = pVolumeDataBlock->GetScale();
 
-  size_t n_bricks = 0;
-  for(size_t i=0; i < pVolumeDataBlock->GetLoDCount(); ++i) {
-    n_bricks += pVolumeDataBlock->GetBrickCount(i).volume();
-  }
-  this->NBricksHint(n_bricks);
-
+  // the bricks of each LoD lie on a regular grid; let the brick table
+  // compute their metadata instead of storing millions of them.
+  const uint32_t iOverlap = pVolumeDataBlock->GetOverlap();
+  const UINTVECTOR3 vCore = pVolumeDataBlock->GetMaxBrickSize() - 2*iOverlap;
   for (size_t j = 0;j<pVolumeDataBlock->GetLoDCount();j++) {
-    UINT64VECTOR3 bc = pVolumeDataBlock->GetBrickCount(j);
-
-    BrickMD bmd;
-    FLOATVECTOR3 vBrickCorner(0,0,0);
-
-    for (uint64_t x=0; x < bc.x; x++) {
-      vBrickCorner.y = 0;
-      for (uint64_t y=0; y < bc.y; y++) {
-        vBrickCorner.z = 0;
-        for (uint64_t z=0; z < bc.z; z++) {
-          const UINT64VECTOR4 coords(x,y,z,j);
-          const BrickKey k = BrickKey(timestep, j,
-            static_cast<size_t>(z*bc.x*bc.y+y*bc.x + x));
-
-          FLOATVECTOR3 vNormalizedDomainSize =
-            FLOATVECTOR3(GetDomainSize(j, timestep)) *
-            FLOATVECTOR3(pVolumeDataBlock->GetBrickAspect(coords));
-          float maxVal = vNormalizedDomainSize.maxVal();
-          vNormalizedDomainSize /= maxVal;
-
-          bmd.extents  = FLOATVECTOR3(GetEffectiveBrickSize(k)) *
-            FLOATVECTOR3(pVolumeDataBlock->GetBrickAspect(coords)) / maxVal;
-          bmd.center   = FLOATVECTOR3(vBrickCorner + bmd.extents/2.0f) -
-                         vNormalizedDomainSize * 0.5f;
-          bmd.n_voxels = UINTVECTOR3(pVolumeDataBlock->GetBrickSize(coords));
-          AddBrick(k, bmd);
-          vBrickCorner.z += bmd.extents.z;
-        }
-        vBrickCorner.y += bmd.extents.y;
-      }
-      vBrickCorner.x += bmd.extents.x;
-    }
+    const FLOATVECTOR3 vAspect(
+      pVolumeDataBlock->GetBrickAspect(UINT64VECTOR4(0,0,0,j)));
+    FLOATVECTOR3 vNormalizedDomainSize =
+      FLOATVECTOR3(GetDomainSize(j, timestep)) * vAspect;
+    const float maxVal = vNormalizedDomainSize.maxVal();
+    vNormalizedDomainSize /= maxVal;
+
+    BrickTable::Grid grid;
+    grid.iTimestep   = timestep;
+    grid.iLOD        = j;
+    grid.vDomainSize = GetDomainSize(j, timestep);
+    grid.vBrickCount = pVolumeDataBlock->GetBrickCount(j);
+    grid.vCore       = vCore;
+    grid.iOverlap    = iOverlap;
+    grid.vVoxelSize  = vAspect / maxVal;
+    grid.vOrigin     = vNormalizedDomainSize * -0.5f;
+    AddBrickGrid(grid);
   }
   m_aMaxBrickSize = pVolumeDataBlock->GetMaxBrickSize();
 }
@@ -622,6 +610,100 @@ uint64_t UVFDataset::GetNumberOfTimesteps() const {
   return m_timesteps.size();
 }
 
+void UVFDataset::SetTimestepPrefetch(size_t iLookahead, uint64_t iMemBudget) {
+  m_pPrefetcher.reset();
+  if(iLookahead == 0 || iMemBudget == 0) { return; }
+  if(!m_bToCBlock) {
+    WARNING("Timestep prefetching needs a UVF file with a TOC block; "
+            "reconvert the dataset to use it.");
+    return;
+  }
+  if(m_timesteps.size() < 2) { return; }
+
+  MESSAGE("Prefetching %u timestep(s) ahead, using up to %llu MB.",
+          static_cast<unsigned>(iLookahead), iMemBudget/(1024*1024));
+  const UVFDataset* self = this;
+  m_pPrefetcher.reset(new TimestepPrefetcher(
+    [self](const BrickKey& k, std::vector<uint8_t>& data) -> bool {
+      try {
+        return self->ReadTOCBrick(k, data);
+      } catch(const std::exception&) {
+        return false;
+      }
+    },
+    m_timesteps.size(), iLookahead, iMemBudget
+  ));
+}
+
+void UVFDataset::SetPlaybackTimestep(size_t ts) {
+  if(m_pPrefetcher) { m_pPrefetcher->SetTimestep(ts); }
+}
+
+void UVFDataset::SetDiskCache(const std::string& strDir, uint64_t iMaxBytes) {
+  // the prefetcher reads through the cache; keep it from doing so meanwhile.
+  SCOPEDLOCK(m_BrickReadGuard);
+  m_pDiskCache.reset();
+  if(strDir.empty() || iMaxBytes == 0 || m_timesteps.empty()) { return; }
+  if(!m_bToCBlock) {
+    MESSAGE("Not using a disk brick cache: raw bricks are read as fast as "
+            "the cache could deliver them.");
+    return;
+  }
+
+  const TOCBlock* toc = static_cast<TOCTimestep*>(m_timesteps[0])->GetDB();
+  if(toc->GetBrickInfo(UINT64VECTOR4(0,0,0,0)).m_eCompression == CT_NONE) {
+    MESSAGE("Not using a disk brick cache: %s is not compressed.",
+            m_strFilename.c_str());
+    return;
+  }
+
+  const UINTVECTOR3 vMaxBrick = toc->GetMaxBrickSize();
+  const uint64_t iSlotBytes = uint64_t(vMaxBrick.volume()) *
+                              toc->GetComponentTypeSize() *
+                              toc->GetComponentCount();
+  // the same file bricked differently gives other bricks for the same keys.
+  std::ostringstream variant;
+  variant << vMaxBrick.x << "x" << vMaxBrick.y << "x" << vMaxBrick.z << "-"
+          << toc->GetComponentTypeSize() << "x" << toc->GetComponentCount()
+          << "-" << m_timesteps.size();
+  m_pDiskCache.reset(new DiskBrickCache(strDir, m_strFilename, variant.str(),
+                                        iMaxBytes, iSlotBytes));
+  if(!m_pDiskCache->IsOpen()) {
+    WARNING("Could not create a disk brick cache in %s.", strDir.c_str());
+    m_pDiskCache.reset();
+  }
+}
+
+void UVFDataset::SetSharedCache(const std::string& strName,
+                                uint64_t iMaxBytes) {
+  SCOPEDLOCK(m_BrickReadGuard);
+  m_pSharedCache.reset();
+  if(strName.empty() || iMaxBytes == 0 || m_timesteps.empty()) { return; }
+  if(!m_bToCBlock) {
+    WARNING("The shared brick cache needs a UVF file with a TOC block; "
+            "reconvert the dataset to use it.");
+    return;
+  }
+
+  const TOCBlock* toc = static_cast<TOCTimestep*>(m_timesteps[0])->GetDB();
+  const UINTVECTOR3 vMaxBrick = toc->GetMaxBrickSize();
+  const uint64_t iSlotBytes = uint64_t(vMaxBrick.volume()) *
+                              toc->GetComponentTypeSize() *
+                              toc->GetComponentCount();
+  std::ostringstream variant;
+  variant << vMaxBrick.x << "x" << vMaxBrick.y << "x" << vMaxBrick.z << "-"
+          << toc->GetComponentTypeSize() << "x" << toc->GetComponentCount()
+          << "-" << m_timesteps.size();
+  m_pSharedCache.reset(new SharedBrickCache(strName, m_strFilename,
+                                            variant.str(), iMaxBytes,
+                                            iSlotBytes));
+  if(!m_pSharedCache->IsOpen()) {
+    WARNING("Could not attach to the shared brick cache %s.",
+            strName.c_str());
+    m_pSharedCache.reset();
+  }
+}
+
 float UVFDataset::MaxGradientMagnitude() const
 {
   float mx = -std::numeric_limits<float>::max();
@@ -943,6 +1025,27 @@ bool UVFDataset::ApplyFunction(uint64_t iLODLevel,
   }
 }
 
+bool UVFDataset::ParallelApplyFunction(uint64_t iLODLevel,
+                                       const ParallelBrickFunc& brickFunc,
+                                       size_t iThreads,
+                                       uint64_t iOverlap) const {
+  // raster data blocks read their bricks one at a time
+  if (!m_bToCBlock) {
+    return Dataset::ParallelApplyFunction(iLODLevel, brickFunc, iThreads,
+                                          iOverlap);
+  }
+
+  bool okay = true;
+  for(std::vector<Timestep*>::const_iterator ts = m_timesteps.begin();
+    ts != m_timesteps.end(); ++ts) {
+    const TOCTimestep* toc_ts = static_cast<TOCTimestep*>(*ts);
+    okay &= toc_ts->GetDB()->ParallelApplyFunction(
+              iLODLevel, brickFunc, iThreads, uint32_t(iOverlap)
+            );
+  }
+  return okay;
+}
+
 // BrickKey's index is 1D. For UVF's RDB, we've got a 3D index.  When
 // we create the brick index to satisfy the interface, we do so in a
 // reversible way.  This methods reverses the 1D into into UVF's 3D
@@ -1473,15 +1576,92 @@ bool UVFDataset::AppendMesh(std::shared_ptr<const Mesh> meshIn) {
 
 
 
+bool UVFDataset::CropBricks(const PLANE<float>& scaleInvariantPlane,
+                            const std::string& strTempDir, bool bKeepOldData)
+{
+  string strBackupFilename;
+  if (bKeepOldData) {
+    strBackupFilename = SysTools::AppendFilename(Filename(),"-beforeCropping");
+    if (SysTools::FileExists(strBackupFilename)) {
+      strBackupFilename = SysTools::FindNextSequenceName(strBackupFilename);
+    }
+    MESSAGE("Keeping the original data as %s", strBackupFilename.c_str());
+    if (!LargeRAWFile::Copy(Filename(), strBackupFilename)) {
+      WARNING("Unable to copy the original data.");
+      remove(strBackupFilename.c_str());
+      return false;
+    }
+  }
+
+  Close();
+  try {
+    Open(false,true,false);
+  } catch(const Exception&) {
+    WARNING("Read/write mode failed, maybe file is write protected?");
+    Open(false,false,false);
+    if (bKeepOldData) remove(strBackupFilename.c_str());
+    return false;
+  }
+
+  // the n-th max/min block belongs to the n-th timestep
+  vector<size_t> vMaxMinBlocks;
+  for (size_t i = 0; i < m_pDatasetFile->GetDataBlockCount(); ++i) {
+    if (m_pDatasetFile->GetDataBlock(i)->GetBlockSemantic() ==
+        UVFTables::BS_MAXMIN_VALUES) {
+      vMaxMinBlocks.push_back(i);
+    }
+  }
+
+  // stage the cropped bricks of every timestep before any of them is
+  // written, a timestep that does not fit must not leave the others cropped
+  vector<TOCBlock*> vTOCBlocks(m_timesteps.size(), NULL);
+  vector<std::shared_ptr<ExtendedOctreeConverter::CropPlan>> vPlans;
+  bool bCroppingOK = true;
+  for (size_t tsi=0; tsi < m_timesteps.size() && bCroppingOK; ++tsi) {
+    MESSAGE("Cropping bricks of timestep %u",
+            static_cast<unsigned>(tsi));
+    vTOCBlocks[tsi] =
+      static_cast<TOCBlock*>(
+        m_pDatasetFile->GetDataBlockRW(m_timesteps[tsi]->block_number, true)
+      );
+    vPlans.push_back(std::make_shared<ExtendedOctreeConverter::CropPlan>());
+    const string strStageFilename = SysTools::FindNextSequenceName(
+      strTempDir + "crop-tmp.stage"
+    );
+    bCroppingOK = vTOCBlocks[tsi]->PrepareCrop(scaleInvariantPlane,
+                                               strStageFilename,
+                                               *vPlans.back());
+  }
+  if (!bCroppingOK) {
+    WARNING("The cropped bricks do not fit into the file.");
+  }
+
+  for (size_t tsi=0; tsi < m_timesteps.size() && bCroppingOK; ++tsi) {
+    MaxMinDataBlock* maxmin = NULL;
+    if (tsi < vMaxMinBlocks.size()) {
+      maxmin = static_cast<MaxMinDataBlock*>(
+        m_pDatasetFile->GetDataBlockRW(vMaxMinBlocks[tsi], false)
+      );
+    }
+    bCroppingOK = vTOCBlocks[tsi]->CommitCrop(*vPlans[tsi], maxmin);
+  }
+  vPlans.clear();
+
+  MESSAGE("Writing changes to disk");
+  Close();
+
+  if (!bCroppingOK && bKeepOldData) {
+    // an I/O error may have left some timesteps cropped already
+    remove(Filename().c_str());
+    rename(strBackupFilename.c_str(), Filename().c_str());
+  }
+  Open(false,false,false);
+  return bCroppingOK;
+}
+
 bool UVFDataset::Crop(const PLANE<float>& plane, const std::string& strTempDir,
                       bool bKeepOldData, bool bUseMedianFilter, bool bClampToEdge)
 {
-  MESSAGE("Flattening dataset");
-  string strTempRawFilename = SysTools::FindNextSequenceName(
-    strTempDir + "crop-tmp.raw"
-  );
-  Export(0, strTempRawFilename , false);
-
   MESSAGE("Cropping at plane (%g %g %g %g)", plane.x, plane.y, plane.z,
                                              plane.w);
   FLOATMATRIX4 m;
@@ -1490,6 +1670,21 @@ bool UVFDataset::Crop(const PLANE<float>& plane, const std::string& strTempDir,
   PLANE<float> scaleInvariantPlane = plane;
   scaleInvariantPlane.transformIT(m);
 
+  // only the bricks the plane touches need to be rewritten; this fails if
+  // the rewritten bricks do not fit into the space of the old ones
+  if (m_bToCBlock) {
+    if (CropBricks(scaleInvariantPlane, strTempDir, bKeepOldData)) {
+      return true;
+    }
+    MESSAGE("Cropping in-place failed, rebuilding the dataset instead");
+  }
+
+  MESSAGE("Flattening dataset");
+  string strTempRawFilename = SysTools::FindNextSequenceName(
+    strTempDir + "crop-tmp.raw"
+  );
+  Export(0, strTempRawFilename , false);
+
   TempFile dataFile(strTempRawFilename);
   if (!dataFile.Open(true)) {
     T_ERROR("Unable to open flattened data.");
@@ -1688,33 +1883,89 @@ std::list<std::string> UVFDataset::Extensions() const
   return retval;
 }
 
+template <class T> bool
+UVFDataset::ReadTOCBrick(const BrickKey& k, std::vector<T>& vData) const
+{
+  const UINT64VECTOR4 coords = KeyToTOCVector(k);
+  const TOCTimestep* ts = static_cast<TOCTimestep*>(
+    m_timesteps[std::get<0>(k)]
+  );
+  const size_t targetSize = size_t(
+    ts->GetDB()->GetComponentTypeSize() *
+    ts->GetDB()->GetComponentCount() *
+    ts->GetDB()->GetBrickSize(coords).volume()
+  ) / sizeof(T);
+  vData.resize(targetSize);
+  uint8_t* pData = (uint8_t*)&vData[0];
+  const size_t iBytes = targetSize * sizeof(T);
+
+  std::shared_ptr<SharedBrickCache> shared;
+  {
+    SCOPEDLOCK(m_BrickReadGuard);
+    shared = m_pSharedCache;
+  }
+  if(shared) {
+    // one process decodes the brick into shared memory, the others wait for
+    // it; all copy it out of there.
+    const UVFDataset* self = this;
+    std::shared_ptr<const void> pinned = shared->AcquireOrLoad(k, iBytes,
+      [self, &k, iBytes](void* pSlot) {
+        return self->DecodeTOCBrick(k, static_cast<uint8_t*>(pSlot), iBytes);
+      });
+    if(pinned) {
+      std::memcpy(pData, pinned.get(), iBytes);
+      return true;
+    }
+  }
+  return DecodeTOCBrick(k, pData, iBytes);
+}
+
+bool UVFDataset::DecodeTOCBrick(const BrickKey& k, uint8_t* pData,
+                                size_t iBytes) const
+{
+  const UINT64VECTOR4 coords = KeyToTOCVector(k);
+  const TOCTimestep* ts = static_cast<TOCTimestep*>(
+    m_timesteps[std::get<0>(k)]
+  );
+  {
+    SCOPEDLOCK(m_BrickReadGuard);
+    if(m_pDiskCache && m_pDiskCache->Lookup(k, pData, iBytes)) {
+      return true;
+    }
+  }
+  ts->GetDB()->GetData(pData,coords);
+  if(ts->GetDB()->GetAtlasSize(coords).area() != 0) {
+    VolumeTools::DeAtalasify(iBytes, ts->GetDB()->GetAtlasSize(coords),
+                             ts->GetDB()->GetMaxBrickSize(),
+                             ts->GetDB()->GetBrickSize(coords), pData,
+                             pData);
+  }
+  {
+    SCOPEDLOCK(m_BrickReadGuard);
+    if(m_pDiskCache) { m_pDiskCache->Store(k, pData, iBytes); }
+  }
+  return true;
+}
+
 template <class T> bool
 UVFDataset::GetBrickTemplate(const BrickKey& k, std::vector<T>& vData) const
 {
   if(m_bToCBlock) {
-    const UINT64VECTOR4 coords = KeyToTOCVector(k);
-    const TOCTimestep* ts = static_cast<TOCTimestep*>(
-      m_timesteps[std::get<0>(k)]
-    );
-    const size_t targetSize = size_t(
-      ts->GetDB()->GetComponentTypeSize() *
-      ts->GetDB()->GetComponentCount() *
-      ts->GetDB()->GetBrickSize(coords).volume()
-    ) / sizeof(T);
-    vData.resize(targetSize);
-    uint8_t* pData = (uint8_t*)&vData[0];
-    ts->GetDB()->GetData(pData,coords);
-    if(ts->GetDB()->GetAtlasSize(coords).area() != 0) {
-      VolumeTools::DeAtalasify(targetSize, ts->GetDB()->GetAtlasSize(coords),
-                               ts->GetDB()->GetMaxBrickSize(),
-                               ts->GetDB()->GetBrickSize(coords), pData,
-                               pData);
+    std::vector<uint8_t> prefetched;
+    if(m_pPrefetcher && m_pPrefetcher->Take(k, prefetched)) {
+      vData.resize(prefetched.size() / sizeof(T));
+      if(!prefetched.empty()) {
+        std::memcpy(&vData[0], &prefetched[0], prefetched.size());
+      }
+      return true;
     }
-    return true;
+    return ReadTOCBrick(k, vData);
   } else {
-    const NDBrickKey& key = this->IndexToVectorKey(k);
-    const RDTimestep* ts = static_cast<RDTimestep*>(m_timesteps[key.timestep]);
-    return ts->GetDB()->GetData(vData, key.lod, key.brick);
+    // we only support a single LOD group, so the LOD is the block's LOD
+    // index, and our linear brick index serializes bricks the way the block
+    // does.
+    const RDTimestep* ts = static_cast<RDTimestep*>(m_timesteps[std::get<0>(k)]);
+    return ts->GetDB()->GetData(vData, std::get<1>(k), std::get<2>(k));
   }
 }
 
@@ -29,14 +29,19 @@
 #ifndef TUVOK_UVF_DATASET_H
 #define TUVOK_UVF_DATASET_H
 
+#include <memory>
 #include <vector>
 #include "Basics/MinMaxBlock.h"
+#include "Basics/Threads.h"
 #include "Controller/Controller.h"
 #include "UVF/RasterDataBlock.h"
 #include "UVF/MaxMinDataBlock.h"
 #include "AbstrConverter.h"
 #include "FileBackedDataset.h"
 #include "LinearIndexDataset.h"
+#include "DiskBrickCache.h"
+#include "SharedBrickCache.h"
+#include "TimestepPrefetcher.h"
 
 /// For UVF, a brick key has to be a list for the LOD indicators and a
 /// list of brick indices for the brick itself.
@@ -137,6 +142,11 @@ public:
   ///@}
   virtual uint64_t GetNumberOfTimesteps() const;
 
+  virtual void SetTimestepPrefetch(size_t iLookahead, uint64_t iMemBudget);
+  virtual void SetPlaybackTimestep(size_t ts);
+  virtual void SetDiskCache(const std::string& strDir, uint64_t iMaxBytes);
+  virtual void SetSharedCache(const std::string& strName, uint64_t iMaxBytes);
+
   UINTVECTOR3 GetBrickLayout(size_t lod, size_t ts) const;
 
   // Global Data
@@ -166,6 +176,10 @@ public:
                                           void* pUserContext),
                         void *pUserContext= NULL,
                         uint64_t iOverlap=0) const;
+  virtual bool ParallelApplyFunction(uint64_t iLODLevel,
+                                     const ParallelBrickFunc& brickFunc,
+                                     size_t iThreads,
+                                     uint64_t iOverlap) const;
 
   virtual const std::vector<std::pair<std::string, std::string>> GetMetadata() const;
 
@@ -223,8 +237,20 @@ private:
   bool VerifyRasterDataBlock(const RasterDataBlock*) const;
   bool VerifyTOCBlock(const TOCBlock* tb) const;
 
+  /// Crops all timesteps of a TOC based file in-place, rewriting only the
+  /// bricks the plane cuts through or removes.
+  /// @returns false if the dataset needs to be rebuilt; unless the old data
+  /// is kept, earlier timesteps may have been cropped already.
+  bool CropBricks(const PLANE<float>& scaleInvariantPlane,
+                  const std::string& strTempDir, bool bKeepOldData);
+
   template <class T> bool GetBrickTemplate(const BrickKey& k,
                                            std::vector<T>& vData) const;
+  template <class T> bool ReadTOCBrick(const BrickKey& k,
+                                       std::vector<T>& vData) const;
+  /// reads the brick, through the disk cache, into 'iBytes' at 'pData'.
+  bool DecodeTOCBrick(const BrickKey& k, uint8_t* pData,
+                      size_t iBytes) const;
 
 private:
   bool                                  m_bToCBlock;
@@ -240,6 +266,17 @@ private:
 
   uint64_t                              m_iMaxAcceptableBricksize;
 
+  /// guards the brick caches against being replaced while the prefetch
+  /// thread reads through them; the file reads themselves are positional and
+  /// need no lock.
+  mutable CriticalSection               m_BrickReadGuard;
+  std::unique_ptr<TimestepPrefetcher>   m_pPrefetcher;
+  /// decoded bricks of compressed datasets; NULL if disabled.
+  std::unique_ptr<DiskBrickCache>       m_pDiskCache;
+  /// decoded bricks shared with other processes; NULL if disabled.  Readers
+  /// hold a reference while they load a brick into it.
+  std::shared_ptr<SharedBrickCache>     m_pSharedCache;
+
   FLOATVECTOR3 GetVolCoord(uint64_t pos, const UINT64VECTOR3& domSize) {
     UINT64VECTOR3 domCoords;
 
@@ -42,6 +42,7 @@
 using namespace std;
 
 #define DEFAULT_UNDOREDO_BUFFER_SIZE  (50)
+#define DEFAULT_UNDOREDO_MEMORY_BUDGET  (0)
 #define DEFAULT_PROVENANCE_BUFFER_SIZE  (150)
 
 namespace tuvok
@@ -60,6 +61,11 @@ LuaProvenance::LuaProvenance(LuaScripting* scripting)
 , mProvenanceDescLogEnabled(false)  // Disable the provenance log (performance)
 , mUndoRedoProvenanceDisable(false)
 , mCommandDepth(0)
+, mMemoryBudget(DEFAULT_UNDOREDO_MEMORY_BUDGET)
+, mUndoRedoMemory(0)
+, mSpillFile()
+, mCoalesce(false)
+, mCoalesceCandidate(false)
 {
   mUndoRedoStack.reserve(DEFAULT_PROVENANCE_BUFFER_SIZE);
   mProvenanceDescList.reserve(DEFAULT_PROVENANCE_BUFFER_SIZE);
@@ -127,6 +133,28 @@ void LuaProvenance::registerLuaProvenanceFunctions()
                               "Prints the entire provenance record "
                               "to 'log.info'.",
                               false);
+  mMemberReg.registerFunction(this, &LuaProvenance::setMemoryBudget,
+                              "provenance.setMemoryBudget",
+                              "Bounds the memory of the undo/redo stack, in "
+                              "bytes (def: 0, unbounded). Drops the oldest "
+                              "undo steps once exceeded.",
+                              false);
+  mMemberReg.registerFunction(this, &LuaProvenance::getMemoryUsed,
+                              "provenance.getMemoryUsed",
+                              "Estimated memory of the undo/redo stack, in "
+                              "bytes. Only tracked with a memory budget.",
+                              false);
+  mMemberReg.registerFunction(this, &LuaProvenance::enableCoalescing,
+                              "provenance.enableCoalescing",
+                              "Enables/Disables merging consecutive calls to "
+                              "the same function into one undo step "
+                              "(def: false).",
+                              false);
+  mMemberReg.registerFunction(this, &LuaProvenance::setSpillFile,
+                              "provenance.setSpillFile",
+                              "Appends undo steps dropped due to the memory "
+                              "budget to the given file.",
+                              false);
   // Reentry exception does not need to be stack exempt.
 }
 
@@ -284,10 +312,26 @@ void LuaProvenance::logExecution(const string& fname,
     lua_pop(L, numParams);
   }
 
+  const uint64_t memory = estimateMemory(fname, funParams);
   if (mCommandDepth == 0)
   {
-    mUndoRedoStack.push_back(UndoRedoItem(fname, emptyParams, funParams));
-    ++mStackPointer;
+    if (canCoalesce(fname))
+    {
+      // Keep the undo parameters of the first call, redo to the latest.
+      UndoRedoItem& top = mUndoRedoStack.back();
+      top.redoParams = funParams;
+      mUndoRedoMemory = mUndoRedoMemory - top.memory + memory;
+      top.memory = memory;
+    }
+    else
+    {
+      mUndoRedoStack.push_back(UndoRedoItem(fname, emptyParams, funParams));
+      mUndoRedoStack.back().memory = memory;
+      mUndoRedoMemory += memory;
+      ++mStackPointer;
+    }
+    mCoalesceCandidate = true;
+    enforceMemoryBudget();
   }
   else
   {
@@ -296,6 +340,8 @@ void LuaProvenance::logExecution(const string& fname,
     // entry on the top of the stack because our depth is greater than 0).
     mUndoRedoStack.back().addChildItem(
         UndoRedoItem(fname, emptyParams, funParams));
+    mUndoRedoStack.back().memory += memory;
+    mUndoRedoMemory += memory;
   }
 
   // Repopulate the lastExec table to most recently executed function parameters
@@ -318,6 +364,123 @@ void LuaProvenance::logExecution(const string& fname,
   mLoggingProvenance = false;
 }
 
+//-----------------------------------------------------------------------------
+uint64_t LuaProvenance::estimateMemory(const string& fname,
+                                       shared_ptr<LuaCFunAbstract> params) const
+{
+  if (mMemoryBudget == 0)
+    return 0;
+
+  // The formatted parameters grow with the parameters (e.g. with the size of
+  // a vector), which is what we are after. Undo and redo parameters are of
+  // the same type, hence twice.
+  return sizeof(UndoRedoItem) + fname.size()
+      + 2 * params->getFormattedParameterValues().size();
+}
+
+//-----------------------------------------------------------------------------
+bool LuaProvenance::canCoalesce(const string& fname) const
+{
+  if (mCoalesce == false || mCoalesceCandidate == false
+      || mUndoRedoStack.empty())
+    return false;
+
+  // Items which grouped or created/deleted instances must stay as they are.
+  const UndoRedoItem& top = mUndoRedoStack.back();
+  return top.function == fname
+      && top.childItems.get() == NULL
+      && top.instCreations.get() == NULL
+      && top.instDeletions.get() == NULL
+      && top.alsoRedoChildren == false;
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::enforceMemoryBudget()
+{
+  if (mMemoryBudget == 0)
+    return;
+
+  // Always keep the most recent step, and never drop redo steps.
+  URStackType::size_type numDropped = 0;
+  while (mUndoRedoMemory > mMemoryBudget
+         && numDropped + 1 < mUndoRedoStack.size()
+         && numDropped < static_cast<URStackType::size_type>(mStackPointer))
+  {
+    mUndoRedoMemory -= mUndoRedoStack[numDropped].memory;
+    ++numDropped;
+  }
+  if (numDropped == 0)
+    return;
+
+  if (!mSpillFile.empty())
+  {
+    ofstream f(mSpillFile.c_str(), ios::app);
+    for (URStackType::size_type i = 0; i < numDropped; ++i)
+    {
+      const UndoRedoItem& item = mUndoRedoStack[i];
+      f << item.function << "("
+        << item.redoParams->getFormattedParameterValues() << ") -- "
+        << item.function << "("
+        << item.undoParams->getFormattedParameterValues() << ")" << endl;
+      if (item.childItems.get() != NULL)
+      {
+        for (vector<UndoRedoItem>::const_iterator it = item.childItems->begin();
+             it != item.childItems->end(); ++it)
+        {
+          f << "  " << it->function << "("
+            << it->redoParams->getFormattedParameterValues() << ")" << endl;
+        }
+      }
+    }
+  }
+
+  mUndoRedoStack.erase(mUndoRedoStack.begin(),
+                       mUndoRedoStack.begin() + numDropped);
+  mStackPointer -= static_cast<int>(numDropped);
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::setMemoryBudget(uint64_t bytes)
+{
+  // Items logged without a budget carry no estimate; estimate them now.
+  if (mMemoryBudget == 0 && bytes != 0)
+  {
+    mMemoryBudget = bytes;
+    mUndoRedoMemory = 0;
+    for (URStackType::iterator it = mUndoRedoStack.begin();
+         it != mUndoRedoStack.end(); ++it)
+    {
+      it->memory = estimateMemory(it->function, it->redoParams);
+      if (it->childItems.get() != NULL)
+      {
+        for (vector<UndoRedoItem>::const_iterator c = it->childItems->begin();
+             c != it->childItems->end(); ++c)
+        {
+          it->memory += estimateMemory(c->function, c->redoParams);
+        }
+      }
+      mUndoRedoMemory += it->memory;
+    }
+  }
+  mMemoryBudget = bytes;
+  if (mMemoryBudget == 0)
+    mUndoRedoMemory = 0;
+
+  enforceMemoryBudget();
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::enableCoalescing(bool enable)
+{
+  mCoalesce = enable;
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::setSpillFile(const std::string& file)
+{
+  mSpillFile = file;
+}
+
 //-----------------------------------------------------------------------------
 int LuaProvenance::bruteRerollDetermineUndos(int undoIndex)
 {
@@ -397,6 +560,9 @@ void LuaProvenance::issueUndo()
   if (mEnabled == false)
     return;
 
+  // The next call starts a new undo step.
+  mCoalesceCandidate = false;
+
   // If mStackPointer is at 1, then we can undo to the 'default' state.
   if (mStackPointer == 0)
   {
@@ -503,6 +669,8 @@ void LuaProvenance::issueRedo()
   if (mEnabled == false)
     return;
 
+  mCoalesceCandidate = false;
+
   if (static_cast<URStackType::size_type>(mStackPointer) ==
       mUndoRedoStack.size())
   {
@@ -709,6 +877,8 @@ void LuaProvenance::clearProvenance()
 {
   mUndoRedoStack.clear();
   mStackPointer = 0;
+  mUndoRedoMemory = 0;
+  mCoalesceCandidate = false;
 
   // Clear out last exec for ALL functions. This will clean up any dangling
   // shared pointers.
@@ -1239,6 +1409,53 @@ SUITE(LuaProvenanceTests)
     CHECK_EQUAL(0, i1);
   }
 
+  TEST(ProvenanceCoalesceAndBudget)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    sc->registerFunction(&set_i1, "set_i1", "", true);
+    sc->registerFunction(&set_b1, "set_b1", "", true);
+    i1 = 0;
+    b1 = false;
+
+    sc->exec("provenance.enableCoalescing(true)");
+    sc->exec("set_i1(1)");
+    sc->exec("set_i1(2)");
+    sc->exec("set_i1(3)");
+    sc->exec("set_b1(true)");
+    sc->exec("set_i1(4)");
+    CHECK_EQUAL(4, i1);
+
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(3, i1);
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(false, b1);
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(0, i1);
+    sc->exec("provenance.redo()");
+    CHECK_EQUAL(3, i1);
+
+    // Calls after an undo or redo start a new undo step.
+    sc->exec("set_i1(5)");
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(3, i1);
+
+    // With a tiny budget, only the most recent step is kept.
+    sc->exec("provenance.enableCoalescing(false)");
+    sc->exec("provenance.setMemoryBudget(1)");
+    sc->exec("set_i1(6)");
+    sc->exec("set_i1(7)");
+    CHECK(sc->execRet<uint64_t>("provenance.getMemoryUsed()") > 0);
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(6, i1);
+
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(sc->exec("provenance.undo()"), LuaProvenanceInvalidUndo);
+    sc->setExpectedExceptionFlag(false);
+  }
+
   LuaScripting* sc = NULL;
 
   static void set_i1_s1_b1(int a, string b, bool c)
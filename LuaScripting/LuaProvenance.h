@@ -42,9 +42,6 @@ namespace tuvok
 
 class LuaScripting;
 
-// TODO: Implement MAX size for undo / redo buffer. Think circular buffer, or
-//       just std::vector::erase for simplicity.
-
 class LuaProvenance
 {
 public:
@@ -113,6 +110,23 @@ public:
   /// Retrieve command depth.
   int getCommandDepth()   {return mCommandDepth;}
 
+  /// Bounds the memory held by the undo/redo stack. Once the budget is
+  /// exceeded, the oldest undo steps are dropped. 0 (the default) disables
+  /// the bound, and the cost of estimating the memory of each step.
+  void setMemoryBudget(uint64_t bytes);
+
+  /// Estimated memory held by the undo/redo stack, in bytes. Only tracked
+  /// while a memory budget is set.
+  uint64_t getMemoryUsed() const {return mUndoRedoMemory;}
+
+  /// If enabled, consecutive calls to the same function are coalesced into
+  /// a single undo step, e.g. all updates of one slider drag.
+  void enableCoalescing(bool enable);
+
+  /// Undo steps dropped due to the memory budget are appended to this file,
+  /// as text. An empty file name (the default) discards them.
+  void setSpillFile(const std::string& file);
+
   /// Testing function to check if the last undo/redo item contains the list
   /// of deleted items.
   /// Returns true if all of the deleted items are present.
@@ -158,7 +172,7 @@ private:
                  std::shared_ptr<LuaCFunAbstract> undo,
                  std::shared_ptr<LuaCFunAbstract> redo)
     : function(funName), undoParams(undo), redoParams(redo), childItems()
-    , instCreations(), instDeletions(), alsoRedoChildren(false)
+    , instCreations(), instDeletions(), alsoRedoChildren(false), memory(0)
     {}
 
     /// Function name we operate on at this stack index.
@@ -235,6 +249,10 @@ private:
     /// item must be explicitly called by the redo mechanism. This is only
     /// used to group command together.
     bool alsoRedoChildren;
+
+    /// Estimated memory of this item and its children. 0 if no memory budget
+    /// was set when the item was logged.
+    uint64_t memory;
   };
 
   typedef std::vector<UndoRedoItem> URStackType;
@@ -252,6 +270,18 @@ private:
   void printRedoStack();
 
   std::vector<std::string> getFullProvenanceDesc();
+
+  /// Rough estimate of the memory an undo/redo item for a call to 'fname'
+  /// with 'params' holds.
+  uint64_t estimateMemory(const std::string& fname,
+                          std::shared_ptr<LuaCFunAbstract> params) const;
+
+  /// Returns true if a call to 'fname' can be merged into the undo step on
+  /// the top of the stack.
+  bool canCoalesce(const std::string& fname) const;
+
+  /// Drops the oldest undo steps until the memory budget is met.
+  void enforceMemoryBudget();
   void printProvRecord();
   void printProvRecordToFile(const std::string& file);
 
@@ -286,6 +316,15 @@ private:
   /// and the undo/redo buffer. The calls deeper than the first command are
   /// still logged into the provenance logging system for debugging purposes.
   int                       mCommandDepth;
+
+  uint64_t                  mMemoryBudget;    ///< 0 if unbounded.
+  uint64_t                  mUndoRedoMemory;  ///< Sum of UndoRedoItem::memory.
+  std::string               mSpillFile;
+
+  bool                      mCoalesce;
+  /// True while the top of the undo stack is the last call we logged, i.e.
+  /// neither undo nor redo happened since.
+  bool                      mCoalesceCandidate;
 };
 
 }
@@ -40,6 +40,7 @@
 
 #include "StdTuvokDefines.h"
 #include <sstream>
+#include <chrono>
 #include <cstring>
 #include <functional>
 #include <iostream>
@@ -792,6 +793,7 @@ void LuaScripting::enableProvenance(bool enable)
 void LuaScripting::unregisterAllFunctions()
 {
   LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
+  invalidateFunctionHandles();
   for (vector<string>::const_iterator it = mRegisteredGlobals.begin();
        it != mRegisteredGlobals.end(); ++it)
   {
@@ -1430,6 +1432,8 @@ std::string LuaScripting::getCmdPath(std::string fqName)
 void LuaScripting::bindClosureTableWithFQName(const string& fqName,
                                               int tableIndex)
 {
+  invalidateFunctionHandles();
+
   LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
 
   // Tokenize the fully qualified name.
@@ -1858,6 +1862,8 @@ bool LuaScripting::getFunctionTable(const std::string& fqName)
 //-----------------------------------------------------------------------------
 void LuaScripting::unregisterFunction(const std::string& fqName)
 {
+  invalidateFunctionHandles();
+
   // Lookup the function table based on the fully qualified name.
   int baseStackIndex = lua_gettop(mL);
 
@@ -2205,6 +2211,34 @@ void LuaScripting::prepForExecution(const std::string& fqName)
     throw LuaNonExistantFunction(nf.str(), _func_, __LINE__);
   }
 
+  prepTableForExecution();
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::prepForExecution(const LuaFunctionHandle& fn)
+{
+  if (fn.mSlot < 0 ||
+      static_cast<size_t>(fn.mSlot) >= mFunctionHandleRefs.size())
+    throw LuaError("Invalid function handle.");
+
+  int& ref = mFunctionHandleRefs[fn.mSlot];
+  if (ref == LUA_NOREF)
+  {
+    if (getFunctionTable(fn.fqName()) == false) {
+      std::ostringstream nf;
+      nf << "Could not find '" << fn.fqName() << "' function.";
+      throw LuaNonExistantFunction(nf.str(), _func_, __LINE__);
+    }
+    ref = luaL_ref(mL, LUA_REGISTRYINDEX); // Pops the function table.
+  }
+  lua_rawgeti(mL, LUA_REGISTRYINDEX, ref);
+
+  prepTableForExecution();
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::prepTableForExecution()
+{
   if (lua_getmetatable(mL, -1) == 0)
     throw LuaError("Unable to find function metatable.");
   lua_getfield(mL, -1, "__call");
@@ -2246,6 +2280,60 @@ void LuaScripting::cexec(const std::string& cmd)
   executeFunctionOnStack(0, 0);
 }
 
+//-----------------------------------------------------------------------------
+LuaFunctionHandle LuaScripting::getFunctionHandle(const std::string& fqName)
+{
+  LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
+
+  map<string, int>::const_iterator it = mFunctionHandleSlots.find(fqName);
+  if (it != mFunctionHandleSlots.end())
+    return LuaFunctionHandle(fqName, it->second);
+
+  if (getFunctionTable(fqName) == false) {
+    std::ostringstream nf;
+    nf << "Could not find '" << fqName << "' function.";
+    throw LuaNonExistantFunction(nf.str(), _func_, __LINE__);
+  }
+  int slot = static_cast<int>(mFunctionHandleRefs.size());
+  mFunctionHandleRefs.push_back(luaL_ref(mL, LUA_REGISTRYINDEX));
+  mFunctionHandleSlots[fqName] = slot;
+  return LuaFunctionHandle(fqName, slot);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::invalidateFunctionHandles()
+{
+  for (vector<int>::iterator it = mFunctionHandleRefs.begin();
+       it != mFunctionHandleRefs.end(); ++it)
+  {
+    if (*it != LUA_NOREF)
+    {
+      luaL_unref(mL, LUA_REGISTRYINDEX, *it);
+      *it = LUA_NOREF;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::cexecBatch(const vector<function<void ()>>& calls)
+{
+  beginCommandGroup();
+  try
+  {
+    for (vector<function<void ()>>::const_iterator it = calls.begin();
+         it != calls.end(); ++it)
+    {
+      (*it)();
+    }
+  }
+  catch (...)
+  {
+    endCommandGroup();
+    throw;
+  }
+  endCommandGroup();
+}
+
 //-----------------------------------------------------------------------------
 void LuaScripting::resetFunDefault(int argumentPos, int ftableStackPos)
 {
@@ -2343,6 +2431,7 @@ bool LuaScripting::getClassTable(LuaClassInstance inst)
 void LuaScripting::deleteLuaClassInstance(LuaClassInstance inst)
 {
   LuaStackRAII _a(mL, 0, 0);
+  invalidateFunctionHandles();
 
   if (getFunctionTable(inst.fqName()))
   {
@@ -3429,6 +3518,81 @@ SUITE(TestLuaScriptingSystem)
     CHECK_EQUAL(true, equal(vecB.begin(), vecB.end(), strArray, predString));
   }
 
+  int handleVal = 0;
+  int handleVal2 = 0;
+  void setHandleVal(int a) { handleVal = a; }
+  void setHandleVal2(int a) { handleVal2 = a; }
+
+  TEST(TestFunctionHandles)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    sc->registerFunction(&dfun, "test.dummyFun", "", true);
+    sc->registerFunction(&setHandleVal, "test.setVal", "", true);
+    sc->registerFunction(&setHandleVal2, "test.setVal2", "", true);
+
+    LuaFunctionHandle f = sc->getFunctionHandle("test.dummyFun");
+    CHECK_EQUAL(42, sc->cexecRet<int>(f, 1, 2, 39));
+
+    // Registering functions invalidates the handles, they are resolved again.
+    sc->registerFunction(&dfun, "test.dummyFun2", "", true);
+    CHECK_EQUAL(65, sc->cexecRet<int>(f, 5, 21, 39));
+
+    // A batch is undone as a whole.
+    LuaFunctionHandle set = sc->getFunctionHandle("test.setVal");
+    LuaFunctionHandle set2 = sc->getFunctionHandle("test.setVal2");
+    sc->cexec(set, 1);
+    vector<function<void ()>> calls;
+    calls.push_back([&sc, set]() {sc->cexec(set, 4);});
+    calls.push_back([&sc, set2]() {sc->cexec(set2, 7);});
+    sc->cexecBatch(calls);
+    CHECK_EQUAL(4, handleVal);
+    CHECK_EQUAL(7, handleVal2);
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(1, handleVal);
+    CHECK_EQUAL(0, handleVal2);
+
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(sc->getFunctionHandle("test.noSuchFun"),
+                LuaNonExistantFunction);
+    sc->setExpectedExceptionFlag(false);
+  }
+
+  // This is really a benchmark, not a test per se...
+  TEST(TestFunctionHandleThroughput)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+    sc->registerFunction(&setHandleVal, "p1.p2.p3.setVal", "", true);
+    LuaFunctionHandle f = sc->getFunctionHandle("p1.p2.p3.setVal");
+
+    const int numCalls = 20000;
+    typedef chrono::high_resolution_clock Clock;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < numCalls; ++i)
+      sc->cexec("p1.p2.p3.setVal", i);
+    Clock::time_point byName = Clock::now();
+    for (int i = 0; i < numCalls; ++i)
+      sc->cexec(f, i);
+    Clock::time_point byHandle = Clock::now();
+    vector<function<void ()>> calls;
+    for (int i = 0; i < numCalls; ++i)
+      calls.push_back([&sc, f, i]() {sc->cexec(f, i);});
+    sc->cexecBatch(calls);
+    Clock::time_point batched = Clock::now();
+
+    typedef chrono::duration<double, micro> us;
+    printf("\n %d cexec calls, per call: by name %.2fus, by handle %.2fus, "
+           "batched %.2fus\n", numCalls,
+           us(byName - start).count() / numCalls,
+           us(byHandle - byName).count() / numCalls,
+           us(batched - byHandle).count() / numCalls);
+    CHECK_EQUAL(numCalls - 1, handleVal);
+  }
+
   // More unit tests are spread out amongst the Lua* files.
 
   /// TODO: Add tests for passing shared_ptr's around, and how they work
@@ -42,7 +42,10 @@
 #define TUVOK_LUASCRIPTING_H_
 
 #include <functional>
+#include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 #ifndef LUASCRIPTING_NO_TUVOK
 
@@ -80,6 +83,28 @@ class LuaMemberRegUnsafe;
 class LuaClassConstructor;
 template <class T> class LuaClassRegistration;
 
+/// A function resolved once by LuaScripting::getFunctionHandle. Calling it
+/// through the handle skips the lookup of its fully qualified name.
+/// Handles survive (un)registration of functions: they are resolved again on
+/// their next use. Functions replaced from within Lua code are not noticed.
+class LuaFunctionHandle
+{
+public:
+  LuaFunctionHandle() : mSlot(-1) {}
+
+  const std::string& fqName() const {return mFQName;}
+
+private:
+  friend class LuaScripting;
+  LuaFunctionHandle(const std::string& fqName, int slot)
+  : mFQName(fqName)
+  , mSlot(slot)
+  {}
+
+  std::string mFQName;
+  int         mSlot;    ///< Index into LuaScripting::mFunctionHandleRefs.
+};
+
 /// Usage Note: If you construct any Lua Class instances that retain a
 /// shared_ptr reference to this LuaScripting class, be sure to call
 /// removeAllRegistrations before deleting LuaScripting.
@@ -280,6 +305,30 @@ public:
   TUVOK_LUA_CEXEC_RET_FUNCTIONS
   ///@}
 
+  /// Resolves the function with the given fully qualified name for repeated
+  /// calls through the cexec/cexecRet overloads below.
+  /// Throws LuaNonExistantFunction if there is no such function.
+  LuaFunctionHandle getFunctionHandle(const std::string& fqName);
+
+  /// Same as cexec / cexecRet above, but call a function resolved by
+  /// getFunctionHandle.
+  ///
+  /// Example: LuaFunctionHandle f = getFunctionHandle("myFunc");
+  ///          cexec(f, a, b, c, ...)
+  ///@{
+  template <typename... Args>
+  void cexec(const LuaFunctionHandle& fn, Args... args);
+
+  template <typename T, typename... Args>
+  T cexecRet(const LuaFunctionHandle& fn, Args... args);
+  ///@}
+
+  /// Executes the given calls as one command group, so that a single
+  /// provenance.undo() undoes all of them.
+  ///
+  /// Example: cexecBatch({[&]() {cexec(f, 1);}, [&]() {cexec(g, 2);}})
+  void cexecBatch(const std::vector<std::function<void ()>>& calls);
+
   /// The following functions allow you to specify default parameters to use
   /// for registered functions.
   /// This is so you can specify different undo/redo defaults (such as turning
@@ -495,6 +544,37 @@ private:
 
   /// Prepare function for execution (places function on the top of the stack).
   void prepForExecution(const std::string& fqName);
+  void prepForExecution(const LuaFunctionHandle& fn);
+
+  /// Replaces the function table on the top of the stack with its __call
+  /// function and the table itself (the first parameter of the call).
+  void prepTableForExecution();
+
+  /// Forgets all resolved function handles, they are resolved again on their
+  /// next use. Called whenever functions are registered or unregistered.
+  void invalidateFunctionHandles();
+
+  /// Pushes the parameters of a call through a function handle.
+  ///@{
+  void pushParams() {}
+  template <typename P, typename... Rest>
+  void pushParams(const P& p, const Rest&... rest)
+  {
+    LuaStrictStack<P>::push(mL, p);
+    pushParams(rest...);
+  }
+  ///@}
+
+#ifdef TUVOK_DEBUG_LUA_USE_RTTI_CHECKS
+  /// Checks the parameters of a call through a function handle against the
+  /// signature of the function table on the top of the stack.
+  template <typename... Args>
+  void checkParams(const std::string& name, const Args&... args);
+  void checkParamTypes(const std::string&, int, int) {}
+  template <typename P, typename... Rest>
+  void checkParamTypes(const std::string& name, int ttable, int check_pos,
+                       const P&, const Rest&... rest);
+#endif
 
   /// Execute the function on the top of the stack. Works excatly like lua_call.
   void executeFunctionOnStack(int nparams, int nret);
@@ -703,6 +783,12 @@ private:
 
   bool                              mVerboseMode;
 
+  /// Slots of the resolved function handles, by fully qualified name.
+  std::map<std::string, int>        mFunctionHandleSlots;
+  /// Registry references to the function tables of the handles.
+  /// LUA_NOREF if the function has yet to be resolved (again).
+  std::vector<int>                  mFunctionHandleRefs;
+
   /// These structures were created in order to handle void return types easily
   ///@{
   template <typename FunPtr, typename Ret>
@@ -1017,6 +1103,58 @@ void Tuvok_luaCheckParam(lua_State* L, const std::string& name,
 // Include cexec/cexecRet/setDefaults function bodies
 #include "LuaScriptingExecBody.h"
 
+#ifdef TUVOK_DEBUG_LUA_USE_RTTI_CHECKS
+template <typename... Args>
+void LuaScripting::checkParams(const std::string& name, const Args&... args)
+{
+  int ftable = lua_gettop(mL);
+  lua_getfield(mL, ftable, TBL_MD_NUM_PARAMS);
+  if (lua_tointeger(mL, -1) != static_cast<int>(sizeof...(Args)))
+    throw LuaUnequalNumParams("Unequal params");
+  lua_pop(mL, 1);
+
+  lua_getfield(mL, ftable, LuaScripting::TBL_MD_TYPES_TABLE);
+  checkParamTypes(name, lua_gettop(mL), 0, args...);
+  lua_pop(mL, 1);
+}
+
+template <typename P, typename... Rest>
+void LuaScripting::checkParamTypes(const std::string& name, int ttable,
+                                   int check_pos, const P&,
+                                   const Rest&... rest)
+{
+  Tuvok_luaCheckParam<P>(mL, name, ttable, check_pos);
+  checkParamTypes(name, ttable, check_pos + 1, rest...);
+}
+#endif
+
+template <typename... Args>
+void LuaScripting::cexec(const LuaFunctionHandle& fn, Args... args)
+{
+  LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
+  prepForExecution(fn);
+#ifdef TUVOK_DEBUG_LUA_USE_RTTI_CHECKS
+  checkParams(fn.fqName(), args...);
+#endif
+  pushParams(args...);
+  executeFunctionOnStack(static_cast<int>(sizeof...(Args)), 0);
+}
+
+template <typename T, typename... Args>
+T LuaScripting::cexecRet(const LuaFunctionHandle& fn, Args... args)
+{
+  LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
+  prepForExecution(fn);
+#ifdef TUVOK_DEBUG_LUA_USE_RTTI_CHECKS
+  checkParams(fn.fqName(), args...);
+#endif
+  pushParams(args...);
+  executeFunctionOnStack(static_cast<int>(sizeof...(Args)), 1);
+  T ret = LuaStrictStack<T>::get(mL, lua_gettop(mL));
+  lua_pop(mL, 1); // Pop return value.
+  return ret;
+}
+
 template <typename FunPtr>
 std::string LuaScripting::registerFunction(FunPtr f, const std::string& name,
                                            const std::string& desc,
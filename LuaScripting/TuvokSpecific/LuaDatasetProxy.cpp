@@ -37,6 +37,7 @@
 #include "IO/DynamicBrickingDS.h"
 #include "IO/FileBackedDataset.h"
 #include "IO/IOManager.h"
+#include "IO/ProgressiveBrickRequest.h"
 #include "IO/uvfDataset.h"
 #include "../LuaClassRegistration.h"
 #include "../LuaScripting.h"
@@ -83,6 +84,7 @@ LuaDatasetProxy::LuaDatasetProxy()
 
 LuaDatasetProxy::~LuaDatasetProxy()
 {
+  mRegionRequest.reset();
   delete mReg; mReg = NULL;
   mDS = NULL;
 }
@@ -100,6 +102,8 @@ void LuaDatasetProxy::bind(Dataset* ds, shared_ptr<LuaScripting> ss)
 
   mReg->clearProxyFunctions();
 
+  // the request reads from the old dataset.
+  mRegionRequest.reset();
   mDS = ds;
   if (ds != NULL)
   {
@@ -166,6 +170,30 @@ void LuaDatasetProxy::bind(Dataset* ds, shared_ptr<LuaScripting> ss)
         false
       );
       ss->setProvenanceExempt(id);
+
+      // UVFs can read bricks from the request's thread.
+      id = mReg->functionProxy(this, &LuaDatasetProxy::proxyRequestRegion,
+                               "requestRegion",
+                               "reads a region coarse to fine, in the "
+                               "background.", false);
+      ss->addParamInfo(id, 0, "timestep", "timestep to read");
+      ss->addParamInfo(id, 1, "lod", "finest LoD to read");
+      ss->addParamInfo(id, 2, "min", "lower corner of the region");
+      ss->addParamInfo(id, 3, "max", "upper corner of the region");
+      ss->setProvenanceExempt(id);
+      id = mReg->functionProxy(this, &LuaDatasetProxy::proxyGetRegionLoD,
+                               "getRegionLoD",
+                               "finest LoD at which the requested region "
+                               "was read completely.", false);
+      id = mReg->functionProxy(this, &LuaDatasetProxy::proxyWaitRegion,
+                               "waitRegion",
+                               "waits until the requested region was read.",
+                               false);
+      ss->setProvenanceExempt(id);
+      id = mReg->functionProxy(this, &LuaDatasetProxy::proxyCancelRegion,
+                               "cancelRegion",
+                               "stops reading the requested region.", false);
+      ss->setProvenanceExempt(id);
     } catch(const std::bad_cast&) {
       WARNING("Not a uvf; not binding mesh functions.");
     }
@@ -230,4 +258,37 @@ LuaDatasetProxy::proxyGetMetadata()
   return mDS->GetMetadata();
 }
 
+bool LuaDatasetProxy::proxyRequestRegion(size_t ts, size_t lod,
+                                         FLOATVECTOR3 vMin, FLOATVECTOR3 vMax)
+{
+  mRegionRequest.reset();
+  if (mDS == NULL || ts >= mDS->GetNumberOfTimesteps()) {
+    T_ERROR("No such timestep: %u", static_cast<unsigned>(ts));
+    return false;
+  }
+  // reading is all we want; the dataset and the OS cache what they read.
+  mRegionRequest.reset(new ProgressiveBrickRequest(*mDS, ts, lod, vMin, vMax,
+    [](const BrickKey&, const std::vector<uint8_t>&, bool) { return true; }
+  ));
+  return true;
+}
+
+size_t LuaDatasetProxy::proxyGetRegionLoD() const
+{
+  if (!mRegionRequest) {
+    return mDS != NULL ? size_t(mDS->GetLODLevelCount()) : 0;
+  }
+  return mRegionRequest->GetCompletedLoD();
+}
+
+bool LuaDatasetProxy::proxyWaitRegion()
+{
+  return mRegionRequest && mRegionRequest->Wait();
+}
+
+void LuaDatasetProxy::proxyCancelRegion()
+{
+  if (mRegionRequest) { mRegionRequest->Cancel(); }
+}
+
 } /* namespace tuvok */
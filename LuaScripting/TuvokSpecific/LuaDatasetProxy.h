@@ -33,13 +33,16 @@
 #ifndef TUVOK_LUADATASETPROXY_H_
 #define TUVOK_LUADATASETPROXY_H_
 
+#include <memory>
 #include "../LuaScripting.h"
 #include "../LuaClassRegistration.h"
+#include "Basics/Vectors.h"
 
 namespace tuvok
 {
 
 class Dataset;
+class ProgressiveBrickRequest;
 
 namespace Registrar {
   // entry point for registering all the tuvok.dataset functions.
@@ -77,6 +80,18 @@ private:
 
   std::vector<std::pair<std::string, std::string>> proxyGetMetadata();
 
+  /// Reads a region of the dataset coarse to fine in the background, e.g.
+  /// so that a script can have it read while it sets up the view, and poll
+  /// how far it got.  Replaces (cancels) the previous region request.
+  bool proxyRequestRegion(size_t ts, size_t lod, FLOATVECTOR3 vMin,
+                          FLOATVECTOR3 vMax);
+  /// @returns the finest LoD at which the requested region was read
+  /// completely, the LoD count if none (yet).
+  size_t proxyGetRegionLoD() const;
+  /// Waits for the region request. @returns true if it read every brick.
+  bool proxyWaitRegion();
+  void proxyCancelRegion();
+
   /// Class registration we received from defineLuaInterface.
   /// @todo Change to unique pointer.
   LuaClassRegistration<LuaDatasetProxy>*  mReg;
@@ -84,6 +99,9 @@ private:
 
   /// The type of dataset.
   DatasetType mDatasetType;
+
+  /// The region read by proxyRequestRegion, if any.
+  std::unique_ptr<ProgressiveBrickRequest> mRegionRequest;
 };
 
 } /* namespace tuvok */
@@ -82,6 +82,10 @@ void LuaIOManagerProxy::bind()
                                nm + "exportMesh", "", false);
     id = mReg.registerFunction(this, &LuaIOManagerProxy::ReBrickDataset,
                                nm + "rebrickDataset", "", false);
+    id = mReg.registerFunction(this, &LuaIOManagerProxy::UpgradeDataset,
+                               nm + "upgradeDataset",
+                               "Converts the raster data blocks of an old "
+                               "UVF file to TOC blocks.", false);
     id = mReg.registerFunction(this, &LuaIOManagerProxy::ConvertDataset,
                                nm + "convertDataset", "", false);
     mSS->addParamInfo(id, 0, "file list", "list of files to convert");
@@ -246,6 +250,12 @@ bool LuaIOManagerProxy::ReBrickDataset(const string& strSourceFilename,
                              mIO->GetBrickOverlap(), false);
 }
 
+bool LuaIOManagerProxy::UpgradeDataset(const string& strSourceFilename,
+                                       const string& strTargetFilename,
+                                       const string& strTempDir) const {
+  return mIO->UpgradeDataset(strSourceFilename, strTargetFilename, strTempDir);
+}
+
 bool LuaIOManagerProxy::ConvertDataset(const list<std::string>& files,
                                        const string& strTargetFilename,
                                        const string& strTempDir,
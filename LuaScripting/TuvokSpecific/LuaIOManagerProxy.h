@@ -90,6 +90,9 @@ private:
   bool ReBrickDataset(const std::string& strSourceFilename,
                       const std::string& strTargetFilename,
                       const std::string& strTempDir) const;
+  bool UpgradeDataset(const std::string& strSourceFilename,
+                      const std::string& strTargetFilename,
+                      const std::string& strTempDir) const;
   bool ConvertDataset(const std::list<std::string>& files,
                       const std::string& strTargetFilename,
                       const std::string& strTempDir,
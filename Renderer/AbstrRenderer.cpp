@@ -1547,9 +1547,25 @@ void AbstrRenderer::ReloadMesh(size_t index, const std::shared_ptr<Mesh> m) {
 void AbstrRenderer::SetTimestep(size_t t) {
   if(t != m_iTimestep) {
     m_iTimestep = t;
+    if(m_pDataset) { m_pDataset->SetPlaybackTimestep(t); }
     ScheduleCompleteRedraw();
   }
 }
+void AbstrRenderer::SetTimestepPrefetch(size_t iLookahead) {
+  if(!m_pDataset) { return; }
+  // leave the bulk of the memory to the bricks of the current timestep.
+  const uint64_t iBudget = m_pMasterController->MemMan()->GetCPUMem() / 4;
+  m_pDataset->SetTimestepPrefetch(iLookahead, iBudget);
+  m_pDataset->SetPlaybackTimestep(m_iTimestep);
+}
+void AbstrRenderer::SetDiskCache(std::string strDir, size_t iMegabytes) {
+  if(!m_pDataset) { return; }
+  m_pDataset->SetDiskCache(strDir, uint64_t(iMegabytes) * 1024 * 1024);
+}
+void AbstrRenderer::SetSharedCache(std::string strName, size_t iMegabytes) {
+  if(!m_pDataset) { return; }
+  m_pDataset->SetSharedCache(strName, uint64_t(iMegabytes) * 1024 * 1024);
+}
 size_t AbstrRenderer::Timestep() const {
   return m_iTimestep;
 }
@@ -2083,6 +2099,17 @@ void AbstrRenderer::RegisterLuaFunctions(
 
   id = reg.function(&AbstrRenderer::SetTimestep,
                     "setTimestep", "", true);
+  id = reg.function(&AbstrRenderer::SetTimestepPrefetch,
+                    "setTimestepPrefetch", "Number of timesteps to load "
+                    "ahead during playback; 0 disables prefetching.", false);
+  id = reg.function(&AbstrRenderer::SetDiskCache,
+                    "setDiskCache", "Directory and size (in MB) of a cache "
+                    "for decoded bricks of compressed datasets which is kept "
+                    "across sessions; 0 MB disables it.", false);
+  id = reg.function(&AbstrRenderer::SetSharedCache,
+                    "setSharedCache", "Name and size (in MB) of a cache for "
+                    "decoded bricks which is shared by all processes of this "
+                    "user that use the same name; 0 MB disables it.", false);
 
   id = reg.function(&AbstrRenderer::SetGlobalBBox,
                     "setGlobalBBox", "", true);
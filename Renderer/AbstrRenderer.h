@@ -572,6 +572,12 @@ class AbstrRenderer {
 
     void SetTimestep(size_t);
     size_t Timestep() const;
+    /// Playback: load the next 'iLookahead' timesteps in the background.
+    void SetTimestepPrefetch(size_t iLookahead);
+    /// Keep up to 'iMegabytes' of decoded bricks in 'strDir' across sessions.
+    void SetDiskCache(std::string strDir, size_t iMegabytes);
+    /// Share decoded bricks with other processes using the cache 'strName'.
+    void SetSharedCache(std::string strName, size_t iMegabytes);
 
     void SetGlobalBBox(bool bRenderBBox);
     bool GetGlobalBBox() const {return m_bRenderGlobalBBox;}
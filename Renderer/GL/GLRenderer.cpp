@@ -2326,8 +2326,7 @@ void GLRenderer::RenderMergedMesh(SortIndexPVec& mergedMesh) {
   if (mergedMesh.empty()) return;
 
   // sort the mesh
-  std::sort(mergedMesh.begin(), mergedMesh.end(), 
-           (m_bSortMeshBTF) ?  DistanceSortOver : DistanceSortUnder);
+  SortByDepth(mergedMesh, m_bSortMeshBTF);
 
   // turn it into something renderable
   std::vector<MeshFormat> list;
@@ -915,7 +915,7 @@ GLVolume* GPUMemMan::AllocOrGetVolume(Dataset* pDataset,
 
   // for OpenGL we ignore the GPU memory load and let GL do the paging
   if (m_iAllocatedCPUMemory + iNeededCPUMemory >
-      m_SystemInfo.GetMaxUsableCPUMem()) {
+      m_SystemInfo.GetBufferPoolBudget()) {
     MESSAGE("Not enough memory for texture %u x %u x %u (%llubit * %llu), "
             "paging ...", sz[0], sz[1], sz[2],
             iBitWidth, iCompCount);
@@ -946,12 +946,12 @@ GLVolume* GPUMemMan::AllocOrGetVolume(Dataset* pDataset,
               " brick fits into memory");
 
       while (m_iAllocatedCPUMemory + iNeededCPUMemory >
-             m_SystemInfo.GetMaxUsableCPUMem()) {
+             m_SystemInfo.GetBufferPoolBudget()) {
         if (m_vpTex3DList.empty()) {
           // we do not have enough memory to page in even a single block...
           T_ERROR("Not enough memory to page a single brick into memory, "
                   "aborting (MaxMem=%llukb, NeededMem=%llukb).",
-                  m_SystemInfo.GetMaxUsableCPUMem()/1024,
+                  m_SystemInfo.GetBufferPoolBudget()/1024,
                   iNeededCPUMemory/1024);
           return NULL;
         }
@@ -1056,7 +1056,7 @@ void GPUMemMan::FreeAssociatedTextures(Dataset* pDataset, int iShareGroupID) {
 }
 
 void GPUMemMan::MemSizesChanged() {
-  if (m_iAllocatedCPUMemory > m_SystemInfo.GetMaxUsableCPUMem()) {
+  if (m_iAllocatedCPUMemory > m_SystemInfo.GetBufferPoolBudget()) {
       /// \todo CPU free resources to match max mem requirements
   }
 
@@ -1081,7 +1081,7 @@ GLFBOTex* GPUMemMan::GetFBO(GLenum minfilter, GLenum magfilter,
 
   // if we are running out of mem, kick out bricks to create room for the FBO
   while (m_iAllocatedCPUMemory + m_iCPUMemEstimate >
-         m_SystemInfo.GetMaxUsableCPUMem() && !m_vpTex3DList.empty()) {
+         m_SystemInfo.GetBufferPoolBudget() && !m_vpTex3DList.empty()) {
     MESSAGE("Not enough memory for FBO %i x %i x %i, "
             "paging out bricks ...", int(width), int(height), iNumBuffers);
 
@@ -35,10 +35,114 @@
 #include "RenderMesh.h"
 #include "KDTree.h"
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include <algorithm>
 
 using namespace tuvok;
 
+namespace {
+  // Maps a float to an unsigned integer, such that the integers have the
+  // same order as the floats.
+  uint32_t DepthKey(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(float));
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+  }
+
+  template <bool bOver> bool Before(const SortIndex* a, const SortIndex* b) {
+    return bOver ? a->fDepth > b->fDepth : a->fDepth < b->fDepth;
+  }
+
+  // counts the neighbours which are in the wrong order
+  template <bool bOver> size_t CountDescents(const SortIndexPVec& list) {
+    size_t iCount = 0;
+    for (size_t i = 1;i<list.size();i++) {
+      if (Before<bOver>(list[i], list[i-1])) iCount++;
+    }
+    return iCount;
+  }
+
+  // Sorts by insertion, but gives up once more than iBudget elements were
+  // moved.  The list is a permutation of the input in any case.
+  // Returns true if the list is sorted.
+  template <bool bOver> bool InsertionSort(SortIndexPVec& list,
+                                           size_t iBudget) {
+    size_t iMoves = 0;
+    for (size_t i = 1;i<list.size();i++) {
+      SortIndex* p = list[i];
+      size_t j = i;
+      while (j > 0 && Before<bOver>(p, list[j-1])) {
+        list[j] = list[j-1];
+        j--;
+      }
+      list[j] = p;
+      iMoves += i-j;
+      if (iMoves > iBudget) return false;
+    }
+    return true;
+  }
+
+  // LSD radix sort on the 32 bit keys, 11 bits per pass
+  void RadixSort(SortIndexPVec& list, bool bOver) {
+    const size_t RADIX_BITS = 11;
+    const size_t BUCKETS = size_t(1) << RADIX_BITS;
+    const size_t n = list.size();
+    typedef std::pair<uint32_t, SortIndex*> KeyIndex;
+    std::vector<KeyIndex> keys(n), temp(n);
+    std::vector<size_t> histogram(3*BUCKETS, 0);
+
+    for (size_t i = 0;i<n;i++) {
+      uint32_t k = DepthKey(list[i]->fDepth);
+      if (bOver) k = ~k;
+      keys[i] = KeyIndex(k, list[i]);
+      histogram[k & (BUCKETS-1)]++;
+      histogram[BUCKETS + ((k >> RADIX_BITS) & (BUCKETS-1))]++;
+      histogram[2*BUCKETS + (k >> (2*RADIX_BITS))]++;
+    }
+
+    for (size_t iPass = 0;iPass<3;iPass++) {
+      size_t* count = &histogram[iPass*BUCKETS];
+      const size_t iShift = iPass*RADIX_BITS;
+      // all keys have the same digit, nothing to do for this pass
+      if (count[(keys[0].first >> iShift) & (BUCKETS-1)] == n) continue;
+
+      size_t iSum = 0;
+      for (size_t b = 0;b<BUCKETS;b++) {
+        const size_t c = count[b];
+        count[b] = iSum;
+        iSum += c;
+      }
+      for (size_t i = 0;i<n;i++) {
+        temp[count[(keys[i].first >> iShift) & (BUCKETS-1)]++] = keys[i];
+      }
+      keys.swap(temp);
+    }
+
+    for (size_t i = 0;i<n;i++) list[i] = keys[i].second;
+  }
+
+  template <bool bOver> void DepthSort(SortIndexPVec& list) {
+    // std::sort's insertion sort is as good for such short lists
+    if (list.size() < 256) {
+      std::sort(list.begin(), list.end(), Before<bOver>);
+      return;
+    }
+    const size_t iDescents = CountDescents<bOver>(list);
+    if (iDescents == 0) return;
+    if (iDescents < list.size()/32 &&
+        InsertionSort<bOver>(list, 4*list.size())) return;
+    RadixSort(list, bOver);
+  }
+}
+
+void tuvok::SortByDepth(SortIndexPVec& list, bool bOver) {
+  if (bOver)
+    DepthSort<true>(list);
+  else
+    DepthSort<false>(list);
+}
+
 
 SortIndex::SortIndex(size_t index, const RenderMesh* m) :
   m_index(index),
@@ -75,7 +179,8 @@ RenderMesh::RenderMesh(const Mesh& other, float fTransTreshhold) :
    m_VolumeMin(FLOATVECTOR3(0,0,0)),
    m_VolumeMax(FLOATVECTOR3(0,0,0)),
    m_QuadrantsDirty(true),
-   m_FIBHashDirty(true)
+   m_FIBHashDirty(true),
+   m_iViewQuadrant(27)
 {
   m_Quadrants.resize(27);
   SplitOpaqueFromTransparent();
@@ -101,7 +206,8 @@ RenderMesh::RenderMesh(const VertVec& vertices, const NormVec& normals,
    m_VolumeMin(FLOATVECTOR3(0,0,0)),
    m_VolumeMax(FLOATVECTOR3(0,0,0)),
    m_QuadrantsDirty(true),
-   m_FIBHashDirty(true)
+   m_FIBHashDirty(true),
+   m_iViewQuadrant(27)
 {
   m_Quadrants.resize(27);
   SplitOpaqueFromTransparent();
@@ -201,6 +307,14 @@ void RenderMesh::GeometryHasChanged(bool bUpdateAABB, bool bUpdateKDtree) {
   for (size_t i = m_splitIndex;i<m_Data.m_VertIndices.size();i+=m_VerticesPerPoly) {
     m_allPolys.push_back(SortIndex(i, this));
   }
+  m_vCentroidX.resize(m_allPolys.size());
+  m_vCentroidY.resize(m_allPolys.size());
+  m_vCentroidZ.resize(m_allPolys.size());
+  for (size_t i = 0;i<m_allPolys.size();i++) {
+    m_vCentroidX[i] = m_allPolys[i].m_centroid.x;
+    m_vCentroidY[i] = m_allPolys[i].m_centroid.y;
+    m_vCentroidZ[i] = m_allPolys[i].m_centroid.z;
+  }
 
   m_QuadrantsDirty = true;
   m_FIBHashDirty = true;
@@ -234,6 +348,9 @@ void RenderMesh::SetUserPos(const FLOATVECTOR3& viewPoint) {
 // so x is fastes, then y and finally z
 void RenderMesh::SortTransparentDataIntoQuadrants() {
   m_QuadrantsDirty = false;
+  // the front and behind lists are made of the quadrants
+  m_FIBHashDirty = true;
+  m_iViewQuadrant = 27;
   for (int i = 0;i<27;i++) m_Quadrants[i].clear();
   m_InPointList.clear();
 
@@ -291,18 +408,40 @@ void RenderMesh::Front(int index,...)
 void RenderMesh::RehashTransparentData() {
   m_FIBHashDirty = false;
 
-  for (SortIndexVec::iterator poly = m_allPolys.begin();
-       poly != m_allPolys.end();
-       poly++) {
-    poly->UpdateDistance();
+  // same as SortIndex::UpdateDistance, but on the centroid arrays, which
+  // the compiler can vectorize
+  const size_t iPolyCount = m_allPolys.size();
+  m_vDistance.resize(iPolyCount);
+  for (size_t i = 0;i<iPolyCount;i++) {
+    const float dx = m_viewPoint.x - m_vCentroidX[i];
+    const float dy = m_viewPoint.y - m_vCentroidY[i];
+    const float dz = m_viewPoint.z - m_vCentroidZ[i];
+    m_vDistance[i] = std::sqrt(dx*dx + dy*dy + dz*dz);
   }
-  m_FrontPointList.clear();
-  m_BehindPointList.clear();
+  for (size_t i = 0;i<iPolyCount;i++) {
+    m_allPolys[i].fDepth = m_vDistance[i];
+  }
+
+  m_BackSorted = false;
+  m_InSorted = false;
+  m_FrontSorted = false;
 
   // is the entire mesh opaque ?
-  if (IsCompletelyOpaque()) return;
+  if (IsCompletelyOpaque()) {
+    m_FrontPointList.clear();
+    m_BehindPointList.clear();
+    m_iViewQuadrant = 27;
+    return;
+  }
 
+  // As long as the viewer stays in the same quadrant the lists hold the
+  // same polygons.  Keeping them also keeps the order of the last sort,
+  // which is close to the new one if the viewer moved only a little.
   size_t index = PosToQuadrant(m_viewPoint);
+  if (index == m_iViewQuadrant) return;
+  m_iViewQuadrant = index;
+  m_FrontPointList.clear();
+  m_BehindPointList.clear();
 
   switch (index) {
     case  0 : Front( 0, 1, 2,
@@ -630,17 +769,13 @@ void RenderMesh::RehashTransparentData() {
                     END);
               break;
   }
-
-  m_BackSorted = false;
-  m_InSorted = false;
-  m_FrontSorted = false;
 }
 
 const SortIndexPVec& RenderMesh::GetFrontPointList(bool bSorted) {
   if (m_QuadrantsDirty) SortTransparentDataIntoQuadrants();
   if (m_FIBHashDirty) RehashTransparentData();
   if (bSorted && !m_FrontSorted) {
-    std::sort(m_FrontPointList.begin(), m_FrontPointList.end(), (m_bSortOver) ? DistanceSortOver : DistanceSortUnder);
+    SortByDepth(m_FrontPointList, m_bSortOver);
     m_FrontSorted = true;
   }
   return m_FrontPointList;
@@ -650,7 +785,7 @@ const SortIndexPVec& RenderMesh::GetInPointList(bool bSorted) {
   if (m_QuadrantsDirty) SortTransparentDataIntoQuadrants();
   if (m_FIBHashDirty) RehashTransparentData();
   if (bSorted && !m_InSorted) {
-    std::sort(m_InPointList.begin(), m_InPointList.end(), (m_bSortOver) ? DistanceSortOver : DistanceSortUnder);
+    SortByDepth(m_InPointList, m_bSortOver);
     m_InSorted = true;
   }
   return m_InPointList;
@@ -660,7 +795,7 @@ const SortIndexPVec& RenderMesh::GetBehindPointList(bool bSorted) {
   if (m_QuadrantsDirty) SortTransparentDataIntoQuadrants();
   if (m_FIBHashDirty) RehashTransparentData();
   if (bSorted && !m_BackSorted) {
-    std::sort(m_BehindPointList.begin(), m_BehindPointList.end(), (m_bSortOver) ? DistanceSortOver : DistanceSortUnder);
+    SortByDepth(m_BehindPointList, m_bSortOver);
     m_BackSorted = true;
   }
   return m_BehindPointList;
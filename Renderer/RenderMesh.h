@@ -73,6 +73,13 @@ inline bool DistanceSortUnder(const SortIndex* e1, const SortIndex* e2)
 typedef std::vector< SortIndex > SortIndexVec;
 typedef std::vector< SortIndex* > SortIndexPVec;
 
+/** Sorts polygons by their fDepth, in the order of DistanceSortOver if
+ *  bOver, else in the order of DistanceSortUnder.  Lists which are almost
+ *  sorted already, e.g. the lists of the last frame after the viewer moved
+ *  a little, are finished with an insertion sort; others are radix sorted.
+ */
+void SortByDepth(SortIndexPVec& list, bool bOver);
+
 
 class RenderMesh : public Mesh
 {
@@ -171,12 +178,21 @@ protected:
   FLOATVECTOR3 m_VolumeMax;
   bool         m_QuadrantsDirty;
   bool         m_FIBHashDirty;
+  //! quadrant of the viewer the front and behind lists were built for,
+  //! 27 if they need to be rebuilt
+  size_t       m_iViewQuadrant;
 
   SortIndexVec m_allPolys;
   std::vector< SortIndexPVec > m_Quadrants;
   SortIndexPVec m_FrontPointList;
   SortIndexPVec m_InPointList;
   SortIndexPVec m_BehindPointList;
+  //! the centroids of m_allPolys, one array per coordinate
+  std::vector<float> m_vCentroidX;
+  std::vector<float> m_vCentroidY;
+  std::vector<float> m_vCentroidZ;
+  //! distance of the viewer to the centroids of m_allPolys
+  std::vector<float> m_vDistance;
 
   /** If the mesh contains transparent parts this call creates * 27
    *  lists pointing to parts of the transparent mesh in the 27 * quadrants
@@ -346,7 +346,7 @@ void SBVRGeogen::MeshEntryToVertexFormat(std::vector<VERTEX_FORMAT>& list,
 
 void SBVRGeogen::SortMeshWithoutVolume(std::vector<VERTEX_FORMAT>& list) {
   if (!m_mesh.empty()) {
-    std::sort(m_mesh.begin(), m_mesh.end(), DistanceSortUnder);
+    SortByDepth(m_mesh, false);
 
     for (SortIndexPVec::const_iterator index = m_mesh.begin();
          index != m_mesh.end();
@@ -45,14 +45,14 @@
 
 using namespace tuvok;
 
-static bool CheckOrdering(const FLOATVECTOR3& a, const FLOATVECTOR3& b,
-                          const FLOATVECTOR3& c);
-static void SortPoints(std::vector<VERTEX_FORMAT> &fArray);
+// the slices of at most this many brick shapes are kept
+static const size_t SLICE_CACHE_SIZE = 64;
 
 SBVRGeogen3D::SBVRGeogen3D(void) :
   SBVRGeogen(),
   m_fMaxZ(0),
-  m_fMinZ(0)
+  m_fMinZ(0),
+  m_iNextCacheEntry(0)
 {
 }
 
@@ -89,119 +89,96 @@ void SBVRGeogen3D::InitBBOX() {
 }
 
 
-bool SBVRGeogen3D::DepthPlaneIntersection(float z,
-                                const VERTEX_FORMAT &plA,
-                                const VERTEX_FORMAT &plB,
-                                std::vector<VERTEX_FORMAT>& vHits,
-                                bool bClip)
-{
-  /*
-     returns NO INTERSECTION if the line of the 2 points a,b is
-     1. in front of the intersection plane
-     2. behind the intersection plane
-     3. parallel to the intersection plane (both points have 
-        "pretty much" the same z)
-  */
-  if ((z > plA.m_vPos.z && z > plB.m_vPos.z) ||
-      (z < plA.m_vPos.z && z < plB.m_vPos.z) ||
-      (EpsilonEqual(plA.m_vPos.z, plB.m_vPos.z))) {
-    return false;
-  }
-
-  float fAlpha = (z - plA.m_vPos.z) /
-                 (plA.m_vPos.z - plB.m_vPos.z);
-
-  VERTEX_FORMAT vHit;
-
-  vHit.m_vPos.x = plA.m_vPos.x + (plA.m_vPos.x - plB.m_vPos.x) * fAlpha;
-  vHit.m_vPos.y = plA.m_vPos.y + (plA.m_vPos.y - plB.m_vPos.y) * fAlpha;
-  vHit.m_vPos.z = z;
-
-  vHit.m_vVertexData = plA.m_vVertexData + (plA.m_vVertexData - plB.m_vVertexData) * fAlpha;
-  vHit.m_bClip = bClip;
-
-  vHits.push_back(vHit);
+// the edges of the bounding box, as indices into m_pfBBOXVertex
+static const unsigned char BOX_EDGES[12][2] = {
+  {0,1}, {1,2}, {2,3}, {3,0},
+  {4,5}, {5,6}, {6,7}, {7,4},
+  {4,0}, {5,1}, {6,2}, {7,3}
+};
 
-  return true;
+// A monotonic replacement for the angle of (dx,dy), in [0,4).  Cheaper than
+// atan2 and all we need to order points around a center.
+static float PseudoAngle(float dx, float dy) {
+  const float fSum = fabs(dx) + fabs(dy);
+  if (fSum == 0.0f) return 0.0f;
+  const float p = dy / fSum;
+  if (dx < 0) return 2.0f - p;
+  if (dy < 0) return 4.0f + p;
+  return p;
 }
 
-
-// Functor to identify the point with the lowest `y' coordinate.
-struct vertex_min : public std::binary_function<VERTEX_FORMAT,
-                                                VERTEX_FORMAT,
-                                                bool> {
-  bool operator()(const VERTEX_FORMAT &a, const VERTEX_FORMAT &b) const {
-    return (a.m_vPos.y < b.m_vPos.y);
-  }
-};
-
-// Sorts a vector
-void SBVRGeogen3D::SortByGradient(std::vector<VERTEX_FORMAT>& fArray)
+bool SBVRGeogen3D::SliceBox(const VERTEX_FORMAT* pBox, float fDepth,
+                            bool bClip, std::vector<VERTEX_FORMAT>& vTriangles)
 {
-  // move bottom element to front of array
-  if(fArray.empty()) { return; }
-  std::swap(fArray[0],
-            *std::min_element(fArray.begin(), fArray.end(), vertex_min()));
-  if(fArray.size() > 2) {
-    // sort points according to gradient
-    SortPoints(fArray);
+  // a plane cuts a box in at most six points; more hits are possible only
+  // if the plane passes through vertices, which then are hit repeatedly.
+  VERTEX_FORMAT vHits[12];
+  size_t iHits = 0;
+  for (size_t e = 0; e < 12; ++e) {
+    const VERTEX_FORMAT& a = pBox[BOX_EDGES[e][0]];
+    const VERTEX_FORMAT& b = pBox[BOX_EDGES[e][1]];
+    /*
+       no intersection if the line of the 2 points a,b is
+       1. in front of the intersection plane
+       2. behind the intersection plane
+       3. parallel to the intersection plane (both points have 
+          "pretty much" the same z)
+    */
+    if ((fDepth > a.m_vPos.z && fDepth > b.m_vPos.z) ||
+        (fDepth < a.m_vPos.z && fDepth < b.m_vPos.z) ||
+        (EpsilonEqual(a.m_vPos.z, b.m_vPos.z))) {
+      continue;
+    }
+    const float fAlpha = (fDepth - a.m_vPos.z) / (a.m_vPos.z - b.m_vPos.z);
+    VERTEX_FORMAT& vHit = vHits[iHits++];
+    vHit.m_vPos.x = a.m_vPos.x + (a.m_vPos.x - b.m_vPos.x) * fAlpha;
+    vHit.m_vPos.y = a.m_vPos.y + (a.m_vPos.y - b.m_vPos.y) * fAlpha;
+    vHit.m_vPos.z = fDepth;
+    vHit.m_vVertexData = a.m_vVertexData +
+                         (a.m_vVertexData - b.m_vVertexData) * fAlpha;
+    vHit.m_bClip = bClip;
   }
-}
-
-void SBVRGeogen3D::Triangulate(std::vector<VERTEX_FORMAT> &fArray) {
-  SortByGradient(fArray);
+  if (iHits <= 2) return false;
+
+  // the polygon is convex, so ordering its points by their angle around
+  // the centroid gives its outline (counter clockwise)
+  float fCX = 0, fCY = 0;
+  for (size_t i = 0; i < iHits; ++i) {
+    fCX += vHits[i].m_vPos.x;
+    fCY += vHits[i].m_vPos.y;
+  }
+  fCX /= float(iHits);
+  fCY /= float(iHits);
+  std::pair<float, size_t> order[12];
+  for (size_t i = 0; i < iHits; ++i) {
+    order[i] = std::make_pair(PseudoAngle(vHits[i].m_vPos.x - fCX,
+                                          vHits[i].m_vPos.y - fCY), i);
+  }
+  std::sort(order, order + iHits);
 
-  // convert to triangles
-  for (uint32_t i=0; i<(fArray.size()-2) ; i++) {
-    m_vSliceTriangles.push_back(fArray[0]);
-    m_vSliceTriangles.push_back(fArray[i+1]);
-    m_vSliceTriangles.push_back(fArray[i+2]);
+  // convert to a triangle fan
+  for (size_t i = 1; i + 1 < iHits; ++i) {
+    vTriangles.push_back(vHits[order[0].second]);
+    vTriangles.push_back(vHits[order[i].second]);
+    vTriangles.push_back(vHits[order[i+1].second]);
   }
+  return true;
 }
 
-
 bool SBVRGeogen3D::ComputeLayerGeometry(float fDepth) {
-  std::vector<VERTEX_FORMAT> vLayerPoints;
-  vLayerPoints.reserve(12);
-
   assert(!MathTools::NaN(fDepth));
 
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[0], m_pfBBOXVertex[1],
-                      vLayerPoints, m_bClipVolume);
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[1], m_pfBBOXVertex[2],
-                      vLayerPoints, m_bClipVolume);
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[2], m_pfBBOXVertex[3],
-                      vLayerPoints, m_bClipVolume);
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[3], m_pfBBOXVertex[0],
-                      vLayerPoints, m_bClipVolume);
-
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[4], m_pfBBOXVertex[5],
-                      vLayerPoints, m_bClipVolume);
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[5], m_pfBBOXVertex[6],
-                      vLayerPoints, m_bClipVolume);
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[6], m_pfBBOXVertex[7],
-                      vLayerPoints, m_bClipVolume);
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[7], m_pfBBOXVertex[4],
-                      vLayerPoints, m_bClipVolume);
-
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[4], m_pfBBOXVertex[0],
-                      vLayerPoints, m_bClipVolume);
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[5], m_pfBBOXVertex[1],
-                      vLayerPoints, m_bClipVolume);
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[6], m_pfBBOXVertex[2],
-                      vLayerPoints, m_bClipVolume);
-  DepthPlaneIntersection(fDepth, m_pfBBOXVertex[7], m_pfBBOXVertex[3],
-                      vLayerPoints, m_bClipVolume);
-
-  if (vLayerPoints.size() <= 2) {
+  std::vector<VERTEX_FORMAT> vSlice;
+  vSlice.reserve(12);
+  if (!SliceBox(m_pfBBOXVertex, fDepth, m_bClipVolume, vSlice)) {
     return false;
   }
 
   // insert mesh triangles
   if (HasMesh()) InsertMeshUpToSlice(fDepth);
 
-  Triangulate(vLayerPoints);
-
+  m_vSliceTriangles.insert(m_vSliceTriangles.end(), vSlice.begin(),
+                           vSlice.end());
   return true;
 }
 
@@ -243,7 +220,7 @@ void SBVRGeogen3D::DepthSortMeshWithVolume() {
     (*index)->fDepth = centroid.z;
   }
   // sort
-  std::sort(m_mesh.begin(), m_mesh.end(), DistanceSortOver);
+  SortByDepth(m_mesh, true);
   m_MeshTransferIter = m_mesh.begin();
 }
 
@@ -267,21 +244,23 @@ void SBVRGeogen3D::ComputeGeometry(bool bMeshOnly) {
   // so we end up with an infinite loop computing geometry below.
   assert(!MathTools::NaN(fDepth));
 
-  // prepare mesh triangles for insertion (i.e. sort them)
-  if (HasMesh()) DepthSortMeshWithVolume();
+  if (HasMesh()) {
+    // prepare mesh triangles for insertion (i.e. sort them)
+    DepthSortMeshWithVolume();
 
-  do {
-    ComputeLayerGeometry(fDepth);
-    fDepth -= fLayerDistance;
-  } while (fDepth > m_fMinZ);
+    do {
+      ComputeLayerGeometry(fDepth);
+      fDepth -= fLayerDistance;
+    } while (fDepth > m_fMinZ);
 
-  // insert all the leftover triangles they must be behind the last plane
-  if (HasMesh()) { 
+    // insert all the leftover triangles they must be behind the last plane
     for (SortIndexPVec::const_iterator index = m_MeshTransferIter;
          index != m_mesh.end();
          index++) {
       MeshEntryToVertexFormat(m_vSliceTriangles, (*index)->m_mesh, (*index)->m_index, m_bClipMesh);
     }
+  } else {
+    ComputeCachedSlices(m_vSliceTriangles);
   }
 
   if(m_bClipPlaneEnabled && (m_bClipVolume || m_bClipMesh)) {
@@ -293,30 +272,68 @@ void SBVRGeogen3D::ComputeGeometry(bool bMeshOnly) {
 
 }
 
-// Checks the ordering of two points relative to a third.
-static bool CheckOrdering(const FLOATVECTOR3& a,
-                          const FLOATVECTOR3& b,
-                          const FLOATVECTOR3& c) {
-  float g1 = (a.y-c.y)/(a.x-c.x),
-        g2 = (b.y-c.y)/(b.x-c.x);
-
-  if (EpsilonEqual(a.x,c.x))
-    return (g2 < 0) || (EpsilonEqual(g2,0.0f) && b.x < c.x);
-  if (EpsilonEqual(b.x,c.x))
-    return (g1 > 0) || (EpsilonEqual(g1,0.0f) && a.x > c.x);
-
+void SBVRGeogen3D::ComputeCachedSlices(std::vector<VERTEX_FORMAT>& vTriangles)
+{
+  const FLOATVECTOR3 vCenter(m_matWorldView.m41, m_matWorldView.m42,
+                             m_matWorldView.m43);
+  FLOATMATRIX4 matRotation = m_matWorldView;
+  matRotation.m41 = matRotation.m42 = matRotation.m43 = 0;
+
+  SliceCacheEntry* entry = NULL;
+  for (std::vector<SliceCacheEntry>::iterator e = m_vSliceCache.begin();
+       e != m_vSliceCache.end(); ++e) {
+    if (e->vAspect == m_vAspect && e->vSize == m_vSize &&
+        e->vTexCoordMin == m_vTexCoordMin &&
+        e->vTexCoordMax == m_vTexCoordMax) {
+      entry = &*e;
+      break;
+    }
+  }
+  if (!entry) {
+    if (m_vSliceCache.size() < SLICE_CACHE_SIZE) {
+      m_vSliceCache.push_back(SliceCacheEntry());
+      entry = &m_vSliceCache.back();
+    } else {
+      entry = &m_vSliceCache[m_iNextCacheEntry];
+      m_iNextCacheEntry = (m_iNextCacheEntry + 1) % SLICE_CACHE_SIZE;
+    }
+    entry->vAspect = m_vAspect;
+    entry->vSize = m_vSize;
+    entry->vTexCoordMin = m_vTexCoordMin;
+    entry->vTexCoordMax = m_vTexCoordMax;
+    entry->fSamplingModifier = 0; // forces the slicing below
+  }
 
-  if (a.x < c.x)
-    if (b.x < c.x) return g1 < g2; else return false;
-  else
-    if (b.x < c.x) return true; else return g1 < g2;
-}
+  if (entry->matRotation != matRotation ||
+      entry->fSamplingModifier != m_fSamplingModifier ||
+      entry->bClip != m_bClipVolume) {
+    entry->matRotation = matRotation;
+    entry->fSamplingModifier = m_fSamplingModifier;
+    entry->bClip = m_bClipVolume;
+
+    VERTEX_FORMAT pBox[8];
+    for (size_t i = 0; i < 8; ++i) {
+      pBox[i] = m_pfBBOXVertex[i];
+      pBox[i].m_vPos -= vCenter;
+    }
+    const float fLayerDistance = GetLayerDistance();
+    const float fMinZ = m_fMinZ - vCenter.z;
+    float fDepth = m_fMaxZ - vCenter.z;
+
+    std::vector<VERTEX_FORMAT>& vSlices = entry->vTriangles;
+    vSlices.clear();
+    // a slice has at most six corners, i.e. four triangles
+    vSlices.reserve(size_t((fDepth - fMinZ) / fLayerDistance + 2) * 12);
+    do {
+      SliceBox(pBox, fDepth, m_bClipVolume, vSlices);
+      fDepth -= fLayerDistance;
+    } while (fDepth > fMinZ);
+  }
 
-/// @todo: should be replaced with std::sort.
-static void SortPoints(std::vector<VERTEX_FORMAT> &fArray) {
-  // for small arrays, this bubble sort actually beats qsort.
-  for (uint32_t i= 1;i<fArray.size();++i)
-    for (uint32_t j = 1;j<fArray.size()-i;++j)
-      if (!CheckOrdering(fArray[j].m_vPos,fArray[j+1].m_vPos,fArray[0].m_vPos))
-        std::swap(fArray[j], fArray[j+1]);
+  const std::vector<VERTEX_FORMAT>& vSlices = entry->vTriangles;
+  vTriangles.resize(vSlices.size());
+  for (size_t i = 0; i < vSlices.size(); ++i) {
+    vTriangles[i] = vSlices[i];
+    vTriangles[i].m_vPos += vCenter;
+  }
 }
@@ -94,44 +94,52 @@ namespace tuvok {
     */
     bool ComputeLayerGeometry(float fDepth);
 
-    /** 
-     \brief Triangulates a planar polygon specified by the vertices in fArray,
-     the result is appended to m_vSliceTriangles
-
-     \param fArray the vertices of the polygon
-    */
-    void Triangulate(std::vector<VERTEX_FORMAT> &fArray);
-
     //! returns the distance between two slices
     float GetLayerDistance() const;
 
-    
     /** 
-     \brief Computes the intersection of a plane perpendicular to the viewing
-     direction with a line (typically one of the edges of the the bounding box 
-     of the volume)
-
-     \param z distance of the plane to the viewer
-     \param plA starting point of the line
-     \param plB end point of the line
-     \param vHits intersection point of the line and the plane
-     \result true if the plane intersects the line
+     \brief Intersects a plane perpendicular to the viewing direction with a
+     box and appends the resulting convex polygon, as a triangle fan, to
+     vTriangles
+
+     \param pBox the eight vertices of the box, ordered like m_pfBBOXVertex
+     \param fDepth distance of the plane to the viewer
+     \param bClip value of m_bClip for the generated vertices
+     \param vTriangles the triangles are appended here
+     \result true if the plane intersects the box in more than a line
     */
-    static bool DepthPlaneIntersection(float z,
-                                    const VERTEX_FORMAT &plA,
-                                    const VERTEX_FORMAT &plB,
-                                    std::vector<VERTEX_FORMAT>& vHits,
-                                    bool bClip);
+    static bool SliceBox(const VERTEX_FORMAT* pBox, float fDepth, bool bClip,
+                         std::vector<VERTEX_FORMAT>& vTriangles);
 
     /** 
-     \brief inplace sorts a number lines by their gradient, the n-1 lines 
-     defined by an array of n vertices, whereas the m-th line is a connection 
-     of the (m-1)-th vertex to the first
-
-     \param fArray the vertices defining the lines
+     \brief Sets vTriangles to all slices of the current brick, without any
+     mesh, taking them from m_vSliceCache if possible.
+
+     The slices of a brick only depend on its shape and on the rotation of
+     the view; if the brick (or the view) moves, they move along.  Thus they
+     are cached relative to the center of the brick, per brick shape, and
+     are reused across bricks of the same shape and across frames in which
+     only the translation changed.
     */
-    static void SortByGradient(std::vector<VERTEX_FORMAT>& fArray);
-  
+    void ComputeCachedSlices(std::vector<VERTEX_FORMAT>& vTriangles);
+
+    /// The slices of one brick shape, relative to the brick center.
+    struct SliceCacheEntry {
+      FLOATVECTOR3 vAspect;
+      UINTVECTOR3  vSize;
+      FLOATVECTOR3 vTexCoordMin;
+      FLOATVECTOR3 vTexCoordMax;
+      //! m_matWorldView without the translation
+      FLOATMATRIX4 matRotation;
+      float        fSamplingModifier;
+      bool         bClip;
+      std::vector<VERTEX_FORMAT> vTriangles;
+    };
+    //! a dataset has few different brick shapes per LOD
+    std::vector<SliceCacheEntry> m_vSliceCache;
+    //! entry to replace next once m_vSliceCache is full
+    size_t m_iNextCacheEntry;
+
     SortIndexPVec::const_iterator m_MeshTransferIter;
     void DepthSortMeshWithVolume();
     void InsertMeshUpToSlice(float fDepth);
@@ -110,6 +110,7 @@ HEADERS += \
            Basics/Plane.h \
            Basics/ProgressTimer.h \
            Basics/SysTools.h \
+           Basics/TaskScheduler.h \
            Basics/Threads.h \
            Basics/Timer.h \
            Basics/TuvokException.h \
@@ -117,6 +118,7 @@ HEADERS += \
            Controller/Controller.h \
            Controller/MasterController.h \
            DebugOut/AbstrDebugOut.h \
+           DebugOut/AsyncDebugOut.h \
            DebugOut/ConsoleOut.h \
            DebugOut/MultiplexOut.h \
            DebugOut/TextfileOut.h \
@@ -163,13 +165,16 @@ HEADERS += \
            IO/BOVConverter.h \
            IO/BrickCache.h \
            IO/BrickedDataset.h \
+           IO/BrickTable.h \
            IO/const-brick-iterator.h \
            IO/Dataset.h \
            IO/DICOM/DICOMParser.h \
            IO/DirectoryParser.h \
+           IO/DiskBrickCache.h \
            IO/DSFactory.h \
            IO/DynamicBrickingDS.h \
            IO/FileBackedDataset.h \
+           IO/FilteredRAWFile.h \
            IO/G3D.h \
            IO/GeomViewConverter.h \
            IO/gzio.h \
@@ -189,14 +194,19 @@ HEADERS += \
            IO/MRCConverter.h \
            IO/NRRDConverter.h \
            IO/OBJGeoConverter.h \
+           IO/ParallelDecompression.h \
            IO/PLYGeoConverter.h \
+           IO/ProgressiveBrickRequest.h \
            IO/Quantize.h \
            IO/QVISConverter.h \
            IO/RAWConverter.h \
            IO/REKConverter.h \
+           IO/SharedBrickCache.h \
+           IO/StackDecoder.h \
            IO/StkConverter.h \
            IO/StLGeoConverter.h \
            IO/TiffVolumeConverter.h \
+           IO/TimestepPrefetcher.h \
            IO/TransferFunction1D.h \
            IO/TransferFunction2D.h \
            IO/TTIFFWriter/TTIFFWriter.h \
@@ -212,6 +222,7 @@ HEADERS += \
            IO/UVF/ExtendedOctree/Hilbert.h \
            IO/UVF/ExtendedOctree/Lz4Compression.h \
            IO/UVF/ExtendedOctree/LzmaCompression.h \
+           IO/UVF/ExtendedOctree/Morton.h \
            IO/UVF/ExtendedOctree/VolumeTools.h \
            IO/UVF/ExtendedOctree/ZlibCompression.h \
            IO/UVF/GeometryDataBlock.h \
@@ -301,7 +312,8 @@ HEADERS += \
 unix:HEADERS += \
   Basics/LargeFileAIO.h \
   Basics/LargeFileFD.h \
-  Basics/LargeFileMMap.h
+  Basics/LargeFileMMap.h \
+  Basics/LargeFileURing.h
 
 SOURCES += \
            3rdParty/GLEW/GL/glew.c \
@@ -354,10 +366,12 @@ SOURCES += \
            Basics/ProgressTimer.cpp \
            Basics/SystemInfo.cpp \
            Basics/SysTools.cpp \
+           Basics/TaskScheduler.cpp \
            Basics/Threads.cpp \
            Basics/Timer.cpp \
            Controller/MasterController.cpp \
            DebugOut/AbstrDebugOut.cpp \
+           DebugOut/AsyncDebugOut.cpp \
            DebugOut/ConsoleOut.cpp \
            DebugOut/MultiplexOut.cpp \
            DebugOut/TextfileOut.cpp \
@@ -480,13 +494,16 @@ SOURCES += \
            IO/BOVConverter.cpp \
            IO/BrickCache.cpp \
            IO/BrickedDataset.cpp \
+           IO/BrickTable.cpp \
            IO/const-brick-iterator.cpp \
            IO/Dataset.cpp \
            IO/DICOM/DICOMParser.cpp \
            IO/DirectoryParser.cpp \
+           IO/DiskBrickCache.cpp \
            IO/DSFactory.cpp \
            IO/DynamicBrickingDS.cpp \
            IO/FileBackedDataset.cpp \
+           IO/FilteredRAWFile.cpp \
            IO/G3D.cpp \
            IO/GeomViewConverter.cpp \
            IO/gzio.c \
@@ -506,13 +523,18 @@ SOURCES += \
            IO/MRCConverter.cpp \
            IO/NRRDConverter.cpp \
            IO/OBJGeoConverter.cpp \
+           IO/ParallelDecompression.cpp \
            IO/PLYGeoConverter.cpp \
+           IO/ProgressiveBrickRequest.cpp \
            IO/QVISConverter.cpp \
            IO/RAWConverter.cpp \
            IO/REKConverter.cpp \
+           IO/SharedBrickCache.cpp \
+           IO/StackDecoder.cpp \
            IO/StkConverter.cpp \
            IO/StLGeoConverter.cpp \
            IO/TiffVolumeConverter.cpp \
+           IO/TimestepPrefetcher.cpp \
            IO/TransferFunction1D.cpp \
            IO/TransferFunction2D.cpp \
            IO/TTIFFWriter/TTIFFWriter.cpp \
@@ -598,6 +620,7 @@ unix:SOURCES += \
   Basics/LargeFileAIO.cpp \
   Basics/LargeFileFD.cpp \
   Basics/LargeFileMMap.cpp \
+  Basics/LargeFileURing.cpp \
   IO/3rdParty/tiff/tif_unix.c
 
 win32 {